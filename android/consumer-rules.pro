@@ -0,0 +1,15 @@
+# Applied to apps that minify with R8. libmnn-rn finds these by name from native code.
+
+# JNI entry points are bound by class and method name
+-keepclasseswithmembernames,includedescriptorclasses class com.mnnrn.** {
+    native <methods>;
+}
+
+# Listener interfaces resolved in JNI_OnLoad (jni_registry.cpp), with the methods native code calls
+-keep interface com.mnnrn.MnnRnModule$ProgressListener { *; }
+-keep interface com.mnnrn.MnnRnModule$CompletionListener { *; }
+-keep interface com.mnnrn.MnnRnModule$BenchmarkListener { *; }
+-keep interface com.mnnrn.MnnRnModule$LoadListener { *; }
+-keep interface com.mnnrn.MnnRnModule$PrefillListener { *; }
+-keep interface com.mnnrn.MnnRnModule$ThermalListener { *; }
+-keep interface com.mnnrn.MnnRnModule$AudioBufferListener { *; }
@@ -0,0 +1,166 @@
+#include "backend_policy.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/stat.h>
+#include "MNN/expr/Executor.hpp"
+#include "mls_log.h"
+#include "prompt_snapshot.hpp"
+
+namespace mls {
+
+namespace {
+
+constexpr const char* kTuningMagic = "MBTC1";
+
+struct BackendSupport {
+    bool metal = false;
+    bool opencl = false;
+    bool vulkan = false;
+};
+
+const BackendSupport& ProbeBackends() {
+    static BackendSupport support;
+    static std::once_flag once;
+    std::call_once(once, []() {
+        MNN::ScheduleConfig config;
+        config.type = MNN_FORWARD_CPU;
+        std::shared_ptr<MNN::Express::Executor::RuntimeManager> runtime(
+                MNN::Express::Executor::RuntimeManager::createRuntimeManager(config),
+                MNN::Express::Executor::RuntimeManager::destroy);
+        if (!runtime) {
+            MNN_WARN("BackendPolicy: cannot create a runtime to probe backends");
+            return;
+        }
+        auto available = runtime->isBackendSupport({MNN_FORWARD_METAL, MNN_FORWARD_OPENCL, MNN_FORWARD_VULKAN});
+        if (available.size() == 3) {
+            support.metal = available[0];
+            support.opencl = available[1];
+            support.vulkan = available[2];
+        }
+        MNN_INFO("BackendPolicy: metal=%d opencl=%d vulkan=%d", support.metal, support.opencl, support.vulkan);
+    });
+    return support;
+}
+
+} // namespace
+
+BackendPolicy ParseBackendPolicy(const std::string& name) {
+    if (name == "cpu") {
+        return BackendPolicy::CPU;
+    }
+    if (name == "opencl") {
+        return BackendPolicy::OPENCL;
+    }
+    if (name == "vulkan") {
+        return BackendPolicy::VULKAN;
+    }
+    if (name == "metal") {
+        return BackendPolicy::METAL;
+    }
+    return BackendPolicy::AUTO;
+}
+
+const char* BackendTypeName(BackendPolicy policy) {
+    switch (policy) {
+        case BackendPolicy::OPENCL:
+            return "opencl";
+        case BackendPolicy::VULKAN:
+            return "vulkan";
+        case BackendPolicy::METAL:
+            return "metal";
+        default:
+            return "cpu";
+    }
+}
+
+bool IsBackendAvailable(BackendPolicy policy) {
+    const auto& support = ProbeBackends();
+    switch (policy) {
+        case BackendPolicy::CPU:
+            return true;
+        case BackendPolicy::OPENCL:
+            return support.opencl;
+        case BackendPolicy::VULKAN:
+            return support.vulkan;
+        case BackendPolicy::METAL:
+            return support.metal;
+        default:
+            return false;
+    }
+}
+
+BackendPolicy ResolveBackendPolicy(BackendPolicy policy) {
+    if (policy == BackendPolicy::AUTO) {
+        for (auto candidate : {BackendPolicy::METAL, BackendPolicy::OPENCL, BackendPolicy::VULKAN}) {
+            if (IsBackendAvailable(candidate)) {
+                return candidate;
+            }
+        }
+        return BackendPolicy::CPU;
+    }
+    if (!IsBackendAvailable(policy)) {
+        MNN_WARN("BackendPolicy: %s is not available, using cpu", BackendTypeName(policy));
+        return BackendPolicy::CPU;
+    }
+    return policy;
+}
+
+BackendTuningCache::BackendTuningCache(std::string root_dir) {
+    if (root_dir.empty()) {
+        return;
+    }
+    dir_ = root_dir + "/backend_tuning";
+    if (mkdir(dir_.c_str(), 0700) != 0 && errno != EEXIST) {
+        MNN_ERROR("BackendTuningCache: cannot create %s", dir_.c_str());
+        dir_.clear();
+    }
+}
+
+std::string BackendTuningCache::PathFor(const std::string& model_path, const std::string& backend) const {
+    return dir_ + "/" + PromptSnapshotStore::MakeKey(model_path, backend) + ".tune";
+}
+
+bool BackendTuningCache::Load(const std::string& model_path, const std::string& backend,
+                              int& op_encoder_number) const {
+    if (!enabled()) {
+        return false;
+    }
+    FILE* file = fopen(PathFor(model_path, backend).c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char magic[8] = {0};
+    int value = 0;
+    bool ok = fscanf(file, "%7s %d", magic, &value) == 2 && std::string(magic) == kTuningMagic && value > 0;
+    fclose(file);
+    if (ok) {
+        op_encoder_number = value;
+    }
+    return ok;
+}
+
+bool BackendTuningCache::Save(const std::string& model_path, const std::string& backend,
+                              int op_encoder_number) const {
+    if (!enabled()) {
+        return false;
+    }
+    auto path = PathFor(model_path, backend);
+    auto tmp_path = path + ".tmp";
+    FILE* file = fopen(tmp_path.c_str(), "w");
+    if (file == nullptr) {
+        MNN_ERROR("BackendTuningCache: cannot write %s", tmp_path.c_str());
+        return false;
+    }
+    bool ok = fprintf(file, "%s %d\n", kTuningMagic, op_encoder_number) > 0;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace mls
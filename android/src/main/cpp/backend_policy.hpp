@@ -0,0 +1,54 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <string>
+
+namespace mls {
+
+enum class BackendPolicy {
+    AUTO = 0,
+    CPU = 1,
+    OPENCL = 2,
+    VULKAN = 3,
+    METAL = 4,
+};
+
+// "auto", "cpu", "opencl", "vulkan" or "metal"; anything else is AUTO
+BackendPolicy ParseBackendPolicy(const std::string& name);
+
+// MNN LLM backend_type for a concrete policy; AUTO maps to "cpu"
+const char* BackendTypeName(BackendPolicy policy);
+
+/**
+ * Whether MNN can create the backend on this device. Probed once per process.
+ */
+bool IsBackendAvailable(BackendPolicy policy);
+
+/**
+ * Turn a policy into a concrete backend: AUTO picks the first available of Metal, OpenCL
+ * and Vulkan, and an unavailable GPU choice falls back to CPU.
+ */
+BackendPolicy ResolveBackendPolicy(BackendPolicy policy);
+
+/**
+ * Persisted GPU tuning results under mmap_dir/backend_tuning, keyed by model path and backend,
+ * so only the first launch pays for autotuning.
+ */
+class BackendTuningCache {
+public:
+    explicit BackendTuningCache(std::string root_dir);
+
+    bool Load(const std::string& model_path, const std::string& backend, int& op_encoder_number) const;
+    bool Save(const std::string& model_path, const std::string& backend, int op_encoder_number) const;
+
+    bool enabled() const { return !dir_.empty(); }
+
+private:
+    std::string PathFor(const std::string& model_path, const std::string& backend) const;
+
+    std::string dir_;
+};
+
+} // namespace mls
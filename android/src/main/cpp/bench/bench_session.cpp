@@ -0,0 +1,123 @@
+//
+// Created for MNN React Native bindings
+//
+// LlmSession against the mocked Llm in mock_mnn.cpp: what the binding layer adds around the model
+// per request and per token, with the model's own cost reduced to a byte copy.
+//
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "generation_metrics.hpp"
+#include "llm_session.h"
+#include "prompt_token_cache.hpp"
+
+namespace {
+
+std::unique_ptr<mls::LlmSession> LoadSession(int max_new_tokens, bool keep_history = false) {
+    json config = {{"max_new_tokens", max_new_tokens}, {"system_prompt", "You are a helpful assistant."}};
+    json extra_config = {{"mmap_dir", ""}, {"keep_history", keep_history}, {"prefetch_weights", false}};
+    auto session = std::make_unique<mls::LlmSession>("mock/config.json", config, extra_config,
+                                                     std::vector<std::string>{});
+    session->Load();
+    return session;
+}
+
+std::vector<mls::PromptItem> Conversation(int turns) {
+    std::vector<mls::PromptItem> history{{"system", "You are a helpful assistant."}};
+    for (int i = 0; i < turns; i++) {
+        history.emplace_back("user", "Question " + std::to_string(i) + ": what should I pack for a weekend hike?");
+        history.emplace_back("assistant", "Water, layers, a map, snacks and a small first aid kit. 🥾 "
+                                          "别忘了带雨衣。");
+    }
+    return history;
+}
+
+// A whole request, prefill to last chunk, with Arg tokens generated and one chunk per token
+void BM_ResponseLoop(benchmark::State& state) {
+    int tokens = static_cast<int>(state.range(0));
+    auto session = LoadSession(tokens);
+    size_t received = 0;
+    auto on_progress = [&received](const std::string& chunk, bool is_eop) {
+        received += chunk.size();
+        return false;
+    };
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(session->Response("Tell me about the weather today.", on_progress));
+    }
+    benchmark::DoNotOptimize(received);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * tokens));
+}
+BENCHMARK(BM_ResponseLoop)->Arg(1)->Arg(64)->Arg(512);
+
+// The same with output coalesced to one chunk per 16 tokens, as stream_flush would set it
+void BM_ResponseLoopBatched(benchmark::State& state) {
+    auto session = LoadSession(512);
+    session->setStreamFlushPolicy({{"max_tokens", 16}});
+    auto on_progress = [](const std::string& chunk, bool is_eop) { return false; };
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(session->Response("Tell me about the weather today.", on_progress));
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * 512));
+}
+BENCHMARK(BM_ResponseLoopBatched);
+
+// ResponseWithHistory with Arg turns: templating, tokenizing and prefilling a full conversation
+void BM_ResponseWithHistory(benchmark::State& state) {
+    auto session = LoadSession(16);
+    auto history = Conversation(static_cast<int>(state.range(0)));
+    history.emplace_back("user", "And for a week?");
+    auto on_progress = [](const std::string& chunk, bool is_eop) { return false; };
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(session->ResponseWithHistory(history, on_progress));
+    }
+}
+BENCHMARK(BM_ResponseWithHistory)->Arg(4)->Arg(32);
+
+/**
+ * History templating and tokenizing through PromptTokenCache. Arg 1 is 0 for a cold cache, every
+ * message tokenized, or 1 for a conversation that only added its last turn since the last prompt.
+ */
+void BM_HistoryTemplating(benchmark::State& state) {
+    std::unique_ptr<Llm> llm(Llm::createLLM("mock/config.json"));
+    auto history = Conversation(static_cast<int>(state.range(0)));
+    bool warm = state.range(1) != 0;
+    mls::PromptTokenCache cache;
+    for (int i = 0; warm && i <= mls::PromptTokenCache::kInitialValidations; i++) {
+        cache.Encode(llm.get(), history);
+    }
+    for (auto _ : state) {
+        if (!warm) {
+            cache.clear();
+        }
+        benchmark::DoNotOptimize(cache.Encode(llm.get(), history));
+    }
+    state.SetLabel(warm ? "warm" : "cold");
+}
+BENCHMARK(BM_HistoryTemplating)->ArgsProduct({{4, 32}, {0, 1}});
+
+// updateConfig: parsing the update, merging it into the session config and handing it to the model
+void BM_UpdateConfig(benchmark::State& state) {
+    auto session = LoadSession(256);
+    const std::string update = R"({"temperature":0.7,"topK":40,"topP":0.9,"penalty":1.1,"sampler_type":"mixed",
+                                   "mixed_samplers":["topK","topP","temperature"]})";
+    for (auto _ : state) {
+        session->updateConfig(update);
+    }
+}
+BENCHMARK(BM_UpdateConfig);
+
+/**
+ * The metrics a finished request reports, as the JNI completion path collects them before filling
+ * its HashMap and the JSI path before building its object. The JNI calls themselves need a JVM.
+ */
+void BM_CollectGenerationMetrics(benchmark::State& state) {
+    auto session = LoadSession(64);
+    const auto* context = session->Response("Hi", [](const std::string& chunk, bool is_eop) { return false; });
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(mls::CollectGenerationMetrics(*session, context));
+    }
+}
+BENCHMARK(BM_CollectGenerationMetrics);
+
+} // namespace
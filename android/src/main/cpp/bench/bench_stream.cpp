@@ -0,0 +1,118 @@
+//
+// Created for MNN React Native bindings
+//
+// Streaming path between MNN's output stream and the platform callback: UTF-8 reassembly,
+// the streambuf MNN writes into and chunk coalescing.
+//
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "llm_stream_buffer.hpp"
+#include "stream_chunk_batcher.hpp"
+#include "utf8_stream_processor.hpp"
+
+namespace {
+
+enum Script { kAscii, kCjk, kEmoji };
+
+// About 64 KB of text in one script
+std::string Text(int script) {
+    const char* unit = script == kAscii ? "The quick brown fox jumps over the lazy dog. "
+                       : script == kCjk ? "敏捷的棕色狐狸跳过了那只懒狗。"
+                                        : "🙂🚀👍🏽🎉❤️‍🔥 ";
+    std::string text;
+    while (text.size() < 64 * 1024) {
+        text += unit;
+    }
+    return text;
+}
+
+const char* ScriptName(int script) {
+    return script == kAscii ? "ascii" : script == kCjk ? "cjk" : "emoji";
+}
+
+/**
+ * processStream fed the way MNN decodes: one piece per token. Arg 1 is the piece size in bytes,
+ * 1 for byte-fallback tokens that split multi-byte characters, larger for merged tokens.
+ */
+void BM_Utf8StreamProcessor(benchmark::State& state) {
+    auto text = Text(static_cast<int>(state.range(0)));
+    size_t piece = static_cast<size_t>(state.range(1));
+    size_t emitted = 0;
+    mls::Utf8StreamProcessor processor([&emitted](std::string_view chars) { emitted += chars.size(); });
+    for (auto _ : state) {
+        for (size_t pos = 0; pos < text.size(); pos += piece) {
+            processor.processStream(text.data() + pos, std::min(piece, text.size() - pos));
+        }
+        benchmark::DoNotOptimize(emitted);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+    state.SetLabel(ScriptName(static_cast<int>(state.range(0))));
+}
+BENCHMARK(BM_Utf8StreamProcessor)->ArgsProduct({{kAscii, kCjk, kEmoji}, {1, 3, 4096}});
+
+// The std::ostream MNN writes each decoded token into, feeding the processor directly
+void BM_LlmStreamBuffer(benchmark::State& state) {
+    auto text = Text(static_cast<int>(state.range(0)));
+    constexpr size_t kPiece = 4;
+    size_t emitted = 0;
+    mls::Utf8StreamProcessor processor([&emitted](std::string_view chars) { emitted += chars.size(); });
+    LlmStreamBuffer buffer(&processor);
+    std::ostream os(&buffer);
+    for (auto _ : state) {
+        for (size_t pos = 0; pos < text.size(); pos += kPiece) {
+            os.write(text.data() + pos, static_cast<std::streamsize>(std::min(kPiece, text.size() - pos)));
+            os.flush();
+        }
+        benchmark::DoNotOptimize(emitted);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+    state.SetLabel(ScriptName(static_cast<int>(state.range(0))));
+}
+BENCHMARK(BM_LlmStreamBuffer)->Arg(kAscii)->Arg(kCjk)->Arg(kEmoji);
+
+// The same through the std::function constructor, the path a caller-supplied callback takes
+void BM_LlmStreamBufferCallback(benchmark::State& state) {
+    auto text = Text(kAscii);
+    constexpr size_t kPiece = 4;
+    size_t received = 0;
+    LlmStreamBuffer buffer([&received](const char* str, size_t len) { received += len; });
+    std::ostream os(&buffer);
+    for (auto _ : state) {
+        for (size_t pos = 0; pos < text.size(); pos += kPiece) {
+            os.write(text.data() + pos, static_cast<std::streamsize>(std::min(kPiece, text.size() - pos)));
+            os.flush();
+        }
+        benchmark::DoNotOptimize(received);
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+}
+BENCHMARK(BM_LlmStreamBufferCallback);
+
+// Appending one token's text at a time and flushing every Arg tokens, as stream_flush max_tokens
+void BM_StreamChunkBatcher(benchmark::State& state) {
+    auto text = Text(kCjk);
+    constexpr size_t kPiece = 3;
+    mls::StreamFlushPolicy policy;
+    policy.max_tokens = static_cast<int>(state.range(0));
+    size_t flushed = 0;
+    mls::StreamChunkBatcher::OnFlush on_flush = [&flushed](const std::string& chunk, bool is_eop) {
+        flushed += chunk.size();
+        return false;
+    };
+    mls::StreamChunkBatcher batcher(policy, on_flush);
+    for (auto _ : state) {
+        for (size_t pos = 0; pos < text.size(); pos += kPiece) {
+            batcher.append(std::string_view(text.data() + pos, std::min(kPiece, text.size() - pos)));
+            batcher.onToken();
+        }
+        batcher.flush();
+        benchmark::DoNotOptimize(flushed);
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * (text.size() / kPiece)));
+}
+BENCHMARK(BM_StreamChunkBatcher)->Arg(1)->Arg(8);
+
+} // namespace
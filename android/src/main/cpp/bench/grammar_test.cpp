@@ -0,0 +1,137 @@
+//
+// Created for MNN React Native bindings
+//
+// Grammar parsing and matching, and ConstrainedDecoder's masks through a session on the mock,
+// which samples its canned reply unless the mask rules the byte out.
+//
+#include <memory>
+#include <string>
+#include <vector>
+#include "constrained_decoder.hpp"
+#include "grammar.hpp"
+#include "llm_session.h"
+#include "test_check.hpp"
+
+namespace {
+
+using mls::Grammar;
+using mls::GrammarMatcher;
+
+std::shared_ptr<const Grammar> Compile(const std::string& kind, const std::string& spec) {
+    std::string error;
+    auto grammar = mls::CompileResponseFormat(kind, spec, &error);
+    if (grammar == nullptr) {
+        fprintf(stderr, "%s does not compile: %s\n", spec.c_str(), error.c_str());
+    }
+    return grammar;
+}
+
+// Whether the whole text is a complete match, fed one byte at a time as tokens would be
+bool Matches(const std::shared_ptr<const Grammar>& grammar, const std::string& text) {
+    GrammarMatcher matcher(grammar);
+    for (char c : text) {
+        if (!matcher.Advance(std::string(1, c))) {
+            return false;
+        }
+    }
+    return matcher.accepting();
+}
+
+void ParseErrors() {
+    std::string error;
+    CHECK(Grammar::Parse("item ::= \"a\"", &error) == nullptr);
+    CHECK(!error.empty());
+    error.clear();
+    CHECK(Grammar::Parse("root ::= missing", &error) == nullptr);
+    CHECK(!error.empty());
+    error.clear();
+    CHECK(Grammar::Parse("root ::= \"a", &error) == nullptr);
+    CHECK(!error.empty());
+    CHECK(mls::CompileResponseFormat("text", "", &error) == nullptr);
+}
+
+void MatcherStates() {
+    auto grammar = Compile("grammar", "root ::= \"yes\" | \"no\"");
+    CHECK(grammar != nullptr);
+    GrammarMatcher matcher(grammar);
+    CHECK(matcher.Advance("y"));
+    CHECK(!matcher.accepting());
+    // A rejected piece leaves the state as it was
+    CHECK(!matcher.Advance("x"));
+    CHECK(matcher.alive());
+    CHECK(matcher.Advance("es"));
+    CHECK(matcher.accepting());
+    CHECK(matcher.finished());
+
+    auto repeated = Compile("grammar", "root ::= [a-z]+ (\",\" [a-z]+)*");
+    CHECK(Matches(repeated, "abc,de"));
+    CHECK(!Matches(repeated, "abc,"));
+    CHECK(!Matches(repeated, "ab1"));
+    GrammarMatcher open(repeated);
+    CHECK(open.Advance("abc"));
+    CHECK(open.accepting());
+    CHECK(!open.finished());
+
+    // A class past ASCII takes any byte of a multi-byte character
+    auto cjk = Compile("grammar", "root ::= [一-龥]+");
+    CHECK(Matches(cjk, "当然"));
+    CHECK(!Matches(cjk, "ok"));
+}
+
+void JsonSchema() {
+    auto grammar = Compile("json_schema", R"({
+        "type": "object",
+        "properties": {"tool": {"enum": ["search", "weather"]}, "limit": {"type": "integer"}},
+        "required": ["tool"]
+    })");
+    CHECK(grammar != nullptr);
+    CHECK(Matches(grammar, R"({"tool": "search"})"));
+    CHECK(Matches(grammar, R"({"tool": "weather", "limit": 3})"));
+    CHECK(!Matches(grammar, R"({"tool": "music"})"));
+    CHECK(!Matches(grammar, R"({"limit": 3})"));
+    CHECK(!Matches(grammar, R"({"tool": "search", "limit": "3"})"));
+    std::string error;
+    CHECK(mls::CompileResponseFormat("json_schema", "{not json", &error) == nullptr);
+    CHECK(!error.empty());
+}
+
+std::string ConstrainedReply(const std::string& gbnf, int* resampled) {
+    json config = {{"max_new_tokens", 32}, {"system_prompt", "You are a helpful assistant."}};
+    json extra_config = {{"mmap_dir", ""}, {"prefetch_weights", false}};
+    mls::LlmSession session("mock/config.json", config, extra_config, std::vector<std::string>{});
+    session.Load();
+    session.setGrammar(Compile("grammar", gbnf));
+    std::string reply;
+    session.Response("Answer yes or no.", [&reply](const std::string& chunk, bool is_eop) {
+        if (!is_eop) {
+            reply += chunk;
+        }
+        return false;
+    });
+    *resampled = session.getGenerationStats().grammar_resampled;
+    return reply;
+}
+
+// The mock replies "Sure, here is a short answer. ..." one byte per token, token = byte + 1
+void MasksThroughDecoding() {
+    int resampled = -1;
+    // Bytes the grammar allows go out as sampled, and the complete match ends the reply
+    CHECK_EQ(ConstrainedReply("root ::= \"Sure\"", &resampled), std::string("Sure"));
+    CHECK_EQ(resampled, 0);
+    // 'S' and 'u' are masked out; with flat logits the lowest allowed token is drawn each time
+    CHECK_EQ(ConstrainedReply("root ::= \"yes\" | \"no\"", &resampled), std::string("no"));
+    CHECK_EQ(resampled, 2);
+    // Every step is masked for the state the previous one reached, not just the first
+    CHECK_EQ(ConstrainedReply("root ::= \"a\" \"a\" \"a\"", &resampled), std::string("aaa"));
+    CHECK_EQ(resampled, 3);
+}
+
+} // namespace
+
+int main() {
+    ParseErrors();
+    MatcherStates();
+    JsonSchema();
+    MasksThroughDecoding();
+    return TestResult();
+}
@@ -0,0 +1,336 @@
+//
+// Created for MNN React Native bindings
+//
+// Link-time stand-in for libMNN: the few Llm, Express and CV symbols the binding layer calls,
+// so the real LlmSession code runs without a model. Each byte is a token, the chat template is a
+// fixed ChatML-style one and the model replies with a canned mix of ASCII, CJK and emoji text,
+// one byte per decode step, so multi-byte characters arrive split as with byte-fallback vocabularies.
+//
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include "MNN/ImageProcess.hpp"
+#include "MNN/expr/Executor.hpp"
+#include "MNN/expr/ExecutorScope.hpp"
+#include "llm/llm.hpp"
+#include "nlohmann/json.hpp"
+
+namespace MNN {
+namespace Transformer {
+
+namespace {
+
+constexpr int kStopToken = 0;
+constexpr int kByteOffset = 1;
+constexpr int kVocabularySize = 256 + kByteOffset;
+
+const char* kReply =
+        "Sure, here is a short answer. 当然，这是一个简短的回答。 Of course 🙂 — let's go step by step 🚀. ";
+
+} // namespace
+
+// Only the mock sees its definition; it holds the config set_config merges into
+class LlmConfig {
+public:
+    nlohmann::json config = nlohmann::json::object();
+    // Position in kReply of the next byte the model "generates"
+    size_t reply_pos = 0;
+};
+
+Llm* Llm::createLLM(const std::string& config_path) {
+    return new Llm(std::make_shared<LlmConfig>());
+}
+
+void Llm::destroy(Llm* llm) {
+    delete llm;
+}
+
+Llm::Llm(std::shared_ptr<LlmConfig> config) : mConfig(std::move(config)) {
+    mContext = std::make_shared<LlmContext>();
+}
+
+Llm::~Llm() = default;
+
+bool Llm::load() {
+    return true;
+}
+
+Express::VARP Llm::gen_attention_mask(int seq_len) {
+    return nullptr;
+}
+
+Express::VARP Llm::gen_position_ids(int seq_len) {
+    return nullptr;
+}
+
+Express::VARP Llm::embedding(const std::vector<int>& input_ids) {
+    return nullptr;
+}
+
+int Llm::sample(Express::VARP logits, int offset, int size) {
+    const char* reply = kReply;
+    size_t length = std::strlen(reply);
+    auto byte = static_cast<unsigned char>(reply[mConfig->reply_pos]);
+    mConfig->reply_pos = (mConfig->reply_pos + 1) % length;
+    int token = byte + kByteOffset;
+    if (logits.get() != nullptr) {
+        // Masked logits: the reply byte if it is allowed, else the first of the highest allowed
+        const float* values = logits->readMap<float>();
+        if (values[token] == -std::numeric_limits<float>::infinity()) {
+            token = static_cast<int>(std::max_element(values, values + kVocabularySize) - values);
+        }
+    }
+    return token;
+}
+
+std::vector<Express::VARP> Llm::getOutputs() const {
+    // Flat logits over the vocabulary, for ConstrainedDecoder to mask
+    auto logits = Express::_Input({1, kVocabularySize}, Express::NHWC, halide_type_of<float>());
+    std::fill_n(logits->writeMap<float>(), kVocabularySize, 0.0f);
+    return {logits};
+}
+
+void Llm::reset() {
+    mContext->history_tokens.clear();
+    mContext->output_tokens.clear();
+    mContext->all_seq_len = 0;
+    mConfig->reply_pos = 0;
+}
+
+void Llm::tuning(TuneType type, std::vector<int> candidates) {}
+
+std::vector<Express::VARP> Llm::forwardRaw(Express::VARP hiddenState, Express::VARP mask, Express::VARP inputPos) {
+    return {};
+}
+
+size_t Llm::getCurrentHistory() const {
+    return static_cast<size_t>(mContext->all_seq_len);
+}
+
+void Llm::eraseHistory(size_t begin, size_t end) {
+    auto& tokens = mContext->history_tokens;
+    size_t stop = end == 0 ? tokens.size() : std::min(end, tokens.size());
+    if (begin < stop) {
+        tokens.erase(tokens.begin() + static_cast<long>(begin), tokens.begin() + static_cast<long>(stop));
+    }
+    mContext->all_seq_len = static_cast<int>(tokens.size());
+}
+
+void Llm::generate_init(std::ostream* os, const char* end_with) {
+    mContext->os = os;
+    mContext->end_with = end_with ? end_with : "";
+    mContext->gen_seq_len = 0;
+    mContext->output_tokens.clear();
+    mContext->generate_str.clear();
+}
+
+void Llm::response(const std::vector<int>& input_ids, std::ostream* os, const char* end_with, int max_new_tokens) {
+    generate_init(os, end_with);
+    mContext->prompt_len = static_cast<int>(input_ids.size());
+    mContext->history_tokens.insert(mContext->history_tokens.end(), input_ids.begin(), input_ids.end());
+    mContext->all_seq_len = static_cast<int>(mContext->history_tokens.size());
+    // The prefill samples the first token; each generate step emits the pending one and samples the next
+    mContext->current_token = sample(nullptr);
+    if (max_new_tokens > 0) {
+        generate(max_new_tokens);
+    }
+}
+
+void Llm::response(const ChatMessages& chat_prompts, std::ostream* os, const char* end_with, int max_new_tokens) {
+    response(tokenizer_encode(apply_chat_template(chat_prompts)), os, end_with, max_new_tokens);
+}
+
+void Llm::generate(int max_token) {
+    for (int i = 0; i < max_token; i++) {
+        int token = mContext->current_token;
+        if (is_stop(token)) {
+            if (mContext->os && !mContext->end_with.empty()) {
+                *mContext->os << mContext->end_with << std::flush;
+            }
+            return;
+        }
+        auto piece = tokenizer_decode(token);
+        if (mContext->os) {
+            *mContext->os << piece << std::flush;
+        }
+        mContext->output_tokens.push_back(token);
+        mContext->history_tokens.push_back(token);
+        mContext->all_seq_len++;
+        mContext->gen_seq_len++;
+        mContext->current_token = sample(nullptr);
+    }
+}
+
+std::string Llm::dump_config() {
+    return mConfig->config.dump();
+}
+
+bool Llm::set_config(const std::string& content) {
+    auto config = nlohmann::json::parse(content, nullptr, false);
+    if (config.is_discarded() || !config.is_object()) {
+        return false;
+    }
+    mConfig->config.update(config);
+    return true;
+}
+
+Llm* Llm::create_lora(const std::string& lora_path) {
+    return new Llm(std::make_shared<LlmConfig>(*mConfig));
+}
+
+bool Llm::is_stop(int token) {
+    return token == kStopToken;
+}
+
+std::string Llm::tokenizer_decode(int token) {
+    if (token < kByteOffset || token >= kVocabularySize) {
+        return "";
+    }
+    return std::string(1, static_cast<char>(token - kByteOffset));
+}
+
+std::vector<int> Llm::tokenizer_encode(const std::string& query) {
+    std::vector<int> ids;
+    ids.reserve(query.size());
+    for (unsigned char c : query) {
+        ids.push_back(c + kByteOffset);
+    }
+    return ids;
+}
+
+std::vector<int> Llm::tokenizer_encode(const MultimodalPrompt& multimodal_input) {
+    return tokenizer_encode(multimodal_input.prompt_template);
+}
+
+std::string Llm::apply_chat_template(const ChatMessages& chat_prompts) const {
+    std::string prompt;
+    for (const auto& [role, content] : chat_prompts) {
+        prompt += "<|im_start|>" + role + "\n" + content + "<|im_end|>\n";
+    }
+    return prompt + "<|im_start|>assistant\n";
+}
+
+} // namespace Transformer
+
+namespace Express {
+
+namespace {
+
+// The buffer and shape behind a VARP, reached through the Expr pointer it holds
+struct MockStorage {
+    Variable::Info info;
+    std::vector<uint8_t> data;
+};
+
+MockStorage* StorageOf(const EXPRP& expr) {
+    return reinterpret_cast<MockStorage*>(expr.get());
+}
+
+} // namespace
+
+VARP _Input(INTS shape, Dimensionformat data_format, halide_type_t dtype) {
+    auto storage = std::make_shared<MockStorage>();
+    storage->info.order = data_format;
+    storage->info.dim = shape;
+    storage->info.type = dtype;
+    storage->info.syncSize();
+    storage->data.resize(storage->info.size * dtype.bytes());
+    // Aliasing: the Expr pointer owns the storage and is never dereferenced as an Expr
+    return Variable::create(EXPRP(storage, reinterpret_cast<Expr*>(storage.get())));
+}
+
+VARP Variable::create(EXPRP expr, int index) {
+    return VARP(new Variable(std::move(expr), index));
+}
+
+void Variable::Info::syncSize() {
+    size = 1;
+    for (int d : dim) {
+        size *= static_cast<size_t>(std::max(d, 0));
+    }
+}
+
+const Variable::Info* Variable::getInfo() {
+    return mFrom ? &StorageOf(mFrom)->info : nullptr;
+}
+
+void* Variable::readInternal(bool forShape) {
+    return mFrom ? StorageOf(mFrom)->data.data() : nullptr;
+}
+
+void* Variable::writeInternal(bool inform) {
+    return readInternal(false);
+}
+
+Executor::Executor(std::shared_ptr<Runtime> backend, MNNForwardType type, int numberThread) {}
+
+Executor::~Executor() = default;
+
+void Executor::gc(GCFlag flag) {}
+
+std::shared_ptr<Executor> Executor::getGlobalExecutor() {
+    static std::shared_ptr<Executor> executor(new Executor(nullptr, MNN_FORWARD_CPU, 1));
+    return executor;
+}
+
+std::shared_ptr<Executor> Executor::newExecutor(MNNForwardType type, const BackendConfig& config, int numberThread) {
+    return std::shared_ptr<Executor>(new Executor(nullptr, type, numberThread));
+}
+
+// No runtime to probe: backend policies resolve to the CPU
+Executor::RuntimeManager* Executor::RuntimeManager::createRuntimeManager(const ScheduleConfig& config) {
+    return nullptr;
+}
+
+void Executor::RuntimeManager::destroy(RuntimeManager* rtmgr) {}
+
+std::vector<bool> Executor::RuntimeManager::isBackendSupport(const std::vector<MNNForwardType> type) {
+    return std::vector<bool>(type.size(), false);
+}
+
+ExecutorScope::ExecutorScope(const std::shared_ptr<Executor>& current) {}
+
+ExecutorScope::~ExecutorScope() = default;
+
+} // namespace Express
+
+namespace CV {
+
+void Matrix::reset() {
+    static const float kIdentity[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    std::memcpy(fMat, kIdentity, sizeof(fMat));
+    fTypeMask = kRectStaysRect_Mask;
+}
+
+void Matrix::setScale(float sx, float sy) {
+    reset();
+    fMat[kMScaleX] = sx;
+    fMat[kMScaleY] = sy;
+    fTypeMask = kUnknown_Mask;
+}
+
+ImageProcess::ImageProcess(const Config& config) : mInside(nullptr) {}
+
+ImageProcess::~ImageProcess() = default;
+
+ImageProcess* ImageProcess::create(const Config& config, const Tensor* dstTensor) {
+    return new ImageProcess(config);
+}
+
+void ImageProcess::destroy(ImageProcess* imageProcess) {
+    delete imageProcess;
+}
+
+void ImageProcess::setMatrix(const Matrix& matrix) {
+    mTransform = matrix;
+}
+
+// Images are not decoded by the mock: the destination is left as allocated
+ErrorCode ImageProcess::convert(const uint8_t* source, int iw, int ih, int stride, void* dest, int ow, int oh,
+                                int outputBpp, int outputStride, halide_type_t type) {
+    return NO_ERROR;
+}
+
+} // namespace CV
+} // namespace MNN
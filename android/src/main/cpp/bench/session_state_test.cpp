@@ -0,0 +1,193 @@
+//
+// Created for MNN React Native bindings
+//
+// SessionStateStore save and load on real files: a round trip, names that are refused, and state
+// files cut short or corrupted, which Load must reject and remove without reading past the mapping.
+//
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "session_state.hpp"
+#include "test_check.hpp"
+
+namespace {
+
+using mls::SessionStateData;
+using mls::SessionStateStore;
+
+// Byte offsets of the StateHeader fields the corruptions below patch
+constexpr size_t kTokenCountOffset = 24;
+constexpr size_t kMessageCountOffset = 28;
+constexpr size_t kImagesOffsetOffset = 48;
+constexpr size_t kHeaderSize = 64;
+
+std::string MakeRootDir() {
+    char dir[] = "/tmp/mnn-rn-state-test-XXXXXX";
+    return mkdtemp(dir) == nullptr ? std::string() : std::string(dir);
+}
+
+SessionStateData SampleState() {
+    SessionStateData data;
+    data.model_key = SessionStateStore::ModelKey("/models/qwen/config.json");
+    data.system_prompt = "You are a helpful assistant.";
+    data.summary = "Talked about the weather.";
+    data.messages = {{"user", "Hello"}, {"assistant", "当然，你好！"}};
+    data.image_counter = 3;
+    data.tokens = {11, 22, 33, 44, 55};
+    MNN::Transformer::PromptImagePart image;
+    image.image_data = MNN::Express::_Input({2, 3, 3}, MNN::Express::NHWC, halide_type_of<uint8_t>());
+    auto* pixels = image.image_data->writeMap<uint8_t>();
+    for (int i = 0; i < 2 * 3 * 3; i++) {
+        pixels[i] = static_cast<uint8_t>(i * 7);
+    }
+    image.width = 3;
+    image.height = 2;
+    data.images["image_2"] = image;
+    return data;
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+void WriteFile(const std::string& path, const std::string& bytes) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+}
+
+uint64_t ReadField(const std::string& bytes, size_t offset, size_t size) {
+    uint64_t value = 0;
+    memcpy(&value, bytes.data() + offset, size);
+    return value;
+}
+
+void PatchField(std::string* bytes, size_t offset, uint32_t value) {
+    memcpy(&(*bytes)[offset], &value, sizeof(value));
+}
+
+void RoundTrip(const SessionStateStore& store) {
+    auto saved = SampleState();
+    std::string error;
+    CHECK(store.Save("chat-1", saved, &error));
+    auto state = store.Load("chat-1", &error);
+    CHECK(state != nullptr);
+    if (state == nullptr) {
+        return;
+    }
+    auto& data = state->data();
+    CHECK_EQ(data.model_key, saved.model_key);
+    CHECK_EQ(data.system_prompt, saved.system_prompt);
+    CHECK_EQ(data.summary, saved.summary);
+    CHECK(data.messages == saved.messages);
+    CHECK_EQ(data.image_counter, saved.image_counter);
+    CHECK_EQ(state->tokenCount(), saved.tokens.size());
+    CHECK(std::equal(saved.tokens.begin(), saved.tokens.end(), state->tokens()));
+    CHECK_EQ(data.images.size(), size_t(1));
+    auto& image = data.images["image_2"];
+    CHECK_EQ(image.width, 3);
+    CHECK_EQ(image.height, 2);
+    CHECK(image.image_data.get() != nullptr &&
+          memcmp(image.image_data->readMap<uint8_t>(), saved.images["image_2"].image_data->readMap<uint8_t>(), 18) == 0);
+
+    // An empty state is written and read back as well
+    CHECK(store.Save("empty", SessionStateData{}, &error));
+    auto empty = store.Load("empty", &error);
+    CHECK(empty != nullptr && empty->tokenCount() == 0 && empty->data().messages.empty());
+}
+
+void RefusedNames(const SessionStateStore& store) {
+    std::vector<std::string> names = {"", ".hidden", "../escape", "a/b", "sp ace", std::string(129, 'x')};
+    for (const auto& name : names) {
+        std::string error;
+        CHECK(!SessionStateStore::ValidName(name));
+        CHECK(!store.Save(name, SampleState(), &error));
+        CHECK(!error.empty());
+        error.clear();
+        CHECK(store.Load(name, &error) == nullptr);
+        CHECK(!error.empty());
+    }
+    CHECK(SessionStateStore::ValidName("chat_2.v1"));
+    std::string error;
+    CHECK(store.Load("never-saved", &error) == nullptr);
+    CHECK(!error.empty());
+}
+
+void WithoutMmapDir() {
+    SessionStateStore store("");
+    CHECK(!store.enabled());
+    std::string error;
+    CHECK(!store.Save("chat-1", SampleState(), &error));
+    CHECK(!error.empty());
+    error.clear();
+    CHECK(store.Load("chat-1", &error) == nullptr);
+    CHECK(!error.empty());
+}
+
+// Saves a good state, damages its file with corrupt, and expects Load to reject and remove it
+void ExpectRejected(const SessionStateStore& store, const std::string& path, const char* what,
+                    void (*corrupt)(std::string*)) {
+    std::string error;
+    CHECK(store.Save("damaged", SampleState(), &error));
+    auto bytes = ReadFile(path);
+    corrupt(&bytes);
+    WriteFile(path, bytes);
+    auto state = store.Load("damaged", &error);
+    if (state != nullptr) {
+        fprintf(stderr, "%s: loaded a damaged state\n", what);
+    }
+    CHECK(state == nullptr);
+    CHECK(!error.empty());
+    CHECK(access(path.c_str(), F_OK) != 0);
+}
+
+void DamagedFiles(const SessionStateStore& store, const std::string& root_dir) {
+    std::string path = root_dir + "/session_states/damaged.state";
+    ExpectRejected(store, path, "bad magic", [](std::string* bytes) { (*bytes)[0] ^= 0x5A; });
+    ExpectRejected(store, path, "shorter than a header", [](std::string* bytes) { bytes->resize(kHeaderSize - 1); });
+    ExpectRejected(store, path, "truncated", [](std::string* bytes) { bytes->pop_back(); });
+    ExpectRejected(store, path, "grown", [](std::string* bytes) { bytes->push_back('\0'); });
+    ExpectRejected(store, path, "token count", [](std::string* bytes) {
+        PatchField(bytes, kTokenCountOffset, static_cast<uint32_t>(ReadField(*bytes, kTokenCountOffset, 4)) + 1);
+    });
+    // More messages than the strings section holds
+    ExpectRejected(store, path, "message count", [](std::string* bytes) {
+        PatchField(bytes, kMessageCountOffset, static_cast<uint32_t>(ReadField(*bytes, kMessageCountOffset, 4)) + 1);
+    });
+    // The system prompt's length runs past the end of the file
+    ExpectRejected(store, path, "string length", [](std::string* bytes) {
+        size_t strings_offset = kHeaderSize + ReadField(*bytes, kTokenCountOffset, 4) * sizeof(int);
+        PatchField(bytes, strings_offset, 0xFFFFFF00u);
+    });
+    // An image whose dimensions claim more pixels than are left
+    ExpectRejected(store, path, "image size", [](std::string* bytes) {
+        size_t images_offset = ReadField(*bytes, kImagesOffsetOffset, 8);
+        size_t name_length = ReadField(*bytes, images_offset, 4);
+        size_t dims_offset = images_offset + sizeof(uint32_t) + name_length + 2 * sizeof(int32_t);
+        PatchField(bytes, dims_offset, 1 << 20);
+    });
+    ExpectRejected(store, path, "negative image size", [](std::string* bytes) {
+        size_t images_offset = ReadField(*bytes, kImagesOffsetOffset, 8);
+        size_t name_length = ReadField(*bytes, images_offset, 4);
+        PatchField(bytes, images_offset + sizeof(uint32_t) + name_length + 2 * sizeof(int32_t), 0xFFFFFFFFu);
+    });
+}
+
+} // namespace
+
+int main() {
+    auto root_dir = MakeRootDir();
+    CHECK(!root_dir.empty());
+    SessionStateStore store(root_dir);
+    CHECK(store.enabled());
+    RoundTrip(store);
+    RefusedNames(store);
+    WithoutMmapDir();
+    DamagedFiles(store, root_dir);
+    return TestResult();
+}
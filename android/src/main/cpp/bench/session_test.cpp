@@ -0,0 +1,100 @@
+//
+// Created for MNN React Native bindings
+//
+// Regression checks for LlmSession against the mocked Llm in mock_mnn.cpp, run by ctest with a
+// timeout so a lock the worker never gets back fails the test instead of hanging it.
+//
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "llm_session.h"
+#include "test_check.hpp"
+
+namespace {
+
+// A model dir whose config gives the KV cache a size, so memory_budget_bytes has something to count
+std::string WriteModelDir() {
+    char dir[] = "/tmp/mnn-rn-session-test-XXXXXX";
+    if (mkdtemp(dir) == nullptr) {
+        return "mock";
+    }
+    std::ofstream(std::string(dir) + "/config.json") << R"({"key_value_shape": [2, 1, 0, 2, 64], "layer_nums": 4})";
+    return dir;
+}
+
+std::unique_ptr<mls::LlmSession> LoadSession(const std::string& model_dir, const json& extra,
+                                             int max_new_tokens = 16) {
+    json config = {{"max_new_tokens", max_new_tokens}, {"system_prompt", "You are a helpful assistant."}};
+    json extra_config = {{"mmap_dir", ""}, {"prefetch_weights", false}};
+    extra_config.update(extra);
+    auto session = std::make_unique<mls::LlmSession>(model_dir + "/config.json", config, extra_config,
+                                                     std::vector<std::string>{});
+    session->Load();
+    return session;
+}
+
+// EnforceMemoryBudget trims the KV cache while Response holds the shared model's turn
+void SharedModelOverMemoryBudget(const std::string& model_dir) {
+    json extra = {{"share_model", true}, {"keep_history", true}, {"memory_budget_bytes", 1}};
+    auto first = LoadSession(model_dir, extra);
+    auto second = LoadSession(model_dir, extra);
+    auto on_progress = [](const std::string&, bool) { return false; };
+    for (int turn = 0; turn < 2; turn++) {
+        for (auto* session : {first.get(), second.get()}) {
+            session->Response("Tell me about the weather today.", on_progress);
+            CHECK(session->getSessionMemory().kv_tokens > 0);
+        }
+    }
+    CHECK(first->getSessionMemory().last_trim == mls::TrimAction::KV_CACHE);
+    CHECK(second->getSessionMemory().last_trim == mls::TrimAction::KV_CACHE);
+}
+
+// A request without a progress callback runs to the end instead of calling an empty function
+void ResponseWithoutCallback(const std::string& model_dir) {
+    auto session = LoadSession(model_dir, {{"keep_history", true}});
+    session->Response("Tell me about the weather today.", nullptr);
+    CHECK(session->getSessionMemory().kv_tokens > 0);
+    session->ResponseWithHistory({{"system", "You are a helpful assistant."}, {"user", "Hello"}}, nullptr);
+    CHECK(session->getSessionMemory().kv_tokens > 0);
+}
+
+// The reply text a fresh mock session streams with extra_config "stop" set to stop
+std::string ReplyWithStop(const std::string& model_dir, const json& stop) {
+    auto session = LoadSession(model_dir, {{"stop", stop}}, 64);
+    std::string reply;
+    bool ended = false;
+    session->Response("Tell me about the weather today.", [&reply, &ended](const std::string& chunk, bool is_eop) {
+        if (is_eop) {
+            ended = true;
+        } else {
+            reply += chunk;
+        }
+        return false;
+    });
+    CHECK(ended);
+    return reply;
+}
+
+// The mock replies "Sure, here is a short answer. 当然..." one byte per token, token = byte + 1
+void StopSequencesAndTokens(const std::string& model_dir) {
+    // Cut across tokens, with the text before the sequence kept
+    CHECK_EQ(ReplyWithStop(model_dir, {{"sequences", {"short answer"}}}), std::string("Sure, here is a "));
+    // The space held back as the start of " isX" is released when the stop token 'i' ends the reply
+    CHECK_EQ(ReplyWithStop(model_dir, {{"sequences", {" isX"}}, {"token_ids", {'i' + 1}}}), std::string("Sure, here "));
+    // The first byte of a CJK character streams no text of its own and still stops generation
+    CHECK_EQ(ReplyWithStop(model_dir, {{"token_ids", {0xE5 + 1}}}), std::string("Sure, here is a short answer. "));
+    // A stop token sampled by the prefill is checked before it goes out
+    CHECK_EQ(ReplyWithStop(model_dir, {{"token_ids", {'S' + 1}}}), std::string());
+}
+
+} // namespace
+
+int main() {
+    auto model_dir = WriteModelDir();
+    SharedModelOverMemoryBudget(model_dir);
+    ResponseWithoutCallback(model_dir);
+    StopSequencesAndTokens(model_dir);
+    return TestResult();
+}
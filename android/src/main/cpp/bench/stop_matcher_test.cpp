@@ -0,0 +1,123 @@
+//
+// Created for MNN React Native bindings
+//
+// StopMatcher on its own: what each piece of output releases and where a reply is cut.
+//
+#include <string>
+#include <vector>
+#include "mls_config.h"
+#include "stop_matcher.hpp"
+#include "test_check.hpp"
+
+namespace {
+
+using mls::END_OF_PROMPT;
+using mls::STOP_MAX_SEQUENCE_BYTES;
+using mls::STOP_MAX_SEQUENCES;
+using mls::StopConfig;
+using mls::StopMatcher;
+
+StopMatcher MatcherFor(const char* config) {
+    StopMatcher matcher;
+    matcher.setConfig(StopConfig::Parse(nlohmann::json::parse(config)));
+    return matcher;
+}
+
+// The text pieces release, Drain included when no sequence matched
+std::string Run(StopMatcher& matcher, const std::vector<std::string>& pieces, bool* matched) {
+    std::string out;
+    matcher.Reset();
+    *matched = false;
+    for (const auto& piece : pieces) {
+        out.append(matcher.Feed(piece, matched));
+        if (*matched) {
+            return out;
+        }
+    }
+    out.append(matcher.Drain());
+    return out;
+}
+
+void SequenceAcrossPieces() {
+    auto matcher = MatcherFor(R"({"sequences": ["\nUser:"]})");
+    bool matched = false;
+    CHECK_EQ(Run(matcher, {"Hello \nUs", "er: more"}, &matched), std::string("Hello "));
+    CHECK(matched);
+    // The same bytes in one piece
+    CHECK_EQ(Run(matcher, {"Hello \nUser: more"}, &matched), std::string("Hello "));
+    CHECK(matched);
+    // Held bytes come out with the piece that rules the sequence out
+    CHECK_EQ(std::string(matcher.Feed("a\nU", &matched)), std::string("a"));
+    CHECK(!matched);
+    CHECK_EQ(std::string(matcher.Feed("p", &matched)), std::string("\nUp"));
+    CHECK(!matched);
+}
+
+void SequenceInsideLongerOne() {
+    auto matcher = MatcherFor(R"({"sequences": ["abc", "b"]})");
+    bool matched = false;
+    // "b" ends inside "abc" and completes first
+    CHECK_EQ(Run(matcher, {"zza", "bc"}, &matched), std::string("zza"));
+    CHECK(matched);
+    // A failure link into a shorter sequence: "xab" falls back to "ab", then "abc" completes
+    auto longer = MatcherFor(R"({"sequences": ["xay", "abc"]})");
+    CHECK_EQ(Run(longer, {"xa", "bc!"}, &matched), std::string("x"));
+    CHECK(matched);
+}
+
+void DrainAfterPartialMatch() {
+    auto matcher = MatcherFor(R"({"sequences": ["</answer>"]})");
+    bool matched = false;
+    CHECK_EQ(std::string(matcher.Feed("42 </ans", &matched)), std::string("42 "));
+    CHECK(!matched);
+    CHECK_EQ(std::string(matcher.Drain()), std::string("</ans"));
+    // Drain resets, so the next reply starts clean
+    CHECK_EQ(std::string(matcher.Drain()), std::string());
+    CHECK_EQ(std::string(matcher.Feed("wer>", &matched)), std::string("wer>"));
+    CHECK(!matched);
+}
+
+void EndOfPromptAlwaysMatches() {
+    StopMatcher matcher;
+    bool matched = false;
+    std::string piece = std::string("done") + END_OF_PROMPT + "ignored";
+    CHECK_EQ(Run(matcher, {piece}, &matched), std::string("done"));
+    CHECK(matched);
+    // Output that cannot start a sequence is passed through without a copy
+    std::string plain = "plain text";
+    auto out = matcher.Feed(plain, &matched);
+    CHECK(out.data() == plain.data());
+    CHECK(!matched);
+}
+
+void ParseLimitsAndStopTokens() {
+    std::string long_sequence(STOP_MAX_SEQUENCE_BYTES + 1, 'x');
+    nlohmann::json config = {{"sequences", {"", long_sequence, "ok"}}, {"token_ids", {7, 3, 7, "9"}}};
+    auto parsed = StopConfig::Parse(config);
+    CHECK_EQ(parsed.sequences, std::vector<std::string>{"ok"});
+    CHECK_EQ(parsed.token_ids.size(), size_t(3));
+    nlohmann::json many = {{"sequences", nlohmann::json::array()}};
+    for (size_t i = 0; i < STOP_MAX_SEQUENCES + 4; i++) {
+        many["sequences"].push_back("s" + std::to_string(i));
+    }
+    CHECK_EQ(StopConfig::Parse(many).sequences.size(), STOP_MAX_SEQUENCES);
+
+    StopMatcher matcher;
+    CHECK(!matcher.hasStopTokens());
+    matcher.setConfig(parsed);
+    CHECK(matcher.hasStopTokens());
+    CHECK(matcher.isStopToken(3));
+    CHECK(matcher.isStopToken(7));
+    CHECK(!matcher.isStopToken(9));
+}
+
+} // namespace
+
+int main() {
+    SequenceAcrossPieces();
+    SequenceInsideLongerOne();
+    DrainAfterPartialMatch();
+    EndOfPromptAlwaysMatches();
+    ParseLimitsAndStopTokens();
+    return TestResult();
+}
@@ -0,0 +1,40 @@
+//
+// Created for MNN React Native bindings
+//
+// The few macros the host tests share: a failed CHECK is reported and counted, and
+// TEST_MAIN's exit status tells ctest whether any failed.
+//
+#pragma once
+
+#include <cstdio>
+
+namespace mls_test {
+inline int g_failures = 0;
+} // namespace mls_test
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            mls_test::g_failures++;                                                       \
+        }                                                                                 \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                  \
+    do {                                                                                            \
+        const auto& check_actual = (actual);                                                        \
+        const auto& check_expected = (expected);                                                    \
+        if (!(check_actual == check_expected)) {                                                    \
+            fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed\n", __FILE__, __LINE__, #actual, #expected); \
+            mls_test::g_failures++;                                                                 \
+        }                                                                                           \
+    } while (0)
+
+inline int TestResult() {
+    if (mls_test::g_failures != 0) {
+        fprintf(stderr, "%d checks failed\n", mls_test::g_failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,225 @@
+//
+// Created for MNN React Native bindings
+//
+#include "constrained_decoder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include "MNN/expr/ExprCreator.hpp"
+#include "json_schema_grammar.hpp"
+#include "mls_config.h"
+#include "mls_log.h"
+
+namespace mls {
+
+using MNN::Transformer::Llm;
+using MNN::Transformer::LlmContext;
+
+void ConstrainedDecoder::setGrammar(std::shared_ptr<const Grammar> grammar) {
+    grammar_ = std::move(grammar);
+    // Cached masks are keyed by positions in the grammar they were built for
+    masks_.clear();
+    matcher_ = grammar_ ? GrammarMatcher(grammar_) : GrammarMatcher();
+}
+
+void ConstrainedDecoder::Begin() {
+    if (grammar_) {
+        matcher_ = GrammarMatcher(grammar_);
+    }
+    resampled_ = 0;
+    mask_us_ = 0;
+}
+
+void ConstrainedDecoder::clearVocabulary() {
+    vocabulary_ = Vocabulary();
+    masks_.clear();
+}
+
+bool ConstrainedDecoder::Accept(Llm* llm, int token) {
+    if (llm->is_stop(token)) {
+        return matcher_.accepting();
+    }
+    auto piece = llm->tokenizer_decode(token);
+    return !piece.empty() && matcher_.Advance(piece);
+}
+
+void ConstrainedDecoder::SetPending(Llm* llm, int token) {
+    // The context is only exposed const; the next generate(1) emits and forwards current_token
+    const_cast<LlmContext*>(llm->getContext())->current_token = token;
+}
+
+bool ConstrainedDecoder::EnsureVocabulary(Llm* llm, int size) {
+    if (vocabulary_.size == size) {
+        return true;
+    }
+    auto start = std::chrono::steady_clock::now();
+    clearVocabulary();
+    vocabulary_.size = size;
+    vocabulary_.pieces.resize(static_cast<size_t>(size));
+    for (int id = 0; id < size; id++) {
+        if (llm->is_stop(id)) {
+            vocabulary_.stop_tokens.push_back(id);
+            continue;
+        }
+        vocabulary_.pieces[id] = llm->tokenizer_decode(id);
+        // Tokens without text (padding, control tokens) can never advance a grammar
+        if (!vocabulary_.pieces[id].empty()) {
+            vocabulary_.sorted.push_back(id);
+        }
+    }
+    const auto& pieces = vocabulary_.pieces;
+    std::sort(vocabulary_.sorted.begin(), vocabulary_.sorted.end(),
+              [&pieces](int a, int b) { return pieces[a] < pieces[b]; });
+    vocabulary_.shared_prefix.resize(vocabulary_.sorted.size(), 0);
+    for (size_t k = 1; k < vocabulary_.sorted.size(); k++) {
+        const auto& previous = pieces[vocabulary_.sorted[k - 1]];
+        const auto& piece = pieces[vocabulary_.sorted[k]];
+        auto mismatch = std::mismatch(previous.begin(), previous.end(), piece.begin(), piece.end());
+        vocabulary_.shared_prefix[k] = static_cast<uint32_t>(mismatch.first - previous.begin());
+    }
+    MNN_DEBUG("ConstrainedDecoder: read %d tokens (%zu with text) in %lldms", size, vocabulary_.sorted.size(),
+              (long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now() - start).count());
+    return !vocabulary_.sorted.empty();
+}
+
+const ConstrainedDecoder::Mask& ConstrainedDecoder::CurrentMask() {
+    std::vector<const Grammar::Element*> key;
+    for (const auto& stack : matcher_.stacks()) {
+        key.insert(key.end(), stack.begin(), stack.end());
+        key.push_back(nullptr);
+    }
+    auto cached = masks_.find(key);
+    if (cached != masks_.end()) {
+        return cached->second;
+    }
+    if (masks_.size() >= GRAMMAR_MASK_CACHE_SIZE) {
+        masks_.clear();
+    }
+    Mask mask((static_cast<size_t>(vocabulary_.size) + 63) / 64, 0);
+    // Walk the tokens in sorted order, keeping the grammar state after each byte of the previous
+    // one: a token only advances past the prefix it shares with it. Once a prefix is rejected,
+    // the tokens after it that share it are skipped without matching.
+    std::vector<std::vector<GrammarMatcher::Stack>> states{matcher_.stacks()};
+    size_t rejected_prefix = std::numeric_limits<size_t>::max();
+    for (size_t k = 0; k < vocabulary_.sorted.size(); k++) {
+        int id = vocabulary_.sorted[k];
+        const auto& piece = vocabulary_.pieces[id];
+        size_t shared = vocabulary_.shared_prefix[k];
+        if (shared >= rejected_prefix) {
+            continue;
+        }
+        rejected_prefix = std::numeric_limits<size_t>::max();
+        states.resize(shared + 1);
+        for (size_t i = shared; i < piece.size(); i++) {
+            auto next = matcher_.Next(states.back(), static_cast<uint8_t>(piece[i]));
+            if (next.empty()) {
+                rejected_prefix = i + 1;
+                break;
+            }
+            states.push_back(std::move(next));
+        }
+        if (rejected_prefix == std::numeric_limits<size_t>::max()) {
+            mask[id / 64] |= uint64_t{1} << (id % 64);
+        }
+    }
+    return masks_.emplace(std::move(key), std::move(mask)).first->second;
+}
+
+void ConstrainedDecoder::Step(Llm* llm) {
+    if (!grammar_) {
+        return;
+    }
+    bool complete = matcher_.accepting();
+    if (!matcher_.finished() && Accept(llm, llm->getContext()->current_token)) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto outputs = llm->getOutputs();
+    const auto* info = outputs.empty() || outputs[0].get() == nullptr ? nullptr : outputs[0]->getInfo();
+    if (info == nullptr || info->dim.empty() || !EnsureVocabulary(llm, info->dim.back())) {
+        MNN_WARN("ConstrainedDecoder: no logits to mask, leaving the sampled token");
+        return;
+    }
+    if (complete) {
+        // Nothing the model wanted fits after a complete match
+        if (!vocabulary_.stop_tokens.empty()) {
+            SetPending(llm, vocabulary_.stop_tokens.front());
+        }
+        return;
+    }
+    const auto& mask = CurrentMask();
+    int size = vocabulary_.size;
+    // Logits of the last position when the output holds several
+    const float* logits = outputs[0]->readMap<float>() + (info->size - size);
+    auto masked = MNN::Express::_Input({size}, MNN::Express::NHWC, halide_type_of<float>());
+    float* out = masked->writeMap<float>();
+    const float excluded = -std::numeric_limits<float>::infinity();
+    int allowed = -1;
+    float best = excluded;
+    for (int base = 0; base < size; base += 64) {
+        uint64_t bits = mask[base / 64];
+        int end = std::min(size, base + 64);
+        if (bits == 0) {
+            std::fill(out + base, out + end, excluded);
+            continue;
+        }
+        for (int id = base; id < end; id++) {
+            bool keep = (bits >> (id - base)) & 1;
+            out[id] = keep ? logits[id] : excluded;
+            if (keep && (allowed < 0 || logits[id] > best)) {
+                allowed = id;
+                best = logits[id];
+            }
+        }
+    }
+    mask_us_ += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    if (allowed < 0) {
+        MNN_WARN("ConstrainedDecoder: no token continues the grammar, ending the reply");
+        if (!vocabulary_.stop_tokens.empty()) {
+            SetPending(llm, vocabulary_.stop_tokens.front());
+        }
+        return;
+    }
+    int token = llm->sample(masked);
+    if (token < 0 || token >= size || ((mask[token / 64] >> (token % 64)) & 1) == 0) {
+        // A sampler that ignored the mask, e.g. on all -inf after penalties: take the best allowed token
+        token = allowed;
+    }
+    resampled_++;
+    matcher_.Advance(vocabulary_.pieces[token]);
+    SetPending(llm, token);
+}
+
+std::shared_ptr<const Grammar> CompileResponseFormat(const std::string& kind, const std::string& spec,
+                                                     std::string* error) {
+    if (kind.empty() || kind == "text") {
+        return nullptr;
+    }
+    std::string gbnf;
+    if (kind == "grammar") {
+        gbnf = spec;
+    } else if (kind == "json" || kind == "json_schema") {
+        auto schema = kind == "json" ? nlohmann::ordered_json{{"type", "object"}}
+                                     : nlohmann::ordered_json::parse(spec, nullptr, false);
+        if (schema.is_discarded()) {
+            *error = "schema is not valid JSON";
+            return nullptr;
+        }
+        gbnf = JsonSchemaToGbnf(schema, error);
+        if (gbnf.empty()) {
+            return nullptr;
+        }
+    } else {
+        *error = "unknown response format '" + kind + "'";
+        return nullptr;
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto grammar = Grammar::Parse(gbnf, error);
+    MNN_DEBUG("CompileResponseFormat: %s, %zu rules in %lldus", kind.c_str(), grammar ? grammar->rules().size() : 0,
+              (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - start).count());
+    return grammar;
+}
+
+} // namespace mls
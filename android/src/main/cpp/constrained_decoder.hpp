@@ -0,0 +1,78 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "llm/llm.hpp"
+#include "grammar.hpp"
+
+namespace mls {
+
+/**
+ * Keeps a reply inside a grammar. MNN samples each token inside generate() and only emits it
+ * on the next call, so between calls the pending token in LlmContext::current_token is checked
+ * against the grammar. A token the grammar accepts goes out as sampled; otherwise its logits
+ * are masked to the tokens the grammar allows from the current state and Llm::sample runs
+ * again. Masks are bitsets over the vocabulary, cached by grammar state, so a state seen
+ * before costs one pass over the logits. Once the reply is a complete match, a stop token or
+ * any token the grammar rejects ends it.
+ */
+class ConstrainedDecoder {
+public:
+    // Constrain the replies that follow; nullptr lets the model generate freely again
+    void setGrammar(std::shared_ptr<const Grammar> grammar);
+    bool active() const { return grammar_ != nullptr; }
+
+    // Start a reply at the grammar's root
+    void Begin();
+    /**
+     * Make the token pending in llm's context one the grammar allows, resampling it if needed,
+     * or a stop token when the reply is complete. Call before every generate(1).
+     */
+    void Step(MNN::Transformer::Llm* llm);
+    // Drop the vocabulary and masks, when the model they were read from is released
+    void clearVocabulary();
+
+    // Of the current reply: tokens resampled under a mask and time spent building and applying masks
+    int resampled() const { return resampled_; }
+    int64_t maskUs() const { return mask_us_; }
+
+private:
+    using Mask = std::vector<uint64_t>;
+
+    struct Vocabulary {
+        int size = 0;
+        std::vector<std::string> pieces;
+        // Token ids with text sorted by it, and the prefix each shares with the one before
+        std::vector<int> sorted;
+        std::vector<uint32_t> shared_prefix;
+        std::vector<int> stop_tokens;
+    };
+
+    bool Accept(MNN::Transformer::Llm* llm, int token);
+    bool EnsureVocabulary(MNN::Transformer::Llm* llm, int size);
+    const Mask& CurrentMask();
+    void SetPending(MNN::Transformer::Llm* llm, int token);
+
+    std::shared_ptr<const Grammar> grammar_;
+    GrammarMatcher matcher_;
+    Vocabulary vocabulary_;
+    std::map<std::vector<const Grammar::Element*>, Mask> masks_;
+    int resampled_ = 0;
+    int64_t mask_us_ = 0;
+};
+
+/**
+ * Grammar for a response format: kind "json_schema" with the schema as JSON text, "grammar"
+ * with GBNF, "json" for any JSON object (spec unused), or "text" for no constraint.
+ * @return nullptr for "text", or with a message in error if spec does not compile
+ */
+std::shared_ptr<const Grammar> CompileResponseFormat(const std::string& kind, const std::string& spec,
+                                                     std::string* error);
+
+} // namespace mls
@@ -0,0 +1,141 @@
+//
+// Created for MNN React Native bindings
+//
+#include "context_manager.hpp"
+#include <algorithm>
+#include <unordered_set>
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+// Bounds the measured template overhead in case a template adds a long default system prompt
+constexpr int kMaxMessageOverhead = 32;
+
+} // namespace
+
+ContextBudget ContextBudget::Parse(const nlohmann::json& config) {
+    ContextBudget budget;
+    if (!config.is_object()) {
+        return budget;
+    }
+    budget.max_tokens = std::max(0, config.value("max_tokens", 0));
+    budget.reserve_tokens = config.value("reserve_tokens", -1);
+    budget.summary_tokens = std::max(16, config.value("summary_tokens", budget.summary_tokens));
+    auto policy = config.value("policy", std::string("sliding_window"));
+    if (policy == "summarize") {
+        budget.policy = ContextPolicy::SUMMARIZE;
+    } else if (policy != "sliding_window") {
+        MNN_WARN("ContextBudget: unknown policy %s, using sliding_window", policy.c_str());
+    }
+    if (budget.enabled() && budget.promptTokens() <= 0) {
+        MNN_WARN("ContextBudget: reserve_tokens %d leaves no room for the prompt, budget disabled",
+                 budget.reserve_tokens);
+        budget.max_tokens = 0;
+    }
+    return budget;
+}
+
+uint64_t ContextManager::Hash(const PromptItem& item) {
+    uint64_t hash = 1469598103934665603ULL;
+    auto mix = [&hash](const std::string& str) {
+        for (unsigned char c : str) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+    };
+    mix(item.first);
+    hash ^= 0xff;
+    hash *= 1099511628211ULL;
+    mix(item.second);
+    return hash;
+}
+
+int ContextManager::MessageOverhead(MNN::Transformer::Llm* llm) {
+    if (overhead_ >= 0) {
+        return overhead_;
+    }
+    // Two extra turns in an otherwise identical prompt cancel out the system prompt and
+    // generation prefix the template may add
+    MNN::Transformer::ChatMessages one{{"user", "c"}};
+    MNN::Transformer::ChatMessages three{{"user", "a"}, {"assistant", "b"}, {"user", "c"}};
+    int with_two = static_cast<int>(llm->tokenizer_encode(llm->apply_chat_template(three)).size());
+    int base = static_cast<int>(llm->tokenizer_encode(llm->apply_chat_template(one)).size());
+    int content = static_cast<int>(llm->tokenizer_encode("a").size() + llm->tokenizer_encode("b").size());
+    overhead_ = std::clamp((with_two - base - content + 1) / 2, 0, kMaxMessageOverhead);
+    MNN_DEBUG("ContextManager: %d template tokens per message", overhead_);
+    return overhead_;
+}
+
+int ContextManager::MessageTokens(MNN::Transformer::Llm* llm, const PromptItem& item) {
+    auto key = Hash(item);
+    auto it = counts_.find(key);
+    if (it != counts_.end()) {
+        return it->second;
+    }
+    int tokens = static_cast<int>(llm->tokenizer_encode(item.second).size()) + MessageOverhead(llm);
+    counts_.emplace(key, tokens);
+    return tokens;
+}
+
+int ContextManager::HistoryTokens(MNN::Transformer::Llm* llm, const std::vector<PromptItem>& history) {
+    int total = 0;
+    for (const auto& item : history) {
+        total += MessageTokens(llm, item);
+    }
+    return total;
+}
+
+std::vector<PromptItem> ContextManager::Fit(MNN::Transformer::Llm* llm, std::vector<PromptItem>& history,
+                                            int* prompt_tokens) {
+    std::vector<PromptItem> evicted;
+    if (!enabled() || llm == nullptr || history.size() < 3) {
+        return evicted;
+    }
+    int limit = budget_.promptTokens();
+    int total = HistoryTokens(llm, history);
+    if (counts_.size() > 2 * history.size() + 64) {
+        Prune(history);
+    }
+    if (prompt_tokens) {
+        *prompt_tokens = total;
+    }
+    if (total <= limit) {
+        return evicted;
+    }
+    // history[0] is the system prompt and history.back() the turn being answered
+    size_t first_kept = 1;
+    size_t last = history.size() - 1;
+    while (first_kept < last && total > limit) {
+        total -= MessageTokens(llm, history[first_kept]);
+        first_kept++;
+        // Never leave the window starting on a reply to an evicted question
+        while (first_kept < last && history[first_kept].first == "assistant") {
+            total -= MessageTokens(llm, history[first_kept]);
+            first_kept++;
+        }
+    }
+    evicted.assign(history.begin() + 1, history.begin() + static_cast<std::ptrdiff_t>(first_kept));
+    history.erase(history.begin() + 1, history.begin() + static_cast<std::ptrdiff_t>(first_kept));
+    if (prompt_tokens) {
+        *prompt_tokens = total;
+    }
+    if (total > limit) {
+        MNN_WARN("ContextManager: %d prompt tokens exceed the budget of %d after eviction", total, limit);
+    }
+    MNN_DEBUG("ContextManager: evicted %zu messages, %d prompt tokens left", evicted.size(), total);
+    return evicted;
+}
+
+void ContextManager::Prune(const std::vector<PromptItem>& history) {
+    std::unordered_set<uint64_t> live;
+    for (const auto& item : history) {
+        live.insert(Hash(item));
+    }
+    for (auto it = counts_.begin(); it != counts_.end();) {
+        it = live.count(it->first) ? std::next(it) : counts_.erase(it);
+    }
+}
+
+} // namespace mls
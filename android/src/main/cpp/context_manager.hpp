@@ -0,0 +1,80 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "nlohmann/json.hpp"
+#include "llm/llm.hpp"
+
+namespace mls {
+
+using PromptItem = std::pair<std::string, std::string>;
+
+enum class ContextPolicy {
+    // Drop the oldest turns
+    SLIDING_WINDOW,
+    // Drop the oldest turns and fold them into a model-written summary in the system prompt
+    SUMMARIZE,
+};
+
+/**
+ * Token budget of the templated prompt, from extra_config "context":
+ * {"max_tokens": n, "reserve_tokens": n, "policy": "sliding_window" | "summarize", "summary_tokens": n}
+ */
+struct ContextBudget {
+    // 0 disables the budget
+    int max_tokens = 0;
+    // Kept free for the reply; -1 reserves a quarter of max_tokens
+    int reserve_tokens = -1;
+    ContextPolicy policy = ContextPolicy::SLIDING_WINDOW;
+    int summary_tokens = 128;
+
+    bool enabled() const { return max_tokens > 0; }
+    int promptTokens() const { return max_tokens - (reserve_tokens < 0 ? max_tokens / 4 : reserve_tokens); }
+
+    static ContextBudget Parse(const nlohmann::json& config);
+};
+
+/**
+ * Keeps a conversation inside a ContextBudget. Token counts are cached per distinct message,
+ * so each message is tokenized once however many turns it stays in the history.
+ */
+class ContextManager {
+public:
+    void setBudget(const ContextBudget& budget) { budget_ = budget; }
+    const ContextBudget& budget() const { return budget_; }
+    bool enabled() const { return budget_.enabled(); }
+
+    // Tokens the message adds to the templated prompt, including its role markers
+    int MessageTokens(MNN::Transformer::Llm* llm, const PromptItem& item);
+    int HistoryTokens(MNN::Transformer::Llm* llm, const std::vector<PromptItem>& history);
+
+    /**
+     * Evict the oldest turns after the system prompt until history fits the budget, starting
+     * the remainder on a user message. The system prompt and the last message always stay.
+     * prompt_tokens receives the estimated size of what is left.
+     * @return the evicted messages, oldest first
+     */
+    std::vector<PromptItem> Fit(MNN::Transformer::Llm* llm, std::vector<PromptItem>& history,
+                                int* prompt_tokens = nullptr);
+
+    // Drop cached counts of messages no longer in history
+    void Prune(const std::vector<PromptItem>& history);
+    void clear() { counts_.clear(); }
+
+private:
+    static uint64_t Hash(const PromptItem& item);
+    // Template tokens around one message, measured once on the loaded model's template
+    int MessageOverhead(MNN::Transformer::Llm* llm);
+
+    ContextBudget budget_{};
+    std::unordered_map<uint64_t, int> counts_;
+    int overhead_ = -1;
+};
+
+} // namespace mls
@@ -0,0 +1,53 @@
+//
+// Created for MNN React Native bindings
+//
+#include "cpu_features.hpp"
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#endif
+
+namespace mls {
+
+namespace {
+
+// From the kernel's arch/arm64/include/uapi/asm/hwcap.h, for NDK headers that predate them
+constexpr unsigned long kHwcapAsimdHp = 1UL << 10;
+constexpr unsigned long kHwcapAsimdDp = 1UL << 20;
+constexpr unsigned long kHwcapSve = 1UL << 22;
+constexpr unsigned long kHwcap2I8mm = 1UL << 13;
+
+} // namespace
+
+CpuFeatures CpuFeatures::FromHwcaps(unsigned long hwcap, unsigned long hwcap2) {
+    CpuFeatures features;
+    features.fp16 = (hwcap & kHwcapAsimdHp) != 0;
+    features.dotprod = (hwcap & kHwcapAsimdDp) != 0;
+    features.sve = (hwcap & kHwcapSve) != 0;
+    features.i8mm = (hwcap2 & kHwcap2I8mm) != 0;
+    return features;
+}
+
+const CpuFeatures& CpuFeatures::Get() {
+#if defined(__aarch64__) && defined(__linux__)
+    static const CpuFeatures features = FromHwcaps(getauxval(AT_HWCAP), getauxval(AT_HWCAP2));
+#else
+    static const CpuFeatures features;
+#endif
+    return features;
+}
+
+std::vector<const char*> MnnLibraryVariants(const CpuFeatures& features) {
+    std::vector<const char*> names;
+    // Each variant is compiled for a -march that also implies the ones below it
+    bool armv82 = features.dotprod && features.fp16;
+    if (armv82 && features.i8mm) {
+        names.push_back("MNN_i8mm");
+    }
+    if (armv82) {
+        names.push_back("MNN_dotprod");
+    }
+    names.push_back("MNN");
+    return names;
+}
+
+} // namespace mls
@@ -0,0 +1,31 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <vector>
+
+namespace mls {
+
+/**
+ * The ARMv8.2+ extensions MNN's quantized and fp16 kernels use, from the kernel's hwcaps.
+ * Everything is false off aarch64 Linux / Android.
+ */
+struct CpuFeatures {
+    bool fp16 = false;    // ASIMDHP: half-precision arithmetic
+    bool dotprod = false; // ASIMDDP: SDOT / UDOT
+    bool i8mm = false;    // SMMLA / USMMLA
+    bool sve = false;
+
+    // Probed once per process
+    static const CpuFeatures& Get();
+    static CpuFeatures FromHwcaps(unsigned long hwcap, unsigned long hwcap2);
+};
+
+/**
+ * Names of the libMNN builds this CPU can run, for System.loadLibrary, best first:
+ * MNN_i8mm (armv8.6-a+i8mm), MNN_dotprod (armv8.2-a+dotprod+fp16), then the baseline MNN.
+ */
+std::vector<const char*> MnnLibraryVariants(const CpuFeatures& features);
+
+} // namespace mls
@@ -0,0 +1,145 @@
+#include "cpu_topology.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#if defined(__linux__)
+#include <sched.h>
+#endif
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+// Decode rarely scales past this many threads on mobile memory bandwidth
+constexpr size_t kMaxDecodeThreadsHigh = 4;
+constexpr size_t kMaxDecodeThreadsNormal = 2;
+
+bool ReadLong(const std::string& path, long& value) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = fscanf(file, "%ld", &value) == 1;
+    fclose(file);
+    return ok;
+}
+
+// Parse a sysfs cpu list such as "0-3,6"
+std::vector<int> ReadCpuList(const std::string& path) {
+    std::vector<int> cpus;
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return cpus;
+    }
+    int first = 0;
+    while (fscanf(file, "%d", &first) == 1) {
+        int last = first;
+        int separator = fgetc(file);
+        if (separator == '-') {
+            if (fscanf(file, "%d", &last) != 1) {
+                break;
+            }
+            separator = fgetc(file);
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+        if (separator != ',') {
+            break;
+        }
+    }
+    fclose(file);
+    return cpus;
+}
+
+PhaseThreadPolicy MakePhase(const std::vector<int>& cores, size_t max_threads) {
+    PhaseThreadPolicy phase;
+    phase.cores.assign(cores.begin(), cores.begin() + std::min(cores.size(), max_threads));
+    phase.threads = std::max<int>(1, static_cast<int>(phase.cores.size()));
+    return phase;
+}
+
+} // namespace
+
+const CpuTopology& CpuTopology::Get() {
+    static const CpuTopology topology = Read("/sys/devices/system/cpu");
+    return topology;
+}
+
+CpuTopology CpuTopology::Read(const std::string& sysfs_root) {
+    std::map<long, std::vector<int>, std::greater<long>> by_freq;
+    for (int cpu : ReadCpuList(sysfs_root + "/possible")) {
+        long freq = 0;
+        ReadLong(sysfs_root + "/cpu" + std::to_string(cpu) + "/cpufreq/cpuinfo_max_freq", freq);
+        by_freq[freq].push_back(cpu);
+    }
+    CpuTopology topology;
+    for (auto& [freq, cores] : by_freq) {
+        topology.clusters.push_back(CpuCluster{freq, cores});
+        MNN_DEBUG("CpuTopology: cluster max_freq=%ldkHz cores=%zu", freq, cores.size());
+    }
+    return topology;
+}
+
+PowerMode ParsePowerMode(const std::string& name) {
+    if (name == "high") {
+        return PowerMode::HIGH;
+    }
+    if (name == "low") {
+        return PowerMode::LOW;
+    }
+    return PowerMode::NORMAL;
+}
+
+ThreadPolicy MakeThreadPolicy(const CpuTopology& topology, PowerMode mode) {
+    ThreadPolicy policy;
+    if (topology.clusters.empty()) {
+        return policy;
+    }
+    const auto& little = topology.clusters.back().cores;
+    std::vector<int> fast;
+    size_t fast_clusters = topology.clusters.size() > 1 ? topology.clusters.size() - 1 : 1;
+    for (size_t i = 0; i < fast_clusters; i++) {
+        const auto& cores = topology.clusters[i].cores;
+        fast.insert(fast.end(), cores.begin(), cores.end());
+    }
+    switch (mode) {
+        case PowerMode::LOW:
+            policy.prefill = MakePhase(little, little.size());
+            policy.decode = MakePhase(little, kMaxDecodeThreadsNormal);
+            break;
+        case PowerMode::HIGH:
+            policy.prefill = MakePhase(fast, fast.size());
+            policy.decode = MakePhase(fast, kMaxDecodeThreadsHigh);
+            break;
+        default:
+            policy.prefill = MakePhase(fast, fast.size());
+            policy.decode = MakePhase(fast, kMaxDecodeThreadsNormal);
+            break;
+    }
+    return policy;
+}
+
+bool PinCurrentThread(const std::vector<int>& cores) {
+    if (cores.empty()) {
+        return true;
+    }
+#if defined(__linux__)
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (int core : cores) {
+        CPU_SET(core, &mask);
+    }
+    if (sched_setaffinity(0, sizeof(mask), &mask) != 0) {
+        MNN_WARN("PinCurrentThread: sched_setaffinity failed for %zu cores", cores.size());
+        return false;
+    }
+    return true;
+#else
+    // No affinity API on Apple platforms; the topology is empty there so this is not reached
+    return false;
+#endif
+}
+
+} // namespace mls
@@ -0,0 +1,59 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace mls {
+
+struct CpuCluster {
+    long max_freq_khz = 0;
+    std::vector<int> cores;
+};
+
+/**
+ * Core clusters read from /sys/devices/system/cpu, fastest first. Cores without cpufreq
+ * information end up in a single cluster.
+ */
+struct CpuTopology {
+    std::vector<CpuCluster> clusters;
+
+    // Probed once per process
+    static const CpuTopology& Get();
+    static CpuTopology Read(const std::string& sysfs_root);
+};
+
+// Same values as the benchmark power argument
+enum class PowerMode {
+    NORMAL = 0,
+    HIGH = 1,
+    LOW = 2,
+};
+
+PowerMode ParsePowerMode(const std::string& name);
+
+struct PhaseThreadPolicy {
+    int threads = 1;
+    std::vector<int> cores;
+};
+
+/**
+ * Thread count and cores for each phase. Prefill is compute-bound and takes every
+ * non-little core; decode is memory-bound and stays on the fastest few.
+ */
+struct ThreadPolicy {
+    PhaseThreadPolicy prefill;
+    PhaseThreadPolicy decode;
+};
+
+ThreadPolicy MakeThreadPolicy(const CpuTopology& topology, PowerMode mode);
+
+/**
+ * Restrict the calling thread to cores; an empty list is a no-op.
+ * @return false if the kernel rejected the mask
+ */
+bool PinCurrentThread(const std::vector<int>& cores);
+
+} // namespace mls
@@ -0,0 +1,92 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace mls {
+
+/**
+ * Opt-in record of the last few prompts and replies for getDebugInfo, kept in a fixed-size
+ * ring. With capacity 0 nothing is stored and nothing is allocated. Written from the inference
+ * worker and read from the JS thread, hence the lock.
+ */
+class DebugCapture {
+public:
+    // Set once at session construction, before any capture happens
+    void setCapacity(size_t capacity) {
+        capacity_ = capacity;
+        entries_.clear();
+        entries_.shrink_to_fit();
+        newest_ = 0;
+    }
+
+    bool enabled() const { return capacity_ > 0; }
+
+    // Start a new entry with its prompt, replacing the oldest one when the ring is full
+    void recordPrompt(const std::vector<std::pair<std::string, std::string>>& history) {
+        if (!enabled()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (entries_.size() < capacity_) {
+            entries_.emplace_back();
+            newest_ = entries_.size() - 1;
+        } else {
+            newest_ = (newest_ + 1) % capacity_;
+        }
+        auto& entry = entries_[newest_];
+        entry.prompt.clear();
+        entry.response.clear();
+        for (const auto& [role, content] : history) {
+            entry.prompt.append("[").append(role).append("]: ").append(content).append("\n");
+        }
+    }
+
+    // Attach the reply to the newest entry
+    void recordResponse(const std::string& response) {
+        if (!enabled()) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (entries_.empty()) {
+            return;
+        }
+        entries_[newest_].response = response;
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        newest_ = 0;
+    }
+
+    // Entries oldest first
+    std::string dump() const {
+        std::string out;
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = entries_.size();
+        for (size_t i = 0; i < count; i++) {
+            const auto& entry = entries_[(newest_ + 1 + i) % count];
+            out.append("prompt:\n").append(entry.prompt).append("\nresponse:\n").append(entry.response).append("\n");
+        }
+        return out;
+    }
+
+private:
+    struct Entry {
+        std::string prompt;
+        std::string response;
+    };
+
+    mutable std::mutex mutex_;
+    size_t capacity_ = 0;
+    std::vector<Entry> entries_;
+    size_t newest_ = 0;
+};
+
+} // namespace mls
@@ -0,0 +1,157 @@
+//
+// Created for MNN React Native bindings
+//
+#include "embedding_session.h"
+#include <chrono>
+#include <cstring>
+#include "MNN/expr/ExecutorScope.hpp"
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+int64_t ElapsedUs(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - since).count();
+}
+
+} // namespace
+
+EmbeddingSession::EmbeddingSession(std::string config_path, nlohmann::json config)
+        : config_path_(std::move(config_path)), config_(std::move(config)) {}
+
+EmbeddingSession::~EmbeddingSession() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    indexes_.clear();
+    if (embedding_) {
+        MNN::Express::ExecutorScope scope(executor_);
+        embedding_.reset();
+    }
+}
+
+bool EmbeddingSession::Load() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    MNN::BackendConfig backend_config;
+    executor_ = MNN::Express::Executor::newExecutor(MNN_FORWARD_CPU, backend_config, 1);
+    MNN::Express::ExecutorScope scope(executor_);
+    embedding_.reset(MNN::Transformer::Embedding::createEmbedding(config_path_, false));
+    if (!embedding_) {
+        MNN_ERROR("EmbeddingSession: createEmbedding failed for %s", config_path_.c_str());
+        return false;
+    }
+    if (!config_.empty()) {
+        embedding_->set_config(config_.dump());
+    }
+    if (!embedding_->load()) {
+        MNN_ERROR("EmbeddingSession: load failed for %s", config_path_.c_str());
+        embedding_.reset();
+        return false;
+    }
+    MNN_DEBUG("EmbeddingSession: loaded %s, dim=%d", config_path_.c_str(), embedding_->dim());
+    return true;
+}
+
+int EmbeddingSession::dim() const {
+    return embedding_ ? embedding_->dim() : 0;
+}
+
+bool EmbeddingSession::EmbedText(const std::string& text, float* out, int64_t* tokens) {
+    auto ids = embedding_->tokenizer_encode(text);
+    if (ids.empty()) {
+        return false;
+    }
+    *tokens += static_cast<int64_t>(ids.size());
+    auto var = embedding_->ids_embedding(ids);
+    const float* data = var.get() != nullptr ? var->readMap<float>() : nullptr;
+    if (data == nullptr || var->getInfo()->size != embedding_->dim()) {
+        return false;
+    }
+    memcpy(out, data, sizeof(float) * embedding_->dim());
+    return true;
+}
+
+bool EmbeddingSession::EmbedToIndex(const std::string& index_path, const std::vector<std::string>& texts,
+                                    const std::vector<int64_t>& ids, IndexStats* stats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!embedding_ || texts.size() != ids.size() || texts.empty()) {
+        MNN_ERROR("EmbeddingSession: invalid batch (loaded=%d, texts=%zu, ids=%zu)",
+                  embedding_ != nullptr, texts.size(), ids.size());
+        return false;
+    }
+    MNN::Express::ExecutorScope scope(executor_);
+    int dim = embedding_->dim();
+    IndexStats local;
+    local.dim = dim;
+    auto embed_start = std::chrono::steady_clock::now();
+    std::vector<float> vectors(texts.size() * dim);
+    std::vector<int64_t> kept_ids;
+    kept_ids.reserve(ids.size());
+    for (size_t i = 0; i < texts.size(); i++) {
+        float* row = vectors.data() + kept_ids.size() * dim;
+        if (!EmbedText(texts[i], row, &local.tokens)) {
+            MNN_WARN("EmbeddingSession: skipping chunk %lld, embedding failed", static_cast<long long>(ids[i]));
+            continue;
+        }
+        kept_ids.push_back(ids[i]);
+    }
+    vectors.resize(kept_ids.size() * dim);
+    local.count = static_cast<int>(kept_ids.size());
+    local.embed_us = ElapsedUs(embed_start);
+    if (kept_ids.empty()) {
+        return false;
+    }
+
+    auto index_start = std::chrono::steady_clock::now();
+    // Drop our mapping first; the index file is replaced by the rebuild
+    indexes_.erase(index_path);
+    bool ok = VectorIndex::Append(index_path, dim, kept_ids, std::move(vectors));
+    local.index_us = ElapsedUs(index_start);
+    MNN_DEBUG("EmbeddingSession: indexed %d chunks (%lld tokens) in %lldus + %lldus", local.count,
+              static_cast<long long>(local.tokens), static_cast<long long>(local.embed_us),
+              static_cast<long long>(local.index_us));
+    if (stats) {
+        *stats = local;
+    }
+    return ok;
+}
+
+VectorIndex* EmbeddingSession::OpenIndex(const std::string& index_path) {
+    auto it = indexes_.find(index_path);
+    if (it != indexes_.end()) {
+        return it->second.get();
+    }
+    auto index = std::make_unique<VectorIndex>();
+    if (!index->Open(index_path)) {
+        return nullptr;
+    }
+    auto* raw = index.get();
+    indexes_[index_path] = std::move(index);
+    return raw;
+}
+
+std::vector<VectorHit> EmbeddingSession::Search(const std::string& index_path, const std::string& query,
+                                                int k, int nprobe) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!embedding_) {
+        return {};
+    }
+    auto* index = OpenIndex(index_path);
+    if (index == nullptr || index->dim() != embedding_->dim()) {
+        MNN_ERROR("EmbeddingSession: cannot search %s", index_path.c_str());
+        return {};
+    }
+    MNN::Express::ExecutorScope scope(executor_);
+    std::vector<float> q(embedding_->dim());
+    int64_t tokens = 0;
+    if (!EmbedText(query, q.data(), &tokens)) {
+        return {};
+    }
+    return index->Search(q.data(), k, nprobe);
+}
+
+void EmbeddingSession::CloseIndex(const std::string& index_path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    indexes_.erase(index_path);
+}
+
+} // namespace mls
@@ -0,0 +1,67 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "nlohmann/json.hpp"
+#include "llm/llm.hpp"
+#include "vector_index.hpp"
+
+namespace MNN {
+namespace Express {
+class Executor;
+}
+}
+
+namespace mls {
+
+/**
+ * Sentence-embedding model plus the vector indexes it writes and searches.
+ * Whole batches of chunks are embedded and indexed in one call so that vectors stay native.
+ * Calls are serialized; run them off the JS thread.
+ */
+class EmbeddingSession {
+public:
+    struct IndexStats {
+        int count = 0;
+        int dim = 0;
+        int64_t tokens = 0;
+        int64_t embed_us = 0;
+        int64_t index_us = 0;
+    };
+
+    EmbeddingSession(std::string config_path, nlohmann::json config);
+    ~EmbeddingSession();
+
+    bool Load();
+    int dim() const;
+
+    /**
+     * Embed texts[i] under ids[i] and add them to the index at index_path, creating it when missing.
+     * An id that is already indexed is replaced.
+     */
+    bool EmbedToIndex(const std::string& index_path, const std::vector<std::string>& texts,
+                      const std::vector<int64_t>& ids, IndexStats* stats);
+
+    std::vector<VectorHit> Search(const std::string& index_path, const std::string& query, int k, int nprobe);
+
+    // Unmap an index so its file can be deleted or replaced by the app
+    void CloseIndex(const std::string& index_path);
+
+private:
+    bool EmbedText(const std::string& text, float* out, int64_t* tokens);
+    VectorIndex* OpenIndex(const std::string& index_path);
+
+    std::string config_path_;
+    nlohmann::json config_;
+    std::shared_ptr<MNN::Express::Executor> executor_;
+    std::unique_ptr<MNN::Transformer::Embedding> embedding_;
+    std::unordered_map<std::string, std::unique_ptr<VectorIndex>> indexes_;
+    std::mutex mutex_;
+};
+
+} // namespace mls
@@ -0,0 +1,76 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "llm_session.h"
+
+namespace mls {
+
+struct GenerationMetric {
+    const char* key;
+    double value;
+    // Counts and durations are reported as integers, ratios as doubles
+    bool integral = true;
+};
+
+/**
+ * The numeric fields of a finished request's metrics, in the order they are reported.
+ * Shared by the JNI and JSI completion paths so both report the same keys.
+ */
+inline std::vector<GenerationMetric> CollectGenerationMetrics(const LlmSession& llm,
+                                                              const MNN::Transformer::LlmContext* context) {
+    std::vector<GenerationMetric> metrics;
+    auto add = [&metrics](const char* key, int64_t value) {
+        metrics.push_back({key, static_cast<double>(value)});
+    };
+    const auto& stats = llm.getGenerationStats();
+    // A chunked prefill leaves only its last chunk in the context
+    bool chunked = stats.prefill_chunks > 1;
+    if (context) {
+        add("promptLen", chunked ? stats.prefilled_tokens : context->prompt_len);
+        add("decodeLen", context->gen_seq_len);
+        add("visionTime", context->vision_us);
+        add("audioTime", context->audio_us);
+        add("prefillTime", chunked ? stats.prefill_us : context->prefill_us);
+        add("decodeTime", context->decode_us);
+    }
+    add("reusedTokens", llm.getReusedPrefixTokens());
+    add("prefixCacheHits", llm.getPrefixCacheHits());
+    add("prefixCacheMisses", llm.getPrefixCacheMisses());
+    add("ttftUs", stats.ttft_us);
+    add("interTokenP50Us", stats.inter_token.percentile(0.50));
+    add("interTokenP90Us", stats.inter_token.percentile(0.90));
+    add("interTokenP99Us", stats.inter_token.percentile(0.99));
+    add("callbackTimeUs", stats.callback_us);
+    add("generateTimeUs", stats.generate_us);
+    add("sampleTimeUs", context ? context->sample_us : 0);
+    add("prefilledTokens", stats.prefilled_tokens);
+    add("prefillChunks", stats.prefill_chunks);
+    add("decodeSteps", stats.decode_steps);
+    add("adapterSwitchUs", stats.adapter_switch_us);
+    add("evictedMessages", stats.evicted_messages);
+    add("contextTokens", stats.context_tokens);
+    add("tokenizeUs", stats.tokenize_us);
+    add("grammarResampledTokens", stats.grammar_resampled);
+    add("grammarMaskUs", stats.grammar_mask_us);
+    add("thermalWaitUs", stats.thermal_wait_us);
+    auto memory = llm.getSessionMemory();
+    add("kvCacheTokens", memory.kv_tokens);
+    add("kvCacheBytes", static_cast<int64_t>(memory.kv_cache_bytes));
+    double tokens_per_step = stats.decode_steps > 0 ? static_cast<double>(stats.decoded_tokens) / stats.decode_steps : 0;
+    metrics.push_back({"tokensPerStep", tokens_per_step, false});
+    // Each verify step emits one token of its own; the rest are accepted draft tokens
+    const auto& speculative = llm.getSpeculativeConfig();
+    double acceptance = 0;
+    if (speculative.enabled && stats.decode_steps > 0) {
+        acceptance = static_cast<double>(stats.decoded_tokens - stats.decode_steps) /
+                     (static_cast<double>(stats.decode_steps) * speculative.draft_length);
+    }
+    metrics.push_back({"draftAcceptanceRate", acceptance, false});
+    return metrics;
+}
+
+} // namespace mls
@@ -0,0 +1,131 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace mls {
+
+/**
+ * Fixed-bucket latency histogram in microseconds: four buckets per power of two, so a
+ * percentile is within ~20% of the true value. Recording is a few integer operations.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kSubBuckets = 4;
+    static constexpr int kBuckets = 40 * kSubBuckets;
+
+    void record(int64_t us) {
+        buckets_[BucketOf(us)]++;
+        count_++;
+        max_us_ = std::max(max_us_, us);
+    }
+
+    /**
+     * Upper bound of the bucket holding the p-th fraction (0..1) of samples, or 0 if empty
+     */
+    int64_t percentile(double p) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        auto target = static_cast<uint64_t>(p * static_cast<double>(count_) + 0.999999);
+        target = std::clamp<uint64_t>(target, 1, count_);
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            seen += buckets_[i];
+            if (seen >= target) {
+                return std::min(UpperBound(i), max_us_);
+            }
+        }
+        return max_us_;
+    }
+
+    uint64_t count() const { return count_; }
+
+    void reset() {
+        buckets_.fill(0);
+        count_ = 0;
+        max_us_ = 0;
+    }
+
+private:
+    static int BucketOf(int64_t us) {
+        if (us < kSubBuckets) {
+            return us > 0 ? static_cast<int>(us) : 0;
+        }
+        int log2 = 63 - __builtin_clzll(static_cast<uint64_t>(us));
+        int sub = static_cast<int>((us >> (log2 - 2)) & (kSubBuckets - 1));
+        return std::min(log2 * kSubBuckets + sub, kBuckets - 1);
+    }
+
+    static int64_t UpperBound(int bucket) {
+        int log2 = bucket / kSubBuckets;
+        int sub = bucket % kSubBuckets;
+        if (log2 < 2) {
+            return bucket;
+        }
+        return ((static_cast<int64_t>(kSubBuckets + sub + 1)) << (log2 - 2)) - 1;
+    }
+
+    std::array<uint32_t, kBuckets> buckets_{};
+    uint64_t count_ = 0;
+    int64_t max_us_ = 0;
+};
+
+/**
+ * Latency breakdown of the last Response / ResponseWithHistory call.
+ */
+struct GenerationStats {
+    // Request start until the first generated token
+    int64_t ttft_us = 0;
+    // Inside on_progress, i.e. the JNI / bridge crossing
+    int64_t callback_us = 0;
+    // Inside llm->generate(1), excluding callbacks made from it
+    int64_t generate_us = 0;
+    // Prompt tokens actually run through prefill (not served from the KV cache)
+    int prefilled_tokens = 0;
+    // Forward passes the prefill was split into and their total time
+    int prefill_chunks = 0;
+    int64_t prefill_us = 0;
+    // generate(1) calls after the first token and the tokens they emitted (more than one per
+    // call when speculative decoding accepts draft tokens)
+    int decode_steps = 0;
+    int decoded_tokens = 0;
+    // Switching to the request's LoRA adapter, including loading it on a cache miss
+    int64_t adapter_switch_us = 0;
+    // Messages the context budget evicted for this request and the estimated prompt size left
+    int evicted_messages = 0;
+    int context_tokens = 0;
+    // Templating and tokenizing the prompt
+    int64_t tokenize_us = 0;
+    // Tokens a response format constraint made the sampler redraw, and time spent masking logits
+    int grammar_resampled = 0;
+    int64_t grammar_mask_us = 0;
+    // Decode time the thermal governor spent waiting to hold its target rate
+    int64_t thermal_wait_us = 0;
+    LatencyHistogram inter_token;
+
+    void reset() {
+        ttft_us = 0;
+        callback_us = 0;
+        generate_us = 0;
+        prefilled_tokens = 0;
+        prefill_chunks = 0;
+        prefill_us = 0;
+        decode_steps = 0;
+        decoded_tokens = 0;
+        adapter_switch_us = 0;
+        evicted_messages = 0;
+        context_tokens = 0;
+        tokenize_us = 0;
+        grammar_resampled = 0;
+        grammar_mask_us = 0;
+        thermal_wait_us = 0;
+        inter_token.reset();
+    }
+};
+
+} // namespace mls
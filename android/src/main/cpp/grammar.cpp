@@ -0,0 +1,573 @@
+//
+// Created for MNN React Native bindings
+//
+#include "grammar.hpp"
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <map>
+
+namespace mls {
+
+namespace {
+
+using Type = Grammar::Type;
+using Element = Grammar::Element;
+
+bool IsEndOfSequence(const Element* pos) {
+    return pos->type == Type::END || pos->type == Type::ALT;
+}
+
+bool IsWordChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_';
+}
+
+void AppendUtf8(uint32_t cp, std::vector<uint8_t>* out) {
+    if (cp < 0x80) {
+        out->push_back(static_cast<uint8_t>(cp));
+    } else if (cp < 0x800) {
+        out->push_back(static_cast<uint8_t>(0xC0 | (cp >> 6)));
+        out->push_back(static_cast<uint8_t>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out->push_back(static_cast<uint8_t>(0xE0 | (cp >> 12)));
+        out->push_back(static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back(static_cast<uint8_t>(0x80 | (cp & 0x3F)));
+    } else {
+        out->push_back(static_cast<uint8_t>(0xF0 | (cp >> 18)));
+        out->push_back(static_cast<uint8_t>(0x80 | ((cp >> 12) & 0x3F)));
+        out->push_back(static_cast<uint8_t>(0x80 | ((cp >> 6) & 0x3F)));
+        out->push_back(static_cast<uint8_t>(0x80 | (cp & 0x3F)));
+    }
+}
+
+// Whether the character class at pos accepts c, and the element after the class
+std::pair<bool, const Element*> MatchChar(const Element* pos, uint8_t c) {
+    bool positive = pos->type == Type::CHAR;
+    bool found = false;
+    do {
+        if (pos[1].type == Type::CHAR_RNG_UPPER) {
+            found = found || (pos->value <= c && c <= pos[1].value);
+            pos += 2;
+        } else {
+            found = found || pos->value == c;
+            pos += 1;
+        }
+    } while (pos->type == Type::CHAR_ALT);
+    return {found == positive, pos};
+}
+
+class GbnfParser {
+public:
+    explicit GbnfParser(const std::string& text) : text_(text) {}
+
+    bool Run(std::vector<Grammar::Rule>* rules, uint32_t* root, std::string* error) {
+        SkipSpace(true);
+        while (ok() && pos_ < text_.size()) {
+            ParseRule();
+            SkipSpace(true);
+        }
+        if (ok()) {
+            for (const auto& [name, id] : symbols_) {
+                if (!defined_[id]) {
+                    error_ = "undefined rule '" + name + "'";
+                    break;
+                }
+            }
+        }
+        if (ok() && symbols_.find("root") == symbols_.end()) {
+            error_ = "no root rule";
+        }
+        if (ok()) {
+            CheckLeftRecursion();
+        }
+        if (!ok()) {
+            *error = error_;
+            return false;
+        }
+        *rules = std::move(rules_);
+        *root = symbols_["root"];
+        return true;
+    }
+
+private:
+    bool ok() const { return error_.empty(); }
+
+    void Fail(const std::string& message) {
+        if (ok()) {
+            error_ = message + " at offset " + std::to_string(pos_);
+        }
+    }
+
+    char Peek(size_t ahead = 0) const {
+        return pos_ + ahead < text_.size() ? text_[pos_ + ahead] : '\0';
+    }
+
+    void SkipSpace(bool newline_ok) {
+        while (pos_ < text_.size()) {
+            char c = text_[pos_];
+            if (c == ' ' || c == '\t' || (newline_ok && (c == '\r' || c == '\n'))) {
+                pos_++;
+            } else if (c == '#') {
+                while (pos_ < text_.size() && text_[pos_] != '\n') {
+                    pos_++;
+                }
+            } else {
+                break;
+            }
+        }
+    }
+
+    uint32_t Symbol(const std::string& name) {
+        auto it = symbols_.find(name);
+        if (it != symbols_.end()) {
+            return it->second;
+        }
+        auto id = static_cast<uint32_t>(rules_.size());
+        symbols_.emplace(name, id);
+        rules_.emplace_back();
+        defined_.push_back(false);
+        return id;
+    }
+
+    uint32_t NewSymbol(const std::string& base) {
+        return Symbol(base + "_" + std::to_string(rules_.size()));
+    }
+
+    void Define(uint32_t id, Grammar::Rule rule) {
+        rules_[id] = std::move(rule);
+        defined_[id] = true;
+    }
+
+    std::string ParseName() {
+        size_t start = pos_;
+        while (pos_ < text_.size() && IsWordChar(text_[pos_])) {
+            pos_++;
+        }
+        if (pos_ == start) {
+            Fail("expected a rule name");
+        }
+        return text_.substr(start, pos_ - start);
+    }
+
+    uint32_t ParseHex(int digits) {
+        uint32_t value = 0;
+        for (int i = 0; i < digits; i++) {
+            char c = Peek();
+            int digit = std::isdigit(static_cast<unsigned char>(c)) ? c - '0'
+                      : (c >= 'a' && c <= 'f') ? c - 'a' + 10
+                      : (c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+            if (digit < 0) {
+                Fail("bad hex escape");
+                return 0;
+            }
+            value = value * 16 + static_cast<uint32_t>(digit);
+            pos_++;
+        }
+        return value;
+    }
+
+    // One possibly escaped character of a literal or class, as a code point
+    uint32_t ParseChar() {
+        if (pos_ >= text_.size()) {
+            Fail("unexpected end of grammar");
+            return 0;
+        }
+        auto c = static_cast<unsigned char>(text_[pos_++]);
+        if (c == '\\') {
+            char escape = Peek();
+            pos_++;
+            switch (escape) {
+                case 'x': return ParseHex(2);
+                case 'u': return ParseHex(4);
+                case 'U': return ParseHex(8);
+                case 't': return '\t';
+                case 'r': return '\r';
+                case 'n': return '\n';
+                case '\\': case '"': case '[': case ']': case '-': case '^':
+                    return static_cast<uint32_t>(escape);
+                default:
+                    Fail("unknown escape");
+                    return 0;
+            }
+        }
+        if (c < 0x80) {
+            return c;
+        }
+        // Raw UTF-8 in the grammar text
+        int extra = c >= 0xF0 ? 3 : c >= 0xE0 ? 2 : 1;
+        uint32_t cp = c & (0x3F >> extra);
+        for (int i = 0; i < extra && pos_ < text_.size(); i++) {
+            cp = (cp << 6) | (static_cast<unsigned char>(text_[pos_++]) & 0x3F);
+        }
+        return cp;
+    }
+
+    void AddClassItem(Grammar::Rule* out, size_t start, Type first, uint32_t lo, uint32_t hi) {
+        auto push = [&](uint32_t from, uint32_t to) {
+            out->push_back({out->size() == start ? first : Type::CHAR_ALT, from});
+            if (to != from) {
+                out->push_back({Type::CHAR_RNG_UPPER, to});
+            }
+        };
+        if (lo <= 0x7F) {
+            push(lo, std::min<uint32_t>(hi, 0x7F));
+        }
+        // Bytes are matched one at a time, so a non-ASCII item stands for any multi-byte
+        // character; in a negated class multi-byte characters simply stay allowed
+        if (hi > 0x7F && first == Type::CHAR) {
+            push(0x80, 0xFF);
+        }
+    }
+
+    void ParseClass(Grammar::Rule* out) {
+        pos_++;
+        Type first = Type::CHAR;
+        if (Peek() == '^') {
+            first = Type::CHAR_NOT;
+            pos_++;
+        }
+        size_t start = out->size();
+        while (ok() && pos_ < text_.size() && Peek() != ']') {
+            uint32_t lo = ParseChar();
+            uint32_t hi = lo;
+            if (Peek() == '-' && Peek(1) != ']') {
+                pos_++;
+                hi = ParseChar();
+            }
+            if (hi < lo) {
+                Fail("bad character range");
+            }
+            AddClassItem(out, start, first, lo, hi);
+        }
+        if (Peek() != ']') {
+            Fail("unterminated character class");
+            return;
+        }
+        pos_++;
+        if (out->size() == start) {
+            // Nothing left to exclude: 256 is never a byte
+            out->push_back({first, 256});
+        }
+    }
+
+    int ParseInt() {
+        size_t start = pos_;
+        int value = 0;
+        while (std::isdigit(static_cast<unsigned char>(Peek()))) {
+            value = value * 10 + (Peek() - '0');
+            pos_++;
+        }
+        if (pos_ == start) {
+            Fail("expected a number");
+        }
+        return value;
+    }
+
+    /**
+     * Rewrite the item from last_start as min copies of itself followed by optional ones:
+     * S{m,n} is S (m times) then a chain of n - m optional rules, S{m,} ends in S' ::= S S' |
+     */
+    void Repeat(Grammar::Rule* out, size_t last_start, const std::string& rule_name, int min_times, int max_times) {
+        if (last_start == out->size()) {
+            Fail("repetition without an item");
+            return;
+        }
+        Grammar::Rule item(out->begin() + static_cast<std::ptrdiff_t>(last_start), out->end());
+        if (min_times == 0) {
+            out->resize(last_start);
+        }
+        for (int i = 1; i < min_times; i++) {
+            out->insert(out->end(), item.begin(), item.end());
+        }
+        int optional = max_times < 0 ? 1 : max_times - min_times;
+        uint32_t last_rule = 0;
+        for (int i = 0; i < optional; i++) {
+            Grammar::Rule rule(item);
+            uint32_t id = NewSymbol(rule_name);
+            if (i > 0 || max_times < 0) {
+                rule.push_back({Type::RULE_REF, max_times < 0 ? id : last_rule});
+            }
+            rule.push_back({Type::ALT, 0});
+            rule.push_back({Type::END, 0});
+            Define(id, std::move(rule));
+            last_rule = id;
+        }
+        if (optional > 0) {
+            out->push_back({Type::RULE_REF, last_rule});
+        }
+    }
+
+    void ParseSequence(const std::string& rule_name, Grammar::Rule* out, bool nested) {
+        size_t last_start = out->size();
+        while (ok() && pos_ < text_.size()) {
+            char c = Peek();
+            if (c == '"') {
+                pos_++;
+                last_start = out->size();
+                std::vector<uint8_t> bytes;
+                while (ok() && pos_ < text_.size() && Peek() != '"') {
+                    AppendUtf8(ParseChar(), &bytes);
+                }
+                if (Peek() != '"') {
+                    Fail("unterminated literal");
+                    return;
+                }
+                pos_++;
+                for (uint8_t byte : bytes) {
+                    out->push_back({Type::CHAR, byte});
+                }
+            } else if (c == '[') {
+                last_start = out->size();
+                ParseClass(out);
+            } else if (c == '.') {
+                pos_++;
+                last_start = out->size();
+                out->push_back({Type::CHAR, 0});
+                out->push_back({Type::CHAR_RNG_UPPER, 0xFF});
+            } else if (IsWordChar(c)) {
+                last_start = out->size();
+                out->push_back({Type::RULE_REF, Symbol(ParseName())});
+            } else if (c == '(') {
+                pos_++;
+                uint32_t id = NewSymbol(rule_name);
+                ParseAlternates(rule_name, id, true);
+                if (Peek() != ')') {
+                    Fail("expected ')'");
+                    return;
+                }
+                pos_++;
+                last_start = out->size();
+                out->push_back({Type::RULE_REF, id});
+            } else if (c == '*' || c == '+' || c == '?') {
+                pos_++;
+                Repeat(out, last_start, rule_name, c == '+' ? 1 : 0, c == '?' ? 1 : -1);
+            } else if (c == '{') {
+                pos_++;
+                SkipSpace(nested);
+                int min_times = ParseInt();
+                int max_times = min_times;
+                SkipSpace(nested);
+                if (Peek() == ',') {
+                    pos_++;
+                    SkipSpace(nested);
+                    max_times = std::isdigit(static_cast<unsigned char>(Peek())) ? ParseInt() : -1;
+                    SkipSpace(nested);
+                }
+                if (Peek() != '}') {
+                    Fail("expected '}'");
+                    return;
+                }
+                pos_++;
+                if (max_times >= 0 && max_times < min_times) {
+                    Fail("bad repetition bounds");
+                    return;
+                }
+                Repeat(out, last_start, rule_name, min_times, max_times);
+            } else {
+                break;
+            }
+            SkipSpace(nested);
+        }
+    }
+
+    void ParseAlternates(const std::string& rule_name, uint32_t id, bool nested) {
+        Grammar::Rule rule;
+        SkipSpace(nested);
+        ParseSequence(rule_name, &rule, nested);
+        while (ok() && Peek() == '|') {
+            rule.push_back({Type::ALT, 0});
+            pos_++;
+            SkipSpace(true);
+            ParseSequence(rule_name, &rule, nested);
+        }
+        rule.push_back({Type::END, 0});
+        Define(id, std::move(rule));
+    }
+
+    void ParseRule() {
+        auto name = ParseName();
+        if (!ok()) {
+            return;
+        }
+        SkipSpace(false);
+        if (text_.compare(pos_, 3, "::=") != 0) {
+            Fail("expected '::='");
+            return;
+        }
+        pos_ += 3;
+        uint32_t id = Symbol(name);
+        if (defined_[id]) {
+            Fail("rule '" + name + "' defined twice");
+            return;
+        }
+        ParseAlternates(name, id, false);
+        if (ok() && pos_ < text_.size() && Peek() != '\n' && Peek() != '\r') {
+            Fail("expected end of rule");
+        }
+    }
+
+    /**
+     * Matching expands rules depth first, so a rule that can reach itself without consuming
+     * a byte would never return. Only directly empty alternatives are treated as nullable.
+     */
+    void CheckLeftRecursion() {
+        size_t n = rules_.size();
+        std::vector<uint8_t> state(n, 0);  // 0 unvisited, 1 in progress, 2 done
+        std::vector<bool> nullable(n, false);
+        for (size_t i = 0; i < n; i++) {
+            const auto& rule = rules_[i];
+            bool at_start = true;
+            for (const auto& element : rule) {
+                if (IsEndOfSequence(&element)) {
+                    if (at_start) {
+                        nullable[i] = true;
+                        break;
+                    }
+                    at_start = true;
+                } else {
+                    at_start = false;
+                }
+            }
+        }
+        std::function<bool(uint32_t)> visit = [&](uint32_t id) {
+            if (state[id] == 1) {
+                return true;
+            }
+            if (state[id] == 2) {
+                return false;
+            }
+            state[id] = 1;
+            bool leftmost = true;
+            for (const auto& element : rules_[id]) {
+                if (element.type == Type::RULE_REF && leftmost) {
+                    if (visit(element.value)) {
+                        return true;
+                    }
+                    leftmost = nullable[element.value];
+                } else {
+                    leftmost = IsEndOfSequence(&element);
+                }
+            }
+            state[id] = 2;
+            return false;
+        };
+        for (const auto& [name, id] : symbols_) {
+            if (visit(id)) {
+                error_ = "rule '" + name + "' is left recursive";
+                return;
+            }
+        }
+    }
+
+    const std::string& text_;
+    size_t pos_ = 0;
+    std::string error_;
+    std::map<std::string, uint32_t> symbols_;
+    std::vector<Grammar::Rule> rules_;
+    std::vector<bool> defined_;
+};
+
+} // namespace
+
+std::shared_ptr<const Grammar> Grammar::Parse(const std::string& text, std::string* error) {
+    auto grammar = std::make_shared<Grammar>();
+    GbnfParser parser(text);
+    if (!parser.Run(&grammar->rules_, &grammar->root_, error)) {
+        return nullptr;
+    }
+    return grammar;
+}
+
+GrammarMatcher::GrammarMatcher(std::shared_ptr<const Grammar> grammar) : grammar_(std::move(grammar)) {
+    const Grammar::Element* pos = grammar_->rules()[grammar_->root()].data();
+    while (true) {
+        Stack stack;
+        if (!IsEndOfSequence(pos)) {
+            stack.push_back(pos);
+        }
+        Expand(stack, &stacks_);
+        while (!IsEndOfSequence(pos)) {
+            pos++;
+        }
+        if (pos->type != Type::ALT) {
+            break;
+        }
+        pos++;
+    }
+    Dedup(&stacks_);
+}
+
+void GrammarMatcher::Expand(const Stack& stack, std::vector<Stack>* out) const {
+    if (stack.empty() || stack.back()->type != Type::RULE_REF) {
+        // Complete, or waiting on a character class
+        out->push_back(stack);
+        return;
+    }
+    const Grammar::Element* pos = stack.back();
+    const Grammar::Element* alternative = grammar_->rules()[pos->value].data();
+    while (true) {
+        Stack next(stack.begin(), stack.end() - 1);
+        if (!IsEndOfSequence(pos + 1)) {
+            next.push_back(pos + 1);
+        }
+        if (!IsEndOfSequence(alternative)) {
+            next.push_back(alternative);
+        }
+        Expand(next, out);
+        while (!IsEndOfSequence(alternative)) {
+            alternative++;
+        }
+        if (alternative->type != Type::ALT) {
+            break;
+        }
+        alternative++;
+    }
+}
+
+void GrammarMatcher::Dedup(std::vector<Stack>* stacks) {
+    std::sort(stacks->begin(), stacks->end());
+    stacks->erase(std::unique(stacks->begin(), stacks->end()), stacks->end());
+}
+
+std::vector<GrammarMatcher::Stack> GrammarMatcher::Next(const std::vector<Stack>& stacks, uint8_t c) const {
+    std::vector<Stack> out;
+    for (const auto& stack : stacks) {
+        if (stack.empty()) {
+            continue;
+        }
+        auto match = MatchChar(stack.back(), c);
+        if (!match.first) {
+            continue;
+        }
+        Stack next(stack.begin(), stack.end() - 1);
+        if (!IsEndOfSequence(match.second)) {
+            next.push_back(match.second);
+        }
+        Expand(next, &out);
+    }
+    Dedup(&out);
+    return out;
+}
+
+bool GrammarMatcher::Advance(const std::string& text) {
+    auto stacks = stacks_;
+    for (unsigned char c : text) {
+        stacks = Next(stacks, c);
+        if (stacks.empty()) {
+            return false;
+        }
+    }
+    stacks_ = std::move(stacks);
+    return true;
+}
+
+bool GrammarMatcher::accepting() const {
+    return std::any_of(stacks_.begin(), stacks_.end(), [](const Stack& stack) { return stack.empty(); });
+}
+
+bool GrammarMatcher::finished() const {
+    return !stacks_.empty() &&
+           std::all_of(stacks_.begin(), stacks_.end(), [](const Stack& stack) { return stack.empty(); });
+}
+
+} // namespace mls
@@ -0,0 +1,85 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace mls {
+
+/**
+ * A GBNF grammar (the llama.cpp dialect) compiled to flat rule arrays. Rules are sequences
+ * of elements with ALT between alternatives and END after the last; repetition and groups
+ * become rules of their own. Matching is over bytes: literals are matched as their UTF-8
+ * bytes, and a character class range past U+007F accepts any byte of a multi-byte character.
+ */
+class Grammar {
+public:
+    enum class Type : uint8_t {
+        END,
+        ALT,
+        RULE_REF,
+        // A character class: CHAR or CHAR_NOT, then CHAR_RNG_UPPER / CHAR_ALT items
+        CHAR,
+        CHAR_NOT,
+        CHAR_RNG_UPPER,
+        CHAR_ALT,
+    };
+    struct Element {
+        Type type;
+        uint32_t value;
+    };
+    using Rule = std::vector<Element>;
+
+    /**
+     * Parse GBNF text with a rule named root.
+     * @return nullptr with a message in error if it does not parse or a rule is undefined
+     */
+    static std::shared_ptr<const Grammar> Parse(const std::string& text, std::string* error);
+
+    const std::vector<Rule>& rules() const { return rules_; }
+    uint32_t root() const { return root_; }
+
+private:
+    std::vector<Rule> rules_;
+    uint32_t root_ = 0;
+};
+
+/**
+ * Where a grammar is in its input: the set of parse stacks still alive, each the positions
+ * left to match, innermost last. Advancing on a byte keeps the stacks whose next character
+ * class accepts it. An empty stack has matched the whole root rule.
+ */
+class GrammarMatcher {
+public:
+    using Stack = std::vector<const Grammar::Element*>;
+
+    GrammarMatcher() = default;
+    explicit GrammarMatcher(std::shared_ptr<const Grammar> grammar);
+
+    // False, leaving the state unchanged, if no stack accepts all of text
+    bool Advance(const std::string& text);
+    // Stacks alive after c, without changing this matcher; empty if c is rejected
+    std::vector<Stack> Next(const std::vector<Stack>& stacks, uint8_t c) const;
+
+    // The input so far is a complete match
+    bool accepting() const;
+    // Complete, and nothing more could follow
+    bool finished() const;
+    bool alive() const { return !stacks_.empty(); }
+
+    const std::vector<Stack>& stacks() const { return stacks_; }
+    const std::shared_ptr<const Grammar>& grammar() const { return grammar_; }
+
+private:
+    void Expand(const Stack& stack, std::vector<Stack>* out) const;
+    static void Dedup(std::vector<Stack>* stacks);
+
+    std::shared_ptr<const Grammar> grammar_;
+    std::vector<Stack> stacks_;
+};
+
+} // namespace mls
@@ -0,0 +1,56 @@
+//
+// Created for MNN React Native bindings
+//
+#include "image_input.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include "MNN/ImageProcess.hpp"
+#include "MNN/expr/ExprCreator.hpp"
+#include "mls_log.h"
+
+namespace mls {
+
+bool ConvertRgbaImage(const uint8_t* pixels, int width, int height, int stride, int max_side,
+                      MNN::Transformer::PromptImagePart* image) {
+    if (pixels == nullptr || width <= 0 || height <= 0 || stride < width * 4) {
+        MNN_ERROR("ConvertRgbaImage: invalid %dx%d image with stride %d", width, height, stride);
+        return false;
+    }
+    int out_width = width;
+    int out_height = height;
+    int longest = std::max(width, height);
+    if (max_side > 0 && longest > max_side) {
+        float scale = static_cast<float>(max_side) / static_cast<float>(longest);
+        out_width = std::max(1, static_cast<int>(std::lround(width * scale)));
+        out_height = std::max(1, static_cast<int>(std::lround(height * scale)));
+    }
+    MNN::CV::ImageProcess::Config config;
+    config.sourceFormat = MNN::CV::RGBA;
+    config.destFormat = MNN::CV::BGR;
+    config.filterType = out_width == width ? MNN::CV::NEAREST : MNN::CV::BILINEAR;
+    std::unique_ptr<MNN::CV::ImageProcess, decltype(&MNN::CV::ImageProcess::destroy)> process(
+            MNN::CV::ImageProcess::create(config), &MNN::CV::ImageProcess::destroy);
+    if (!process) {
+        return false;
+    }
+    // The transform maps output pixels back onto the source
+    MNN::CV::Matrix transform;
+    transform.setScale(static_cast<float>(width) / static_cast<float>(out_width),
+                       static_cast<float>(height) / static_cast<float>(out_height));
+    process->setMatrix(transform);
+    auto data = MNN::Express::_Input({out_height, out_width, 3}, MNN::Express::NHWC, halide_type_of<uint8_t>());
+    auto code = process->convert(pixels, width, height, stride, data->writeMap<uint8_t>(), out_width, out_height, 3, 0,
+                                 halide_type_of<uint8_t>());
+    if (code != MNN::NO_ERROR) {
+        MNN_ERROR("ConvertRgbaImage: ImageProcess failed with %d", static_cast<int>(code));
+        return false;
+    }
+    image->image_data = data;
+    image->width = out_width;
+    image->height = out_height;
+    MNN_DEBUG("ConvertRgbaImage: %dx%d to %dx%d", width, height, out_width, out_height);
+    return true;
+}
+
+} // namespace mls
@@ -0,0 +1,28 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include "llm/llm.hpp"
+
+namespace mls {
+
+// Images of a multimodal prompt by the name its <img> tag refers to
+using ImageMap = std::map<std::string, MNN::Transformer::PromptImagePart>;
+
+/**
+ * Turn RGBA pixels into the image of an MNN multimodal prompt: BGR bytes in HWC order, as
+ * MNN::CV::imread decodes a file. Scaling down to fit max_side and the channel conversion
+ * are one ImageProcess pass that writes into the VARP the vision encoder reads, so an
+ * in-memory frame never goes through an encoded file.
+ * @param stride bytes per row of pixels
+ * @param max_side longest side of the result, 0 to keep the size
+ * @return false if the pixels could not be converted
+ */
+bool ConvertRgbaImage(const uint8_t* pixels, int width, int height, int stride, int max_side,
+                      MNN::Transformer::PromptImagePart* image);
+
+} // namespace mls
@@ -0,0 +1,140 @@
+#include "inference_worker.hpp"
+#include <algorithm>
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+std::mutex g_hooks_mutex;
+InferenceWorker::ThreadHook g_on_thread_start;
+InferenceWorker::ThreadHook g_on_thread_exit;
+
+} // namespace
+
+void InferenceWorker::SetThreadHooks(ThreadHook on_start, ThreadHook on_exit) {
+    std::lock_guard<std::mutex> lock(g_hooks_mutex);
+    g_on_thread_start = std::move(on_start);
+    g_on_thread_exit = std::move(on_exit);
+}
+
+InferenceWorker::InferenceWorker(size_t capacity) : capacity_(capacity) {
+    thread_ = std::thread([this]() { loop(); });
+}
+
+InferenceWorker::~InferenceWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        shutdown_ = true;
+    }
+    cancelAll();
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+uint64_t InferenceWorker::submit(Job job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (shutdown_ || (job.bounded && queue_.size() >= capacity_)) {
+        MNN_WARN("InferenceWorker: rejecting job, pending=%zu capacity=%zu", queue_.size(), capacity_);
+        return 0;
+    }
+    uint64_t id = next_id_++;
+    auto token = std::make_shared<CancellationToken>();
+    int priority = job.priority;
+    bool cancellable = job.bounded;
+    queue_.push(Entry{priority, id, token, std::make_shared<Job>(std::move(job))});
+    if (cancellable) {
+        queued_tokens_.emplace_back(id, token);
+    }
+    cv_.notify_one();
+    return id;
+}
+
+bool InferenceWorker::cancel(uint64_t job_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (job_id == current_id_ && current_token_) {
+        current_token_->cancel();
+        return true;
+    }
+    for (auto& [id, token] : queued_tokens_) {
+        if (id == job_id) {
+            token->cancel();
+            return true;
+        }
+    }
+    return false;
+}
+
+void InferenceWorker::cancelAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_token_) {
+        current_token_->cancel();
+    }
+    for (auto& entry : queued_tokens_) {
+        entry.second->cancel();
+    }
+}
+
+std::shared_ptr<CancellationToken> InferenceWorker::currentToken() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_token_;
+}
+
+int InferenceWorker::currentPriority() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_priority_;
+}
+
+size_t InferenceWorker::pendingCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+void InferenceWorker::loop() {
+    ThreadHook on_exit;
+    {
+        std::lock_guard<std::mutex> lock(g_hooks_mutex);
+        if (g_on_thread_start) {
+            g_on_thread_start();
+        }
+        on_exit = g_on_thread_exit;
+    }
+    while (true) {
+        Entry entry;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this]() { return shutdown_ || !queue_.empty(); });
+            if (queue_.empty()) {
+                break;
+            }
+            entry = queue_.top();
+            queue_.pop();
+            queued_tokens_.erase(std::remove_if(queued_tokens_.begin(), queued_tokens_.end(),
+                                                [&entry](const auto& item) { return item.first == entry.id; }),
+                                 queued_tokens_.end());
+            current_id_ = entry.id;
+            current_priority_ = entry.priority;
+            current_token_ = entry.token;
+        }
+        if (entry.token->cancelled()) {
+            if (entry.job->on_cancel) {
+                entry.job->on_cancel();
+            }
+        } else if (entry.job->run) {
+            entry.job->run(*entry.token);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            current_id_ = 0;
+            current_priority_ = 0;
+            current_token_.reset();
+        }
+    }
+    if (on_exit) {
+        on_exit();
+    }
+}
+
+} // namespace mls
@@ -0,0 +1,111 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace mls {
+
+/**
+ * Shared cancellation flag handed to a job; set from any thread.
+ */
+class CancellationToken {
+public:
+    void cancel() { cancelled_ = true; }
+    bool cancelled() const { return cancelled_; }
+
+private:
+    std::atomic<bool> cancelled_{false};
+};
+
+/**
+ * Single long-lived thread that runs inference jobs for a session one at a time,
+ * highest priority first and FIFO within a priority. The queue is bounded.
+ */
+class InferenceWorker {
+public:
+    struct Job {
+        int priority = 0;
+        // Unbounded jobs (session state updates) are always accepted and never cancelled
+        bool bounded = true;
+        std::function<void(const CancellationToken&)> run;
+        // Called on the worker thread instead of run when the job is cancelled before it starts
+        std::function<void()> on_cancel;
+    };
+
+    using ThreadHook = std::function<void()>;
+
+    // Priority of session state updates, which run before any queued prompt
+    static constexpr int kUpdatePriority = std::numeric_limits<int>::max();
+    // Priority of work done ahead of need, which runs after every queued prompt
+    static constexpr int kBackgroundPriority = std::numeric_limits<int>::min();
+
+    /**
+     * Hooks run once on every worker thread when it starts and before it exits,
+     * e.g. to attach the thread to a VM for its whole lifetime.
+     */
+    static void SetThreadHooks(ThreadHook on_start, ThreadHook on_exit);
+
+    explicit InferenceWorker(size_t capacity);
+    ~InferenceWorker();
+
+    /**
+     * Queue a job.
+     * @return job id (> 0), or 0 if the queue is full or the worker is shutting down
+     */
+    uint64_t submit(Job job);
+
+    // Cancel a queued or running job; returns false if the id is unknown
+    bool cancel(uint64_t job_id);
+
+    // Cancel the running job and every cancellable queued one
+    void cancelAll();
+
+    // Token of the running job, or nullptr when idle
+    std::shared_ptr<CancellationToken> currentToken();
+
+    // Priority of the running job, or 0 when idle
+    int currentPriority();
+
+    size_t pendingCount();
+
+private:
+    struct Entry {
+        int priority;
+        uint64_t id;
+        std::shared_ptr<CancellationToken> token;
+        std::shared_ptr<Job> job;
+        bool operator<(const Entry& other) const {
+            if (priority != other.priority) {
+                return priority < other.priority;
+            }
+            return id > other.id;
+        }
+    };
+
+    void loop();
+
+    const size_t capacity_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::priority_queue<Entry> queue_;
+    std::vector<std::pair<uint64_t, std::shared_ptr<CancellationToken>>> queued_tokens_;
+    uint64_t next_id_ = 1;
+    uint64_t current_id_ = 0;
+    int current_priority_ = 0;
+    std::shared_ptr<CancellationToken> current_token_;
+    bool shutdown_ = false;
+    std::thread thread_;
+};
+
+} // namespace mls
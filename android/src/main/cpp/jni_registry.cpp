@@ -0,0 +1,140 @@
+#include "jni_registry.h"
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+JniRegistry g_registry;
+
+jclass FindGlobalClass(JNIEnv* env, const char* name, bool optional = false) {
+    jclass local = env->FindClass(name);
+    if (local == nullptr) {
+        env->ExceptionClear();
+        if (optional) {
+            // Stripped by a consumer's R8 config: only the feature that calls it is lost
+            MNN_WARN("JniRegistry: optional class not found %s, its callbacks are disabled", name);
+        } else {
+            MNN_ERROR("JniRegistry: class not found %s", name);
+        }
+        return nullptr;
+    }
+    auto global = reinterpret_cast<jclass>(env->NewGlobalRef(local));
+    env->DeleteLocalRef(local);
+    return global;
+}
+
+jmethodID FindMethod(JNIEnv* env, jclass clazz, const char* name, const char* signature) {
+    if (clazz == nullptr) {
+        return nullptr;
+    }
+    jmethodID method = env->GetMethodID(clazz, name, signature);
+    if (method == nullptr) {
+        env->ExceptionClear();
+        MNN_ERROR("JniRegistry: method not found %s%s", name, signature);
+    }
+    return method;
+}
+
+jfieldID FindField(JNIEnv* env, jclass clazz, const char* name, const char* signature) {
+    if (clazz == nullptr) {
+        return nullptr;
+    }
+    jfieldID field = env->GetFieldID(clazz, name, signature);
+    if (field == nullptr) {
+        env->ExceptionClear();
+        MNN_ERROR("JniRegistry: field not found %s", name);
+    }
+    return field;
+}
+
+void DeleteGlobalClass(JNIEnv* env, jclass& clazz) {
+    if (clazz != nullptr) {
+        env->DeleteGlobalRef(clazz);
+        clazz = nullptr;
+    }
+}
+
+} // namespace
+
+bool InitJniRegistry(JavaVM* vm, JNIEnv* env) {
+    auto& r = g_registry;
+    r.vm = vm;
+
+    r.hashMapClass = FindGlobalClass(env, "java/util/HashMap");
+    r.hashMapInit = FindMethod(env, r.hashMapClass, "<init>", "()V");
+    r.hashMapPut = FindMethod(env, r.hashMapClass, "put",
+                              "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;");
+
+    r.longClass = FindGlobalClass(env, "java/lang/Long");
+    r.longInit = FindMethod(env, r.longClass, "<init>", "(J)V");
+
+    r.doubleClass = FindGlobalClass(env, "java/lang/Double");
+    r.doubleInit = FindMethod(env, r.doubleClass, "<init>", "(D)V");
+
+    r.booleanClass = FindGlobalClass(env, "java/lang/Boolean");
+    r.booleanInit = FindMethod(env, r.booleanClass, "<init>", "(Z)V");
+
+    r.pairClass = FindGlobalClass(env, "android/util/Pair");
+    r.pairFirst = FindField(env, r.pairClass, "first", "Ljava/lang/Object;");
+    r.pairSecond = FindField(env, r.pairClass, "second", "Ljava/lang/Object;");
+
+    r.listClass = FindGlobalClass(env, "java/util/List");
+    r.listSize = FindMethod(env, r.listClass, "size", "()I");
+    r.listGet = FindMethod(env, r.listClass, "get", "(I)Ljava/lang/Object;");
+
+    r.progressListenerClass = FindGlobalClass(env, "com/mnnrn/MnnRnModule$ProgressListener");
+    r.progressListenerOnProgress = FindMethod(env, r.progressListenerClass, "onProgress",
+                                              "(Ljava/lang/String;)Z");
+
+    r.completionListenerClass = FindGlobalClass(env, "com/mnnrn/MnnRnModule$CompletionListener");
+    r.completionListenerOnComplete = FindMethod(env, r.completionListenerClass, "onComplete",
+                                                "(Ljava/util/HashMap;)V");
+
+    // Listeners of optional features
+    r.benchmarkListenerClass = FindGlobalClass(env, "com/mnnrn/MnnRnModule$BenchmarkListener", true);
+    r.benchmarkListenerOnProgress = FindMethod(env, r.benchmarkListenerClass, "onProgress",
+                                               "(Ljava/util/HashMap;)Z");
+
+    r.audioBufferListenerClass = FindGlobalClass(env, "com/mnnrn/MnnRnModule$AudioBufferListener", true);
+    r.audioBufferListenerOnAudioWritten = FindMethod(env, r.audioBufferListenerClass, "onAudioWritten", "(JZ)Z");
+
+    r.prefillListenerClass = FindGlobalClass(env, "com/mnnrn/MnnRnModule$PrefillListener", true);
+    r.prefillListenerOnPrefill = FindMethod(env, r.prefillListenerClass, "onPrefill", "(II)V");
+
+    r.thermalListenerClass = FindGlobalClass(env, "com/mnnrn/MnnRnModule$ThermalListener", true);
+    r.thermalListenerOnThermalState = FindMethod(env, r.thermalListenerClass, "onThermalState",
+                                                 "(Ljava/lang/String;Ljava/lang/String;ZDD)V");
+
+    r.loadListenerClass = FindGlobalClass(env, "com/mnnrn/MnnRnModule$LoadListener", true);
+    r.loadListenerOnLoadProgress = FindMethod(env, r.loadListenerClass, "onLoadProgress", "(Ljava/lang/String;IJJ)V");
+
+    // The optional listeners above are left null when missing; their entry points check
+    return r.hashMapInit && r.hashMapPut && r.longInit && r.doubleInit && r.booleanInit &&
+           r.pairFirst && r.pairSecond && r.listSize && r.listGet &&
+           r.progressListenerOnProgress && r.completionListenerOnComplete;
+}
+
+void ReleaseJniRegistry(JNIEnv* env) {
+    auto& r = g_registry;
+    DeleteGlobalClass(env, r.hashMapClass);
+    DeleteGlobalClass(env, r.longClass);
+    DeleteGlobalClass(env, r.doubleClass);
+    DeleteGlobalClass(env, r.booleanClass);
+    DeleteGlobalClass(env, r.pairClass);
+    DeleteGlobalClass(env, r.listClass);
+    DeleteGlobalClass(env, r.progressListenerClass);
+    DeleteGlobalClass(env, r.completionListenerClass);
+    DeleteGlobalClass(env, r.benchmarkListenerClass);
+    DeleteGlobalClass(env, r.audioBufferListenerClass);
+    DeleteGlobalClass(env, r.prefillListenerClass);
+    DeleteGlobalClass(env, r.thermalListenerClass);
+    DeleteGlobalClass(env, r.loadListenerClass);
+    r = JniRegistry{};
+}
+
+const JniRegistry& GetJniRegistry() {
+    return g_registry;
+}
+
+} // namespace mls
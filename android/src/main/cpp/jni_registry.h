@@ -0,0 +1,74 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+#include <jni.h>
+
+namespace mls {
+
+/**
+ * JNI classes and member IDs resolved once in JNI_OnLoad and shared by all entry points.
+ * Classes are held as global refs so the IDs stay valid for the lifetime of the library.
+ */
+struct JniRegistry {
+    JavaVM* vm = nullptr;
+
+    jclass hashMapClass = nullptr;
+    jmethodID hashMapInit = nullptr;
+    jmethodID hashMapPut = nullptr;
+
+    jclass longClass = nullptr;
+    jmethodID longInit = nullptr;
+
+    jclass doubleClass = nullptr;
+    jmethodID doubleInit = nullptr;
+
+    jclass booleanClass = nullptr;
+    jmethodID booleanInit = nullptr;
+
+    jclass pairClass = nullptr;
+    jfieldID pairFirst = nullptr;
+    jfieldID pairSecond = nullptr;
+
+    jclass listClass = nullptr;
+    jmethodID listSize = nullptr;
+    jmethodID listGet = nullptr;
+
+    jclass progressListenerClass = nullptr;
+    jmethodID progressListenerOnProgress = nullptr;
+
+    jclass completionListenerClass = nullptr;
+    jmethodID completionListenerOnComplete = nullptr;
+
+    jclass benchmarkListenerClass = nullptr;
+    jmethodID benchmarkListenerOnProgress = nullptr;
+
+    jclass audioBufferListenerClass = nullptr;
+    jmethodID audioBufferListenerOnAudioWritten = nullptr;
+
+    jclass prefillListenerClass = nullptr;
+    jmethodID prefillListenerOnPrefill = nullptr;
+
+    jclass thermalListenerClass = nullptr;
+    jmethodID thermalListenerOnThermalState = nullptr;
+
+    jclass loadListenerClass = nullptr;
+    jmethodID loadListenerOnLoadProgress = nullptr;
+};
+
+/**
+ * Resolve every class and member ID. Must be called from JNI_OnLoad.
+ * @return false if a lookup the generation path needs failed (a pending exception is cleared).
+ * Missing listeners of optional features (benchmark, audio, prefill, thermal, load progress)
+ * are logged and left null.
+ */
+bool InitJniRegistry(JavaVM* vm, JNIEnv* env);
+
+/**
+ * Drop the global refs taken by InitJniRegistry. Called from JNI_OnUnload.
+ */
+void ReleaseJniRegistry(JNIEnv* env);
+
+const JniRegistry& GetJniRegistry();
+
+} // namespace mls
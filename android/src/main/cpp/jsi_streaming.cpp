@@ -0,0 +1,185 @@
+//
+// Created for MNN React Native bindings
+//
+
+#include "jsi_streaming.h"
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "mls_log.h"
+#include "mls_trace.h"
+#include "llm_session.h"
+#include "generation_metrics.hpp"
+
+namespace jsi = facebook::jsi;
+using facebook::react::CallInvoker;
+
+namespace mls {
+
+namespace {
+
+std::mutex g_sessions_mutex;
+std::unordered_map<int64_t, LlmSession*> g_sessions;
+
+/**
+ * The JS callbacks of one job. jsi values may only be touched on the JS thread, so the
+ * functions are dropped there by the completion call; the worker only ever destroys the
+ * emptied holder.
+ */
+struct JsCallbacks {
+    std::optional<jsi::Function> on_chunk;
+    std::optional<jsi::Function> on_complete;
+};
+
+struct CompletedJob {
+    std::vector<GenerationMetric> metrics;
+    bool cancelled = false;
+};
+
+using ProgressCallback = std::function<bool(const std::string&, bool is_eop)>;
+using Generate = std::function<const MNN::Transformer::LlmContext*(LlmSession*, const ProgressCallback&,
+                                                                   const CancellationToken&)>;
+
+jsi::Object toMetricsObject(jsi::Runtime& runtime, const CompletedJob& job) {
+    jsi::Object metrics(runtime);
+    for (const auto& metric : job.metrics) {
+        metrics.setProperty(runtime, metric.key, metric.value);
+    }
+    metrics.setProperty(runtime, "cancelled", job.cancelled);
+    return metrics;
+}
+
+void postCompletion(const std::shared_ptr<CallInvoker>& js_invoker, std::shared_ptr<JsCallbacks> callbacks,
+                    CompletedJob job) {
+    js_invoker->invokeAsync([callbacks = std::move(callbacks), job = std::move(job)](jsi::Runtime& runtime) {
+        if (callbacks->on_complete) {
+            callbacks->on_complete->call(runtime, toMetricsObject(runtime, job));
+        }
+        callbacks->on_chunk.reset();
+        callbacks->on_complete.reset();
+    });
+}
+
+double submitStreaming(jsi::Runtime& runtime, const std::shared_ptr<CallInvoker>& js_invoker,
+                       const jsi::Value& session_id, int priority, const jsi::Value& on_chunk,
+                       const jsi::Value& on_complete, Generate generate) {
+    auto callbacks = std::make_shared<JsCallbacks>();
+    if (on_chunk.isObject()) {
+        callbacks->on_chunk = on_chunk.getObject(runtime).getFunction(runtime);
+    }
+    if (on_complete.isObject()) {
+        callbacks->on_complete = on_complete.getObject(runtime).getFunction(runtime);
+    }
+
+    std::lock_guard<std::mutex> lock(g_sessions_mutex);
+    auto it = g_sessions.find(static_cast<int64_t>(session_id.asNumber()));
+    if (it == g_sessions.end()) {
+        throw jsi::JSError(runtime, "Invalid session ID");
+    }
+    LlmSession* llm = it->second;
+
+    InferenceWorker::Job job;
+    job.priority = priority;
+    job.run = [llm, js_invoker, callbacks, generate = std::move(generate)](const CancellationToken& token) {
+        ProgressCallback on_progress = [&js_invoker, &callbacks](const std::string& text, bool is_eop) {
+            if (is_eop || text.empty() || !callbacks->on_chunk) {
+                return false;
+            }
+            MLS_TRACE_SCOPE("mls::onChunkJsi");
+            js_invoker->invokeAsync([callbacks, text](jsi::Runtime& runtime) {
+                if (callbacks->on_chunk) {
+                    callbacks->on_chunk->call(runtime, jsi::String::createFromUtf8(runtime, text));
+                }
+            });
+            return false;
+        };
+        auto* context = generate(llm, on_progress, token);
+        postCompletion(js_invoker, callbacks, {CollectGenerationMetrics(*llm, context), token.cancelled()});
+    };
+    job.on_cancel = [js_invoker, callbacks]() {
+        postCompletion(js_invoker, callbacks, {{}, true});
+    };
+    auto job_id = llm->worker().submit(std::move(job));
+    if (job_id == 0) {
+        MNN_DEBUG("submitStreaming: queue full");
+    }
+    return static_cast<double>(job_id);
+}
+
+std::vector<PromptItem> toHistory(jsi::Runtime& runtime, const jsi::Value& messages) {
+    std::vector<PromptItem> history;
+    auto array = messages.asObject(runtime).asArray(runtime);
+    size_t size = array.size(runtime);
+    history.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        auto message = array.getValueAtIndex(runtime, i).asObject(runtime);
+        auto role = message.getProperty(runtime, "role");
+        auto content = message.getProperty(runtime, "content");
+        if (role.isString() && content.isString()) {
+            history.emplace_back(role.getString(runtime).utf8(runtime), content.getString(runtime).utf8(runtime));
+        }
+    }
+    return history;
+}
+
+// Optional trailing LoRA adapter path; empty selects the base model
+std::string toAdapter(jsi::Runtime& rt, const jsi::Value* args, size_t count, size_t index) {
+    return count > index && args[index].isString() ? args[index].asString(rt).utf8(rt) : std::string();
+}
+
+} // namespace
+
+void InstallJsiStreaming(jsi::Runtime& runtime, std::shared_ptr<CallInvoker> js_invoker) {
+    jsi::Object bindings(runtime);
+
+    bindings.setProperty(runtime, "submitPrompt", jsi::Function::createFromHostFunction(
+            runtime, jsi::PropNameID::forAscii(runtime, "submitPrompt"), 6,
+            [js_invoker](jsi::Runtime& rt, const jsi::Value&, const jsi::Value* args, size_t count) -> jsi::Value {
+                if (count < 6) {
+                    throw jsi::JSError(rt, "submitPrompt expects 6 arguments");
+                }
+                std::string prompt = args[1].asString(rt).utf8(rt);
+                int priority = static_cast<int>(args[3].asNumber());
+                return submitStreaming(rt, js_invoker, args[0], priority, args[4], args[5],
+                                       [prompt = std::move(prompt), adapter = toAdapter(rt, args, count, 6)](
+                                               LlmSession* llm, const ProgressCallback& on_progress,
+                                               const CancellationToken& token) {
+                                           llm->SelectAdapter(adapter);
+                                           return llm->Response(prompt, on_progress, &token);
+                                       });
+            }));
+
+    bindings.setProperty(runtime, "submitWithHistory", jsi::Function::createFromHostFunction(
+            runtime, jsi::PropNameID::forAscii(runtime, "submitWithHistory"), 5,
+            [js_invoker](jsi::Runtime& rt, const jsi::Value&, const jsi::Value* args, size_t count) -> jsi::Value {
+                if (count < 5) {
+                    throw jsi::JSError(rt, "submitWithHistory expects 5 arguments");
+                }
+                auto history = toHistory(rt, args[1]);
+                int priority = static_cast<int>(args[2].asNumber());
+                return submitStreaming(rt, js_invoker, args[0], priority, args[3], args[4],
+                                       [history = std::move(history), adapter = toAdapter(rt, args, count, 5)](
+                                               LlmSession* llm, const ProgressCallback& on_progress,
+                                               const CancellationToken& token) {
+                                           llm->SelectAdapter(adapter);
+                                           return llm->ResponseWithHistory(history, on_progress, &token);
+                                       });
+            }));
+
+    runtime.global().setProperty(runtime, "__mnnRnStreaming", std::move(bindings));
+}
+
+void RegisterStreamingSession(int64_t session_id, LlmSession* session) {
+    std::lock_guard<std::mutex> lock(g_sessions_mutex);
+    g_sessions[session_id] = session;
+}
+
+void UnregisterStreamingSession(int64_t session_id) {
+    std::lock_guard<std::mutex> lock(g_sessions_mutex);
+    g_sessions.erase(session_id);
+}
+
+} // namespace mls
@@ -0,0 +1,33 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <jsi/jsi.h>
+#include <ReactCommon/CallInvoker.h>
+
+namespace mls {
+
+class LlmSession;
+
+/**
+ * Install global.__mnnRnStreaming, which submits prompts straight to a session's inference
+ * worker and calls JS back through the CallInvoker: one hop per chunk instead of
+ * JNI -> Kotlin -> event emitter. Must run on the JS thread.
+ *
+ *   submitPrompt(sessionId, prompt, keepHistory, priority, onChunk, onComplete[, adapter]) -> jobId
+ *   submitWithHistory(sessionId, messages, priority, onChunk, onComplete[, adapter]) -> jobId
+ *
+ * A job id of 0 means the session's queue is full. onComplete receives the metrics object
+ * and is called exactly once for every accepted job, including cancelled ones.
+ */
+void InstallJsiStreaming(facebook::jsi::Runtime& runtime,
+                         std::shared_ptr<facebook::react::CallInvoker> js_invoker);
+
+// Make a platform session reachable from JS by its id; unregister before releasing it
+void RegisterStreamingSession(int64_t session_id, LlmSession* session);
+void UnregisterStreamingSession(int64_t session_id);
+
+} // namespace mls
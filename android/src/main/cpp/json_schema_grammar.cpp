@@ -0,0 +1,319 @@
+//
+// Created for MNN React Native bindings
+//
+#include "json_schema_grammar.hpp"
+#include <cctype>
+#include <cstdio>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace mls {
+
+namespace {
+
+using Json = nlohmann::ordered_json;
+
+// Whitespace is bounded so the model cannot pad the output forever
+const char* kPrimitiveRules = R"(space ::= | " " | "\n" [ \t]{0,20}
+boolean ::= ("true" | "false") space
+null ::= "null" space
+integer ::= "-"? ("0" | [1-9] [0-9]{0,15}) space
+number ::= "-"? ("0" | [1-9] [0-9]{0,15}) ("." [0-9]+)? ([eE] [-+]? [0-9]+)? space
+char ::= [^"\\\x7F\x00-\x1F] | "\\" (["\\/bfnrt] | "u" [0-9a-fA-F]{4})
+string ::= "\"" char* "\"" space
+value ::= object | array | string | number | boolean | null
+object ::= "{" space (string ":" space value ("," space string ":" space value)*)? "}" space
+array ::= "[" space (value ("," space value)*)? "]" space
+)";
+
+bool IsRuleName(const std::string& text) {
+    if (text.empty()) {
+        return false;
+    }
+    for (char c : text) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-') {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string RuleName(const std::string& text) {
+    std::string name;
+    for (char c : text) {
+        name += std::isalnum(static_cast<unsigned char>(c)) ? c : '-';
+    }
+    return name;
+}
+
+std::string Literal(const std::string& text) {
+    std::string out = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '\r') {
+            out += "\\r";
+        } else if (c == '\t') {
+            out += "\\t";
+        } else if (c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\x%02X", c);
+            out += escape;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+// The exact JSON text of a value, then optional whitespace
+std::string JsonLiteral(const Json& value) {
+    return Literal(value.dump()) + " space";
+}
+
+class SchemaConverter {
+public:
+    explicit SchemaConverter(const Json& root) : root_(root) {
+        for (const char* name : {"root", "space", "boolean", "null", "integer", "number", "char", "string",
+                                 "value", "object", "array"}) {
+            names_.insert(name);
+        }
+    }
+
+    std::string Convert(std::string* error) {
+        auto root = Visit(root_, "root");
+        if (!error_.empty()) {
+            *error = error_;
+            return "";
+        }
+        std::string out = "root ::= " + root + "\n";
+        for (const auto& [name, expression] : rules_) {
+            out += name + " ::= " + expression + "\n";
+        }
+        return out + kPrimitiveRules;
+    }
+
+private:
+    void Fail(const std::string& message) {
+        if (error_.empty()) {
+            error_ = message;
+        }
+    }
+
+    std::string UniqueName(const std::string& base) {
+        std::string name = base;
+        for (int i = 1; names_.count(name) > 0; i++) {
+            name = base + "-" + std::to_string(i);
+        }
+        names_.insert(name);
+        return name;
+    }
+
+    // A rule for expression, or the expression itself when it already is one
+    std::string Rule(const std::string& name, const std::string& expression) {
+        if (IsRuleName(expression)) {
+            return expression;
+        }
+        auto rule = UniqueName(name);
+        rules_.emplace_back(rule, expression);
+        return rule;
+    }
+
+    std::string Alternatives(const Json& schemas, const std::string& name) {
+        if (!schemas.is_array() || schemas.empty()) {
+            Fail(name + ": anyOf / oneOf needs a list of schemas");
+            return "value";
+        }
+        std::string out;
+        for (size_t i = 0; i < schemas.size(); i++) {
+            auto item = name + "-" + std::to_string(i);
+            out += (i == 0 ? "(" : " | ") + Rule(item, Visit(schemas[i], item));
+        }
+        return out + ")";
+    }
+
+    std::string Ref(const std::string& ref) {
+        auto it = refs_.find(ref);
+        if (it != refs_.end()) {
+            return it->second;
+        }
+        if (ref.rfind("#/", 0) != 0) {
+            Fail("only local $ref is supported: " + ref);
+            return "value";
+        }
+        const Json* target = &root_;
+        std::string segment;
+        size_t start = 2;
+        while (start <= ref.size()) {
+            size_t end = ref.find('/', start);
+            if (end == std::string::npos) {
+                end = ref.size();
+            }
+            segment = ref.substr(start, end - start);
+            // JSON pointer escapes
+            for (size_t pos; (pos = segment.find("~1")) != std::string::npos;) {
+                segment.replace(pos, 2, "/");
+            }
+            for (size_t pos; (pos = segment.find("~0")) != std::string::npos;) {
+                segment.replace(pos, 2, "~");
+            }
+            if (!target->is_object() || !target->contains(segment)) {
+                Fail("unresolved $ref: " + ref);
+                return "value";
+            }
+            target = &(*target)[segment];
+            start = end + 1;
+        }
+        // Named before visiting, so recursive schemas refer back to the rule
+        auto name = UniqueName("ref-" + RuleName(segment));
+        refs_[ref] = name;
+        size_t slot = rules_.size();
+        rules_.emplace_back(name, "");
+        auto expression = Visit(*target, name);
+        rules_[slot].second = expression;
+        return name;
+    }
+
+    std::string VisitObject(const Json& schema, const std::string& name) {
+        auto properties = schema.find("properties");
+        if (properties == schema.end() || !properties->is_object() || properties->empty()) {
+            return "object";
+        }
+        std::set<std::string> required;
+        auto list = schema.find("required");
+        if (list != schema.end() && list->is_array()) {
+            for (const auto& key : *list) {
+                if (key.is_string()) {
+                    required.insert(key.get<std::string>());
+                }
+            }
+        }
+        std::vector<std::string> required_pairs;
+        std::vector<std::string> optional_pairs;
+        for (const auto& [key, value] : properties->items()) {
+            auto item = name + "-" + RuleName(key);
+            auto pair = Literal(Json(key).dump()) + " space \":\" space " + Rule(item, Visit(value, item));
+            (required.count(key) > 0 ? required_pairs : optional_pairs).push_back(pair);
+        }
+        std::string body;
+        for (size_t i = 0; i < required_pairs.size(); i++) {
+            body += (i == 0 ? "" : " \",\" space ") + required_pairs[i];
+        }
+        if (!required_pairs.empty()) {
+            for (const auto& pair : optional_pairs) {
+                body += " (\",\" space " + pair + ")?";
+            }
+        } else {
+            // Any in-order subset: choose the first present property, then each later one or not
+            for (size_t i = 0; i < optional_pairs.size(); i++) {
+                body += (i == 0 ? "(" : " | ") + optional_pairs[i];
+                for (size_t j = i + 1; j < optional_pairs.size(); j++) {
+                    body += " (\",\" space " + optional_pairs[j] + ")?";
+                }
+            }
+            body += ")?";
+        }
+        return "\"{\" space " + body + " \"}\" space";
+    }
+
+    std::string VisitType(const Json& schema, const std::string& type, const std::string& name) {
+        if (type == "object") {
+            return VisitObject(schema, name);
+        }
+        if (type == "array") {
+            auto items = schema.find("items");
+            std::string item = "value";
+            if (items != schema.end() && (items->is_object() || items->is_boolean())) {
+                item = Rule(name + "-item", Visit(*items, name + "-item"));
+            }
+            return "\"[\" space (" + item + " (\",\" space " + item + ")*)? \"]\" space";
+        }
+        if (type == "string" || type == "number" || type == "integer" || type == "boolean" || type == "null") {
+            return type;
+        }
+        Fail(name + ": unsupported type '" + type + "'");
+        return "value";
+    }
+
+    std::string Visit(const Json& schema, const std::string& name) {
+        if (schema.is_boolean()) {
+            if (!schema.get<bool>()) {
+                Fail(name + ": false accepts no value");
+            }
+            return "value";
+        }
+        if (!schema.is_object()) {
+            Fail(name + ": a schema must be an object");
+            return "value";
+        }
+        if (schema.contains("$ref") && schema["$ref"].is_string()) {
+            return Ref(schema["$ref"].get<std::string>());
+        }
+        if (schema.contains("const")) {
+            return JsonLiteral(schema["const"]);
+        }
+        auto values = schema.find("enum");
+        if (values != schema.end()) {
+            if (!values->is_array() || values->empty()) {
+                Fail(name + ": enum needs a list of values");
+                return "value";
+            }
+            std::string out;
+            for (const auto& value : *values) {
+                out += (out.empty() ? "(" : " | ") + Literal(value.dump());
+            }
+            return out + ") space";
+        }
+        for (const char* key : {"anyOf", "oneOf"}) {
+            if (schema.contains(key)) {
+                return Alternatives(schema[key], name);
+            }
+        }
+        auto all = schema.find("allOf");
+        if (all != schema.end()) {
+            if (all->is_array() && all->size() == 1) {
+                return Visit((*all)[0], name);
+            }
+            Fail(name + ": allOf is only supported with a single schema");
+            return "value";
+        }
+        auto type = schema.find("type");
+        if (type != schema.end() && type->is_array()) {
+            std::string out;
+            for (const auto& each : *type) {
+                out += (out.empty() ? "(" : " | ") + VisitType(schema, each.is_string() ? each.get<std::string>() : "", name);
+            }
+            return out.empty() ? "value" : out + ")";
+        }
+        if (type != schema.end() && type->is_string()) {
+            return VisitType(schema, type->get<std::string>(), name);
+        }
+        if (schema.contains("properties")) {
+            return VisitObject(schema, name);
+        }
+        if (schema.contains("items")) {
+            return VisitType(schema, "array", name);
+        }
+        return "value";
+    }
+
+    const Json& root_;
+    std::string error_;
+    std::set<std::string> names_;
+    std::map<std::string, std::string> refs_;
+    std::vector<std::pair<std::string, std::string>> rules_;
+};
+
+} // namespace
+
+std::string JsonSchemaToGbnf(const nlohmann::ordered_json& schema, std::string* error) {
+    SchemaConverter converter(schema);
+    return converter.Convert(error);
+}
+
+} // namespace mls
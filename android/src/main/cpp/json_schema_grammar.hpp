@@ -0,0 +1,21 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <string>
+#include "nlohmann/json.hpp"
+
+namespace mls {
+
+/**
+ * GBNF for the JSON documents a schema accepts, for Grammar::Parse. Supports type (or a list
+ * of types), properties and required, items, enum, const, anyOf / oneOf and local $ref into
+ * definitions or $defs. Required properties come first and the optional ones after, each in the
+ * schema's order; additionalProperties, length, range, pattern and format constraints are not
+ * enforced. An empty schema or true accepts any JSON value.
+ * @return empty with a message in error for a schema it cannot express
+ */
+std::string JsonSchemaToGbnf(const nlohmann::ordered_json& schema, std::string* error);
+
+} // namespace mls
@@ -0,0 +1,78 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include "nlohmann/json.hpp"
+#include "mls_log.h"
+
+namespace mls {
+
+/**
+ * Session-level KV cache layout, from extra_config "kv_cache":
+ *   {"precision": "auto" | "fp16" | "int8", "allocation": "grow" | "reserve",
+ *    "reserve_tokens": n, "spill": bool, "spill_limit_mb": n}
+ * Precision and spilling are load-time MNN options, applied to the model config in Load.
+ * MNN grows the cache a few tokens at a time and never shrinks it on reset, so "reserve" runs
+ * reserve_tokens through the model once at load and later turns find the cache already sized.
+ */
+struct KvCacheConfig {
+    // MNN quant_qkv values: keys in asymmetric int8 and values in fp8
+    static constexpr int kQuantKeyValue = 3;
+
+    std::string precision = "auto";
+    bool reserve = false;
+    // 0 reserves the context window's max_tokens, or KV_DEFAULT_RESERVE_TOKENS without one
+    int reserve_tokens = 0;
+    bool spill = false;
+    int spill_limit_mb = 0;
+
+    static KvCacheConfig Parse(const nlohmann::json& value) {
+        KvCacheConfig config;
+        if (!value.is_object()) {
+            return config;
+        }
+        config.precision = value.value("precision", config.precision);
+        if (config.precision != "auto" && config.precision != "fp16" && config.precision != "int8") {
+            MNN_WARN("kv_cache: unsupported precision '%s', leaving it to the model config", config.precision.c_str());
+            config.precision = "auto";
+        }
+        auto allocation = value.value("allocation", std::string("grow"));
+        if (allocation != "grow" && allocation != "reserve") {
+            MNN_WARN("kv_cache: unsupported allocation '%s', growing on demand", allocation.c_str());
+        }
+        config.reserve = allocation == "reserve";
+        config.reserve_tokens = std::max(0, value.value("reserve_tokens", 0));
+        config.spill = value.value("spill", false);
+        config.spill_limit_mb = std::max(0, value.value("spill_limit_mb", 0));
+        return config;
+    }
+
+    /**
+     * Set MNN's options in model_config. Spilling needs a directory for the cache file, so it
+     * only applies when the model is loaded with a tmp_path.
+     */
+    void applyTo(nlohmann::json& model_config) const {
+        if (precision == "int8") {
+            model_config["quant_qkv"] = kQuantKeyValue;
+        } else if (precision == "fp16") {
+            // MNN keeps the cache at the precision the model runs at
+            model_config["quant_qkv"] = 0;
+            model_config["precision"] = "low";
+        }
+        if (spill) {
+            if (model_config.value("tmp_path", std::string()).empty()) {
+                MNN_WARN("kv_cache: spill needs mmap_dir, keeping the cache in memory");
+                return;
+            }
+            model_config["kvcache_mmap"] = true;
+            if (spill_limit_mb > 0) {
+                model_config["kvcache_limit"] = spill_limit_mb;
+            }
+        }
+    }
+};
+
+} // namespace mls
@@ -0,0 +1,118 @@
+#include "llm_model_registry.hpp"
+#include "MNN/expr/ExecutorScope.hpp"
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+// Options that change the loaded runtime or weights; sessions differing only in
+// prompts or sampling can share a model
+constexpr const char* kRuntimeConfigKeys[] = {
+    "backend_type", "thread_num", "precision", "memory", "power", "use_mmap", "tmp_path",
+    "reuse_kv", "dynamic_option", "quant_qkv", "kvcache_limit", "kvcache_mmap", "use_template",
+};
+
+} // namespace
+
+void ModelTurnLock::lock(int priority) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto key = std::make_pair(priority, -static_cast<int64_t>(next_ticket_++));
+    waiting_.insert(key);
+    cv_.wait(lock, [this, &key]() { return !held_ && *waiting_.rbegin() == key; });
+    waiting_.erase(key);
+    held_ = true;
+}
+
+void ModelTurnLock::unlock() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        held_ = false;
+    }
+    cv_.notify_all();
+}
+
+SharedLlm::~SharedLlm() {
+    MNN_DEBUG("LIFECYCLE: SharedLlm released %p", llm);
+    delete llm;
+}
+
+MNN::Transformer::Llm* CreateAndLoadLlm(const std::string& model_path, const nlohmann::json& config,
+                                        const std::function<void()>& on_configured) {
+    MNN::BackendConfig backendConfig;
+    auto executor = MNN::Express::Executor::newExecutor(MNN_FORWARD_CPU, backendConfig, 1);
+    MNN::Express::ExecutorScope s(executor);
+    auto* llm = MNN::Transformer::Llm::createLLM(model_path);
+    if (llm == nullptr) {
+        MNN_ERROR("createLLM failed for %s", model_path.c_str());
+        return nullptr;
+    }
+    auto config_str = config.dump();
+    MNN_DEBUG("extra_config: %s", config_str.c_str());
+    llm->set_config(config_str);
+    MNN_DEBUG("dumped config: %s", llm->dump_config().c_str());
+    if (on_configured) {
+        on_configured();
+    }
+    if (!llm->load()) {
+        MNN_ERROR("load failed for %s", model_path.c_str());
+        delete llm;
+        return nullptr;
+    }
+    return llm;
+}
+
+LlmModelRegistry& LlmModelRegistry::Instance() {
+    static LlmModelRegistry registry;
+    return registry;
+}
+
+std::string LlmModelRegistry::MakeKey(const std::string& model_path, const nlohmann::json& config) {
+    nlohmann::json runtime = nlohmann::json::object();
+    for (const char* key : kRuntimeConfigKeys) {
+        if (config.contains(key)) {
+            runtime[key] = config[key];
+        }
+    }
+    return model_path + "|" + runtime.dump();
+}
+
+std::shared_ptr<SharedLlm> LlmModelRegistry::Acquire(const std::string& model_path, const nlohmann::json& config,
+                                                    const std::function<void()>& on_configured) {
+    auto key = MakeKey(model_path, config);
+    // Loading happens under the registry lock so two sessions never load the same model twice
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = models_.find(key);
+    if (it != models_.end()) {
+        if (auto existing = it->second.lock()) {
+            MNN_DEBUG("LlmModelRegistry: sharing loaded model %s", key.c_str());
+            return existing;
+        }
+        models_.erase(it);
+    }
+    auto* llm = CreateAndLoadLlm(model_path, config, on_configured);
+    if (llm == nullptr) {
+        return nullptr;
+    }
+    auto shared = std::make_shared<SharedLlm>();
+    shared->llm = llm;
+    models_[key] = shared;
+    MNN_DEBUG("LlmModelRegistry: loaded model %s", key.c_str());
+    return shared;
+}
+
+size_t LlmModelRegistry::loadedCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = 0;
+    for (auto it = models_.begin(); it != models_.end();) {
+        if (it->second.expired()) {
+            it = models_.erase(it);
+        } else {
+            count++;
+            ++it;
+        }
+    }
+    return count;
+}
+
+} // namespace mls
@@ -0,0 +1,83 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include "nlohmann/json.hpp"
+#include "llm/llm.hpp"
+
+namespace mls {
+
+/**
+ * Mutex that hands the model to the highest-priority waiter when it is released, FIFO
+ * among equal priorities. Satisfies BasicLockable; lock() without an argument uses 0.
+ */
+class ModelTurnLock {
+public:
+    void lock(int priority);
+    void lock() { lock(0); }
+    void unlock();
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    bool held_ = false;
+    uint64_t next_ticket_ = 0;
+    // (priority, -ticket) of every waiter; the largest goes next
+    std::set<std::pair<int, int64_t>> waiting_;
+};
+
+/**
+ * One loaded model (weights, runtime and KV cache) shared by several LlmSession contexts.
+ * Sessions hold it through a shared_ptr; the model is released with the last session.
+ */
+struct SharedLlm {
+    MNN::Transformer::Llm* llm = nullptr;
+    // Serializes generation across the sessions sharing this model, by request priority
+    ModelTurnLock mutex;
+    // Session whose config and callbacks are currently applied to llm
+    const void* active_owner = nullptr;
+
+    ~SharedLlm();
+};
+
+/**
+ * Create an Llm, apply config and load the weights. on_configured runs once the config is
+ * applied, before the tokenizer and weights load.
+ * @return nullptr if loading failed
+ */
+MNN::Transformer::Llm* CreateAndLoadLlm(const std::string& model_path, const nlohmann::json& config,
+                                        const std::function<void()>& on_configured = nullptr);
+
+/**
+ * Process-wide registry of loaded models keyed by model path and runtime options.
+ */
+class LlmModelRegistry {
+public:
+    static LlmModelRegistry& Instance();
+
+    /**
+     * Get the loaded model for model_path with these runtime options, loading it if needed.
+     * on_configured is passed to CreateAndLoadLlm when the model is loaded by this call.
+     * @return nullptr if loading failed
+     */
+    std::shared_ptr<SharedLlm> Acquire(const std::string& model_path, const nlohmann::json& config,
+                                       const std::function<void()>& on_configured = nullptr);
+
+    size_t loadedCount();
+
+private:
+    static std::string MakeKey(const std::string& model_path, const nlohmann::json& config);
+
+    std::mutex mutex_;
+    std::map<std::string, std::weak_ptr<SharedLlm>> models_;
+};
+
+} // namespace mls
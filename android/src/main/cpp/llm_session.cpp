@@ -1,370 +1,1510 @@
-//
-// Created for MNN React Native bindings - based on the sample code
-//
-
-#include "llm_session.h"
-#include <utility>
-#include <chrono>
-#include "MNN/MNNForwardType.h"
-#include "MNN/expr/ExecutorScope.hpp"
-#include "mls_log.h"
-#include "mls_config.h"
-#include "utf8_stream_processor.hpp"
-#include "llm_stream_buffer.hpp"
-
-namespace mls {
-
-std::string trimLeadingWhitespace(const std::string& str) {
-    auto it = std::find_if(str.begin(), str.end(), [](unsigned char ch) {
-        return !std::isspace(ch);
-    });
-    return {it, str.end()};
-}
-
-std::string getUserString(const char* user_content, bool for_history, bool is_r1) {
-    if (is_r1) {
-        return R1_USER_START + std::string(user_content) + R1_ASSISTANT_START + (for_history ? "" : R1_THINK_START);
-    } else {
-        return user_content;
-    }
-}
-
-std::string GetSystemPromptString(std::string system_prompt, bool is_r1) {
-    if (is_r1) {
-        return std::string(R1_SENTENCE_START) + system_prompt;
-    } else {
-        return system_prompt;
-    }
-}
-
-std::string deleteThinkPart(std::string assistant_content) {
-    std::size_t think_start = assistant_content.find(R1_THINK_START);
-    if (think_start == std::string::npos) {
-        return assistant_content;
-    }
-    std::size_t think_end = assistant_content.find(R1_THINK_END, think_start);
-    if (think_end == std::string::npos) {
-        return assistant_content;
-    }
-    think_end += std::string(R1_THINK_END).length();
-    assistant_content.erase(think_start, think_end - think_start);
-    return assistant_content;
-}
-
-std::string getR1AssistantString(std::string assistant_content) {
-    std::size_t pos = assistant_content.find(R1_THINK_END);
-    if (pos != std::string::npos) {
-        assistant_content.erase(0, pos + std::string(R1_THINK_END).length());
-    }
-    return trimLeadingWhitespace(assistant_content) + R1_SENTENCE_END;
-}
-
-void LlmSession::Reset() {
-    history_.resize(1);
-}
-
-LlmSession::LlmSession(std::string model_path, json config, json extra_config, std::vector<std::string> history):
-        model_path_(std::move(model_path)), config_(std::move(config)), extra_config_(std::move(extra_config)) {
-    max_new_tokens_ = config_.contains("max_new_tokens") ? config_["max_new_tokens"].get<int>() : DEFAULT_MAX_NEW_TOKENS;
-    keep_history_ = !extra_config_.contains("keep_history") || extra_config_["keep_history"].get<bool>();
-    is_r1_ = extra_config_.contains("is_r1") && extra_config_["is_r1"].get<bool>();
-    system_prompt_ = config_.contains("system_prompt") ? config_["system_prompt"].get<std::string>() : DEFAULT_SYSTEM_PROMPT;
-    history_.emplace_back("system", GetSystemPromptString(system_prompt_, is_r1_));
-    
-    if (!history.empty()) {
-        for (size_t i = 0; i < history.size(); i++) {
-            if (is_r1_) {
-                if (i % 2 == 0) {
-                    history_.emplace_back("user", getUserString(history[i].c_str(), true, is_r1_));
-                } else {
-                    history_.emplace_back("assistant", getR1AssistantString(history[i]));
-                }
-            } else {
-                history_.emplace_back(i % 2 == 0 ? "user" : "assistant",
-                                      i % 2 == 0 ? history[i] :
-                                      deleteThinkPart(history[i]));
-            }
-        }
-    }
-}
-
-void LlmSession::Load() {
-    std::string root_cache_dir_str = extra_config_["mmap_dir"];
-    bool use_mmap = !extra_config_["mmap_dir"].get<std::string>().empty();
-    MNN::BackendConfig backendConfig;
-    auto executor = MNN::Express::Executor::newExecutor(MNN_FORWARD_CPU, backendConfig, 1);
-    MNN::Express::ExecutorScope s(executor);
-    llm_ = Llm::createLLM(model_path_);
-    json config = config_;
-    config["use_mmap"] = use_mmap;
-    if (use_mmap) {
-        std::string temp_dir = root_cache_dir_str;
-        config["tmp_path"] = temp_dir;
-    }
-    if (is_r1_) {
-        config["use_template"] = false;
-        config["precision"] = "high";
-    }
-    current_config_ = config;
-    auto config_str = config.dump();
-    MNN_DEBUG("extra_config: %s", config_str.c_str());
-    llm_->set_config(config_str);
-    MNN_DEBUG("dumped config: %s", llm_->dump_config().c_str());
-    llm_->load();
-}
-
-LlmSession::~LlmSession() {
-    MNN_DEBUG("LIFECYCLE: LlmSession DESTROYED at %p", this);
-    delete llm_;
-}
-
-const MNN::Transformer::LlmContext * LlmSession::Response(const std::string &prompt,
-                                                          const std::function<bool(const std::string&, bool is_eop)>& on_progress) {
-    if (llm_ == nullptr) {
-        return nullptr;
-    }
-
-    if (!keep_history_) {
-        history_.resize(1);
-    }
-    int current_size = 0;
-    stop_requested_ = false;
-    generate_text_end_ = false;
-    std::stringstream response_buffer;
-    mls::Utf8StreamProcessor processor([&response_buffer, &on_progress, this](const std::string& utf8Char) {
-        bool is_eop = utf8Char.find(END_OF_PROMPT) != std::string::npos;
-        if (!is_eop) {
-            response_buffer << utf8Char;
-        } else {
-            std::string response_result = response_buffer.str();
-            MNN_DEBUG("submitNative Result %s", response_result.c_str());
-            response_string_for_debug = response_result;
-            if (is_r1_) {
-                auto& last_message = history_.at(history_.size() - 1);
-                std::size_t user_think_pos = last_message.second.find(R1_THINK_START);
-                if (user_think_pos != std::string::npos) {
-                    last_message.second.erase(user_think_pos, std::string(R1_THINK_START).length());
-                }
-                response_result = getR1AssistantString(response_result);
-            }
-            response_result = trimLeadingWhitespace(deleteThinkPart(response_result));
-            history_.emplace_back("assistant", response_result);
-        }
-        if (on_progress) {
-            bool user_stop_requested = on_progress(utf8Char, is_eop);
-            generate_text_end_ = is_eop;
-            stop_requested_ = user_stop_requested;
-        }
-    });
-    
-    LlmStreamBuffer stream_buffer{[&processor](const char* str, size_t len){
-        processor.processStream(str, len);
-    }};
-    std::ostream output_ostream(&stream_buffer);
-
-    history_.emplace_back("user", getUserString(prompt.c_str(), false, is_r1_));
-    MNN_DEBUG("submitNative history count %zu", history_.size());
-    for (auto & it : history_) {
-        prompt_string_for_debug += it.second;
-    }
-    MNN_DEBUG("submitNative prompt_string_for_debug count %s max_new_tokens_:%d", prompt_string_for_debug.c_str(), max_new_tokens_);
-    llm_->response(history_, &output_ostream, END_OF_PROMPT, 1);
-    current_size++;
-    while (!stop_requested_ && !generate_text_end_ && current_size < max_new_tokens_) {
-        llm_->generate(1);
-        current_size++;
-    }
-    if (!stop_requested_ && enable_audio_output_) {
-        llm_->generateWavform();
-    }
-    auto context = llm_->getContext();
-    return context;
-}
-
-std::string LlmSession::getDebugInfo() {
-    return ("last_prompt:\n" + prompt_string_for_debug + "\nlast_response:\n" + response_string_for_debug);
-}
-
-void LlmSession::SetWavformCallback(std::function<bool(const float *, size_t, bool)> callback) {
-    if (llm_ != nullptr && callback != nullptr) {
-        waveform.clear();
-        llm_->setWavformCallback([this, callback = std::move(callback)](const float *ptr, size_t size, bool last_chunk) {
-#if DEBUG_SAVE_WAV
-            waveform.reserve(waveform.size() + size);
-            waveform.insert(waveform.end(), ptr, ptr + size);
-            MNN_DEBUG("waveform size %zu", waveform.size());
-            if (last_chunk) {
-                auto waveform_var = MNN::Express::_Const(waveform.data(), {(int)waveform.size()}, MNN::Express::NCHW, halide_type_of<float>());
-                MNN::AUDIO::save("/data/data/com.mnnrn/files/output.wav", waveform_var, 24000);
-                waveform.clear();
-            }
-#endif
-            if (!enable_audio_output_ || stop_requested_) {
-                return false;
-            }
-            if (callback) {
-                return !callback(ptr, size, last_chunk);
-            }
-            return false;
-        });
-    } else {
-        MNN_ERROR("no llm instance");
-    }
-}
-
-void LlmSession::SetMaxNewTokens(int i) {
-    max_new_tokens_ = i;
-}
-
-void LlmSession::setSystemPrompt(std::string system_prompt) {
-    system_prompt_= std::move(system_prompt);
-    if (history_.size() > 1) {
-        history_.at(0).second = GetSystemPromptString(system_prompt_, is_r1_);
-    } else {
-        history_.emplace_back("system", GetSystemPromptString(system_prompt_, is_r1_));
-    }
-}
-
-void LlmSession::SetAssistantPrompt(const std::string& assistant_prompt) {
-    current_config_["assistant_prompt_template"] = assistant_prompt;
-    if (llm_) {
-        llm_->set_config(current_config_.dump());
-    }
-    MNN_DEBUG("dumped config: %s", llm_->dump_config().c_str());
-}
-
-void LlmSession::updateConfig(const std::string& config_json) {
-    try {
-        json new_config = json::parse(config_json);
-        for (auto& [key, value] : new_config.items()) {
-            current_config_[key] = value;
-        }
-        if (llm_) {
-            llm_->set_config(current_config_.dump());
-            MNN_DEBUG("Updated config applied: %s", current_config_.dump().c_str());
-        } else {
-            MNN_DEBUG("LLM not initialized yet, config saved for later: %s", current_config_.dump().c_str());
-        }
-    } catch (const std::exception& e) {
-        MNN_ERROR("Failed to parse config JSON: %s", e.what());
-    }
-}
-
-void LlmSession::enableAudioOutput(bool enable) {
-    enable_audio_output_ = enable;
-}
-
-const MNN::Transformer::LlmContext * LlmSession::ResponseWithHistory(
-        const std::vector<PromptItem>& full_history,
-        const std::function<bool(const std::string&, bool is_eop)>& on_progress) {
-    if (llm_ == nullptr) {
-        return nullptr;
-    }
-
-    // Create temporary history, don't modify member variables
-    std::vector<PromptItem> temp_history;
-
-    // Directly use the passed complete history, don't save to member variables
-    temp_history.insert(temp_history.end(), full_history.begin(), full_history.end());
-
-    int current_size = 0;
-    stop_requested_ = false;
-    generate_text_end_ = false;
-    std::stringstream response_buffer;
-
-    // Stream processing logic, but don't modify history_ member
-    mls::Utf8StreamProcessor processor([&response_buffer, &on_progress, this](const std::string& utf8Char) {
-        bool is_eop = utf8Char.find(END_OF_PROMPT) != std::string::npos;
-        if (!is_eop) {
-            response_buffer << utf8Char;
-        } else {
-            std::string response_result = response_buffer.str();
-            MNN_DEBUG("ResponseWithHistory Result %s", response_result.c_str());
-            response_string_for_debug = response_result;
-            if (is_r1_) {
-                response_result = getR1AssistantString(response_result);
-            }
-            response_result = trimLeadingWhitespace(deleteThinkPart(response_result));
-            // Note: here we no longer call history_.emplace_back() to save history
-        }
-        if (on_progress) {
-            bool user_stop_requested = on_progress(utf8Char, is_eop);
-            generate_text_end_ = is_eop;
-            stop_requested_ = user_stop_requested;
-        }
-    });
-
-    LlmStreamBuffer stream_buffer{[&processor](const char* str, size_t len){
-        processor.processStream(str, len);
-    }};
-    std::ostream output_ostream(&stream_buffer);
-
-    MNN_DEBUG("submitNative history count %zu", temp_history.size());
-    prompt_string_for_debug.clear(); // Clear old data to avoid duplicate appending
-    for (const auto& it : temp_history) {
-        // Add role tags and content, e.g. "[user]: Hello"
-        prompt_string_for_debug += "[" + it.first + "]: " + it.second + "\n";
-    }
-    MNN_DEBUG("submitNative prompt_string_for_debug:\n%s\nmax_new_tokens_:%d", prompt_string_for_debug.c_str(), max_new_tokens_);
-    // Use temporary history for inference
-    llm_->response(temp_history, &output_ostream, END_OF_PROMPT, 1);
-    current_size++;
-
-    while (!stop_requested_ && !generate_text_end_ && current_size < max_new_tokens_) {
-        llm_->generate(1);
-        current_size++;
-    }
-
-    if (!stop_requested_ && enable_audio_output_) {
-        llm_->generateWavform();
-    }
-
-    return llm_->getContext();
-}
-
-void LlmSession::clearHistory(int numToKeep) {
-    if (numToKeep < 0) {
-        numToKeep = 0;
-    }
-    if (history_.size() > static_cast<size_t>(numToKeep)) {
-        history_.erase(history_.begin() + numToKeep, history_.end());
-    }
-    // Clear related cache
-    prompt_string_for_debug.clear();
-}
-
-std::string LlmSession::getSystemPrompt() const {
-    return system_prompt_;
-}
-
-// Simplified benchmark implementation - can be expanded later
-LlmSession::BenchmarkResult LlmSession::runBenchmark(int backend, int threads, bool useMmap, int power, 
-                                                    int precision, int memory, int dynamicOption, int nPrompt, 
-                                                    int nGenerate, int nRepeat, bool kvCache, 
-                                                    const BenchmarkCallback& callback) {
-    MNN_DEBUG("BENCHMARK: runBenchmark() STARTED! this=%p", this);
-    MNN_DEBUG("BENCHMARK: Parameters - nPrompt=%d, nGenerate=%d, nRepeat=%d, kvCache=%s", 
-              nPrompt, nGenerate, nRepeat, kvCache ? "true" : "false");
-    
-    BenchmarkResult result;
-    result.prompt_tokens = nPrompt;
-    result.generate_tokens = nGenerate;
-    result.repeat_count = nRepeat;
-    result.kv_cache_enabled = kvCache;
-    result.success = true; // Simplified implementation
-    result.error_message = "";
-    
-    // For now, return a simple success result
-    // Full benchmark implementation can be added later
-    if (callback.onProgress) {
-        BenchmarkProgressInfo progressInfo;
-        progressInfo.progress = 100;
-        progressInfo.statusMessage = "Benchmark completed (simplified implementation)";
-        progressInfo.progressType = ProgressType::COMPLETED;
-        callback.onProgress(progressInfo);
-    }
-    
-    return result;
-}
-
-} // namespace mls
\ No newline at end of file
+//
+// Created for MNN React Native bindings - based on the sample code
+//
+
+#include "llm_session.h"
+#include <algorithm>
+#include <utility>
+#include <chrono>
+#include <sstream>
+#include <thread>
+#include "MNN/MNNForwardType.h"
+#include "MNN/expr/ExecutorScope.hpp"
+#include "mls_log.h"
+#include "mls_trace.h"
+#include "mls_config.h"
+#include "utf8_stream_processor.hpp"
+#include "llm_stream_buffer.hpp"
+#include "stream_chunk_batcher.hpp"
+#include "prompt_snapshot.hpp"
+#include "llm_model_registry.hpp"
+#include "weight_prefetcher.hpp"
+
+namespace mls {
+
+std::string trimLeadingWhitespace(const std::string& str) {
+    auto it = std::find_if(str.begin(), str.end(), [](unsigned char ch) {
+        return !std::isspace(ch);
+    });
+    return {it, str.end()};
+}
+
+std::string getUserString(const char* user_content, bool for_history, bool is_r1) {
+    if (is_r1) {
+        return R1_USER_START + std::string(user_content) + R1_ASSISTANT_START + (for_history ? "" : R1_THINK_START);
+    } else {
+        return user_content;
+    }
+}
+
+std::string GetSystemPromptString(std::string system_prompt, bool is_r1) {
+    if (is_r1) {
+        return std::string(R1_SENTENCE_START) + system_prompt;
+    } else {
+        return system_prompt;
+    }
+}
+
+std::string deleteThinkPart(std::string assistant_content) {
+    std::size_t think_start = assistant_content.find(R1_THINK_START);
+    if (think_start == std::string::npos) {
+        return assistant_content;
+    }
+    std::size_t think_end = assistant_content.find(R1_THINK_END, think_start);
+    if (think_end == std::string::npos) {
+        return assistant_content;
+    }
+    think_end += std::string(R1_THINK_END).length();
+    assistant_content.erase(think_start, think_end - think_start);
+    return assistant_content;
+}
+
+std::string getR1AssistantString(std::string assistant_content) {
+    std::size_t pos = assistant_content.find(R1_THINK_END);
+    if (pos != std::string::npos) {
+        assistant_content.erase(0, pos + std::string(R1_THINK_END).length());
+    }
+    return trimLeadingWhitespace(assistant_content) + R1_SENTENCE_END;
+}
+
+const char* BenchmarkBackendName(int backend) {
+    switch (backend) {
+        case MNN_FORWARD_OPENCL:
+            return "opencl";
+        case MNN_FORWARD_VULKAN:
+            return "vulkan";
+        case MNN_FORWARD_METAL:
+            return "metal";
+        default:
+            return "cpu";
+    }
+}
+
+// Power, precision and memory share the MNN BackendConfig numbering: 0 normal, 1 high, 2 low
+const char* BenchmarkLevelName(int level) {
+    switch (level) {
+        case 1:
+            return "high";
+        case 2:
+            return "low";
+        default:
+            return "normal";
+    }
+}
+
+void LlmSession::Reset() {
+    restored_state_.reset();
+    history_.resize(1);
+    history_summary_.clear();
+    history_.at(0).second = SystemEntry();
+    context_.clear();
+    images_.clear();
+}
+
+LlmSession::LlmSession(std::string model_path, json config, json extra_config, std::vector<std::string> history):
+        model_path_(std::move(model_path)), config_(std::move(config)), extra_config_(std::move(extra_config)) {
+    max_new_tokens_ = config_.contains("max_new_tokens") ? config_["max_new_tokens"].get<int>() : DEFAULT_MAX_NEW_TOKENS;
+    keep_history_ = !extra_config_.contains("keep_history") || extra_config_["keep_history"].get<bool>();
+    debug_capture_.setCapacity(extra_config_.contains("debug_capture") ? extra_config_["debug_capture"].get<size_t>() : 0);
+    is_r1_ = extra_config_.contains("is_r1") && extra_config_["is_r1"].get<bool>();
+    system_prompt_ = config_.contains("system_prompt") ? config_["system_prompt"].get<std::string>() : DEFAULT_SYSTEM_PROMPT;
+    kv_prefix_reuse_ = extra_config_.contains("kv_prefix_reuse") && extra_config_["kv_prefix_reuse"].get<bool>();
+    prompt_snapshot_ = extra_config_.contains("prompt_snapshot") && extra_config_["prompt_snapshot"].get<bool>();
+    share_model_ = extra_config_.contains("share_model") && extra_config_["share_model"].get<bool>();
+    prefetch_weights_ = !extra_config_.contains("prefetch_weights") || extra_config_["prefetch_weights"].get<bool>();
+    warmup_ = extra_config_.contains("warmup") && extra_config_["warmup"].get<bool>();
+    thread_policy_enabled_ = extra_config_.contains("thread_policy") && extra_config_["thread_policy"].get<bool>();
+    if (extra_config_.contains("memory_budget_bytes")) {
+        memory_budget_bytes_ = extra_config_["memory_budget_bytes"].get<size_t>();
+    }
+    if (extra_config_.contains("lora_cache_bytes")) {
+        adapters_.setBudget(extra_config_["lora_cache_bytes"].get<size_t>());
+    }
+    if (extra_config_.contains("speculative")) {
+        speculative_ = SpeculativeConfig::Parse(extra_config_["speculative"]);
+    }
+    if (extra_config_.contains("kv_cache")) {
+        kv_cache_ = KvCacheConfig::Parse(extra_config_["kv_cache"]);
+    }
+    if (extra_config_.contains("image_max_side")) {
+        image_max_side_ = std::max(0, extra_config_["image_max_side"].get<int>());
+    }
+    if (extra_config_.contains("prefill_chunk_tokens")) {
+        prefill_chunk_tokens_ = std::max(0, extra_config_["prefill_chunk_tokens"].get<int>());
+    }
+    if (extra_config_.contains("thermal_governor")) {
+        thermal_.setConfig(ThermalGovernorConfig::Parse(extra_config_["thermal_governor"]));
+    }
+    if (extra_config_.contains("stop")) {
+        stop_matcher_.setConfig(StopConfig::Parse(extra_config_["stop"]));
+    }
+    if (extra_config_.contains("context")) {
+        context_.setBudget(ContextBudget::Parse(extra_config_["context"]));
+    }
+    has_backend_policy_ = extra_config_.contains("backend");
+    if (has_backend_policy_) {
+        backend_policy_ = ParseBackendPolicy(extra_config_["backend"].get<std::string>());
+    }
+    // A prefilled system prompt is only picked up by the next turn through prefix reuse
+    kv_prefix_reuse_ = kv_prefix_reuse_ || prompt_snapshot_;
+    if (extra_config_.contains("stream_flush")) {
+        setStreamFlushPolicy(extra_config_["stream_flush"]);
+    }
+    int queue_size = extra_config_.contains("request_queue_size") ? extra_config_["request_queue_size"].get<int>()
+                                                                  : DEFAULT_REQUEST_QUEUE_SIZE;
+    worker_ = std::make_unique<InferenceWorker>(static_cast<size_t>(std::max(queue_size, 1)));
+    history_.emplace_back("system", GetSystemPromptString(system_prompt_, is_r1_));
+    
+    if (!history.empty()) {
+        for (size_t i = 0; i < history.size(); i++) {
+            if (is_r1_) {
+                if (i % 2 == 0) {
+                    history_.emplace_back("user", getUserString(history[i].c_str(), true, is_r1_));
+                } else {
+                    history_.emplace_back("assistant", getR1AssistantString(history[i]));
+                }
+            } else {
+                history_.emplace_back(i % 2 == 0 ? "user" : "assistant",
+                                      i % 2 == 0 ? history[i] :
+                                      deleteThinkPart(history[i]));
+            }
+        }
+    }
+}
+
+void LlmSession::Load(const LoadProgressCallback& on_progress) {
+    MLS_TRACE_SCOPE("mls::Load");
+    auto load_start = std::chrono::steady_clock::now();
+    WeightPrefetcher prefetcher;
+    auto report = [&](const char* stage, int progress) {
+        LoadProgress info{stage, progress,
+                          std::chrono::duration_cast<std::chrono::microseconds>(
+                                  std::chrono::steady_clock::now() - load_start).count(),
+                          prefetcher.prefetchedBytes()};
+        MNN_DEBUG("Load: %s after %lldus, %zu bytes prefetched", stage, (long long)info.elapsed_us,
+                  info.prefetched_bytes);
+        if (on_progress) {
+            on_progress(info);
+        }
+    };
+    auto model_files = WeightPrefetcher::ModelFiles(model_path_);
+    weight_bytes_ = WeightPrefetcher::TotalBytes(model_files);
+    if (prefetch_weights_) {
+        prefetcher.Start(std::move(model_files));
+    }
+    std::string root_cache_dir_str = extra_config_["mmap_dir"];
+    bool use_mmap = !extra_config_["mmap_dir"].get<std::string>().empty();
+    json config = config_;
+    config["use_mmap"] = use_mmap;
+    if (use_mmap) {
+        std::string temp_dir = root_cache_dir_str;
+        config["tmp_path"] = temp_dir;
+    }
+    if (is_r1_) {
+        config["use_template"] = false;
+        config["precision"] = "high";
+    }
+    if (kv_prefix_reuse_) {
+        config["reuse_kv"] = true;
+    }
+    if (has_backend_policy_) {
+        config["backend_type"] = BackendTypeName(ResolveBackendPolicy(backend_policy_));
+    }
+    if (thread_policy_enabled_) {
+        // MNN fixes its pool size at load, so it is sized for prefill; decode narrows affinity
+        thread_policy_ = MakeThreadPolicy(CpuTopology::Get(),
+                                          ParsePowerMode(config.value("power", std::string("normal"))));
+        config["thread_num"] = thread_policy_.prefill.threads;
+        MNN_DEBUG("Load: thread policy prefill=%d decode=%d", thread_policy_.prefill.threads,
+                  thread_policy_.decode.threads);
+    }
+    speculative_.applyTo(config);
+    kv_cache_.applyTo(config);
+    auto on_configured = [&report]() { report("config", 10); };
+    bool loaded = LoadWithConfig(config, on_configured);
+    if (!loaded && config.value("backend_type", std::string("cpu")) != "cpu") {
+        MNN_WARN("Load: %s backend failed, falling back to cpu", config["backend_type"].get<std::string>().c_str());
+        config["backend_type"] = "cpu";
+        loaded = LoadWithConfig(config, on_configured);
+    }
+    // Whatever is not read ahead by now is faulted in by MNN itself
+    prefetcher.Stop();
+    if (!loaded) {
+        report("failed", 100);
+        return;
+    }
+    report("weights", 70);
+    kv_layout_ = KvCacheLayout::ForModel(model_path_, current_config_);
+    TuneBackend();
+    if (kv_cache_.reserve) {
+        ReserveKvCache();
+    }
+    if (prompt_snapshot_) {
+        PrefillSystemPrompt();
+        report("warm", 90);
+    } else if (warmup_) {
+        WarmUp();
+        report("warm", 90);
+    }
+    unloaded_ = false;
+    UpdateMemoryReport();
+    report("ready", 100);
+}
+
+void LlmSession::WarmUp() {
+    MLS_TRACE_SCOPE("mls::WarmUp");
+    auto model_lock = AcquireModel();
+    std::ostream null_stream(nullptr);
+    llm_->response(std::vector<int>{BENCHMARK_PROMPT_TOKEN}, &null_stream, nullptr, 1);
+    ResetKvCache();
+}
+
+void LlmSession::ReserveKvCache() {
+    MLS_TRACE_SCOPE("mls::ReserveKvCache");
+    int tokens = kv_cache_.reserve_tokens;
+    if (tokens == 0) {
+        tokens = context_.enabled() ? context_.budget().max_tokens : KV_DEFAULT_RESERVE_TOKENS;
+    }
+    auto model_lock = AcquireModel();
+    auto start = std::chrono::steady_clock::now();
+    int chunk_tokens = prefill_chunk_tokens_;
+    prefill_chunk_tokens_ = KV_RESERVE_CHUNK_TOKENS;
+    std::ostream null_stream(nullptr);
+    PrefillTokens(std::vector<int>(static_cast<size_t>(tokens), BENCHMARK_PROMPT_TOKEN), &null_stream, nullptr);
+    prefill_chunk_tokens_ = chunk_tokens;
+    ResetKvCache();
+    stats_.reset();
+    MNN_INFO("ReserveKvCache: %d tokens (%zu bytes) in %lldus", tokens,
+             static_cast<size_t>(tokens) * kv_layout_.bytesPerToken(),
+             (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start).count());
+}
+
+void LlmSession::EnterPhase(const ThreadPolicy& policy, Llm::Stage stage) {
+    PinCurrentThread(stage == Llm::Prefill ? policy.prefill.cores : policy.decode.cores);
+}
+
+void LlmSession::TuneBackend() {
+    MLS_TRACE_SCOPE("mls::TuneBackend");
+    auto backend = current_config_.value("backend_type", std::string("cpu"));
+    if (backend == "cpu") {
+        return;
+    }
+    auto model_lock = AcquireModel();
+    std::vector<int> candidates(std::begin(OP_ENCODER_CANDIDATES), std::end(OP_ENCODER_CANDIDATES));
+    BackendTuningCache cache(extra_config_.value("mmap_dir", ""));
+    if (!cache.enabled()) {
+        // Nowhere to persist the result: let MNN tune for this launch only
+        llm_->tuning(MNN::Transformer::OP_ENCODER_NUMBER, candidates);
+        return;
+    }
+    int op_encoder_number = 0;
+    if (cache.Load(model_path_, backend, op_encoder_number)) {
+        MNN_DEBUG("TuneBackend: %s cached op_encoder_number=%d", backend.c_str(), op_encoder_number);
+        llm_->tuning(MNN::Transformer::OP_ENCODER_NUMBER, {op_encoder_number});
+        return;
+    }
+    // Time a short decode per candidate so the winner can be stored
+    std::ostream null_stream(nullptr);
+    std::vector<int> prompt(TUNING_PROMPT_TOKENS, BENCHMARK_PROMPT_TOKEN);
+    int64_t best_us = -1;
+    for (int candidate : candidates) {
+        llm_->tuning(MNN::Transformer::OP_ENCODER_NUMBER, {candidate});
+        llm_->reset();
+        llm_->response(prompt, &null_stream, nullptr, 1);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < TUNING_DECODE_TOKENS; i++) {
+            llm_->generate(1);
+        }
+        auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        MNN_DEBUG("TuneBackend: %s op_encoder_number=%d decode_us=%lld", backend.c_str(), candidate,
+                  (long long)elapsed_us);
+        if (best_us < 0 || elapsed_us < best_us) {
+            best_us = elapsed_us;
+            op_encoder_number = candidate;
+        }
+    }
+    llm_->tuning(MNN::Transformer::OP_ENCODER_NUMBER, {op_encoder_number});
+    llm_->reset();
+    cache.Save(model_path_, backend, op_encoder_number);
+    MNN_INFO("TuneBackend: %s tuned op_encoder_number=%d", backend.c_str(), op_encoder_number);
+}
+
+void LlmSession::PrefillSystemPrompt() {
+    MLS_TRACE_SCOPE("mls::PrefillSystemPrompt");
+    auto model_lock = AcquireModel();
+    std::vector<PromptItem> system_only(history_.begin(), history_.begin() + 1);
+    auto prompt = llm_->apply_chat_template(system_only);
+    PromptSnapshotStore store(extra_config_.value("mmap_dir", ""));
+    auto key = PromptSnapshotStore::MakeKey(model_path_, prompt);
+    std::vector<int> input_ids;
+    bool from_snapshot = store.Load(key, input_ids);
+    if (!from_snapshot) {
+        input_ids = llm_->tokenizer_encode(prompt);
+        store.Save(key, input_ids);
+    }
+    if (input_ids.empty()) {
+        return;
+    }
+    std::ostream null_stream(nullptr);
+    llm_->reset();
+    llm_->response(input_ids, &null_stream, nullptr, 1);
+    MNN_DEBUG("PrefillSystemPrompt: key=%s tokens=%zu snapshot=%d prefill_us=%lld",
+              key.c_str(), input_ids.size(), from_snapshot, (long long)llm_->getContext()->prefill_us);
+}
+
+bool LlmSession::LoadWithConfig(const json& config, const std::function<void()>& on_configured) {
+    ReleaseLlm();
+    current_config_ = config;
+    if (share_model_) {
+        shared_model_ = LlmModelRegistry::Instance().Acquire(model_path_, config, on_configured);
+        llm_ = shared_model_ ? shared_model_->llm : nullptr;
+    } else {
+        llm_ = CreateAndLoadLlm(model_path_, config, on_configured);
+    }
+    base_llm_ = llm_;
+    bool loaded = llm_ != nullptr;
+    if (loaded && wavform_callback_ && !shared_model_) {
+        SetWavformCallback(wavform_callback_);
+    }
+    return loaded;
+}
+
+void LlmSession::ReleaseLlm() {
+    // Adapters reference the base model's weights
+    adapters_.Clear();
+    active_adapter_.clear();
+    kv_erased_.clear();
+    prompt_tokens_.clear();
+    constrained_.clearVocabulary();
+    if (shared_model_) {
+        std::lock_guard<ModelTurnLock> lock(shared_model_->mutex);
+        if (shared_model_->active_owner == this) {
+            // The callback installed on the shared model captures this session
+            base_llm_->setWavformCallback(nullptr);
+            shared_model_->active_owner = nullptr;
+        }
+    } else {
+        delete base_llm_;
+    }
+    shared_model_.reset();
+    base_llm_ = nullptr;
+    llm_ = nullptr;
+}
+
+std::unique_lock<ModelTurnLock> LlmSession::AcquireModel() {
+    if (!shared_model_) {
+        return {};
+    }
+    shared_model_->mutex.lock(worker_->currentPriority());
+    std::unique_lock<ModelTurnLock> lock(shared_model_->mutex, std::adopt_lock);
+    if (shared_model_->active_owner != this) {
+        // Another session used the model last: restore this session's config and callbacks.
+        // With prefix reuse the KV cache is matched against this conversation; otherwise
+        // every response re-prefills anyway.
+        base_llm_->set_config(current_config_.dump());
+        base_llm_->setWavformCallback(nullptr);
+        shared_model_->active_owner = this;
+        if (wavform_callback_) {
+            InstallWavformCallback();
+        }
+    }
+    return lock;
+}
+
+void LlmSession::ApplyConfig() {
+    if (shared_model_) {
+        // Applied the next time this session takes the model
+        std::lock_guard<ModelTurnLock> lock(shared_model_->mutex);
+        if (shared_model_->active_owner == this) {
+            shared_model_->active_owner = nullptr;
+        }
+        if (llm_ == base_llm_) {
+            return;
+        }
+    }
+    // Adapters are this session's own even on a shared base; inactive ones get it on activation
+    if (llm_) {
+        llm_->set_config(current_config_.dump());
+    }
+}
+
+bool LlmSession::ActivateAdapter() {
+    if (requested_adapter_ == active_adapter_) {
+        return true;
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool loaded = false;
+    Llm* target = requested_adapter_.empty() ? base_llm_ : adapters_.Acquire(base_llm_, requested_adapter_, &loaded);
+    if (target == nullptr) {
+        MNN_ERROR("ActivateAdapter: cannot load LoRA adapter %s", requested_adapter_.c_str());
+        return false;
+    }
+    if (loaded) {
+        // A new adapter can land at the address of an evicted one
+        kv_erased_.erase(target);
+    }
+    if (wavform_callback_ && llm_ != nullptr) {
+        llm_->setWavformCallback(nullptr);
+    }
+    llm_ = target;
+    active_adapter_ = requested_adapter_;
+    llm_->set_config(current_config_.dump());
+    if (wavform_callback_) {
+        InstallWavformCallback();
+    }
+    stats_.adapter_switch_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    MNN_DEBUG("ActivateAdapter: %s in %lldus", active_adapter_.empty() ? "base model" : active_adapter_.c_str(),
+              (long long)stats_.adapter_switch_us);
+    return true;
+}
+
+LlmSession::~LlmSession() {
+    MNN_DEBUG("LIFECYCLE: LlmSession DESTROYED at %p", this);
+    // Stop the running job and drain the queue before the model goes away
+    RequestStop();
+    worker_.reset();
+    ReleaseLlm();
+}
+
+const MNN::Transformer::LlmContext * LlmSession::Response(const std::string &prompt,
+                                                          const std::function<bool(const std::string&, bool is_eop)>& on_progress,
+                                                          const CancellationToken* cancel) {
+    if (llm_ == nullptr && !Reload()) {
+        return nullptr;
+    }
+    auto model_lock = AcquireModel();
+
+    if (!keep_history_) {
+        history_.resize(1);
+    }
+    // The prompt prefills the restored conversation itself
+    restored_state_.reset();
+    reused_prefix_tokens_ = 0;
+    stop_requested_ = false;
+    generate_text_end_ = false;
+    stop_matcher_.Reset();
+    std::stringstream response_buffer;
+    stats_.reset();
+    constrained_.Begin();
+    auto request_start = std::chrono::steady_clock::now();
+    if (!ActivateAdapter()) {
+        return nullptr;
+    }
+    EnforceMemoryBudget();
+    auto timed_progress = TimedProgress(on_progress);
+    StreamChunkBatcher batcher(flush_policy_, timed_progress);
+    mls::Utf8StreamProcessor processor([&response_buffer, &batcher, this](std::string_view utf8Chars) {
+        MLS_TRACE_SCOPE("mls::stream_chunk");
+        bool is_eop = false;
+        auto text = stop_matcher_.Feed(utf8Chars, &is_eop);
+        response_buffer << text;
+        if (is_eop) {
+            std::string response_result = response_buffer.str();
+            MNN_DEBUG("submitNative Result %s", response_result.c_str());
+            debug_capture_.recordResponse(response_result);
+            if (is_r1_) {
+                auto& last_message = history_.at(history_.size() - 1);
+                std::size_t user_think_pos = last_message.second.find(R1_THINK_START);
+                if (user_think_pos != std::string::npos) {
+                    last_message.second.erase(user_think_pos, std::string(R1_THINK_START).length());
+                }
+                response_result = getR1AssistantString(response_result);
+            }
+            response_result = trimLeadingWhitespace(deleteThinkPart(response_result));
+            history_.emplace_back("assistant", response_result);
+        }
+        batcher.append(text);
+        if (is_eop) {
+            generate_text_end_ = true;
+            if (batcher.finish(END_OF_PROMPT)) {
+                stop_requested_ = true;
+            }
+        }
+    });
+    
+    LlmStreamBuffer stream_buffer{&processor};
+    std::ostream output_ostream(&stream_buffer);
+
+    history_.emplace_back("user", getUserString(prompt.c_str(), false, is_r1_));
+    FitContext(history_, true);
+    PruneImages(history_);
+    MNN_DEBUG("submitNative history count %zu max_new_tokens_:%d", history_.size(), max_new_tokens_);
+    debug_capture_.recordPrompt(history_);
+    if (thread_policy_enabled_) {
+        EnterPhase(thread_policy_, Llm::Prefill);
+    }
+    bool prefilled;
+    {
+        MLS_TRACE_SCOPE("mls::prefill");
+        prefilled = kv_prefix_reuse_ ? PrefillWithPrefixReuse(history_, &output_ostream, cancel)
+                                     : PrefillHistory(history_, &output_ostream, cancel);
+    }
+    if (thread_policy_enabled_) {
+        EnterPhase(thread_policy_, Llm::Decode);
+    }
+    if (prefilled) {
+        DecodeLoop(batcher, request_start, cancel);
+    } else {
+        stop_requested_ = true;
+    }
+    if (!stop_requested_ && enable_audio_output_) {
+        llm_->generateWavform();
+    }
+    auto context = llm_->getContext();
+    UpdateMemoryReport();
+    return context;
+}
+
+std::vector<int> LlmSession::PromptTokens(const std::vector<PromptItem>& history) {
+    MLS_TRACE_SCOPE("mls::tokenize");
+    auto start = std::chrono::steady_clock::now();
+    auto input_ids = prompt_tokens_.Encode(llm_, history, images_);
+    stats_.tokenize_us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    return input_ids;
+}
+
+bool LlmSession::PrefillHistory(const std::vector<PromptItem>& history, std::ostream* os,
+                                const CancellationToken* cancel) {
+    auto input_ids = PromptTokens(history);
+    if (input_ids.empty()) {
+        llm_->response(history, os, END_OF_PROMPT, PrefillEmitTokens());
+        stats_.prefilled_tokens = llm_->getContext()->prompt_len;
+        return true;
+    }
+    stats_.prefilled_tokens = static_cast<int>(input_ids.size());
+    return PrefillTokens(input_ids, os, cancel);
+}
+
+bool LlmSession::PrefillTokens(const std::vector<int>& ids, std::ostream* os, const CancellationToken* cancel) {
+    size_t chunk = static_cast<size_t>(prefill_chunk_tokens_);
+    if (chunk == 0 || ids.size() <= chunk || prompt_tokens_.multimodal()) {
+        llm_->response(ids, os, END_OF_PROMPT, PrefillEmitTokens());
+        stats_.prefill_chunks = 1;
+        stats_.prefill_us = llm_->getContext()->prefill_us;
+        return true;
+    }
+    // Each chunk is a response() of its own, so later chunks have to extend the KV cache instead
+    // of replacing it. Without prefix reuse the prompt starts from an empty cache, as it would anyway.
+    if (!kv_prefix_reuse_) {
+        ResetKvCache();
+        llm_->set_config(R"({"reuse_kv":true})");
+    }
+    std::ostream null_stream(nullptr);
+    size_t total = ids.size();
+    size_t done = 0;
+    bool finished = true;
+    while (total - done > chunk) {
+        if (stop_requested_ || (cancel && cancel->cancelled())) {
+            finished = false;
+            break;
+        }
+        std::vector<int> part(ids.begin() + static_cast<std::ptrdiff_t>(done),
+                              ids.begin() + static_cast<std::ptrdiff_t>(done + chunk));
+        llm_->response(part, &null_stream, nullptr, 1);
+        stats_.prefill_us += llm_->getContext()->prefill_us;
+        stats_.prefill_chunks++;
+        done += chunk;
+        if (kv_prefix_reuse_) {
+            // The token sampled after the chunk is in history_tokens but never entered the KV cache
+            size_t kv_len = llm_->getCurrentHistory();
+            kv_erased_[llm_].emplace_back(kv_len, kv_len + 1);
+        }
+        if (prefill_progress_) {
+            prefill_progress_(static_cast<int>(done), static_cast<int>(total));
+        }
+    }
+    if (finished) {
+        std::vector<int> rest(ids.begin() + static_cast<std::ptrdiff_t>(done), ids.end());
+        llm_->response(rest, os, END_OF_PROMPT, PrefillEmitTokens());
+        stats_.prefill_us += llm_->getContext()->prefill_us;
+        stats_.prefill_chunks++;
+    } else {
+        MNN_DEBUG("PrefillTokens: stopped after %zu of %zu tokens", done, total);
+    }
+    if (!kv_prefix_reuse_) {
+        llm_->set_config(R"({"reuse_kv":false})");
+    }
+    return finished;
+}
+
+bool LlmSession::PrefillWithPrefixReuse(const std::vector<PromptItem>& history, std::ostream* os,
+                                        const CancellationToken* cancel) {
+    auto input_ids = PromptTokens(history);
+    if (input_ids.empty()) {
+        llm_->response(history, os, END_OF_PROMPT, PrefillEmitTokens());
+        stats_.prefilled_tokens = llm_->getContext()->prompt_len;
+        return true;
+    }
+    auto cached_ids = CachedTokens();
+    size_t cached_len = cached_ids.size();
+    size_t common = 0;
+    while (common < cached_len && common < input_ids.size() && cached_ids[common] == input_ids[common]) {
+        common++;
+    }
+    // At least one token has to be prefilled to produce logits for the first reply token
+    common = std::min(common, input_ids.size() - 1);
+    // Turns evicted by the context budget leave a gap: the cache continues with tokens the
+    // prompt has right after the common prefix. Erasing just the gap keeps the cached tail.
+    size_t gap = 0;
+    size_t tail = 0;
+    if (common > 0 && context_.enabled()) {
+        size_t max_tail = input_ids.size() - 1 - common;
+        for (size_t d = CONTEXT_MIN_EVICTED_SPAN; common + d + CONTEXT_MIN_REUSED_TAIL <= cached_len; d++) {
+            size_t t = cached_len - common - d;
+            if (t <= max_tail && std::equal(cached_ids.begin() + static_cast<std::ptrdiff_t>(common + d),
+                                            cached_ids.end(),
+                                            input_ids.begin() + static_cast<std::ptrdiff_t>(common))) {
+                gap = d;
+                tail = t;
+                break;
+            }
+        }
+    }
+    if (gap > 0) {
+        // Later positions shift down over the erased span, as in a sliding attention window
+        llm_->eraseHistory(common, common + gap);
+        kv_erased_[llm_].emplace_back(common, common + gap);
+    } else {
+        TruncateKvCache(common);
+    }
+    size_t reused = common + tail;
+    reused_prefix_tokens_ = static_cast<int>(reused);
+    if (reused > 0) {
+        prefix_cache_hits_++;
+    } else {
+        prefix_cache_misses_++;
+    }
+    MNN_DEBUG("PrefillWithPrefixReuse: prompt_tokens=%zu reused=%zu evicted_span=%zu prefill=%zu",
+              input_ids.size(), reused, gap, input_ids.size() - reused);
+    std::vector<int> new_ids(input_ids.begin() + static_cast<std::ptrdiff_t>(reused), input_ids.end());
+    stats_.prefilled_tokens = static_cast<int>(new_ids.size());
+    return PrefillTokens(new_ids, os, cancel);
+}
+
+std::vector<int> LlmSession::CachedTokens() {
+    const auto& tokens = llm_->getContext()->history_tokens;
+    size_t kv_len = llm_->getCurrentHistory();
+    std::vector<int> cached(tokens.begin(), tokens.end());
+    auto it = kv_erased_.find(llm_);
+    if (it != kv_erased_.end()) {
+        size_t erased = 0;
+        for (const auto& span : it->second) {
+            erased += span.second - span.first;
+        }
+        // The KV cache is compacted on erase while history_tokens may still hold the erased
+        // tokens; only then do the recorded spans apply
+        if (cached.size() >= kv_len + erased) {
+            for (const auto& span : it->second) {
+                cached.erase(cached.begin() + static_cast<std::ptrdiff_t>(span.first),
+                             cached.begin() + static_cast<std::ptrdiff_t>(span.second));
+            }
+        } else {
+            kv_erased_.erase(it);
+        }
+    }
+    // history_tokens can hold the last sampled token, which was never forwarded into the KV cache
+    cached.resize(std::min(cached.size(), kv_len));
+    return cached;
+}
+
+void LlmSession::ResetKvCache() {
+    llm_->reset();
+    kv_erased_.erase(llm_);
+}
+
+void LlmSession::TruncateKvCache(size_t length) {
+    if (length == 0) {
+        ResetKvCache();
+    } else if (length < llm_->getCurrentHistory()) {
+        llm_->eraseHistory(length, 0);
+        auto& spans = kv_erased_[llm_];
+        spans.erase(std::remove_if(spans.begin(), spans.end(),
+                                   [length](const std::pair<size_t, size_t>& span) { return span.first >= length; }),
+                    spans.end());
+    }
+}
+
+void LlmSession::TrimMemory(int level) {
+    auto action = TrimActionForLevel(level);
+    if (action == TrimAction::NONE) {
+        return;
+    }
+    MNN_INFO("TrimMemory: level %d, shedding %s", level, TrimActionName(action));
+    Trim(action);
+}
+
+void LlmSession::Trim(TrimAction action) {
+    std::unique_lock<ModelTurnLock> model_lock;
+    if (llm_ != nullptr && action == TrimAction::KV_CACHE) {
+        model_lock = AcquireModel();
+    }
+    TrimLocked(action);
+}
+
+void LlmSession::TrimLocked(TrimAction action) {
+    MLS_TRACE_SCOPE("mls::Trim");
+    last_trim_ = action;
+    prompt_tokens_.clear();
+    if (action >= TrimAction::KV_CACHE) {
+        // Prefilling them now would refill the cache the trim empties
+        restored_state_.reset();
+    }
+    debug_capture_.clear();
+    if (action >= TrimAction::ADAPTERS) {
+        // The active adapter is the most recently used one and is kept
+        adapters_.Shrink();
+        MNN::Express::Executor::getGlobalExecutor()->gc(MNN::Express::Executor::FULL);
+    }
+    if (llm_ != nullptr && action == TrimAction::KV_CACHE) {
+        ResetKvCache();
+    }
+    if (llm_ != nullptr && action == TrimAction::UNLOAD) {
+        ReleaseLlm();
+        unloaded_ = true;
+    }
+    UpdateMemoryReport();
+}
+
+void LlmSession::EnforceMemoryBudget() {
+    if (memory_budget_bytes_ == 0) {
+        return;
+    }
+    UpdateMemoryReport();
+    auto over_budget = [this]() {
+        std::lock_guard<std::mutex> lock(memory_mutex_);
+        return memory_report_.sheddableBytes() > memory_budget_bytes_;
+    };
+    if (over_budget()) {
+        TrimLocked(TrimAction::ADAPTERS);
+    }
+    if (over_budget()) {
+        MNN_DEBUG("EnforceMemoryBudget: KV cache over %zu bytes, dropping it", memory_budget_bytes_);
+        TrimLocked(TrimAction::KV_CACHE);
+    }
+}
+
+bool LlmSession::Reload() {
+    if (!unloaded_) {
+        return false;
+    }
+    MLS_TRACE_SCOPE("mls::Reload");
+    auto start = std::chrono::steady_clock::now();
+    // current_config_ is the config the model was loaded with plus every update since
+    json config = current_config_;
+    if (!LoadWithConfig(config)) {
+        MNN_ERROR("Reload: cannot load %s again", model_path_.c_str());
+        return false;
+    }
+    unloaded_ = false;
+    TuneBackend();
+    if (kv_cache_.reserve) {
+        ReserveKvCache();
+    }
+    if (prompt_snapshot_) {
+        PrefillSystemPrompt();
+    }
+    MNN_INFO("Reload: model released by a memory trim loaded again in %lldus",
+             (long long)std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+void LlmSession::UpdateMemoryReport() {
+    MemoryReport report;
+    report.loaded = llm_ != nullptr;
+    report.shared = shared_model_ != nullptr;
+    report.weight_bytes = report.loaded ? weight_bytes_ : 0;
+    report.kv_tokens = report.loaded ? static_cast<int>(llm_->getCurrentHistory()) : 0;
+    report.kv_cache_bytes = static_cast<size_t>(report.kv_tokens) * kv_layout_.bytesPerToken();
+    report.adapter_bytes = adapters_.bytes();
+    report.token_cache_bytes = prompt_tokens_.bytes();
+    report.budget_bytes = memory_budget_bytes_;
+    report.last_trim = last_trim_;
+    std::lock_guard<std::mutex> lock(memory_mutex_);
+    memory_report_ = report;
+}
+
+MemoryReport LlmSession::getSessionMemory() const {
+    std::lock_guard<std::mutex> lock(memory_mutex_);
+    return memory_report_;
+}
+
+MemoryReport LlmSession::getMemoryReport() const {
+    auto report = getSessionMemory();
+    report.process = ProcessMemory::Read();
+    return report;
+}
+
+std::string LlmSession::SystemEntry() const {
+    auto entry = GetSystemPromptString(system_prompt_, is_r1_);
+    if (!history_summary_.empty()) {
+        entry += "\n\nSummary of the earlier conversation: " + history_summary_;
+    }
+    return entry;
+}
+
+void LlmSession::FitContext(std::vector<PromptItem>& history, bool persistent) {
+    if (!context_.enabled()) {
+        return;
+    }
+    int prompt_tokens = 0;
+    auto evicted = context_.Fit(llm_, history, &prompt_tokens);
+    stats_.evicted_messages = static_cast<int>(evicted.size());
+    // R1 histories are pre-formatted for a raw template, which a summary request can't reuse
+    if (!evicted.empty() && persistent && !is_r1_ && context_.budget().policy == ContextPolicy::SUMMARIZE) {
+        SummarizeEvicted(evicted);
+        history.at(0).second = SystemEntry();
+        // The summary grows the system prompt, which can push out another turn
+        stats_.evicted_messages += static_cast<int>(context_.Fit(llm_, history, &prompt_tokens).size());
+    }
+    stats_.context_tokens = prompt_tokens;
+}
+
+void LlmSession::SummarizeEvicted(const std::vector<PromptItem>& evicted) {
+    MLS_TRACE_SCOPE("mls::summarize_context");
+    std::string transcript;
+    if (!history_summary_.empty()) {
+        transcript += "Summary so far: " + history_summary_ + "\n\n";
+    }
+    for (const auto& [role, content] : evicted) {
+        transcript += role + ": " + deleteThinkPart(content) + "\n";
+    }
+    std::vector<PromptItem> request{
+            {"system", CONTEXT_SUMMARY_INSTRUCTION},
+            {"user", transcript}};
+    // The summary runs on the session's own KV cache, which is re-prefilled afterwards
+    std::stringstream summary;
+    ResetKvCache();
+    llm_->response(request, &summary, nullptr, context_.budget().summary_tokens);
+    ResetKvCache();
+    auto text = trimLeadingWhitespace(deleteThinkPart(summary.str()));
+    text.erase(text.find_last_not_of(" \t\r\n") + 1);
+    if (!text.empty()) {
+        history_summary_ = std::move(text);
+    }
+    MNN_DEBUG("SummarizeEvicted: %zu messages into %zu chars", evicted.size(), history_summary_.size());
+}
+
+StreamChunkBatcher::OnFlush LlmSession::TimedProgress(const StreamChunkBatcher::OnFlush& on_progress) {
+    // Left empty so the batcher skips flushing for callers without a callback
+    if (!on_progress) {
+        return {};
+    }
+    return [this, &on_progress](const std::string& chunk, bool is_eop) {
+        auto start = std::chrono::steady_clock::now();
+        bool stop = on_progress(chunk, is_eop);
+        stats_.callback_us += std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        return stop;
+    };
+}
+
+void LlmSession::DecodeLoop(StreamChunkBatcher& batcher, std::chrono::steady_clock::time_point request_start,
+                            const CancellationToken* cancel) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    using std::chrono::steady_clock;
+    // The prefill call already produced the first token
+    int current_size = 1;
+    const auto* context = llm_->getContext();
+    if (PrefillEmitTokens() == 0) {
+        // The prefill left the first token pending so it is checked before it goes out
+        constrained_.Step(llm_);
+        if (!EndOnStopToken()) {
+            llm_->generate(1);
+        }
+    }
+    if (batcher.onToken()) {
+        stop_requested_ = true;
+    }
+    auto last_token = steady_clock::now();
+    stats_.ttft_us = duration_cast<microseconds>(last_token - request_start).count();
+    if (thermal_.enabled()) {
+        thermal_.Begin(last_token);
+    }
+    while (!stop_requested_ && !generate_text_end_ && current_size < max_new_tokens_) {
+        if (cancel && cancel->cancelled()) {
+            stop_requested_ = true;
+            break;
+        }
+        constrained_.Step(llm_);
+        if (EndOnStopToken()) {
+            break;
+        }
+        int64_t callback_before = stats_.callback_us;
+        auto generate_start = steady_clock::now();
+        int gen_before = context->gen_seq_len;
+        {
+            MLS_TRACE_SCOPE("mls::generate");
+            llm_->generate(1);
+        }
+        auto generate_us = duration_cast<microseconds>(steady_clock::now() - generate_start).count();
+        // Output streamed while generating can flush through on_progress
+        stats_.generate_us += generate_us - (stats_.callback_us - callback_before);
+        // A speculative step emits every accepted draft token plus the verified one
+        int produced = std::max(1, context->gen_seq_len - gen_before);
+        current_size += produced;
+        stats_.decode_steps++;
+        stats_.decoded_tokens += produced;
+        if (batcher.onToken(produced)) {
+            stop_requested_ = true;
+        }
+        auto now = steady_clock::now();
+        auto per_token_us = duration_cast<microseconds>(now - last_token).count() / produced;
+        for (int i = 0; i < produced; i++) {
+            stats_.inter_token.record(per_token_us);
+        }
+        last_token = now;
+        if (thermal_.enabled()) {
+            bool changed = false;
+            auto wait = thermal_.OnStep(produced, generate_us, now, &changed);
+            if (changed && thermal_callback_) {
+                thermal_callback_(thermal_.state());
+            }
+            PaceDecode(wait, cancel);
+        }
+    }
+    if (!stop_requested_ && !generate_text_end_) {
+        // Out of tokens with the start of a stop sequence still held back
+        batcher.append(stop_matcher_.Drain());
+        batcher.flush();
+    }
+    stats_.grammar_resampled = constrained_.resampled();
+    stats_.grammar_mask_us = constrained_.maskUs();
+}
+
+bool LlmSession::EndOnStopToken() {
+    const auto* context = llm_->getContext();
+    if (!stop_matcher_.hasStopTokens() || !stop_matcher_.isStopToken(context->current_token)) {
+        return false;
+    }
+    // Ended the way Llm::is_stop ends generate: the marker releases the held text and ends the reply
+    if (context->os != nullptr) {
+        *context->os << END_OF_PROMPT << std::flush;
+    }
+    generate_text_end_ = true;
+    return true;
+}
+
+void LlmSession::PaceDecode(std::chrono::microseconds wait, const CancellationToken* cancel) {
+    if (wait.count() <= 0 || generate_text_end_) {
+        return;
+    }
+    MLS_TRACE_SCOPE("mls::thermal_wait");
+    auto start = std::chrono::steady_clock::now();
+    auto until = start + wait;
+    for (auto now = start; now < until && !stop_requested_ && !(cancel && cancel->cancelled());
+         now = std::chrono::steady_clock::now()) {
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+                until - now, std::chrono::milliseconds(THERMAL_WAIT_SLICE_MS)));
+    }
+    stats_.thermal_wait_us += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+}
+
+std::string LlmSession::getDebugInfo() {
+    if (!debug_capture_.enabled()) {
+        return "debug capture disabled, set debugCapture in the session config";
+    }
+    return debug_capture_.dump();
+}
+
+void LlmSession::SetWavformCallback(std::function<bool(const float *, size_t, bool)> callback) {
+    if (llm_ != nullptr && callback != nullptr) {
+        wavform_callback_ = std::move(callback);
+        if (shared_model_) {
+            std::lock_guard<ModelTurnLock> lock(shared_model_->mutex);
+            if (shared_model_->active_owner == this) {
+                InstallWavformCallback();
+            }
+        } else {
+            InstallWavformCallback();
+        }
+    } else {
+        MNN_ERROR("no llm instance");
+    }
+}
+
+void LlmSession::InstallWavformCallback() {
+    waveform.clear();
+    llm_->setWavformCallback([this, callback = wavform_callback_](const float *ptr, size_t size, bool last_chunk) {
+#if DEBUG_SAVE_WAV
+        waveform.reserve(waveform.size() + size);
+        waveform.insert(waveform.end(), ptr, ptr + size);
+        MNN_DEBUG("waveform size %zu", waveform.size());
+        if (last_chunk) {
+            auto waveform_var = MNN::Express::_Const(waveform.data(), {(int)waveform.size()}, MNN::Express::NCHW, halide_type_of<float>());
+            MNN::AUDIO::save("/data/data/com.mnnrn/files/output.wav", waveform_var, 24000);
+            waveform.clear();
+        }
+#endif
+        if (!enable_audio_output_ || stop_requested_) {
+            return false;
+        }
+        if (callback) {
+            return !callback(ptr, size, last_chunk);
+        }
+        return false;
+    });
+}
+
+void LlmSession::SetMaxNewTokens(int i) {
+    max_new_tokens_ = i;
+}
+
+void LlmSession::setSystemPrompt(std::string system_prompt) {
+    restored_state_.reset();
+    system_prompt_= std::move(system_prompt);
+    if (history_.size() > 1) {
+        history_.at(0).second = SystemEntry();
+    } else {
+        history_.emplace_back("system", SystemEntry());
+    }
+}
+
+void LlmSession::SetAssistantPrompt(const std::string& assistant_prompt) {
+    current_config_["assistant_prompt_template"] = assistant_prompt;
+    ApplyConfig();
+    MNN_DEBUG("assistant prompt config: %s", current_config_.dump().c_str());
+}
+
+void LlmSession::updateConfig(const std::string& config_json) {
+    try {
+        json new_config = json::parse(config_json);
+        for (auto& [key, value] : new_config.items()) {
+            if (key == "stream_flush") {
+                setStreamFlushPolicy(value);
+                continue;
+            }
+            if (key == "stop") {
+                stop_matcher_.setConfig(StopConfig::Parse(value));
+                continue;
+            }
+            current_config_[key] = value;
+        }
+        if (llm_) {
+            ApplyConfig();
+            MNN_DEBUG("Updated config applied: %s", current_config_.dump().c_str());
+        } else {
+            MNN_DEBUG("LLM not initialized yet, config saved for later: %s", current_config_.dump().c_str());
+        }
+    } catch (const std::exception& e) {
+        MNN_ERROR("Failed to parse config JSON: %s", e.what());
+    }
+}
+
+void LlmSession::setStreamFlushPolicy(const json& policy) {
+    flush_policy_.max_bytes = policy.value("max_bytes", flush_policy_.max_bytes);
+    flush_policy_.max_tokens = policy.value("max_tokens", flush_policy_.max_tokens);
+    flush_policy_.max_ms = policy.value("max_ms", flush_policy_.max_ms);
+    MNN_DEBUG("stream flush policy: max_bytes=%zu max_tokens=%d max_ms=%d",
+              flush_policy_.max_bytes, flush_policy_.max_tokens, flush_policy_.max_ms);
+}
+
+void LlmSession::RequestStop() {
+    stop_requested_ = true;
+}
+
+void LlmSession::enableAudioOutput(bool enable) {
+    enable_audio_output_ = enable;
+}
+
+const MNN::Transformer::LlmContext * LlmSession::ResponseWithHistory(
+        const std::vector<PromptItem>& full_history,
+        const std::function<bool(const std::string&, bool is_eop)>& on_progress,
+        const CancellationToken* cancel) {
+    if (llm_ == nullptr && !Reload()) {
+        return nullptr;
+    }
+    auto model_lock = AcquireModel();
+
+    // The KV cache is about to hold this history rather than the restored one
+    restored_state_.reset();
+    // Create temporary history, don't modify member variables
+    std::vector<PromptItem> temp_history;
+
+    // Directly use the passed complete history, don't save to member variables
+    temp_history.insert(temp_history.end(), full_history.begin(), full_history.end());
+
+    stop_requested_ = false;
+    generate_text_end_ = false;
+    stop_matcher_.Reset();
+    std::stringstream response_buffer;
+    stats_.reset();
+    constrained_.Begin();
+    auto request_start = std::chrono::steady_clock::now();
+    if (!ActivateAdapter()) {
+        return nullptr;
+    }
+    EnforceMemoryBudget();
+    auto timed_progress = TimedProgress(on_progress);
+    StreamChunkBatcher batcher(flush_policy_, timed_progress);
+
+    // Stream processing logic, but don't modify history_ member
+    mls::Utf8StreamProcessor processor([&response_buffer, &batcher, this](std::string_view utf8Chars) {
+        MLS_TRACE_SCOPE("mls::stream_chunk");
+        bool is_eop = false;
+        auto text = stop_matcher_.Feed(utf8Chars, &is_eop);
+        response_buffer << text;
+        if (is_eop) {
+            std::string response_result = response_buffer.str();
+            MNN_DEBUG("ResponseWithHistory Result %s", response_result.c_str());
+            debug_capture_.recordResponse(response_result);
+            if (is_r1_) {
+                response_result = getR1AssistantString(response_result);
+            }
+            response_result = trimLeadingWhitespace(deleteThinkPart(response_result));
+            // Note: here we no longer call history_.emplace_back() to save history
+        }
+        batcher.append(text);
+        if (is_eop) {
+            generate_text_end_ = true;
+            if (batcher.finish(END_OF_PROMPT)) {
+                stop_requested_ = true;
+            }
+        }
+    });
+
+    LlmStreamBuffer stream_buffer{&processor};
+    std::ostream output_ostream(&stream_buffer);
+
+    FitContext(temp_history, false);
+    MNN_DEBUG("submitNative history count %zu max_new_tokens_:%d", temp_history.size(), max_new_tokens_);
+    debug_capture_.recordPrompt(temp_history);
+    // Use temporary history for inference; a client resending a growing message list
+    // hits the KV state left by its previous request
+    reused_prefix_tokens_ = 0;
+    if (thread_policy_enabled_) {
+        EnterPhase(thread_policy_, Llm::Prefill);
+    }
+    bool prefilled;
+    {
+        MLS_TRACE_SCOPE("mls::prefill");
+        prefilled = kv_prefix_reuse_ ? PrefillWithPrefixReuse(temp_history, &output_ostream, cancel)
+                                     : PrefillHistory(temp_history, &output_ostream, cancel);
+    }
+    if (thread_policy_enabled_) {
+        EnterPhase(thread_policy_, Llm::Decode);
+    }
+    if (prefilled) {
+        DecodeLoop(batcher, request_start, cancel);
+    } else {
+        stop_requested_ = true;
+    }
+
+    if (!stop_requested_ && enable_audio_output_) {
+        llm_->generateWavform();
+    }
+
+    UpdateMemoryReport();
+    return llm_->getContext();
+}
+
+void LlmSession::setGrammar(std::shared_ptr<const Grammar> grammar) {
+    if (grammar && speculative_.enabled) {
+        MNN_WARN("setGrammar: not supported with speculative decoding, generating unconstrained");
+        return;
+    }
+    constrained_.setGrammar(std::move(grammar));
+}
+
+void LlmSession::clearHistory() {
+    restored_state_.reset();
+    if (history_.size() > 1) {
+        history_.erase(history_.begin() + 1, history_.end());
+    }
+    history_summary_.clear();
+    if (!history_.empty()) {
+        history_.at(0).second = SystemEntry();
+    }
+    context_.clear();
+    images_.clear();
+    // Clear related cache
+    debug_capture_.clear();
+}
+
+bool LlmSession::SaveState(const std::string& name, std::string* error) {
+    MLS_TRACE_SCOPE("mls::SaveState");
+    SessionStateData data;
+    data.model_key = SessionStateStore::ModelKey(model_path_);
+    data.system_prompt = system_prompt_;
+    data.summary = history_summary_;
+    data.messages.assign(history_.begin() + 1, history_.end());
+    data.images = images_;
+    data.image_counter = image_counter_;
+    if (restored_state_) {
+        // Nothing ran since the restore, so the mapped ids still describe the conversation
+        data.tokens.assign(restored_state_->tokens(), restored_state_->tokens() + restored_state_->tokenCount());
+    } else if (llm_ != nullptr) {
+        auto model_lock = AcquireModel();
+        data.tokens = prompt_tokens_.Encode(llm_, history_, images_);
+        // Image tokens only mean something together with the embeddings of their image
+        if (prompt_tokens_.multimodal()) {
+            data.tokens.clear();
+        }
+    }
+    SessionStateStore store(extra_config_.value("mmap_dir", ""));
+    return store.Save(name, data, error);
+}
+
+bool LlmSession::RestoreState(const std::string& name, bool prefill, std::string* error) {
+    MLS_TRACE_SCOPE("mls::RestoreState");
+    SessionStateStore store(extra_config_.value("mmap_dir", ""));
+    auto state = store.Load(name, error);
+    if (!state) {
+        return false;
+    }
+    auto& data = state->data();
+    system_prompt_ = std::move(data.system_prompt);
+    history_summary_ = std::move(data.summary);
+    history_.resize(1);
+    history_.at(0).second = SystemEntry();
+    history_.insert(history_.end(), std::make_move_iterator(data.messages.begin()),
+                    std::make_move_iterator(data.messages.end()));
+    images_ = std::move(data.images);
+    image_counter_ = std::max(image_counter_, data.image_counter);
+    context_.clear();
+    // Token ids from another model's tokenizer would prefill the wrong conversation
+    bool same_model = data.model_key == SessionStateStore::ModelKey(model_path_);
+    restored_state_.reset();
+    if (kv_prefix_reuse_ && same_model && state->tokenCount() > 0) {
+        restored_state_ = std::move(state);
+    }
+    MNN_INFO("RestoreState: %s, %zu messages, %zu tokens to prefill%s", name.c_str(), history_.size() - 1,
+             restored_state_ ? restored_state_->tokenCount() : 0, same_model ? "" : " (saved for another model)");
+    if (prefill && restored_state_) {
+        InferenceWorker::Job job;
+        job.priority = InferenceWorker::kBackgroundPriority;
+        job.run = [this](const CancellationToken& token) { PrefillRestoredState(&token); };
+        worker_->submit(std::move(job));
+    }
+    return true;
+}
+
+void LlmSession::PrefillRestoredState(const CancellationToken* cancel) {
+    if (!restored_state_ || (llm_ == nullptr && !Reload())) {
+        return;
+    }
+    MLS_TRACE_SCOPE("mls::PrefillRestoredState");
+    auto model_lock = AcquireModel();
+    auto state = std::move(restored_state_);
+    std::vector<int> ids(state->tokens(), state->tokens() + state->tokenCount());
+    auto cached_ids = CachedTokens();
+    size_t common = 0;
+    while (common < cached_ids.size() && common < ids.size() && cached_ids[common] == ids[common]) {
+        common++;
+    }
+    if (common == ids.size()) {
+        return;
+    }
+    TruncateKvCache(common);
+    std::vector<int> rest(ids.begin() + static_cast<std::ptrdiff_t>(common), ids.end());
+    stop_requested_ = false;
+    stats_.reset();
+    if (thread_policy_enabled_) {
+        EnterPhase(thread_policy_, Llm::Prefill);
+    }
+    std::ostream null_stream(nullptr);
+    bool finished = PrefillTokens(rest, &null_stream, cancel);
+    MNN_DEBUG("PrefillRestoredState: reused=%zu prefilled=%zu of %zu in %lldus%s", common, rest.size(), ids.size(),
+              (long long)stats_.prefill_us, finished ? "" : ", stopped");
+    UpdateMemoryReport();
+}
+
+std::string LlmSession::AttachImage(MNN::Transformer::PromptImagePart image) {
+    auto name = "image_" + std::to_string(image_counter_++);
+    images_[name] = std::move(image);
+    return "<img>" + name + "</img>";
+}
+
+void LlmSession::PruneImages(const std::vector<PromptItem>& history) {
+    for (auto it = images_.begin(); it != images_.end();) {
+        auto tag = "<img>" + it->first + "</img>";
+        bool referenced = std::any_of(history.begin(), history.end(), [&tag](const PromptItem& item) {
+            return item.second.find(tag) != std::string::npos;
+        });
+        it = referenced ? std::next(it) : images_.erase(it);
+    }
+}
+
+std::string LlmSession::getSystemPrompt() const {
+    return system_prompt_;
+}
+
+LlmSession::BenchmarkResult LlmSession::runBenchmark(int backend, int threads, bool useMmap, int power,
+                                                    int precision, int memory, int dynamicOption, int nPrompt,
+                                                    int nGenerate, int nRepeat, bool kvCache,
+                                                    const BenchmarkCallback& callback) {
+    MNN_DEBUG("BENCHMARK: runBenchmark() STARTED! this=%p", this);
+    MNN_DEBUG("BENCHMARK: Parameters - backend=%d, threads=%d, nPrompt=%d, nGenerate=%d, nRepeat=%d, kvCache=%s",
+              backend, threads, nPrompt, nGenerate, nRepeat, kvCache ? "true" : "false");
+
+    BenchmarkResult result;
+    result.prompt_tokens = nPrompt;
+    result.generate_tokens = nGenerate;
+    result.repeat_count = nRepeat;
+    result.kv_cache_enabled = kvCache;
+    result.success = false;
+
+    auto fail = [&result, &callback](const std::string& message) {
+        MNN_ERROR("BENCHMARK: %s", message.c_str());
+        result.success = false;
+        result.error_message = message;
+        if (callback.onError) {
+            callback.onError(message);
+        }
+        return result;
+    };
+    auto report = [&callback](BenchmarkProgressInfo& info) {
+        if (callback.onProgress) {
+            callback.onProgress(info);
+        }
+    };
+    auto should_stop = [&callback]() {
+        return callback.shouldStop && callback.shouldStop();
+    };
+
+    if (llm_ == nullptr && !Reload()) {
+        return fail("LLM session is not initialized");
+    }
+    auto model_lock = AcquireModel();
+    if (nPrompt <= 0 || nGenerate < 0 || nRepeat <= 0) {
+        return fail("Invalid benchmark parameters");
+    }
+
+    BenchmarkProgressInfo info;
+    info.totalIterations = nRepeat;
+    info.nPrompt = nPrompt;
+    info.nGenerate = nGenerate;
+    info.progressType = ProgressType::INITIALIZING;
+    info.statusMessage = "Initializing benchmark";
+    report(info);
+
+    // Runtime options (backend, threads, mmap, power, precision, memory) only take effect
+    // when the runtime is created, so the model is reloaded if any of them differ.
+    json original_config = current_config_;
+    // threads <= 0 sizes and pins each phase from the CPU topology for the requested power mode
+    bool topology_threads = threads <= 0;
+    auto bench_policy = MakeThreadPolicy(CpuTopology::Get(), static_cast<PowerMode>(power));
+    json bench_config = current_config_;
+    bench_config["backend_type"] = BenchmarkBackendName(backend);
+    bench_config["thread_num"] = topology_threads ? bench_policy.prefill.threads : threads;
+    bench_config["use_mmap"] = useMmap;
+    bench_config["power"] = BenchmarkLevelName(power);
+    bench_config["precision"] = BenchmarkLevelName(precision);
+    bench_config["memory"] = BenchmarkLevelName(memory);
+    bench_config["dynamic_option"] = dynamicOption;
+    bench_config["reuse_kv"] = kvCache;
+    bench_config["async"] = false;
+    bool needs_reload = false;
+    for (const char* key : {"backend_type", "thread_num", "use_mmap", "power", "precision", "memory", "dynamic_option"}) {
+        if (!original_config.contains(key) || original_config[key] != bench_config[key]) {
+            needs_reload = true;
+            break;
+        }
+    }
+    if (needs_reload && shared_model_) {
+        return fail("Runtime options cannot be changed on a model shared with other sessions");
+    }
+    if (needs_reload) {
+        MNN_DEBUG("BENCHMARK: Reloading model with config %s", bench_config.dump().c_str());
+        if (!LoadWithConfig(bench_config)) {
+            LoadWithConfig(original_config);
+            return fail("Failed to load model with benchmark configuration");
+        }
+    } else {
+        current_config_ = bench_config;
+        llm_->set_config(bench_config.dump());
+    }
+
+    std::vector<int> prompt_tokens(nPrompt, BENCHMARK_PROMPT_TOKEN);
+    std::ostream null_stream(nullptr);
+    auto run_round = [&]() {
+        // Every round times the same context; kvCache only sets reuse_kv for decode within it
+        ResetKvCache();
+        if (topology_threads) {
+            EnterPhase(bench_policy, Llm::Prefill);
+        }
+        // The prefill samples the first token, so nGenerate 0 and 1 both time no decode step
+        llm_->response(prompt_tokens, &null_stream, nullptr, 1);
+        if (topology_threads && nGenerate > 1) {
+            EnterPhase(bench_policy, Llm::Decode);
+        }
+        for (int i = 1; i < nGenerate && !should_stop(); i++) {
+            llm_->generate(1);
+        }
+        return llm_->getContext();
+    };
+
+    info.progressType = ProgressType::WARMING_UP;
+    info.statusMessage = "Warming up";
+    info.progress = 5;
+    report(info);
+    run_round();
+
+    auto bench_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < nRepeat; i++) {
+        if (should_stop()) {
+            info.progressType = ProgressType::STOPPING;
+            info.statusMessage = "Benchmark stopped";
+            report(info);
+            break;
+        }
+        auto* context = run_round();
+        result.prefill_times_us.push_back(context->prefill_us);
+        // A prefill-only round (nGenerate 0) reports no decode time
+        int64_t decode_us = nGenerate > 0 ? context->decode_us : 0;
+        result.decode_times_us.push_back(decode_us);
+        result.sample_times_us.push_back(context->sample_us);
+
+        info.progressType = ProgressType::RUNNING_TEST;
+        info.currentIteration = i + 1;
+        info.progress = 10 + 80 * (i + 1) / nRepeat;
+        info.runTimeSeconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - bench_start).count();
+        info.prefillTimeSeconds = static_cast<float>(context->prefill_us) / 1e6f;
+        info.decodeTimeSeconds = static_cast<float>(decode_us) / 1e6f;
+        info.prefillSpeed = info.prefillTimeSeconds > 0 ? static_cast<float>(nPrompt) / info.prefillTimeSeconds : 0.0f;
+        int decode_tokens = nGenerate > 0 && context->gen_seq_len > 1 ? context->gen_seq_len - 1 : 0;
+        info.decodeSpeed = info.decodeTimeSeconds > 0 ? static_cast<float>(decode_tokens) / info.decodeTimeSeconds : 0.0f;
+        info.statusMessage = "Iteration " + std::to_string(i + 1) + "/" + std::to_string(nRepeat);
+        report(info);
+        if (callback.onIterationComplete) {
+            callback.onIterationComplete("prefill_us=" + std::to_string(context->prefill_us) +
+                                         " decode_us=" + std::to_string(decode_us) +
+                                         " sample_us=" + std::to_string(context->sample_us) +
+                                         " decode_tokens=" + std::to_string(decode_tokens));
+        }
+    }
+
+    info.progressType = ProgressType::PROCESSING_RESULTS;
+    info.statusMessage = "Processing results";
+    info.progress = 95;
+    report(info);
+
+    ResetKvCache();
+    if (needs_reload) {
+        LoadWithConfig(original_config);
+    } else {
+        current_config_ = original_config;
+        llm_->set_config(original_config.dump());
+    }
+
+    result.success = !result.prefill_times_us.empty();
+    if (!result.success) {
+        result.error_message = "Benchmark stopped before any iteration completed";
+    }
+    result.repeat_count = static_cast<int>(result.prefill_times_us.size());
+
+    info.progressType = ProgressType::COMPLETED;
+    info.statusMessage = "Benchmark completed";
+    info.progress = 100;
+    report(info);
+    MNN_DEBUG("BENCHMARK: runBenchmark() FINISHED, %d iterations", result.repeat_count);
+    return result;
+}
+
+} // namespace mls
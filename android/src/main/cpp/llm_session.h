@@ -1,135 +1,401 @@
-//
-// Created for MNN React Native bindings
-//
-#pragma once
-#include <vector>
-#include <string>
-#include <chrono>
-#include "nlohmann/json.hpp"
-#include "llm/llm.hpp"
-
-// Forward declarations for JNI types
-#ifdef __cplusplus
-extern "C" {
-#endif
-typedef struct _JNIEnv JNIEnv;
-typedef struct _jobject* jobject;
-#ifdef __cplusplus
-}
-#endif
-
-using nlohmann::json;
-using MNN::Transformer::Llm;
-
-namespace mls {
-using PromptItem = std::pair<std::string, std::string>;
-
-class LlmSession {
-public:
-    LlmSession(std::string, json config, json extra_config, std::vector<std::string> string_history);
-    void Reset();
-    void Load();
-    ~LlmSession();
-    std::string getDebugInfo();
-    void SetWavformCallback(std::function<bool(const float*, size_t, bool)> callback);
-    const MNN::Transformer::LlmContext *
-    Response(const std::string &prompt, const std::function<bool(const std::string &, bool is_eop)> &on_progress);
-    void SetMaxNewTokens(int i);
-
-    void setSystemPrompt(std::string system_prompt);
-
-    void SetAssistantPrompt(const std::string& assistant_prompt);
-
-    void updateConfig(const std::string& config_json);
-
-    void enableAudioOutput(bool b);
-
-    // New: API service history message inference method
-    const MNN::Transformer::LlmContext *
-    ResponseWithHistory(const std::vector<PromptItem>& full_history,
-                        const std::function<bool(const std::string &, bool is_eop)> &on_progress);
-
-    std::string getSystemPrompt() const;
-
-    void clearHistory(int numToKeep = 1);
-
-    // Add getter method for underlying Llm object for benchmarking purposes
-    Llm* getLlm() const { return llm_; }
-    
-    // Platform-independent benchmark result structure
-    struct BenchmarkResult {
-        bool success;
-        std::string error_message;
-        std::vector<int64_t> prefill_times_us;
-        std::vector<int64_t> decode_times_us;
-        std::vector<int64_t> sample_times_us;
-        int prompt_tokens;
-        int generate_tokens;
-        int repeat_count;
-        bool kv_cache_enabled;
-    };
-    
-    // Progress type enumeration for structured reporting
-    enum class ProgressType {
-        UNKNOWN = 0,
-        INITIALIZING = 1,
-        WARMING_UP = 2,
-        RUNNING_TEST = 3,
-        PROCESSING_RESULTS = 4,
-        COMPLETED = 5,
-        STOPPING = 6
-    };
-    
-    // Structured progress information
-    struct BenchmarkProgressInfo {
-        int progress;              // 0-100
-        std::string statusMessage; // Keep for backward compatibility
-        ProgressType progressType;
-        int currentIteration;
-        int totalIterations;
-        int nPrompt;
-        int nGenerate;
-        float runTimeSeconds;
-        float prefillTimeSeconds;
-        float decodeTimeSeconds;
-        float prefillSpeed;
-        float decodeSpeed;
-        
-        BenchmarkProgressInfo() : progress(0), statusMessage(""), progressType(ProgressType::UNKNOWN),
-                                currentIteration(0), totalIterations(0), nPrompt(0), nGenerate(0),
-                                runTimeSeconds(0.0f), prefillTimeSeconds(0.0f), decodeTimeSeconds(0.0f),
-                                prefillSpeed(0.0f), decodeSpeed(0.0f) {}
-    };
-    
-    // Platform-independent benchmark callback interface
-    struct BenchmarkCallback {
-        std::function<void(const BenchmarkProgressInfo& progressInfo)> onProgress;
-        std::function<void(const std::string& error)> onError;
-        std::function<void(const std::string& detailed_stats)> onIterationComplete;
-    };
-    
-    // Pure C++ benchmark method (platform-independent)
-    BenchmarkResult runBenchmark(int backend, int threads, bool useMmap, int power, 
-                                int precision, int memory, int dynamicOption, int nPrompt, 
-                                int nGenerate, int nRepeat, bool kvCache, 
-                                const BenchmarkCallback& callback);
-
-private:
-    std::string response_string_for_debug{};
-    std::string model_path_;
-    std::vector<PromptItem> history_{};
-    json extra_config_{};
-    json config_{};
-    bool is_r1_{false};
-    bool stop_requested_{false};
-    bool generate_text_end_{false};
-    bool keep_history_{true};
-    std::vector<float> waveform{};
-    Llm* llm_{nullptr};
-    std::string prompt_string_for_debug{};
-    int max_new_tokens_{2048};
-    std::string system_prompt_;
-    json current_config_{};
-    bool enable_audio_output_{false};
-};
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+#include <vector>
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "nlohmann/json.hpp"
+#include "llm/llm.hpp"
+#include "stream_chunk_batcher.hpp"
+#include "inference_worker.hpp"
+#include "backend_policy.hpp"
+#include "cpu_topology.hpp"
+#include "generation_stats.hpp"
+#include "debug_capture.hpp"
+#include "speculative_config.hpp"
+#include "kv_cache_config.hpp"
+#include "lora_adapter_cache.hpp"
+#include "context_manager.hpp"
+#include "prompt_token_cache.hpp"
+#include "memory_governor.hpp"
+#include "constrained_decoder.hpp"
+#include "image_input.hpp"
+#include "thermal_governor.hpp"
+#include "session_state.hpp"
+#include "stop_matcher.hpp"
+#include "mls_config.h"
+
+// Forward declarations for JNI types
+#ifdef __cplusplus
+extern "C" {
+#endif
+typedef struct _JNIEnv JNIEnv;
+typedef struct _jobject* jobject;
+#ifdef __cplusplus
+}
+#endif
+
+using nlohmann::json;
+using MNN::Transformer::Llm;
+
+namespace mls {
+struct SharedLlm;
+class ModelTurnLock;
+using PromptItem = std::pair<std::string, std::string>;
+
+class LlmSession {
+public:
+    LlmSession(std::string, json config, json extra_config, std::vector<std::string> string_history);
+    void Reset();
+
+    // A step of Load: "config", "weights", "warm", then "ready" or "failed"
+    struct LoadProgress {
+        const char* stage;
+        int progress;
+        int64_t elapsed_us;
+        // Weight bytes advised for read-ahead so far (extra_config "prefetch_weights")
+        size_t prefetched_bytes;
+    };
+    using LoadProgressCallback = std::function<void(const LoadProgress&)>;
+    /**
+     * Load the model on the calling thread. With prefetch_weights the weight files are read
+     * ahead on a second thread while MNN parses the config and tokenizer; with warmup one
+     * token is run through the model so the first prompt does not pay for first-touch faults.
+     */
+    void Load(const LoadProgressCallback& on_progress = nullptr);
+    ~LlmSession();
+    std::string getDebugInfo();
+    void SetWavformCallback(std::function<bool(const float*, size_t, bool)> callback);
+    const MNN::Transformer::LlmContext *
+    Response(const std::string &prompt, const std::function<bool(const std::string &, bool is_eop)> &on_progress,
+             const CancellationToken* cancel = nullptr);
+    void SetMaxNewTokens(int i);
+
+    void setSystemPrompt(std::string system_prompt);
+
+    void SetAssistantPrompt(const std::string& assistant_prompt);
+
+    void updateConfig(const std::string& config_json);
+
+    void enableAudioOutput(bool b);
+
+    /**
+     * Set how streamed output is coalesced before on_progress is called.
+     * Accepts {"max_bytes": n, "max_tokens": n, "max_ms": n}; missing keys keep their value.
+     */
+    void setStreamFlushPolicy(const json& policy);
+
+    /**
+     * Model for the next Response / ResponseWithHistory: a LoRA adapter file, loaded onto the
+     * base model on first use, or empty for the base model itself. Call on the worker thread.
+     */
+    void SelectAdapter(std::string adapter_path) { requested_adapter_ = std::move(adapter_path); }
+    const std::string& getActiveAdapter() const { return active_adapter_; }
+
+    // Ask the running Response/ResponseWithHistory to stop at the next token, from any thread
+    void RequestStop();
+
+    /**
+     * Called on the worker thread after each prefill chunk with the prompt tokens prefilled so far
+     * and the total. Only prompts split by extra_config "prefill_chunk_tokens" report progress.
+     */
+    using PrefillProgressCallback = std::function<void(int done, int total)>;
+    void setPrefillProgressCallback(PrefillProgressCallback callback) { prefill_progress_ = std::move(callback); }
+
+    /**
+     * Called on the worker thread when the thermal governor (extra_config "thermal_governor")
+     * starts, changes or stops pacing decode.
+     */
+    using ThermalStateCallback = std::function<void(const ThermalState&)>;
+    void setThermalStateCallback(ThermalStateCallback callback) { thermal_callback_ = std::move(callback); }
+    const ThermalState& getThermalState() const { return thermal_.state(); }
+
+    // New: API service history message inference method
+    const MNN::Transformer::LlmContext *
+    ResponseWithHistory(const std::vector<PromptItem>& full_history,
+                        const std::function<bool(const std::string &, bool is_eop)> &on_progress,
+                        const CancellationToken* cancel = nullptr);
+
+    std::string getSystemPrompt() const;
+
+    // Tokens of the last prompt that were served from the KV cache instead of being prefilled
+    int getReusedPrefixTokens() const { return reused_prefix_tokens_; }
+    // Prompts that could / could not reuse any cached prefix since the session was created
+    int64_t getPrefixCacheHits() const { return prefix_cache_hits_; }
+    int64_t getPrefixCacheMisses() const { return prefix_cache_misses_; }
+
+    // Latency breakdown of the last response
+    const GenerationStats& getGenerationStats() const { return stats_; }
+    const SpeculativeConfig& getSpeculativeConfig() const { return speculative_; }
+
+    /**
+     * Constrain the replies of later requests to grammar, or lift the constraint with nullptr.
+     * Call on the worker thread. Not available with speculative decoding, whose draft tokens are
+     * emitted without going through the sampler.
+     */
+    void setGrammar(std::shared_ptr<const Grammar> grammar);
+    bool constrained() const { return constrained_.active(); }
+
+    // Drop every turn and any summary of them, keeping the system prompt
+    void clearHistory();
+
+    /**
+     * Save the conversation under mmap_dir as name: system prompt, turns, summary, attached images
+     * and the templated conversation's token ids. Call on the worker thread.
+     */
+    bool SaveState(const std::string& name, std::string* error);
+    /**
+     * Replace the conversation with the one saved as name. MNN does not expose the KV cache, so it
+     * is rebuilt from the saved token ids: with kv_prefix_reuse they stay mapped, and with prefill
+     * a background job prefills them once the worker is idle. Otherwise the next prompt prefills
+     * the conversation. Call on the worker thread.
+     */
+    bool RestoreState(const std::string& name, bool prefill, std::string* error);
+    /**
+     * Prefill the restored token ids the KV cache does not hold yet. A no-op once a request or a
+     * history change superseded them.
+     */
+    void PrefillRestoredState(const CancellationToken* cancel);
+
+    /**
+     * Shed memory for an onTrimMemory level, as TrimActionForLevel maps it. Call on the worker
+     * thread. A model released by the trim is loaded again by the next request.
+     */
+    void TrimMemory(int level);
+    // Snapshot taken after the last request, load or trim, with current process figures
+    MemoryReport getMemoryReport() const;
+    // The same snapshot without the process figures, cheap enough for every request's metrics
+    MemoryReport getSessionMemory() const;
+
+    /**
+     * The session's inference thread. Generation and every call that touches history or
+     * the model are queued here so they never run concurrently.
+     */
+    InferenceWorker& worker() { return *worker_; }
+
+    /**
+     * Keep image for the session's coming turns and return the <img> tag that refers to it, to
+     * put in the prompt. The image is dropped once no turn in the history refers to it any more.
+     * Call on the worker thread.
+     */
+    std::string AttachImage(MNN::Transformer::PromptImagePart image);
+    // Longest side in-memory images are scaled down to before they are attached
+    int getImageMaxSide() const { return image_max_side_; }
+
+    // Add getter method for underlying Llm object for benchmarking purposes
+    Llm* getLlm() const { return llm_; }
+    
+    // Platform-independent benchmark result structure
+    struct BenchmarkResult {
+        bool success;
+        std::string error_message;
+        std::vector<int64_t> prefill_times_us;
+        std::vector<int64_t> decode_times_us;
+        std::vector<int64_t> sample_times_us;
+        int prompt_tokens;
+        int generate_tokens;
+        int repeat_count;
+        bool kv_cache_enabled;
+    };
+    
+    // Progress type enumeration for structured reporting
+    enum class ProgressType {
+        UNKNOWN = 0,
+        INITIALIZING = 1,
+        WARMING_UP = 2,
+        RUNNING_TEST = 3,
+        PROCESSING_RESULTS = 4,
+        COMPLETED = 5,
+        STOPPING = 6
+    };
+    
+    // Structured progress information
+    struct BenchmarkProgressInfo {
+        int progress;              // 0-100
+        std::string statusMessage; // Keep for backward compatibility
+        ProgressType progressType;
+        int currentIteration;
+        int totalIterations;
+        int nPrompt;
+        int nGenerate;
+        float runTimeSeconds;
+        float prefillTimeSeconds;
+        float decodeTimeSeconds;
+        float prefillSpeed;
+        float decodeSpeed;
+        
+        BenchmarkProgressInfo() : progress(0), statusMessage(""), progressType(ProgressType::UNKNOWN),
+                                currentIteration(0), totalIterations(0), nPrompt(0), nGenerate(0),
+                                runTimeSeconds(0.0f), prefillTimeSeconds(0.0f), decodeTimeSeconds(0.0f),
+                                prefillSpeed(0.0f), decodeSpeed(0.0f) {}
+    };
+    
+    // Platform-independent benchmark callback interface
+    struct BenchmarkCallback {
+        std::function<void(const BenchmarkProgressInfo& progressInfo)> onProgress;
+        std::function<void(const std::string& error)> onError;
+        std::function<void(const std::string& detailed_stats)> onIterationComplete;
+        std::function<bool()> shouldStop;
+    };
+    
+    // Pure C++ benchmark method (platform-independent)
+    BenchmarkResult runBenchmark(int backend, int threads, bool useMmap, int power, 
+                                int precision, int memory, int dynamicOption, int nPrompt, 
+                                int nGenerate, int nRepeat, bool kvCache, 
+                                const BenchmarkCallback& callback);
+
+private:
+    bool LoadWithConfig(const json& config, const std::function<void()>& on_configured = nullptr);
+    // Run one token through the loaded model and drop it from the KV cache
+    void WarmUp();
+    // Grow the KV cache to its reserved size once, then empty it; MNN keeps the buffers
+    void ReserveKvCache();
+    void ReleaseLlm();
+    /**
+     * Lock the model for this session's exclusive use. For a shared model this also applies
+     * this session's config and callbacks if another session used it last; otherwise a no-op.
+     * Waiting sessions get the shared model in order of their running request's priority.
+     */
+    std::unique_lock<ModelTurnLock> AcquireModel();
+    // Push current_config_ to the model, or defer it to the next AcquireModel on a shared one
+    void ApplyConfig();
+    void InstallWavformCallback();
+    // Switch llm_ to the selected adapter (or the base model); false if it failed to load
+    bool ActivateAdapter();
+    /**
+     * Template and tokenize the whole conversation, keep the longest prefix already in the
+     * KV cache, drop the divergent suffix and prefill only the remaining tokens.
+     */
+    bool PrefillWithPrefixReuse(const std::vector<PromptItem>& history, std::ostream* os,
+                                const CancellationToken* cancel);
+    // Prefill the whole templated history, tokenized through prompt_tokens_
+    bool PrefillHistory(const std::vector<PromptItem>& history, std::ostream* os, const CancellationToken* cancel);
+    /**
+     * Forward ids and sample the first reply token into os. Long prompts go in chunks of
+     * prefill_chunk_tokens_, with stop and cancel checked in between.
+     * @return false if the prefill was stopped before the last chunk
+     */
+    bool PrefillTokens(const std::vector<int>& ids, std::ostream* os, const CancellationToken* cancel);
+    std::vector<int> PromptTokens(const std::vector<PromptItem>& history);
+    // Tokens the final prefill call emits: none for a constrained reply or with stop token ids,
+    // whose first token DecodeLoop checks first
+    int PrefillEmitTokens() const { return constrained_.active() || stop_matcher_.hasStopTokens() ? 0 : 1; }
+    /**
+     * Tokens held in llm_'s KV cache, in order. Turns evicted from the middle of the cache are
+     * erased in place, so they are removed here as well.
+     */
+    std::vector<int> CachedTokens();
+    void ResetKvCache();
+    // Keep the first length tokens of the KV cache and drop the rest
+    void TruncateKvCache(size_t length);
+    // Takes the model turn for TrimAction::KV_CACHE; TrimLocked is for callers already holding it
+    void Trim(TrimAction action);
+    void TrimLocked(TrimAction action);
+    // Trim the KV cache and adapters while they hold more than extra_config "memory_budget_bytes";
+    // the caller holds the model turn
+    void EnforceMemoryBudget();
+    // Load the model released by TrimAction::UNLOAD again with the config it had; false if it stays unloaded
+    bool Reload();
+    void UpdateMemoryReport();
+    /**
+     * Apply the context budget to history. Only the session's own history (persistent) is
+     * summarized; a caller-supplied history is windowed.
+     */
+    void FitContext(std::vector<PromptItem>& history, bool persistent);
+    // Drop attached images that no message of history refers to
+    void PruneImages(const std::vector<PromptItem>& history);
+    // Fold evicted turns into history_summary_ with a short generation on llm_
+    void SummarizeEvicted(const std::vector<PromptItem>& evicted);
+    std::string SystemEntry() const;
+    // Prefill the system prompt into the KV cache during Load so the first turn reuses it
+    void PrefillSystemPrompt();
+    // Apply the persisted GPU tuning for the loaded backend, measuring it on first launch
+    void TuneBackend();
+    // Wrap on_progress so time spent in it is accounted as callback time
+    StreamChunkBatcher::OnFlush TimedProgress(const StreamChunkBatcher::OnFlush& on_progress);
+    /**
+     * Stream the first token produced by prefill, then generate until eop, stop, cancel or
+     * max_new_tokens, recording TTFT and inter-token latency.
+     */
+    void DecodeLoop(StreamChunkBatcher& batcher, std::chrono::steady_clock::time_point request_start,
+                    const CancellationToken* cancel);
+    // Sleep for the thermal governor's wait ahead of the next decode step, waking early on stop or cancel
+    void PaceDecode(std::chrono::microseconds wait, const CancellationToken* cancel);
+    // End the reply before the pending token goes out if it is one of the "stop" token ids
+    bool EndOnStopToken();
+    // Pin the calling thread to the cores policy assigns to stage
+    static void EnterPhase(const ThreadPolicy& policy, Llm::Stage stage);
+
+    std::string model_path_;
+    std::vector<PromptItem> history_{};
+    json extra_config_{};
+    json config_{};
+    bool is_r1_{false};
+    std::atomic<bool> stop_requested_{false};
+    bool generate_text_end_{false};
+    bool keep_history_{true};
+    std::vector<float> waveform{};
+    std::function<bool(const float*, size_t, bool)> wavform_callback_{};
+    // Model that serves requests: the base model, or the active LoRA adapter created on it
+    Llm* llm_{nullptr};
+    Llm* base_llm_{nullptr};
+    LoraAdapterCache adapters_;
+    std::string requested_adapter_;
+    std::string active_adapter_;
+    DebugCapture debug_capture_;
+    int max_new_tokens_{2048};
+    std::string system_prompt_;
+    json current_config_{};
+    bool enable_audio_output_{false};
+    StreamFlushPolicy flush_policy_{};
+    bool kv_prefix_reuse_{false};
+    bool prompt_snapshot_{false};
+    bool share_model_{false};
+    bool prefetch_weights_{true};
+    bool warmup_{false};
+    // Set when extra_config has "backend"; otherwise config backend_type is used as is
+    bool has_backend_policy_{false};
+    BackendPolicy backend_policy_{BackendPolicy::AUTO};
+    // Set by extra_config "thread_policy": thread count and affinity from the CPU topology
+    bool thread_policy_enabled_{false};
+    ThreadPolicy thread_policy_{};
+    SpeculativeConfig speculative_{};
+    KvCacheConfig kv_cache_{};
+    ConstrainedDecoder constrained_;
+    ContextManager context_;
+    PromptTokenCache prompt_tokens_;
+    ImageMap images_;
+    int64_t image_counter_{0};
+    int image_max_side_{IMAGE_DEFAULT_MAX_SIDE};
+    // 0 prefills each prompt in one forward pass
+    int prefill_chunk_tokens_{0};
+    PrefillProgressCallback prefill_progress_{};
+    ThermalGovernor thermal_;
+    StopMatcher stop_matcher_;
+    ThermalStateCallback thermal_callback_{};
+    std::string history_summary_;
+    // Token ids of a restored conversation, mapped until they are prefilled or superseded
+    std::unique_ptr<MappedSessionState> restored_state_;
+    // KV ranges erased from the middle of each model's cache, in the order they were erased
+    std::unordered_map<const Llm*, std::vector<std::pair<size_t, size_t>>> kv_erased_;
+    GenerationStats stats_{};
+    KvCacheLayout kv_layout_{};
+    size_t weight_bytes_{0};
+    // 0 leaves the KV cache and adapters to grow until the system asks for memory
+    size_t memory_budget_bytes_{0};
+    bool unloaded_{false};
+    TrimAction last_trim_{TrimAction::NONE};
+    mutable std::mutex memory_mutex_;
+    MemoryReport memory_report_{};
+    std::shared_ptr<SharedLlm> shared_model_{};
+    int reused_prefix_tokens_{0};
+    int64_t prefix_cache_hits_{0};
+    int64_t prefix_cache_misses_{0};
+    std::unique_ptr<InferenceWorker> worker_{};
+};
 }
\ No newline at end of file
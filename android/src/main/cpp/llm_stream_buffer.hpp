@@ -3,6 +3,7 @@
 //
 #include <ostream>
 #include <sstream>
+#include "utf8_stream_processor.hpp"
 
 class LlmStreamBuffer : public std::streambuf {
 public:
@@ -11,12 +12,17 @@ public:
                              callback) :
             callback_(std::move(callback)) {}
 
+    // Feed writes straight into a UTF-8 processor without going through a std::function
+    explicit LlmStreamBuffer(mls::Utf8StreamProcessor *processor) : processor_(processor) {}
+
 protected:
 
     std::streamsize xsputn(const char *s, std::streamsize n)
 
     override {
-        if (callback_) {
+        if (processor_) {
+            processor_->processStream(s, n);
+        } else if (callback_) {
             callback_(s, n
             );
         }
@@ -24,6 +30,16 @@ protected:
                 n;
     }
 
+    int_type overflow(int_type ch) override {
+        if (traits_type::eq_int_type(ch, traits_type::eof())) {
+            return traits_type::not_eof(ch);
+        }
+        char c = traits_type::to_char_type(ch);
+        xsputn(&c, 1);
+        return ch;
+    }
+
 private:
     CallBack callback_ = nullptr;
-};
\ No newline at end of file
+    mls::Utf8StreamProcessor *processor_ = nullptr;
+};
@@ -0,0 +1,89 @@
+//
+// Created for MNN React Native bindings
+//
+#include "lora_adapter_cache.hpp"
+#include <sys/stat.h>
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+size_t FileSize(const std::string& path) {
+    struct stat st{};
+    return stat(path.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+}
+
+// Exported adapters may keep their weights next to the graph, as base models do
+size_t AdapterBytes(const std::string& path) {
+    return FileSize(path) + FileSize(path + ".weight");
+}
+
+} // namespace
+
+MNN::Transformer::Llm* LoraAdapterCache::Acquire(MNN::Transformer::Llm* base, const std::string& path, bool* loaded) {
+    if (loaded) {
+        *loaded = false;
+    }
+    auto it = entries_.find(path);
+    if (it != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->llm;
+    }
+    if (base == nullptr) {
+        return nullptr;
+    }
+    size_t bytes = AdapterBytes(path);
+    if (bytes == 0) {
+        MNN_ERROR("LoraAdapterCache: adapter %s not found", path.c_str());
+        return nullptr;
+    }
+    auto* adapter = base->create_lora(path);
+    if (adapter == nullptr) {
+        MNN_ERROR("LoraAdapterCache: create_lora failed for %s", path.c_str());
+        return nullptr;
+    }
+    lru_.push_front({path, adapter, bytes});
+    entries_[path] = lru_.begin();
+    bytes_ += bytes;
+    if (loaded) {
+        *loaded = true;
+    }
+    MNN_DEBUG("LoraAdapterCache: loaded %s (%zu bytes, %zu cached)", path.c_str(), bytes, lru_.size());
+    EvictToBudget();
+    return adapter;
+}
+
+void LoraAdapterCache::EvictToBudget() {
+    while (bytes_ > budget_bytes_ && lru_.size() > 1) {
+        auto& victim = lru_.back();
+        MNN_DEBUG("LoraAdapterCache: evicting %s", victim.path.c_str());
+        bytes_ -= victim.bytes;
+        delete victim.llm;
+        entries_.erase(victim.path);
+        lru_.pop_back();
+    }
+}
+
+void LoraAdapterCache::setBudget(size_t budget_bytes) {
+    budget_bytes_ = budget_bytes;
+    EvictToBudget();
+}
+
+void LoraAdapterCache::Shrink() {
+    size_t budget_bytes = budget_bytes_;
+    budget_bytes_ = 0;
+    EvictToBudget();
+    budget_bytes_ = budget_bytes;
+}
+
+void LoraAdapterCache::Clear() {
+    for (auto& entry : lru_) {
+        delete entry.llm;
+    }
+    lru_.clear();
+    entries_.clear();
+    bytes_ = 0;
+}
+
+} // namespace mls
@@ -0,0 +1,62 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include "llm/llm.hpp"
+
+namespace mls {
+
+/**
+ * LoRA adapters created on one base model with Llm::create_lora, loaded from disk on first
+ * use and kept in LRU order under a byte budget. An adapter shares the base weights and
+ * holds its own LoRA weights and KV cache, so switching to a cached one costs nothing.
+ * Clear() must run before the base model is released.
+ */
+class LoraAdapterCache {
+public:
+    static constexpr size_t kDefaultBudgetBytes = 256u << 20;
+
+    explicit LoraAdapterCache(size_t budget_bytes = kDefaultBudgetBytes) : budget_bytes_(budget_bytes) {}
+    ~LoraAdapterCache() { Clear(); }
+    LoraAdapterCache(const LoraAdapterCache&) = delete;
+    LoraAdapterCache& operator=(const LoraAdapterCache&) = delete;
+
+    /**
+     * The adapter at path, created on base when not cached. Least recently used adapters are
+     * evicted until the cache fits the budget again; the returned one is always kept.
+     * loaded is set when the adapter was created by this call rather than found in the cache.
+     * @return nullptr if the adapter could not be loaded
+     */
+    MNN::Transformer::Llm* Acquire(MNN::Transformer::Llm* base, const std::string& path, bool* loaded = nullptr);
+
+    void Clear();
+    void setBudget(size_t budget_bytes);
+    // Evict every adapter but the most recently used one, keeping the budget
+    void Shrink();
+
+    // On-disk size of the cached adapters' weights
+    size_t bytes() const { return bytes_; }
+    size_t count() const { return lru_.size(); }
+
+private:
+    struct Entry {
+        std::string path;
+        MNN::Transformer::Llm* llm;
+        size_t bytes;
+    };
+
+    void EvictToBudget();
+
+    size_t budget_bytes_;
+    size_t bytes_ = 0;
+    // Most recently used first
+    std::list<Entry> lru_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+};
+
+} // namespace mls
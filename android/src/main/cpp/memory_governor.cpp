@@ -0,0 +1,121 @@
+//
+// Created for MNN React Native bindings
+//
+#include "memory_governor.hpp"
+#include <fstream>
+#include <unistd.h>
+#include "weight_prefetcher.hpp"
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <malloc/malloc.h>
+#elif defined(__ANDROID__)
+#include <malloc.h>
+#endif
+
+namespace mls {
+
+TrimAction TrimActionForLevel(int level) {
+    if (level >= TRIM_MEMORY_MODERATE) {
+        return TrimAction::UNLOAD;
+    }
+    if (level >= TRIM_MEMORY_BACKGROUND) {
+        return TrimAction::KV_CACHE;
+    }
+    if (level >= TRIM_MEMORY_UI_HIDDEN) {
+        return TrimAction::CACHES;
+    }
+    if (level >= TRIM_MEMORY_RUNNING_CRITICAL) {
+        return TrimAction::KV_CACHE;
+    }
+    if (level >= TRIM_MEMORY_RUNNING_LOW) {
+        return TrimAction::ADAPTERS;
+    }
+    return level >= TRIM_MEMORY_RUNNING_MODERATE ? TrimAction::CACHES : TrimAction::NONE;
+}
+
+const char* TrimActionName(TrimAction action) {
+    switch (action) {
+        case TrimAction::CACHES:
+            return "caches";
+        case TrimAction::ADAPTERS:
+            return "adapters";
+        case TrimAction::KV_CACHE:
+            return "kv_cache";
+        case TrimAction::UNLOAD:
+            return "unload";
+        default:
+            return "none";
+    }
+}
+
+ProcessMemory ProcessMemory::Read() {
+    ProcessMemory memory;
+#if defined(__APPLE__)
+    // The footprint is what jetsam compares against the app's limit
+    task_vm_info_data_t info{};
+    mach_msg_type_number_t count = TASK_VM_INFO_COUNT;
+    if (task_info(mach_task_self(), TASK_VM_INFO, reinterpret_cast<task_info_t>(&info), &count) == KERN_SUCCESS) {
+        memory.resident_bytes = static_cast<size_t>(info.phys_footprint);
+    }
+    malloc_statistics_t stats{};
+    malloc_zone_statistics(nullptr, &stats);
+    memory.native_heap_bytes = stats.size_in_use;
+#else
+    std::ifstream statm("/proc/self/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (statm >> total_pages >> resident_pages) {
+        memory.resident_bytes = resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+#if defined(__ANDROID__)
+    memory.native_heap_bytes = mallinfo().uordblks;
+#endif
+#endif
+    return memory;
+}
+
+KvCacheLayout KvCacheLayout::FromConfig(const nlohmann::json& config) {
+    KvCacheLayout layout;
+    if (!config.is_object()) {
+        return layout;
+    }
+    // Exported as [2, batch, seq, kv_heads, head_dim] per layer: K and V, with seq left at 0
+    auto shape = config.find("key_value_shape");
+    int layers = config.value("layer_nums", 0);
+    if (shape == config.end() || !shape->is_array() || shape->size() < 2 || layers <= 0) {
+        return layout;
+    }
+    size_t elements = 1;
+    for (size_t i = 1; i < shape->size(); i++) {
+        const auto& dim = (*shape)[i];
+        if (dim.is_number_integer() && dim.get<int64_t>() > 0) {
+            elements *= static_cast<size_t>(dim.get<int64_t>());
+        }
+    }
+    layout.elements_per_token = elements * static_cast<size_t>(layers);
+    size_t float_bytes = config.value("precision", std::string("low")) == "low" ? 2 : 4;
+    int quant = config.value("quant_qkv", 0);
+    layout.key_bytes = quant == 1 || quant >= 3 ? 1 : float_bytes;
+    layout.value_bytes = quant >= 2 ? 1 : float_bytes;
+    return layout;
+}
+
+KvCacheLayout KvCacheLayout::ForModel(const std::string& config_path, const nlohmann::json& runtime_config) {
+    std::string dir;
+    auto config = WeightPrefetcher::ReadConfig(config_path, &dir);
+    std::ifstream in(dir + "/" + config.value("llm_config", std::string("llm_config.json")));
+    if (in) {
+        auto llm_config = nlohmann::json::parse(in, nullptr, false);
+        if (llm_config.is_object()) {
+            config.update(llm_config);
+        }
+    }
+    for (const char* key : {"precision", "quant_qkv"}) {
+        if (runtime_config.is_object() && runtime_config.contains(key)) {
+            config[key] = runtime_config[key];
+        }
+    }
+    return FromConfig(config);
+}
+
+} // namespace mls
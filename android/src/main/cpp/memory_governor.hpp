@@ -0,0 +1,89 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "nlohmann/json.hpp"
+
+namespace mls {
+
+// ComponentCallbacks2.onTrimMemory levels; the iOS memory warning is mapped onto them
+constexpr int TRIM_MEMORY_RUNNING_MODERATE = 5;
+constexpr int TRIM_MEMORY_RUNNING_LOW = 10;
+constexpr int TRIM_MEMORY_RUNNING_CRITICAL = 15;
+constexpr int TRIM_MEMORY_UI_HIDDEN = 20;
+constexpr int TRIM_MEMORY_BACKGROUND = 40;
+constexpr int TRIM_MEMORY_MODERATE = 60;
+constexpr int TRIM_MEMORY_COMPLETE = 80;
+
+/**
+ * What a session sheds under memory pressure. Each action includes the ones before it:
+ * CACHES drops the prompt token and debug caches, ADAPTERS also evicts every LoRA adapter but
+ * the active one, KV_CACHE also empties the KV cache (the next turn is prefilled from scratch)
+ * and UNLOAD also releases the model, which is loaded again by the next request.
+ */
+enum class TrimAction {
+    NONE = 0,
+    CACHES = 1,
+    ADAPTERS = 2,
+    KV_CACHE = 3,
+    UNLOAD = 4,
+};
+
+/**
+ * While in the foreground (RUNNING_*) the session keeps its model and sheds more as the
+ * system runs lower; once the app is in the background it keeps less the more likely it is
+ * to be killed. UI_HIDDEN is not pressure by itself.
+ */
+TrimAction TrimActionForLevel(int level);
+const char* TrimActionName(TrimAction action);
+
+struct ProcessMemory {
+    // Resident set of the whole process, including mapped weight pages
+    size_t resident_bytes = 0;
+    // Bytes allocated from the native heap, 0 where the platform does not report it
+    size_t native_heap_bytes = 0;
+
+    static ProcessMemory Read();
+};
+
+/**
+ * Per-token size of a model's KV cache from its llm_config, for every layer. MNN keeps the
+ * cache in fp16 when the model runs at low precision and fp32 otherwise, except where
+ * quant_qkv stores keys as int8 or values as fp8.
+ */
+struct KvCacheLayout {
+    // Of K or V alone
+    size_t elements_per_token = 0;
+    size_t key_bytes = 4;
+    size_t value_bytes = 4;
+
+    size_t bytesPerToken() const { return elements_per_token * (key_bytes + value_bytes); }
+    static KvCacheLayout FromConfig(const nlohmann::json& config);
+    // Layout of the model at config_path, with precision and quant_qkv from the config it was loaded with
+    static KvCacheLayout ForModel(const std::string& config_path, const nlohmann::json& runtime_config);
+};
+
+// Native memory of one session by category, as returned by LlmSession::getMemoryReport
+struct MemoryReport {
+    ProcessMemory process;
+    // Model files in use; a shared model is counted by every session using it
+    size_t weight_bytes = 0;
+    // Estimated from kv_tokens and the model's KvCacheLayout
+    size_t kv_cache_bytes = 0;
+    int kv_tokens = 0;
+    size_t adapter_bytes = 0;
+    size_t token_cache_bytes = 0;
+    size_t budget_bytes = 0;
+    bool loaded = false;
+    bool shared = false;
+    TrimAction last_trim = TrimAction::NONE;
+
+    // What a trim can give back without unloading the model
+    size_t sheddableBytes() const { return kv_cache_bytes + adapter_bytes + token_cache_bytes; }
+};
+
+} // namespace mls
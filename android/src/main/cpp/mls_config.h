@@ -1,22 +1,64 @@
-#pragma once
-
-// Configuration constants for MLS (MNN LLM Session)
-
-namespace mls {
-
-// Default configuration values
-constexpr int DEFAULT_MAX_NEW_TOKENS = 2048;
-constexpr const char* DEFAULT_SYSTEM_PROMPT = "You are a helpful assistant.";
-
-// R1 model constants  
-constexpr const char* R1_USER_START = "<|User|>";
-constexpr const char* R1_ASSISTANT_START = "<|Assistant|>";
-constexpr const char* R1_THINK_START = "<think>\n";
-constexpr const char* R1_THINK_END = "</think>";
-constexpr const char* R1_SENTENCE_START = "<|begin_of_sentence|>";
-constexpr const char* R1_SENTENCE_END = "<|end_of_sentence|>";
-
-// Stream processing constants
-constexpr const char* END_OF_PROMPT = "<eop>";
-
+#pragma once
+
+#include <cstddef>
+
+// Configuration constants for MLS (MNN LLM Session)
+
+namespace mls {
+
+// Default configuration values
+constexpr int DEFAULT_MAX_NEW_TOKENS = 2048;
+// Prompts that may wait on a session's inference worker before new ones are rejected
+constexpr int DEFAULT_REQUEST_QUEUE_SIZE = 8;
+constexpr const char* DEFAULT_SYSTEM_PROMPT = "You are a helpful assistant.";
+
+// R1 model constants  
+constexpr const char* R1_USER_START = "<|User|>";
+constexpr const char* R1_ASSISTANT_START = "<|Assistant|>";
+constexpr const char* R1_THINK_START = "<think>\n";
+constexpr const char* R1_THINK_END = "</think>";
+constexpr const char* R1_SENTENCE_START = "<|begin_of_sentence|>";
+constexpr const char* R1_SENTENCE_END = "<|end_of_sentence|>";
+
+// Stream processing constants
+constexpr const char* END_OF_PROMPT = "<eop>";
+// Stop sequences beyond these limits are ignored, keeping the matcher's transition table small
+constexpr size_t STOP_MAX_SEQUENCES = 16;
+constexpr size_t STOP_MAX_SEQUENCE_BYTES = 64;
+
+// Context budget: a cached span evicted from the middle of the KV cache is erased only when at
+// least this much, and the tail after it this long, can be kept
+constexpr size_t CONTEXT_MIN_EVICTED_SPAN = 2;
+constexpr size_t CONTEXT_MIN_REUSED_TAIL = 32;
+constexpr const char* CONTEXT_SUMMARY_INSTRUCTION =
+        "Summarize the conversation below in a few sentences. Keep names, facts and decisions.";
+
+// KV cache "reserve" allocation: tokens reserved without a context budget, and the chunk they
+// are run through the model in so no forward pass holds a full-length attention matrix
+constexpr int KV_DEFAULT_RESERVE_TOKENS = 4096;
+constexpr int KV_RESERVE_CHUNK_TOKENS = 512;
+
+// Constrained decoding: vocabulary masks kept per grammar state, each vocab_size / 8 bytes
+constexpr size_t GRAMMAR_MASK_CACHE_SIZE = 64;
+
+// In-memory images (Bitmap / UIImage) are scaled down to this longest side before the vision
+// encoder's own resize, unless extra_config "image_max_side" says otherwise
+constexpr int IMAGE_DEFAULT_MAX_SIDE = 1024;
+
+// Thermal governor: how often the thermal status is read during decode, the share of the decode
+// rate measured while cool held once the device warms up (and half that once it is hot), and
+// the slice a paced decode step sleeps in so stop() still takes effect promptly
+constexpr int THERMAL_SAMPLE_INTERVAL_MS = 1000;
+constexpr double THERMAL_SUSTAIN_FRACTION = 0.75;
+constexpr double THERMAL_COOL_FRACTION = 0.5;
+constexpr int THERMAL_WAIT_SLICE_MS = 20;
+
+// Benchmark constants
+constexpr int BENCHMARK_PROMPT_TOKEN = 16;
+
+// GPU command-buffer batching tried by LlmSession::TuneBackend, and the workload timed per value
+constexpr int OP_ENCODER_CANDIDATES[] = {1, 5, 10, 20, 30, 50, 100};
+constexpr int TUNING_PROMPT_TOKENS = 32;
+constexpr int TUNING_DECODE_TOKENS = 8;
+
 } // namespace mls
\ No newline at end of file
@@ -1,30 +1,192 @@
-#include "mls_log.h"
-#include <android/log.h>
-
-void mls_log_debug(const char* format, ...) {
-    va_list args;
-    va_start(args, format);
-    __android_log_vprint(ANDROID_LOG_DEBUG, "MNN_RN_DEBUG", format, args);
-    va_end(args);
-}
-
-void mls_log_error(const char* format, ...) {
-    va_list args;
-    va_start(args, format);
-    __android_log_vprint(ANDROID_LOG_ERROR, "MNN_RN_ERROR", format, args);
-    va_end(args);
-}
-
-void mls_log_info(const char* format, ...) {
-    va_list args;
-    va_start(args, format);
-    __android_log_vprint(ANDROID_LOG_INFO, "MNN_RN_INFO", format, args);
-    va_end(args);
-}
-
-void mls_log_warn(const char* format, ...) {
-    va_list args;
-    va_start(args, format);
-    __android_log_vprint(ANDROID_LOG_WARN, "MNN_RN_WARN", format, args);
-    va_end(args);
-}
\ No newline at end of file
+#include "mls_log.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#if defined(__ANDROID__)
+#include <android/log.h>
+#elif defined(__APPLE__)
+#include <os/log.h>
+#endif
+
+namespace {
+
+#if !defined(__ANDROID__)
+// Logcat priorities, kept so the ring stores the same values on every platform
+enum { ANDROID_LOG_DEBUG = 3, ANDROID_LOG_INFO = 4, ANDROID_LOG_WARN = 5, ANDROID_LOG_ERROR = 6 };
+
+void __android_log_write(int priority, const char* tag, const char* message) {
+#if defined(__APPLE__)
+    os_log_type_t type = priority >= ANDROID_LOG_ERROR ? OS_LOG_TYPE_ERROR
+                         : priority <= ANDROID_LOG_DEBUG ? OS_LOG_TYPE_DEBUG
+                         : OS_LOG_TYPE_DEFAULT;
+    os_log_with_type(OS_LOG_DEFAULT, type, "%{public}s: %{public}s", tag, message);
+#else
+    fprintf(stderr, "%s: %s\n", tag, message);
+#endif
+}
+
+void __android_log_vprint(int priority, const char* tag, const char* format, va_list args) {
+    char message[1024];
+    vsnprintf(message, sizeof(message), format, args);
+    __android_log_write(priority, tag, message);
+}
+
+void __android_log_print(int priority, const char* tag, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    __android_log_vprint(priority, tag, format, args);
+    va_end(args);
+}
+#endif
+
+constexpr size_t kRingSlots = 1024; // power of two
+constexpr size_t kMessageBytes = 256;
+constexpr auto kDrainInterval = std::chrono::milliseconds(20);
+
+/**
+ * Bounded multi-producer ring (sequence-numbered slots); the drain thread is the only consumer.
+ */
+class AsyncLogRing {
+public:
+    AsyncLogRing() {
+        for (size_t i = 0; i < kRingSlots; i++) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool push(int priority, const char* tag, const char* format, va_list args) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Slot* slot = nullptr;
+        while (true) {
+            slot = &slots_[pos & (kRingSlots - 1)];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        slot->priority = priority;
+        slot->tag = tag;
+        vsnprintf(slot->message, sizeof(slot->message), format, args);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Write everything queued to logcat; returns the number of lines written
+    size_t drain() {
+        size_t written = 0;
+        while (true) {
+            Slot& slot = slots_[dequeue_pos_ & (kRingSlots - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos_ + 1) {
+                break;
+            }
+            __android_log_write(slot.priority, slot.tag, slot.message);
+            slot.sequence.store(dequeue_pos_ + kRingSlots, std::memory_order_release);
+            dequeue_pos_++;
+            written++;
+        }
+        auto dropped = dropped_.exchange(0, std::memory_order_relaxed);
+        if (dropped > 0) {
+            __android_log_print(ANDROID_LOG_WARN, "MNN_RN_WARN", "async log dropped %zu lines", dropped);
+        }
+        return written;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence{0};
+        int priority = ANDROID_LOG_DEBUG;
+        const char* tag = "";
+        char message[kMessageBytes];
+    };
+
+    Slot slots_[kRingSlots];
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) size_t dequeue_pos_ = 0;
+    std::atomic<size_t> dropped_{0};
+};
+
+std::atomic<bool> g_async_enabled{false};
+std::mutex g_async_mutex;
+
+// Intentionally leaked: loggers may run during static destruction
+AsyncLogRing& Ring() {
+    static auto* ring = new AsyncLogRing();
+    return *ring;
+}
+
+std::thread& DrainThread() {
+    static auto* thread = new std::thread();
+    return *thread;
+}
+
+void log_write(int priority, const char* tag, const char* format, va_list args) {
+    if (g_async_enabled.load(std::memory_order_relaxed)) {
+        Ring().push(priority, tag, format, args);
+        return;
+    }
+    __android_log_vprint(priority, tag, format, args);
+}
+
+} // namespace
+
+void mls_log_set_async(bool enabled) {
+    std::lock_guard<std::mutex> lock(g_async_mutex);
+    auto& thread = DrainThread();
+    if (enabled == thread.joinable()) {
+        return;
+    }
+    if (enabled) {
+        Ring();
+        g_async_enabled.store(true, std::memory_order_release);
+        thread = std::thread([]() {
+            while (g_async_enabled.load(std::memory_order_acquire)) {
+                if (Ring().drain() == 0) {
+                    std::this_thread::sleep_for(kDrainInterval);
+                }
+            }
+        });
+    } else {
+        g_async_enabled.store(false, std::memory_order_release);
+        thread.join();
+        // A line still being written by a racing producer goes out on the next enable
+        Ring().drain();
+    }
+}
+
+void mls_log_debug(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_write(ANDROID_LOG_DEBUG, "MNN_RN_DEBUG", format, args);
+    va_end(args);
+}
+
+void mls_log_error(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_write(ANDROID_LOG_ERROR, "MNN_RN_ERROR", format, args);
+    va_end(args);
+}
+
+void mls_log_info(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_write(ANDROID_LOG_INFO, "MNN_RN_INFO", format, args);
+    va_end(args);
+}
+
+void mls_log_warn(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    log_write(ANDROID_LOG_WARN, "MNN_RN_WARN", format, args);
+    va_end(args);
+}
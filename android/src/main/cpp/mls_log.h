@@ -1,15 +1,56 @@
-#pragma once
-
-#include <cstdarg>
-
-// Debug logging macros
-#define MNN_DEBUG(...) mls_log_debug(__VA_ARGS__)
-#define MNN_ERROR(...) mls_log_error(__VA_ARGS__)
-#define MNN_INFO(...) mls_log_info(__VA_ARGS__)
-#define MNN_WARN(...) mls_log_warn(__VA_ARGS__)
-
-// Function declarations
-void mls_log_debug(const char* format, ...);
-void mls_log_error(const char* format, ...);
-void mls_log_info(const char* format, ...);
-void mls_log_warn(const char* format, ...);
\ No newline at end of file
+#pragma once
+
+#include <cstdarg>
+
+// Log levels; statements below MLS_LOG_LEVEL compile away
+#define MLS_LOG_LEVEL_DEBUG 0
+#define MLS_LOG_LEVEL_INFO 1
+#define MLS_LOG_LEVEL_WARN 2
+#define MLS_LOG_LEVEL_ERROR 3
+#define MLS_LOG_LEVEL_NONE 4
+
+#ifndef MLS_LOG_LEVEL
+#ifdef NDEBUG
+#define MLS_LOG_LEVEL MLS_LOG_LEVEL_INFO
+#else
+#define MLS_LOG_LEVEL MLS_LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// Disabled statements keep their format checked but are never evaluated
+#define MLS_LOG_DISABLED(fn, ...) do { if (false) fn(__VA_ARGS__); } while (false)
+
+// Debug logging macros
+#if MLS_LOG_LEVEL <= MLS_LOG_LEVEL_DEBUG
+#define MNN_DEBUG(...) mls_log_debug(__VA_ARGS__)
+#else
+#define MNN_DEBUG(...) MLS_LOG_DISABLED(mls_log_debug, __VA_ARGS__)
+#endif
+#if MLS_LOG_LEVEL <= MLS_LOG_LEVEL_INFO
+#define MNN_INFO(...) mls_log_info(__VA_ARGS__)
+#else
+#define MNN_INFO(...) MLS_LOG_DISABLED(mls_log_info, __VA_ARGS__)
+#endif
+#if MLS_LOG_LEVEL <= MLS_LOG_LEVEL_WARN
+#define MNN_WARN(...) mls_log_warn(__VA_ARGS__)
+#else
+#define MNN_WARN(...) MLS_LOG_DISABLED(mls_log_warn, __VA_ARGS__)
+#endif
+#if MLS_LOG_LEVEL <= MLS_LOG_LEVEL_ERROR
+#define MNN_ERROR(...) mls_log_error(__VA_ARGS__)
+#else
+#define MNN_ERROR(...) MLS_LOG_DISABLED(mls_log_error, __VA_ARGS__)
+#endif
+
+// Function declarations
+void mls_log_debug(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void mls_log_error(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void mls_log_info(const char* format, ...) __attribute__((format(printf, 1, 2)));
+void mls_log_warn(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * Queue log lines in a lock-free ring buffer drained to logcat by a background thread,
+ * instead of writing them from the calling thread. Lines are dropped (and counted) when
+ * the ring is full. Disabling flushes what is queued.
+ */
+void mls_log_set_async(bool enabled);
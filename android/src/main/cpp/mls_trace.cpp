@@ -0,0 +1,39 @@
+#include "mls_trace.h"
+#if defined(__ANDROID__)
+#include <android/trace.h>
+#endif
+
+namespace mls {
+
+std::atomic<bool> g_trace_enabled{false};
+
+#if defined(__ANDROID__)
+bool TraceBegin(const char* name) {
+    if (!ATrace_isEnabled()) {
+        return false;
+    }
+    ATrace_beginSection(name);
+    return true;
+}
+
+void TraceEnd() {
+    ATrace_endSection();
+}
+#else
+// ATrace only; elsewhere spans are never opened
+bool TraceBegin(const char*) {
+    return false;
+}
+
+void TraceEnd() {}
+#endif
+
+} // namespace mls
+
+void mls_trace_set_enabled(bool enabled) {
+    mls::g_trace_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool mls_trace_is_enabled() {
+    return mls::g_trace_enabled.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+
+// System trace spans (ATrace, visible in Perfetto / systrace next to the app's own threads).
+// Off by default; when off a span costs one relaxed atomic load.
+#define MLS_TRACE_CONCAT_INNER(a, b) a##b
+#define MLS_TRACE_CONCAT(a, b) MLS_TRACE_CONCAT_INNER(a, b)
+#define MLS_TRACE_SCOPE(name) mls::TraceScope MLS_TRACE_CONCAT(mls_trace_scope_, __LINE__)(name)
+
+void mls_trace_set_enabled(bool enabled);
+bool mls_trace_is_enabled();
+
+namespace mls {
+
+extern std::atomic<bool> g_trace_enabled;
+
+// Begins the section only if tracing is switched on and a trace is being recorded
+bool TraceBegin(const char* name);
+void TraceEnd();
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name)
+        : active_(g_trace_enabled.load(std::memory_order_relaxed) && TraceBegin(name)) {}
+    ~TraceScope() {
+        if (active_) {
+            TraceEnd();
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const bool active_;
+};
+
+} // namespace mls
@@ -1,558 +1,1112 @@
-#include <android/asset_manager_jni.h>
-#include <android/bitmap.h>
-#include <android/log.h>
-#include <jni.h>
-#include <string>
-#include <utility>
-#include <vector>
-#include <thread>
-#include <mutex>
-#include <ostream>
-#include <sstream>
-#include <chrono>
-#include "mls_log.h"
-#include "MNN/expr/ExecutorScope.hpp"
-#include "nlohmann/json.hpp"
-#include "llm_stream_buffer.hpp"
-#include "utf8_stream_processor.hpp"
-#include "llm_session.h"
-
-using MNN::Transformer::Llm;
-using json = nlohmann::json;
-
-extern "C" {
-
-JNIEXPORT jint JNI_OnLoad(JavaVM *vm, void *reserved) {
-    __android_log_print(ANDROID_LOG_DEBUG, "MNN_RN_DEBUG", "JNI_OnLoad");
-    return JNI_VERSION_1_4;
-}
-
-JNIEXPORT void JNI_OnUnload(JavaVM *vm, void *reserved) {
-    __android_log_print(ANDROID_LOG_DEBUG, "MNN_RN_DEBUG", "JNI_OnUnload");
-}
-
-JNIEXPORT jlong JNICALL Java_com_mnnrn_MnnRnModule_initNative(JNIEnv *env,
-                                                              jobject thiz,
-                                                              jstring modelDir,
-                                                              jobject chat_history,
-                                                              jstring mergeConfigStr,
-                                                              jstring configJsonStr) {
-    MNN_DEBUG("initNative: START");
-    const char *model_dir = env->GetStringUTFChars(modelDir, nullptr);
-    auto model_dir_str = std::string(model_dir);
-    MNN_DEBUG("initNative: modelDir=%s", model_dir_str.c_str());
-    const char *config_json_cstr = env->GetStringUTFChars(configJsonStr, nullptr);
-    const char *merged_config_cstr = env->GetStringUTFChars(mergeConfigStr, nullptr);
-    MNN_DEBUG("initNative: Parsing config JSON");
-    json merged_config = json::parse(merged_config_cstr);
-    json extra_json_config = json::parse(config_json_cstr);
-    env->ReleaseStringUTFChars(modelDir, model_dir);
-    env->ReleaseStringUTFChars(configJsonStr, config_json_cstr);
-    env->ReleaseStringUTFChars(mergeConfigStr, merged_config_cstr);
-    
-    MNN_DEBUG("createLLM BeginLoad %s", model_dir_str.c_str());
-    
-    std::vector<std::string> history;
-    history.clear();
-    MNN_DEBUG("initNative: Processing chat history");
-    if (chat_history != nullptr) {
-        jclass listClass = env->GetObjectClass(chat_history);
-        jmethodID sizeMethod = env->GetMethodID(listClass, "size", "()I");
-        jmethodID getMethod = env->GetMethodID(listClass, "get", "(I)Ljava/lang/Object;");
-        jint listSize = env->CallIntMethod(chat_history, sizeMethod);
-        MNN_DEBUG("initNative: Chat history size=%d", listSize);
-        for (jint i = 0; i < listSize; i++) {
-            jobject element = env->CallObjectMethod(chat_history, getMethod, i);
-            const char *elementCStr = env->GetStringUTFChars((jstring) element, nullptr);
-            history.emplace_back(elementCStr);
-            env->ReleaseStringUTFChars((jstring) element, elementCStr);
-            env->DeleteLocalRef(element);
-        }
-    }
-    
-    auto llm_session = new mls::LlmSession(model_dir_str, merged_config, extra_json_config, history);
-    llm_session->Load();
-    MNN_DEBUG("LIFECYCLE: LlmSession CREATED at %p", llm_session);
-    MNN_DEBUG("createLLM EndLoad %ld ", reinterpret_cast<jlong>(llm_session));
-    return reinterpret_cast<jlong>(llm_session);
-}
-
-JNIEXPORT jobject JNICALL Java_com_mnnrn_MnnRnModule_submitNative(JNIEnv *env,
-                                                                  jobject thiz,
-                                                                  jlong llmPtr,
-                                                                  jstring inputStr,
-                                                                  jboolean keepHistory,
-                                                                  jobject progressListener) {
-    MNN_DEBUG("submitNative: START - llmPtr=%p", reinterpret_cast<void*>(llmPtr));
-    auto *llm = reinterpret_cast<mls::LlmSession *>(llmPtr);
-    if (!llm) {
-        MNN_DEBUG("submitNative: ERROR - LLM session is null");
-        // Return error result
-        jclass hashMapClass = env->FindClass("java/util/HashMap");
-        jmethodID hashMapInit = env->GetMethodID(hashMapClass, "<init>", "()V");
-        return env->NewObject(hashMapClass, hashMapInit);
-    }
-    
-    const char *input_str = env->GetStringUTFChars(inputStr, nullptr);
-    MNN_DEBUG("submitNative: input=%s, keepHistory=%d", input_str, keepHistory);
-    jclass progressListenerClass = env->GetObjectClass(progressListener);
-    jmethodID onProgressMethod = env->GetMethodID(progressListenerClass, "onProgress",
-                                                  "(Ljava/lang/String;)Z");
-    if (!onProgressMethod) {
-        MNN_DEBUG("submitNative: ERROR - ProgressListener onProgress method not found");
-    }
-    
-    MNN_DEBUG("submitNative: Calling llm->Response()");
-    auto *context = llm->Response(input_str, [&, progressListener, onProgressMethod](
-            const std::string &response, bool is_eop) {
-        if (progressListener && onProgressMethod) {
-            MNN_DEBUG("submitNative: Response callback - is_eop=%d, response_len=%zu", is_eop, response.length());
-            if (!is_eop && response.length() > 0) {
-                MNN_DEBUG("submitNative: Response chunk: %s", response.c_str());
-            }
-            jstring javaString = is_eop ? nullptr : env->NewStringUTF(response.c_str());
-            jboolean user_stop_requested = env->CallBooleanMethod(progressListener,
-                                                                  onProgressMethod, javaString);
-            MNN_DEBUG("submitNative: Response callback - user_stop_requested=%d", user_stop_requested);
-            if (javaString) {
-                env->DeleteLocalRef(javaString);
-            }
-            return (bool) user_stop_requested;
-        } else {
-            MNN_DEBUG("submitNative: Response callback - no listener, returning true");
-            return true;
-        }
-    });
-    
-    env->ReleaseStringUTFChars(inputStr, input_str);
-    
-    int64_t prompt_len = 0;
-    int64_t decode_len = 0;
-    int64_t vision_time = 0;
-    int64_t audio_time = 0;
-    int64_t prefill_time = 0;
-    int64_t decode_time = 0;
-    
-    if (context) {
-        prompt_len += context->prompt_len;
-        decode_len += context->gen_seq_len;
-        vision_time += context->vision_us;
-        audio_time += context->audio_us;
-        prefill_time += context->prefill_us;
-        decode_time += context->decode_us;
-        MNN_DEBUG("submitNative: Context stats - prompt_len=%lld, decode_len=%lld, vision_time=%lld, audio_time=%lld, prefill_time=%lld, decode_time=%lld",
-                  (long long)prompt_len, (long long)decode_len, (long long)vision_time,
-                  (long long)audio_time, (long long)prefill_time, (long long)decode_time);
-    } else {
-        MNN_DEBUG("submitNative: WARNING - context is null");
-    }
-    
-    jclass hashMapClass = env->FindClass("java/util/HashMap");
-    jmethodID hashMapInit = env->GetMethodID(hashMapClass, "<init>", "()V");
-    jmethodID putMethod = env->GetMethodID(hashMapClass, "put",
-                                           "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;");
-    jobject hashMap = env->NewObject(hashMapClass, hashMapInit);
-
-    // Add metrics to the HashMap
-    jclass longClass = env->FindClass("java/lang/Long");
-    jmethodID longInit = env->GetMethodID(longClass, "<init>", "(J)V");
-    
-    env->CallObjectMethod(hashMap, putMethod, env->NewStringUTF("promptLen"),
-                          env->NewObject(longClass, longInit, prompt_len));
-    env->CallObjectMethod(hashMap, putMethod, env->NewStringUTF("decodeLen"),
-                          env->NewObject(longClass, longInit, decode_len));
-    env->CallObjectMethod(hashMap, putMethod, env->NewStringUTF("visionTime"),
-                          env->NewObject(longClass, longInit, vision_time));
-    env->CallObjectMethod(hashMap, putMethod, env->NewStringUTF("audioTime"),
-                          env->NewObject(longClass, longInit, audio_time));
-    env->CallObjectMethod(hashMap, putMethod, env->NewStringUTF("prefillTime"),
-                          env->NewObject(longClass, longInit, prefill_time));
-    env->CallObjectMethod(hashMap, putMethod, env->NewStringUTF("decodeTime"),
-                          env->NewObject(longClass, longInit, decode_time));
-    
-    MNN_DEBUG("submitNative: END - returning metrics");
-    return hashMap;
-}
-
-JNIEXPORT jobject JNICALL Java_com_mnnrn_MnnRnModule_submitFullHistoryNative(
-        JNIEnv *env,
-        jobject thiz,
-        jlong llmPtr,
-        jobject historyList,  // List<Pair<String, String>>
-        jobject progressListener
-) {
-    MNN_DEBUG("submitFullHistoryNative: START - llmPtr=%p", reinterpret_cast<void*>(llmPtr));
-    auto *llm = reinterpret_cast<mls::LlmSession *>(llmPtr);
-    if (!llm) {
-        MNN_DEBUG("submitFullHistoryNative: ERROR - LLM session is null");
-        // Return error result
-        jclass hashMapClass = env->FindClass("java/util/HashMap");
-        jmethodID hashMapInit = env->GetMethodID(hashMapClass, "<init>", "()V");
-        return env->NewObject(hashMapClass, hashMapInit);
-    }
-
-    // Parse Java List<Pair<String, String>> to C++ vector
-    std::vector<mls::PromptItem> history;
-
-    // Get List class and related methods
-    jclass listClass = env->GetObjectClass(historyList);
-    jmethodID sizeMethod = env->GetMethodID(listClass, "size", "()I");
-    jmethodID getMethod = env->GetMethodID(listClass, "get", "(I)Ljava/lang/Object;");
-
-    jint listSize = env->CallIntMethod(historyList, sizeMethod);
-    MNN_DEBUG("submitFullHistoryNative: History list size=%d", listSize);
-
-    // Get Pair class and related methods
-    jclass pairClass = env->FindClass("android/util/Pair");
-    if (pairClass == nullptr) {
-        MNN_DEBUG("submitFullHistoryNative: ERROR - Failed to find android.util.Pair class");
-        jclass hashMapClass = env->FindClass("java/util/HashMap");
-        jmethodID hashMapInit = env->GetMethodID(hashMapClass, "<init>", "()V");
-        return env->NewObject(hashMapClass, hashMapInit);
-    }
-    jfieldID firstField = env->GetFieldID(pairClass, "first", "Ljava/lang/Object;");
-    jfieldID secondField = env->GetFieldID(pairClass, "second", "Ljava/lang/Object;");
-
-    // Iterate through List, extract each Pair
-    for (jint i = 0; i < listSize; i++) {
-        jobject pairObj = env->CallObjectMethod(historyList, getMethod, i);
-        if (pairObj == nullptr) {
-            continue;
-        }
-        jobject roleObj = env->GetObjectField(pairObj, firstField);
-        jobject contentObj = env->GetObjectField(pairObj, secondField);
-
-        const char *role = nullptr;
-        const char *content = nullptr;
-        if (roleObj != nullptr) {
-            role = env->GetStringUTFChars((jstring) roleObj, nullptr);
-        }
-        if (contentObj != nullptr) {
-            content = env->GetStringUTFChars((jstring) contentObj, nullptr);
-        }
-
-        if (role && content) {
-            MNN_DEBUG("submitFullHistoryNative: History item %d - role=%s, content_len=%zu", i, role, strlen(content));
-            history.emplace_back(std::string(role), std::string(content));
-        }
-
-        if (role) {
-            env->ReleaseStringUTFChars((jstring) roleObj, role);
-        }
-        if (content) {
-            env->ReleaseStringUTFChars((jstring) contentObj, content);
-        }
-        
-        if (pairObj) env->DeleteLocalRef(pairObj);
-        if (roleObj) env->DeleteLocalRef(roleObj);
-        if (contentObj) env->DeleteLocalRef(contentObj);
-    }
-
-    // Set progress callback
-    jclass progressListenerClass = env->GetObjectClass(progressListener);
-    jmethodID onProgressMethod = env->GetMethodID(progressListenerClass, "onProgress",
-                                                  "(Ljava/lang/String;)Z");
-
-    if (!onProgressMethod) {
-        MNN_DEBUG("submitFullHistoryNative: ERROR - ProgressListener onProgress method not found");
-    }
-    
-    MNN_DEBUG("submitFullHistoryNative: Calling llm->ResponseWithHistory()");
-    // Call API service inference method
-    auto *context = llm->ResponseWithHistory(history, [&, progressListener, onProgressMethod](
-            const std::string &response, bool is_eop) {
-        if (progressListener && onProgressMethod) {
-            MNN_DEBUG("submitFullHistoryNative: Response callback - is_eop=%d, response_len=%zu", is_eop, response.length());
-            if (!is_eop && response.length() > 0) {
-                MNN_DEBUG("submitFullHistoryNative: Response chunk: %s", response.c_str());
-            }
-            jstring javaString = is_eop ? nullptr : env->NewStringUTF(response.c_str());
-            jboolean user_stop_requested = env->CallBooleanMethod(progressListener,
-                                                                  onProgressMethod, javaString);
-            MNN_DEBUG("submitFullHistoryNative: Response callback - user_stop_requested=%d", user_stop_requested);
-            if (javaString) {
-                env->DeleteLocalRef(javaString);
-            }
-            return (bool) user_stop_requested;
-        } else {
-            MNN_DEBUG("submitFullHistoryNative: Response callback - no listener, returning true");
-            return true;
-        }
-    });
-
-    // Build return result
-    int64_t prompt_len = 0;
-    int64_t decode_len = 0;
-    int64_t vision_time = 0;
-    int64_t audio_time = 0;
-    int64_t prefill_time = 0;
-    int64_t decode_time = 0;
-
-    if (context) {
-        prompt_len += context->prompt_len;
-        decode_len += context->gen_seq_len;
-        vision_time += context->vision_us;
-        audio_time += context->audio_us;
-        prefill_time += context->prefill_us;
-        decode_time += context->decode_us;
-        MNN_DEBUG("submitFullHistoryNative: Context stats - prompt_len=%lld, decode_len=%lld, vision_time=%lld, audio_time=%lld, prefill_time=%lld, decode_time=%lld",
-                  (long long)prompt_len, (long long)decode_len, (long long)vision_time,
-                  (long long)audio_time, (long long)prefill_time, (long long)decode_time);
-    } else {
-        MNN_DEBUG("submitFullHistoryNative: WARNING - context is null");
-    }
-
-    jclass hashMapClass = env->FindClass("java/util/HashMap");
-    jmethodID hashMapInit = env->GetMethodID(hashMapClass, "<init>", "()V");
-    jmethodID hashMapPut = env->GetMethodID(hashMapClass, "put",
-                                            "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;");
-    jobject hashMap = env->NewObject(hashMapClass, hashMapInit);
-
-    // Add statistics
-    jclass longClass = env->FindClass("java/lang/Long");
-    jmethodID longInit = env->GetMethodID(longClass, "<init>", "(J)V");
-
-    env->CallObjectMethod(hashMap, hashMapPut, env->NewStringUTF("promptLen"),
-                          env->NewObject(longClass, longInit, prompt_len));
-    env->CallObjectMethod(hashMap, hashMapPut, env->NewStringUTF("decodeLen"),
-                          env->NewObject(longClass, longInit, decode_len));
-    env->CallObjectMethod(hashMap, hashMapPut, env->NewStringUTF("visionTime"),
-                          env->NewObject(longClass, longInit, vision_time));
-    env->CallObjectMethod(hashMap, hashMapPut, env->NewStringUTF("audioTime"),
-                          env->NewObject(longClass, longInit, audio_time));
-    env->CallObjectMethod(hashMap, hashMapPut, env->NewStringUTF("prefillTime"),
-                          env->NewObject(longClass, longInit, prefill_time));
-    env->CallObjectMethod(hashMap, hashMapPut, env->NewStringUTF("decodeTime"),
-                          env->NewObject(longClass, longInit, decode_time));
-    
-    MNN_DEBUG("submitFullHistoryNative: END - returning metrics");
-    return hashMap;
-}
-
-JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_resetNative(JNIEnv *env, jobject thiz, jlong object_ptr) {
-    MNN_DEBUG("resetNative: START - object_ptr=%p", reinterpret_cast<void*>(object_ptr));
-    auto *llm = reinterpret_cast<mls::LlmSession *>(object_ptr);
-    if (llm) {
-        MNN_DEBUG("resetNative: Calling llm->Reset()");
-        llm->Reset();
-        MNN_DEBUG("resetNative: END - Reset complete");
-    } else {
-        MNN_DEBUG("resetNative: ERROR - LLM session is null");
-    }
-}
-
-JNIEXPORT jboolean JNICALL Java_com_mnnrn_MnnRnModule_setWavformCallbackNative(
-        JNIEnv *env, jobject thiz, jlong instance_id, jobject listener) {
-    MNN_DEBUG("setWavformCallbackNative: START - instance_id=%p", reinterpret_cast<void*>(instance_id));
-    if (instance_id == 0 || !listener) {
-        MNN_DEBUG("setWavformCallbackNative: ERROR - invalid parameters");
-        return JNI_FALSE;
-    }
-    auto *session = reinterpret_cast<mls::LlmSession *>(instance_id);
-    jobject global_ref = env->NewGlobalRef(listener);
-    JavaVM *jvm;
-    env->GetJavaVM(&jvm);
-    MNN_DEBUG("setWavformCallbackNative: Setting callback");
-    session->SetWavformCallback(
-            [jvm, global_ref](const float *data, size_t size, bool is_end) -> bool {
-                MNN_DEBUG("Wavform callback: size=%zu, is_end=%d", size, is_end);
-                bool needDetach = false;
-                JNIEnv *env;
-                if (jvm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) != JNI_OK) {
-                    jvm->AttachCurrentThread(&env, NULL);
-                    needDetach = true;
-                }
-                jclass listenerClass = env->GetObjectClass(global_ref);
-                jmethodID onAudioDataMethod = env->GetMethodID(listenerClass, "onAudioData",
-                                                               "([FZ)Z");
-                jfloatArray audioDataArray = env->NewFloatArray(size);
-                env->SetFloatArrayRegion(audioDataArray, 0, size, data);
-                jboolean result = env->CallBooleanMethod(global_ref, onAudioDataMethod,
-                                                         audioDataArray, is_end);
-                env->DeleteLocalRef(audioDataArray);
-                env->DeleteLocalRef(listenerClass);
-                if (needDetach) {
-                    jvm->DetachCurrentThread();
-                }
-                MNN_DEBUG("Wavform callback: result=%d", result);
-                return result == JNI_TRUE;
-            });
-
-    MNN_DEBUG("setWavformCallbackNative: END - callback set successfully");
-    return JNI_TRUE;
-}
-
-JNIEXPORT jstring JNICALL Java_com_mnnrn_MnnRnModule_getDebugInfoNative(JNIEnv *env, jobject thiz, jlong objecPtr) {
-    MNN_DEBUG("getDebugInfoNative: START - objecPtr=%p", reinterpret_cast<void*>(objecPtr));
-    auto *llm = reinterpret_cast<mls::LlmSession *>(objecPtr);
-    if (llm == nullptr) {
-        MNN_DEBUG("getDebugInfoNative: ERROR - LLM session is null");
-        return env->NewStringUTF("");
-    }
-    std::string debug_info = llm->getDebugInfo();
-    MNN_DEBUG("getDebugInfoNative: END - returning debug info (len=%zu)", debug_info.length());
-    return env->NewStringUTF(debug_info.c_str());
-}
-
-JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_releaseNative(JNIEnv *env, jobject thiz, jlong objecPtr) {
-    MNN_DEBUG("LIFECYCLE: About to DESTROY LlmSession at %p", reinterpret_cast<void*>(objecPtr));
-    auto *llm = reinterpret_cast<mls::LlmSession *>(objecPtr);
-    delete llm;
-    MNN_DEBUG("LIFECYCLE: LlmSession DESTROYED at %p", reinterpret_cast<void*>(objecPtr));
-}
-
-JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_updateMaxNewTokensNative(JNIEnv *env, jobject thiz,
-                                                                           jlong llm_ptr,
-                                                                           jint max_new_tokens) {
-    MNN_DEBUG("updateMaxNewTokensNative: START - llm_ptr=%p, max_new_tokens=%d", reinterpret_cast<void*>(llm_ptr), max_new_tokens);
-    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
-    if (llm) {
-        llm->SetMaxNewTokens(max_new_tokens);
-        MNN_DEBUG("updateMaxNewTokensNative: END - updated successfully");
-    } else {
-        MNN_DEBUG("updateMaxNewTokensNative: ERROR - LLM session is null");
-    }
-}
-
-JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_updateSystemPromptNative(JNIEnv *env, jobject thiz,
-                                                                           jlong llm_ptr,
-                                                                           jstring system_promp_j) {
-    MNN_DEBUG("updateSystemPromptNative: START - llm_ptr=%p", reinterpret_cast<void*>(llm_ptr));
-    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
-    const char *system_prompt_cstr = env->GetStringUTFChars(system_promp_j, nullptr);
-    MNN_DEBUG("updateSystemPromptNative: system_prompt=%s", system_prompt_cstr);
-    if (llm) {
-        llm->setSystemPrompt(system_prompt_cstr);
-        MNN_DEBUG("updateSystemPromptNative: END - updated successfully");
-    } else {
-        MNN_DEBUG("updateSystemPromptNative: ERROR - LLM session is null");
-    }
-    env->ReleaseStringUTFChars(system_promp_j, system_prompt_cstr);
-}
-
-JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_updateAssistantPromptNative(JNIEnv *env,
-                                                                              jobject thiz,
-                                                                              jlong llm_ptr,
-                                                                              jstring assistant_prompt_j) {
-    MNN_DEBUG("updateAssistantPromptNative: START - llm_ptr=%p", reinterpret_cast<void*>(llm_ptr));
-    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
-    const char *assistant_prompt_cstr = env->GetStringUTFChars(assistant_prompt_j, nullptr);
-    MNN_DEBUG("updateAssistantPromptNative: assistant_prompt=%s", assistant_prompt_cstr);
-    if (llm) {
-        llm->SetAssistantPrompt(assistant_prompt_cstr);
-        MNN_DEBUG("updateAssistantPromptNative: END - updated successfully");
-    } else {
-        MNN_DEBUG("updateAssistantPromptNative: ERROR - LLM session is null");
-    }
-    env->ReleaseStringUTFChars(assistant_prompt_j, assistant_prompt_cstr);
-}
-
-JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_updateConfigNative(JNIEnv *env,
-                                                                     jobject thiz,
-                                                                     jlong llm_ptr,
-                                                                     jstring config_json_j) {
-    MNN_DEBUG("updateConfigNative: START - llm_ptr=%p", reinterpret_cast<void*>(llm_ptr));
-    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
-    const char *config_json_cstr = env->GetStringUTFChars(config_json_j, nullptr);
-    MNN_DEBUG("updateConfigNative: config_json=%s", config_json_cstr);
-    if (llm) {
-        llm->updateConfig(config_json_cstr);
-        MNN_DEBUG("updateConfigNative: END - updated successfully");
-    } else {
-        MNN_DEBUG("updateConfigNative: ERROR - LLM session is null");
-    }
-    env->ReleaseStringUTFChars(config_json_j, config_json_cstr);
-}
-
-JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_updateEnableAudioOutputNative(JNIEnv *env,jobject thiz, jlong llm_ptr, jboolean enable) {
-    MNN_DEBUG("updateEnableAudioOutputNative: START - llm_ptr=%p, enable=%d", reinterpret_cast<void*>(llm_ptr), enable);
-    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
-    if (llm) {
-        llm->enableAudioOutput((bool)enable);
-        MNN_DEBUG("updateEnableAudioOutputNative: END - updated successfully");
-    } else {
-        MNN_DEBUG("updateEnableAudioOutputNative: ERROR - LLM session is null");
-    }
-}
-
-JNIEXPORT jstring JNICALL Java_com_mnnrn_MnnRnModule_getSystemPromptNative(JNIEnv *env, jobject thiz, jlong llm_ptr) {
-    MNN_DEBUG("getSystemPromptNative: START - llm_ptr=%p", reinterpret_cast<void*>(llm_ptr));
-    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
-    if (llm) {
-        std::string system_prompt = llm->getSystemPrompt();
-        MNN_DEBUG("getSystemPromptNative: END - returning prompt (len=%zu)", system_prompt.length());
-        return env->NewStringUTF(system_prompt.c_str());
-    }
-    MNN_DEBUG("getSystemPromptNative: ERROR - LLM session is null");
-    return nullptr;
-}
-
-JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_clearHistoryNative(JNIEnv *env, jobject thiz, jlong llm_ptr) {
-    MNN_DEBUG("clearHistoryNative: START - llm_ptr=%p", reinterpret_cast<void*>(llm_ptr));
-    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
-    if (llm) {
-        llm->clearHistory();
-        MNN_DEBUG("clearHistoryNative: END - history cleared");
-    } else {
-        MNN_DEBUG("clearHistoryNative: ERROR - LLM session is null");
-    }
-}
-
-// Simplified benchmark implementation - can be expanded later
-JNIEXPORT jobject JNICALL Java_com_mnnrn_MnnRnModule_runBenchmarkNative(
-        JNIEnv *env,
-        jobject thiz,
-        jlong llmPtr,
-        jint backend,
-        jint threads,
-        jboolean useMmap,
-        jint power,
-        jint precision,
-        jint memory,
-        jint dynamicOption,
-        jint nPrompt,
-        jint nGenerate,
-        jint nRepeat,
-        jboolean kvCache,
-        jobject testInstance,
-        jobject callback
-) {
-    MNN_DEBUG("runBenchmarkNative: START - llmPtr=%p, backend=%d, threads=%d, nPrompt=%d, nGenerate=%d",
-              reinterpret_cast<void*>(llmPtr), backend, threads, nPrompt, nGenerate);
-    auto *llm_session = reinterpret_cast<mls::LlmSession *>(llmPtr);
-    if (!llm_session) {
-        MNN_DEBUG("runBenchmarkNative: ERROR - LLM session is null");
-        // Return failure result
-        jclass hashMapClass = env->FindClass("java/util/HashMap");
-        jmethodID hashMapInit = env->GetMethodID(hashMapClass, "<init>", "()V");
-        jmethodID putMethod = env->GetMethodID(hashMapClass, "put",
-                                               "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;");
-        jobject hashMap = env->NewObject(hashMapClass, hashMapInit);
-        env->CallObjectMethod(hashMap, putMethod, env->NewStringUTF("success"), 
-                              env->NewObject(env->FindClass("java/lang/Boolean"),
-                                           env->GetMethodID(env->FindClass("java/lang/Boolean"), "<init>", "(Z)V"),
-                                           JNI_FALSE));
-        env->CallObjectMethod(hashMap, putMethod, env->NewStringUTF("errorMessage"), 
-                              env->NewStringUTF("LLM session is not initialized"));
-        return hashMap;
-    }
-
-    MNN_DEBUG("BENCHMARK: Attempting to use LlmSession at %p", llm_session);
-    
-    // Return basic success result for now - full benchmark implementation can be added later
-    jclass hashMapClass = env->FindClass("java/util/HashMap");
-    jmethodID hashMapInit = env->GetMethodID(hashMapClass, "<init>", "()V");
-    jmethodID putMethod = env->GetMethodID(hashMapClass, "put",
-                                           "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;");
-    jobject hashMap = env->NewObject(hashMapClass, hashMapInit);
-    
-    env->CallObjectMethod(hashMap, putMethod, env->NewStringUTF("success"), 
-                          env->NewObject(env->FindClass("java/lang/Boolean"),
-                                       env->GetMethodID(env->FindClass("java/lang/Boolean"), "<init>", "(Z)V"),
-                                       JNI_TRUE));
-    
-    MNN_DEBUG("runBenchmarkNative: END - returning success");
-    return hashMap;
-}
-
-} // extern "C"
\ No newline at end of file
+#include <android/asset_manager_jni.h>
+#include <android/bitmap.h>
+#include <android/log.h>
+#include <jni.h>
+#include <fbjni/fbjni.h>
+#include <ReactCommon/CallInvokerHolder.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <chrono>
+#include <future>
+#include "mls_log.h"
+#include "mls_trace.h"
+#include "MNN/expr/ExecutorScope.hpp"
+#include "nlohmann/json.hpp"
+#include "llm_stream_buffer.hpp"
+#include "utf8_stream_processor.hpp"
+#include "llm_session.h"
+#include "jni_registry.h"
+#include "inference_worker.hpp"
+#include "generation_metrics.hpp"
+#include "jsi_streaming.h"
+#include "pcm_ring.hpp"
+#include "embedding_session.h"
+#include "image_input.hpp"
+
+using MNN::Transformer::Llm;
+using json = nlohmann::json;
+
+namespace {
+
+jobject newHashMap(JNIEnv *env) {
+    const auto &jni = mls::GetJniRegistry();
+    return env->NewObject(jni.hashMapClass, jni.hashMapInit);
+}
+
+void putObject(JNIEnv *env, jobject hashMap, const char *key, jobject value) {
+    const auto &jni = mls::GetJniRegistry();
+    jstring jkey = env->NewStringUTF(key);
+    jobject previous = env->CallObjectMethod(hashMap, jni.hashMapPut, jkey, value);
+    if (previous) env->DeleteLocalRef(previous);
+    env->DeleteLocalRef(jkey);
+    env->DeleteLocalRef(value);
+}
+
+void putLong(JNIEnv *env, jobject hashMap, const char *key, int64_t value) {
+    const auto &jni = mls::GetJniRegistry();
+    putObject(env, hashMap, key, env->NewObject(jni.longClass, jni.longInit, (jlong) value));
+}
+
+void putDouble(JNIEnv *env, jobject hashMap, const char *key, double value) {
+    const auto &jni = mls::GetJniRegistry();
+    putObject(env, hashMap, key, env->NewObject(jni.doubleClass, jni.doubleInit, (jdouble) value));
+}
+
+void putBoolean(JNIEnv *env, jobject hashMap, const char *key, bool value) {
+    const auto &jni = mls::GetJniRegistry();
+    putObject(env, hashMap, key, env->NewObject(jni.booleanClass, jni.booleanInit, (jboolean) value));
+}
+
+void putString(JNIEnv *env, jobject hashMap, const char *key, const char *value) {
+    putObject(env, hashMap, key, env->NewStringUTF(value));
+}
+
+void putLongArray(JNIEnv *env, jobject hashMap, const char *key, const std::vector<int64_t> &values) {
+    jlongArray array = env->NewLongArray(static_cast<jsize>(values.size()));
+    std::vector<jlong> buffer(values.begin(), values.end());
+    env->SetLongArrayRegion(array, 0, static_cast<jsize>(buffer.size()), buffer.data());
+    putObject(env, hashMap, key, array);
+}
+
+void putDoubleArray(JNIEnv *env, jobject hashMap, const char *key, const std::vector<double> &values) {
+    jdoubleArray array = env->NewDoubleArray(static_cast<jsize>(values.size()));
+    env->SetDoubleArrayRegion(array, 0, static_cast<jsize>(values.size()), values.data());
+    putObject(env, hashMap, key, array);
+}
+
+std::string toStdString(JNIEnv *env, jstring value) {
+    if (value == nullptr) {
+        return {};
+    }
+    const char *chars = env->GetStringUTFChars(value, nullptr);
+    std::string result(chars);
+    env->ReleaseStringUTFChars(value, chars);
+    return result;
+}
+
+void putGenerationMetrics(JNIEnv *env, jobject hashMap, const mls::LlmSession &llm,
+                          const MNN::Transformer::LlmContext *context) {
+    for (const auto &metric : mls::CollectGenerationMetrics(llm, context)) {
+        if (metric.integral) {
+            putLong(env, hashMap, metric.key, static_cast<int64_t>(metric.value));
+        } else {
+            putDouble(env, hashMap, metric.key, metric.value);
+        }
+    }
+}
+
+using ProgressCallback = std::function<bool(const std::string &, bool is_eop)>;
+
+// Env of the current thread; inference workers stay attached for their whole lifetime
+JNIEnv *currentEnv() {
+    JNIEnv *env = nullptr;
+    mls::GetJniRegistry().vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6);
+    return env;
+}
+
+// A listener that threw must not leave the exception pending on a native thread
+void clearListenerException(JNIEnv *env, const char *where) {
+    if (env->ExceptionCheck()) {
+        MNN_ERROR("%s: listener threw", where);
+        env->ExceptionDescribe();
+        env->ExceptionClear();
+    }
+}
+
+ProgressCallback newProgressCallback(JNIEnv *env, jobject progressListener) {
+    jmethodID onProgressMethod = mls::GetJniRegistry().progressListenerOnProgress;
+    return [env, progressListener, onProgressMethod](const std::string &response, bool is_eop) {
+        if (!progressListener || !onProgressMethod) {
+            return false;
+        }
+        MLS_TRACE_SCOPE("mls::onProgress");
+        MNN_DEBUG("generation: Response callback - is_eop=%d, response_len=%zu", is_eop, response.length());
+        jstring javaString = is_eop ? nullptr : env->NewStringUTF(response.c_str());
+        jboolean user_stop_requested = env->CallBooleanMethod(progressListener, onProgressMethod, javaString);
+        clearListenerException(env, "generation");
+        if (javaString) {
+            env->DeleteLocalRef(javaString);
+        }
+        return (bool) user_stop_requested;
+    };
+}
+
+void completeGeneration(JNIEnv *env, jobject completionListener, jobject metrics) {
+    if (completionListener) {
+        env->CallVoidMethod(completionListener, mls::GetJniRegistry().completionListenerOnComplete, metrics);
+        clearListenerException(env, "generation");
+    }
+    env->DeleteLocalRef(metrics);
+}
+
+/**
+ * Queue a generation on the session's inference worker. The listeners are promoted to
+ * global refs for the job and released on the worker once the completion listener ran,
+ * whether the job finished, was stopped or was cancelled while still queued.
+ * @return job id, or 0 if the queue is full
+ */
+uint64_t submitGeneration(JNIEnv *env, mls::LlmSession *llm, jint priority,
+                          jobject progressListener, jobject completionListener,
+                          std::function<const MNN::Transformer::LlmContext *(const ProgressCallback &,
+                                                                             const mls::CancellationToken &)> generate) {
+    jobject progress = progressListener ? env->NewGlobalRef(progressListener) : nullptr;
+    jobject completion = completionListener ? env->NewGlobalRef(completionListener) : nullptr;
+    auto release = [progress, completion](JNIEnv *worker_env) {
+        if (progress) worker_env->DeleteGlobalRef(progress);
+        if (completion) worker_env->DeleteGlobalRef(completion);
+    };
+
+    mls::InferenceWorker::Job job;
+    job.priority = priority;
+    job.run = [llm, progress, completion, release, generate = std::move(generate)](
+            const mls::CancellationToken &token) {
+        JNIEnv *worker_env = currentEnv();
+        auto *context = generate(newProgressCallback(worker_env, progress), token);
+        if (context) {
+            MNN_DEBUG("generation: Context stats - prompt_len=%d, decode_len=%d, prefill_time=%lld, decode_time=%lld",
+                      context->prompt_len, context->gen_seq_len,
+                      (long long)context->prefill_us, (long long)context->decode_us);
+        } else {
+            MNN_DEBUG("generation: WARNING - context is null");
+        }
+        jobject hashMap = newHashMap(worker_env);
+        putGenerationMetrics(worker_env, hashMap, *llm, context);
+        putBoolean(worker_env, hashMap, "cancelled", token.cancelled());
+        completeGeneration(worker_env, completion, hashMap);
+        release(worker_env);
+    };
+    job.on_cancel = [completion, release]() {
+        JNIEnv *worker_env = currentEnv();
+        jobject hashMap = newHashMap(worker_env);
+        putBoolean(worker_env, hashMap, "cancelled", true);
+        completeGeneration(worker_env, completion, hashMap);
+        release(worker_env);
+    };
+    auto job_id = llm->worker().submit(std::move(job));
+    if (job_id == 0) {
+        release(env);
+    }
+    return job_id;
+}
+
+/**
+ * JNIEnv for the calling thread. Inference workers are attached already; a thread MNN starts
+ * on its own (audio synthesis) is attached on first use and stays attached until it exits,
+ * instead of attaching and detaching around every chunk.
+ */
+JNIEnv *attachedEnv() {
+    struct ThreadAttachment {
+        JNIEnv *env = nullptr;
+        bool attached = false;
+        ~ThreadAttachment() {
+            if (attached) {
+                mls::GetJniRegistry().vm->DetachCurrentThread();
+            }
+        }
+    };
+    thread_local ThreadAttachment attachment;
+    if (!attachment.env) {
+        JavaVM *vm = mls::GetJniRegistry().vm;
+        if (vm->GetEnv(reinterpret_cast<void **>(&attachment.env), JNI_VERSION_1_6) != JNI_OK) {
+            vm->AttachCurrentThread(&attachment.env, nullptr);
+            attachment.attached = true;
+        }
+    }
+    return attachment.env;
+}
+
+// Audio output target: the PCM ring over a Kotlin direct ByteBuffer and its listener
+struct AudioSink {
+    AudioSink(JNIEnv *env, jobject buffer, jobject listener, float *samples, size_t capacity)
+            : buffer(env->NewGlobalRef(buffer)), listener(env->NewGlobalRef(listener)), ring(samples, capacity) {}
+    ~AudioSink() {
+        JNIEnv *env = attachedEnv();
+        env->DeleteGlobalRef(listener);
+        env->DeleteGlobalRef(buffer);
+    }
+
+    jobject buffer;
+    jobject listener;
+    mls::PcmRing ring;
+};
+
+// A Kotlin listener kept as a global ref for as long as a session callback holds it
+struct ListenerRef {
+    ListenerRef(JNIEnv *env, jobject listener) : listener(env->NewGlobalRef(listener)) {}
+    ~ListenerRef() { attachedEnv()->DeleteGlobalRef(listener); }
+
+    jobject listener;
+};
+
+// Apply a session update in order with generation instead of racing a running one
+void queueSessionUpdate(mls::LlmSession *llm, std::function<void()> update) {
+    mls::InferenceWorker::Job job;
+    job.priority = mls::InferenceWorker::kUpdatePriority;
+    job.bounded = false;
+    job.run = [update = std::move(update)](const mls::CancellationToken &) { update(); };
+    llm->worker().submit(std::move(job));
+}
+
+/**
+ * Run call on the session's worker in order with generation, and wait for it. Its result, an
+ * error message or empty, is returned as a Java string, or null when the call succeeded.
+ */
+jstring runSessionCall(JNIEnv *env, mls::LlmSession *llm, const std::function<std::string()> &call) {
+    std::string error;
+    std::promise<void> done;
+    mls::InferenceWorker::Job job;
+    job.priority = mls::InferenceWorker::kUpdatePriority;
+    job.bounded = false;
+    job.run = [&](const mls::CancellationToken &) {
+        error = call();
+        done.set_value();
+    };
+    job.on_cancel = [&]() {
+        error = "session was released";
+        done.set_value();
+    };
+    if (llm->worker().submit(std::move(job)) == 0) {
+        error = "session was released";
+    } else {
+        done.get_future().wait();
+    }
+    return error.empty() ? nullptr : env->NewStringUTF(error.c_str());
+}
+
+} // namespace
+
+extern "C" {
+
+JNIEXPORT jint JNI_OnLoad(JavaVM *vm, void *reserved) {
+    __android_log_print(ANDROID_LOG_DEBUG, "MNN_RN_DEBUG", "JNI_OnLoad");
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+    // fbjni backs the CallInvokerHolder unwrapping used by the JSI streaming path
+    facebook::jni::initialize(vm, [] {});
+    if (!mls::InitJniRegistry(vm, env)) {
+        MNN_ERROR("JNI_OnLoad: failed to resolve JNI classes");
+        return JNI_ERR;
+    }
+    // Inference workers attach once instead of around every callback
+    mls::InferenceWorker::SetThreadHooks(
+            [vm]() {
+                JNIEnv *worker_env = nullptr;
+                vm->AttachCurrentThread(&worker_env, nullptr);
+            },
+            [vm]() { vm->DetachCurrentThread(); });
+    return JNI_VERSION_1_6;
+}
+
+JNIEXPORT void JNI_OnUnload(JavaVM *vm, void *reserved) {
+    __android_log_print(ANDROID_LOG_DEBUG, "MNN_RN_DEBUG", "JNI_OnUnload");
+    mls::InferenceWorker::SetThreadHooks(nullptr, nullptr);
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void **>(&env), JNI_VERSION_1_6) == JNI_OK) {
+        mls::ReleaseJniRegistry(env);
+    }
+}
+
+JNIEXPORT jlong JNICALL Java_com_mnnrn_MnnRnModule_initNative(JNIEnv *env,
+                                                              jobject thiz,
+                                                              jstring modelDir,
+                                                              jobject chat_history,
+                                                              jstring mergeConfigStr,
+                                                              jstring configJsonStr,
+                                                              jobject loadListener) {
+    MNN_DEBUG("initNative: START");
+    const char *model_dir = env->GetStringUTFChars(modelDir, nullptr);
+    auto model_dir_str = std::string(model_dir);
+    MNN_DEBUG("initNative: modelDir=%s", model_dir_str.c_str());
+    const char *config_json_cstr = env->GetStringUTFChars(configJsonStr, nullptr);
+    const char *merged_config_cstr = env->GetStringUTFChars(mergeConfigStr, nullptr);
+    MNN_DEBUG("initNative: Parsing config JSON");
+    json merged_config = json::parse(merged_config_cstr);
+    json extra_json_config = json::parse(config_json_cstr);
+    env->ReleaseStringUTFChars(modelDir, model_dir);
+    env->ReleaseStringUTFChars(configJsonStr, config_json_cstr);
+    env->ReleaseStringUTFChars(mergeConfigStr, merged_config_cstr);
+    
+    MNN_DEBUG("createLLM BeginLoad %s", model_dir_str.c_str());
+    
+    std::vector<std::string> history;
+    history.clear();
+    MNN_DEBUG("initNative: Processing chat history");
+    if (chat_history != nullptr) {
+        const auto &jni = mls::GetJniRegistry();
+        jint listSize = env->CallIntMethod(chat_history, jni.listSize);
+        MNN_DEBUG("initNative: Chat history size=%d", listSize);
+        for (jint i = 0; i < listSize; i++) {
+            jobject element = env->CallObjectMethod(chat_history, jni.listGet, i);
+            const char *elementCStr = env->GetStringUTFChars((jstring) element, nullptr);
+            history.emplace_back(elementCStr);
+            env->ReleaseStringUTFChars((jstring) element, elementCStr);
+            env->DeleteLocalRef(element);
+        }
+    }
+    
+    auto llm_session = new mls::LlmSession(model_dir_str, merged_config, extra_json_config, history);
+    // Load runs on this thread, so the listener is called with this env
+    jmethodID onLoadProgress = mls::GetJniRegistry().loadListenerOnLoadProgress;
+    llm_session->Load([env, loadListener, onLoadProgress](const mls::LlmSession::LoadProgress &info) {
+        if (!loadListener || !onLoadProgress) {
+            return;
+        }
+        jstring stage = env->NewStringUTF(info.stage);
+        env->CallVoidMethod(loadListener, onLoadProgress, stage, static_cast<jint>(info.progress),
+                            static_cast<jlong>(info.elapsed_us / 1000), static_cast<jlong>(info.prefetched_bytes));
+        clearListenerException(env, "onLoadProgress");
+        env->DeleteLocalRef(stage);
+    });
+    MNN_DEBUG("LIFECYCLE: LlmSession CREATED at %p", llm_session);
+    MNN_DEBUG("createLLM EndLoad %ld ", reinterpret_cast<jlong>(llm_session));
+    return reinterpret_cast<jlong>(llm_session);
+}
+
+JNIEXPORT jlong JNICALL Java_com_mnnrn_MnnRnModule_submitAsyncNative(JNIEnv *env,
+                                                                     jobject thiz,
+                                                                     jlong llmPtr,
+                                                                     jstring inputStr,
+                                                                     jboolean keepHistory,
+                                                                     jint priority,
+                                                                     jstring adapterPath,
+                                                                     jobject progressListener,
+                                                                     jobject completionListener) {
+    MNN_DEBUG("submitAsyncNative: START - llmPtr=%p", reinterpret_cast<void*>(llmPtr));
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llmPtr);
+    if (!llm) {
+        MNN_DEBUG("submitAsyncNative: ERROR - LLM session is null");
+        return 0;
+    }
+
+    const char *input_str = env->GetStringUTFChars(inputStr, nullptr);
+    MNN_DEBUG("submitAsyncNative: input=%s, keepHistory=%d, priority=%d", input_str, keepHistory, priority);
+    std::string input(input_str);
+    env->ReleaseStringUTFChars(inputStr, input_str);
+
+    auto job_id = submitGeneration(env, llm, priority, progressListener, completionListener,
+                                   [llm, input, adapter = toStdString(env, adapterPath)](
+                                           const ProgressCallback &on_progress, const mls::CancellationToken &token) {
+                                       llm->SelectAdapter(adapter);
+                                       return llm->Response(input, on_progress, &token);
+                                   });
+    MNN_DEBUG("submitAsyncNative: END - job=%llu", (unsigned long long) job_id);
+    return static_cast<jlong>(job_id);
+}
+
+JNIEXPORT jlong JNICALL Java_com_mnnrn_MnnRnModule_submitImageAsyncNative(JNIEnv *env,
+                                                                          jobject thiz,
+                                                                          jlong llmPtr,
+                                                                          jstring inputStr,
+                                                                          jobject bitmap,
+                                                                          jint priority,
+                                                                          jstring adapterPath,
+                                                                          jobject progressListener,
+                                                                          jobject completionListener) {
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llmPtr);
+    if (!llm) {
+        MNN_DEBUG("submitImageAsyncNative: ERROR - LLM session is null");
+        return -1;
+    }
+    AndroidBitmapInfo info{};
+    if (AndroidBitmap_getInfo(env, bitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS ||
+        info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+        MNN_ERROR("submitImageAsyncNative: bitmap is not ARGB_8888");
+        return -1;
+    }
+    // The pixels are only borrowed while locked: converted straight into the encoder's input here,
+    // so the caller may recycle the Bitmap as soon as this returns
+    void *pixels = nullptr;
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS) {
+        MNN_ERROR("submitImageAsyncNative: could not lock the bitmap");
+        return -1;
+    }
+    MNN::Transformer::PromptImagePart image;
+    bool converted;
+    {
+        MLS_TRACE_SCOPE("mls::convert_image");
+        converted = mls::ConvertRgbaImage(static_cast<const uint8_t *>(pixels), static_cast<int>(info.width),
+                                          static_cast<int>(info.height), static_cast<int>(info.stride),
+                                          llm->getImageMaxSide(), &image);
+    }
+    AndroidBitmap_unlockPixels(env, bitmap);
+    if (!converted) {
+        return -1;
+    }
+    auto job_id = submitGeneration(env, llm, priority, progressListener, completionListener,
+                                   [llm, input = toStdString(env, inputStr), image, adapter = toStdString(env, adapterPath)](
+                                           const ProgressCallback &on_progress, const mls::CancellationToken &token) {
+                                       llm->SelectAdapter(adapter);
+                                       return llm->Response(llm->AttachImage(image) + input, on_progress, &token);
+                                   });
+    MNN_DEBUG("submitImageAsyncNative: %ux%u bitmap, job=%llu", info.width, info.height, (unsigned long long) job_id);
+    return static_cast<jlong>(job_id);
+}
+
+JNIEXPORT jint JNICALL Java_com_mnnrn_MnnRnModule_imageMaxSideNative(JNIEnv *env, jobject thiz, jlong llmPtr) {
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llmPtr);
+    return llm ? llm->getImageMaxSide() : mls::IMAGE_DEFAULT_MAX_SIDE;
+}
+
+JNIEXPORT jlong JNICALL Java_com_mnnrn_MnnRnModule_submitFullHistoryAsyncNative(
+        JNIEnv *env,
+        jobject thiz,
+        jlong llmPtr,
+        jobject historyList,  // List<Pair<String, String>>
+        jint priority,
+        jstring adapterPath,
+        jobject progressListener,
+        jobject completionListener
+) {
+    MNN_DEBUG("submitFullHistoryAsyncNative: START - llmPtr=%p", reinterpret_cast<void*>(llmPtr));
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llmPtr);
+    if (!llm) {
+        MNN_DEBUG("submitFullHistoryAsyncNative: ERROR - LLM session is null");
+        return 0;
+    }
+
+    const auto &jni = mls::GetJniRegistry();
+
+    // Parse Java List<Pair<String, String>> to C++ vector
+    std::vector<mls::PromptItem> history;
+
+    jint listSize = env->CallIntMethod(historyList, jni.listSize);
+    MNN_DEBUG("submitFullHistoryAsyncNative: History list size=%d", listSize);
+
+    // Iterate through List, extract each Pair
+    for (jint i = 0; i < listSize; i++) {
+        jobject pairObj = env->CallObjectMethod(historyList, jni.listGet, i);
+        if (pairObj == nullptr) {
+            continue;
+        }
+        jobject roleObj = env->GetObjectField(pairObj, jni.pairFirst);
+        jobject contentObj = env->GetObjectField(pairObj, jni.pairSecond);
+
+        const char *role = nullptr;
+        const char *content = nullptr;
+        if (roleObj != nullptr) {
+            role = env->GetStringUTFChars((jstring) roleObj, nullptr);
+        }
+        if (contentObj != nullptr) {
+            content = env->GetStringUTFChars((jstring) contentObj, nullptr);
+        }
+
+        if (role && content) {
+            MNN_DEBUG("submitFullHistoryAsyncNative: History item %d - role=%s, content_len=%zu", i, role, strlen(content));
+            history.emplace_back(std::string(role), std::string(content));
+        }
+
+        if (role) {
+            env->ReleaseStringUTFChars((jstring) roleObj, role);
+        }
+        if (content) {
+            env->ReleaseStringUTFChars((jstring) contentObj, content);
+        }
+        
+        if (pairObj) env->DeleteLocalRef(pairObj);
+        if (roleObj) env->DeleteLocalRef(roleObj);
+        if (contentObj) env->DeleteLocalRef(contentObj);
+    }
+
+    auto job_id = submitGeneration(env, llm, priority, progressListener, completionListener,
+                                   [llm, history = std::move(history), adapter = toStdString(env, adapterPath)](
+                                           const ProgressCallback &on_progress, const mls::CancellationToken &token) {
+                                       llm->SelectAdapter(adapter);
+                                       return llm->ResponseWithHistory(history, on_progress, &token);
+                                   });
+    MNN_DEBUG("submitFullHistoryAsyncNative: END - job=%llu", (unsigned long long) job_id);
+    return static_cast<jlong>(job_id);
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_resetNative(JNIEnv *env, jobject thiz, jlong object_ptr) {
+    MNN_DEBUG("resetNative: START - object_ptr=%p", reinterpret_cast<void*>(object_ptr));
+    auto *llm = reinterpret_cast<mls::LlmSession *>(object_ptr);
+    if (llm) {
+        MNN_DEBUG("resetNative: Queueing llm->Reset()");
+        queueSessionUpdate(llm, [llm]() { llm->Reset(); });
+        MNN_DEBUG("resetNative: END - Reset queued");
+    } else {
+        MNN_DEBUG("resetNative: ERROR - LLM session is null");
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_setTracingEnabledNative(JNIEnv *env, jobject thiz,
+                                                                          jboolean enabled) {
+    MNN_DEBUG("setTracingEnabledNative: enabled=%d", enabled);
+    mls_trace_set_enabled(enabled == JNI_TRUE);
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_setAsyncLoggingNative(JNIEnv *env, jobject thiz,
+                                                                        jboolean enabled) {
+    mls_log_set_async(enabled == JNI_TRUE);
+}
+
+// Called from a synchronous module method, so this runs on the JS thread
+JNIEXPORT jboolean JNICALL Java_com_mnnrn_MnnRnModule_installStreamingNative(JNIEnv *env, jobject thiz,
+                                                                            jlong jsContext,
+                                                                            jobject callInvokerHolder) {
+    auto *runtime = reinterpret_cast<facebook::jsi::Runtime *>(jsContext);
+    if (!runtime || !callInvokerHolder) {
+        MNN_ERROR("installStreamingNative: no JS runtime");
+        return JNI_FALSE;
+    }
+    using facebook::react::CallInvokerHolder;
+    auto js_invoker = facebook::jni::alias_ref<CallInvokerHolder::javaobject>{
+            reinterpret_cast<CallInvokerHolder::javaobject>(callInvokerHolder)}->cthis()->getCallInvoker();
+    if (!js_invoker) {
+        MNN_ERROR("installStreamingNative: no JS call invoker");
+        return JNI_FALSE;
+    }
+    mls::InstallJsiStreaming(*runtime, js_invoker);
+    return JNI_TRUE;
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_registerStreamingSessionNative(JNIEnv *env, jobject thiz,
+                                                                                jlong sessionId,
+                                                                                jlong llmPtr) {
+    mls::RegisterStreamingSession(sessionId, reinterpret_cast<mls::LlmSession *>(llmPtr));
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_unregisterStreamingSessionNative(JNIEnv *env, jobject thiz,
+                                                                                  jlong sessionId) {
+    mls::UnregisterStreamingSession(sessionId);
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_stopNative(JNIEnv *env, jobject thiz, jlong object_ptr) {
+    MNN_DEBUG("stopNative: START - object_ptr=%p", reinterpret_cast<void*>(object_ptr));
+    auto *llm = reinterpret_cast<mls::LlmSession *>(object_ptr);
+    if (llm) {
+        // Cancels the running job and everything still queued for this session
+        llm->worker().cancelAll();
+        llm->RequestStop();
+    } else {
+        MNN_DEBUG("stopNative: ERROR - LLM session is null");
+    }
+}
+
+/**
+ * Point the session's audio output at a direct ByteBuffer of floats. Samples are written into
+ * it in place and the listener only receives the new write position; the consumer reports what
+ * it has played through audioConsumedNative. The sink lives until replaced or the session ends.
+ * @return sink handle for audioConsumedNative, or 0 if the buffer is not direct
+ */
+JNIEXPORT jlong JNICALL Java_com_mnnrn_MnnRnModule_setAudioBufferNative(
+        JNIEnv *env, jobject thiz, jlong llmPtr, jobject buffer, jobject listener) {
+    auto *session = reinterpret_cast<mls::LlmSession *>(llmPtr);
+    auto *samples = buffer ? static_cast<float *>(env->GetDirectBufferAddress(buffer)) : nullptr;
+    jlong bytes = buffer ? env->GetDirectBufferCapacity(buffer) : -1;
+    if (!session || !listener || !samples || bytes < static_cast<jlong>(sizeof(float))) {
+        MNN_ERROR("setAudioBufferNative: need a session, a listener and a direct buffer");
+        return 0;
+    }
+    if (!mls::GetJniRegistry().audioBufferListenerOnAudioWritten) {
+        MNN_ERROR("setAudioBufferNative: AudioBufferListener was not found at load");
+        return 0;
+    }
+    auto sink = std::make_shared<AudioSink>(env, buffer, listener, samples,
+                                            static_cast<size_t>(bytes) / sizeof(float));
+    jmethodID onAudioWritten = mls::GetJniRegistry().audioBufferListenerOnAudioWritten;
+    queueSessionUpdate(session, [session, sink, onAudioWritten]() {
+        session->SetWavformCallback([sink, onAudioWritten](const float *data, size_t size, bool is_end) -> bool {
+            MLS_TRACE_SCOPE("mls::onAudioData");
+            JNIEnv *env = attachedEnv();
+            size_t written = sink->ring.write(data, size);
+            jboolean stop = env->CallBooleanMethod(sink->listener, onAudioWritten,
+                                                   static_cast<jlong>(sink->ring.writePosition()), is_end);
+            clearListenerException(env, "onAudioWritten");
+            return stop == JNI_TRUE || written < size;
+        });
+    });
+    return reinterpret_cast<jlong>(sink.get());
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_setPrefillListenerNative(
+        JNIEnv *env, jobject thiz, jlong llmPtr, jobject listener) {
+    auto *session = reinterpret_cast<mls::LlmSession *>(llmPtr);
+    if (!session || !listener) {
+        return;
+    }
+    jmethodID onPrefill = mls::GetJniRegistry().prefillListenerOnPrefill;
+    if (!onPrefill) {
+        return;
+    }
+    auto ref = std::make_shared<ListenerRef>(env, listener);
+    queueSessionUpdate(session, [session, ref, onPrefill]() {
+        session->setPrefillProgressCallback([ref, onPrefill](int done, int total) {
+            // Called on the session's inference worker, which stays attached
+            JNIEnv *env = currentEnv();
+            env->CallVoidMethod(ref->listener, onPrefill, static_cast<jint>(done), static_cast<jint>(total));
+            clearListenerException(env, "onPrefill");
+        });
+    });
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_setThermalListenerNative(
+        JNIEnv *env, jobject thiz, jlong llmPtr, jobject listener) {
+    auto *session = reinterpret_cast<mls::LlmSession *>(llmPtr);
+    if (!session || !listener) {
+        return;
+    }
+    jmethodID onThermalState = mls::GetJniRegistry().thermalListenerOnThermalState;
+    if (!onThermalState) {
+        return;
+    }
+    auto ref = std::make_shared<ListenerRef>(env, listener);
+    queueSessionUpdate(session, [session, ref, onThermalState]() {
+        session->setThermalStateCallback([ref, onThermalState](const mls::ThermalState &state) {
+            JNIEnv *env = currentEnv();
+            jstring status = env->NewStringUTF(mls::ThermalStatusName(state.status));
+            jstring level = env->NewStringUTF(mls::ThrottleLevelName(state.level));
+            env->CallVoidMethod(ref->listener, onThermalState, status, level,
+                                static_cast<jboolean>(state.power_save),
+                                static_cast<jdouble>(state.target_tokens_per_s),
+                                static_cast<jdouble>(state.measured_tokens_per_s));
+            clearListenerException(env, "onThermalState");
+            env->DeleteLocalRef(status);
+            env->DeleteLocalRef(level);
+        });
+    });
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_setPowerSaveModeNative(JNIEnv *env, jobject thiz,
+                                                                         jboolean enabled) {
+    mls::SetPowerSaveMode(enabled == JNI_TRUE);
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_audioConsumedNative(JNIEnv *env, jobject thiz,
+                                                                      jlong sinkPtr, jlong position) {
+    auto *sink = reinterpret_cast<AudioSink *>(sinkPtr);
+    if (sink) {
+        sink->ring.setReadPosition(static_cast<uint64_t>(position));
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_audioClosedNative(JNIEnv *env, jobject thiz, jlong sinkPtr) {
+    auto *sink = reinterpret_cast<AudioSink *>(sinkPtr);
+    if (sink) {
+        sink->ring.close();
+    }
+}
+
+JNIEXPORT jstring JNICALL Java_com_mnnrn_MnnRnModule_getDebugInfoNative(JNIEnv *env, jobject thiz, jlong objecPtr) {
+    MNN_DEBUG("getDebugInfoNative: START - objecPtr=%p", reinterpret_cast<void*>(objecPtr));
+    auto *llm = reinterpret_cast<mls::LlmSession *>(objecPtr);
+    if (llm == nullptr) {
+        MNN_DEBUG("getDebugInfoNative: ERROR - LLM session is null");
+        return env->NewStringUTF("");
+    }
+    std::string debug_info = llm->getDebugInfo();
+    MNN_DEBUG("getDebugInfoNative: END - returning debug info (len=%zu)", debug_info.length());
+    return env->NewStringUTF(debug_info.c_str());
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_trimMemoryNative(JNIEnv *env, jobject thiz, jlong objecPtr,
+                                                                   jint level) {
+    auto *llm = reinterpret_cast<mls::LlmSession *>(objecPtr);
+    if (llm) {
+        queueSessionUpdate(llm, [llm, level]() { llm->TrimMemory(level); });
+    }
+}
+
+JNIEXPORT jobject JNICALL Java_com_mnnrn_MnnRnModule_getMemoryReportNative(JNIEnv *env, jobject thiz,
+                                                                          jlong objecPtr) {
+    auto *llm = reinterpret_cast<mls::LlmSession *>(objecPtr);
+    jobject report = newHashMap(env);
+    if (llm == nullptr) {
+        return report;
+    }
+    auto memory = llm->getMemoryReport();
+    putLong(env, report, "residentBytes", static_cast<int64_t>(memory.process.resident_bytes));
+    putLong(env, report, "nativeHeapBytes", static_cast<int64_t>(memory.process.native_heap_bytes));
+    putLong(env, report, "weightBytes", static_cast<int64_t>(memory.weight_bytes));
+    putLong(env, report, "kvCacheBytes", static_cast<int64_t>(memory.kv_cache_bytes));
+    putLong(env, report, "kvTokens", memory.kv_tokens);
+    putLong(env, report, "adapterBytes", static_cast<int64_t>(memory.adapter_bytes));
+    putLong(env, report, "tokenCacheBytes", static_cast<int64_t>(memory.token_cache_bytes));
+    putLong(env, report, "budgetBytes", static_cast<int64_t>(memory.budget_bytes));
+    putBoolean(env, report, "loaded", memory.loaded);
+    putBoolean(env, report, "shared", memory.shared);
+    putString(env, report, "lastTrim", mls::TrimActionName(memory.last_trim));
+    return report;
+}
+
+JNIEXPORT jstring JNICALL Java_com_mnnrn_MnnRnModule_setResponseFormatNative(JNIEnv *env, jobject thiz,
+                                                                           jlong llm_ptr, jstring kind_j,
+                                                                           jstring spec_j) {
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
+    if (llm == nullptr) {
+        return env->NewStringUTF("session is not initialized");
+    }
+    const char *kind_cstr = env->GetStringUTFChars(kind_j, nullptr);
+    const char *spec_cstr = env->GetStringUTFChars(spec_j, nullptr);
+    std::string kind(kind_cstr);
+    std::string spec(spec_cstr);
+    env->ReleaseStringUTFChars(kind_j, kind_cstr);
+    env->ReleaseStringUTFChars(spec_j, spec_cstr);
+    // Compiled here so a bad schema is reported to the caller instead of the worker's log
+    std::string error;
+    auto grammar = mls::CompileResponseFormat(kind, spec, &error);
+    if (grammar == nullptr && !error.empty()) {
+        MNN_ERROR("setResponseFormatNative: %s", error.c_str());
+        return env->NewStringUTF(error.c_str());
+    }
+    if (grammar && llm->getSpeculativeConfig().enabled) {
+        return env->NewStringUTF("constrained output is not available with speculative decoding");
+    }
+    queueSessionUpdate(llm, [llm, grammar]() { llm->setGrammar(grammar); });
+    return nullptr;
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_releaseNative(JNIEnv *env, jobject thiz, jlong objecPtr) {
+    MNN_DEBUG("LIFECYCLE: About to DESTROY LlmSession at %p", reinterpret_cast<void*>(objecPtr));
+    auto *llm = reinterpret_cast<mls::LlmSession *>(objecPtr);
+    delete llm;
+    MNN_DEBUG("LIFECYCLE: LlmSession DESTROYED at %p", reinterpret_cast<void*>(objecPtr));
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_updateMaxNewTokensNative(JNIEnv *env, jobject thiz,
+                                                                           jlong llm_ptr,
+                                                                           jint max_new_tokens) {
+    MNN_DEBUG("updateMaxNewTokensNative: START - llm_ptr=%p, max_new_tokens=%d", reinterpret_cast<void*>(llm_ptr), max_new_tokens);
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
+    if (llm) {
+        queueSessionUpdate(llm, [llm, max_new_tokens]() { llm->SetMaxNewTokens(max_new_tokens); });
+        MNN_DEBUG("updateMaxNewTokensNative: END - update queued");
+    } else {
+        MNN_DEBUG("updateMaxNewTokensNative: ERROR - LLM session is null");
+    }
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_updateSystemPromptNative(JNIEnv *env, jobject thiz,
+                                                                           jlong llm_ptr,
+                                                                           jstring system_promp_j) {
+    MNN_DEBUG("updateSystemPromptNative: START - llm_ptr=%p", reinterpret_cast<void*>(llm_ptr));
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
+    const char *system_prompt_cstr = env->GetStringUTFChars(system_promp_j, nullptr);
+    MNN_DEBUG("updateSystemPromptNative: system_prompt=%s", system_prompt_cstr);
+    if (llm) {
+        queueSessionUpdate(llm, [llm, system_prompt = std::string(system_prompt_cstr)]() {
+            llm->setSystemPrompt(system_prompt);
+        });
+        MNN_DEBUG("updateSystemPromptNative: END - update queued");
+    } else {
+        MNN_DEBUG("updateSystemPromptNative: ERROR - LLM session is null");
+    }
+    env->ReleaseStringUTFChars(system_promp_j, system_prompt_cstr);
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_updateAssistantPromptNative(JNIEnv *env,
+                                                                              jobject thiz,
+                                                                              jlong llm_ptr,
+                                                                              jstring assistant_prompt_j) {
+    MNN_DEBUG("updateAssistantPromptNative: START - llm_ptr=%p", reinterpret_cast<void*>(llm_ptr));
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
+    const char *assistant_prompt_cstr = env->GetStringUTFChars(assistant_prompt_j, nullptr);
+    MNN_DEBUG("updateAssistantPromptNative: assistant_prompt=%s", assistant_prompt_cstr);
+    if (llm) {
+        queueSessionUpdate(llm, [llm, assistant_prompt = std::string(assistant_prompt_cstr)]() {
+            llm->SetAssistantPrompt(assistant_prompt);
+        });
+        MNN_DEBUG("updateAssistantPromptNative: END - update queued");
+    } else {
+        MNN_DEBUG("updateAssistantPromptNative: ERROR - LLM session is null");
+    }
+    env->ReleaseStringUTFChars(assistant_prompt_j, assistant_prompt_cstr);
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_updateConfigNative(JNIEnv *env,
+                                                                     jobject thiz,
+                                                                     jlong llm_ptr,
+                                                                     jstring config_json_j) {
+    MNN_DEBUG("updateConfigNative: START - llm_ptr=%p", reinterpret_cast<void*>(llm_ptr));
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
+    const char *config_json_cstr = env->GetStringUTFChars(config_json_j, nullptr);
+    MNN_DEBUG("updateConfigNative: config_json=%s", config_json_cstr);
+    if (llm) {
+        queueSessionUpdate(llm, [llm, config_json = std::string(config_json_cstr)]() {
+            llm->updateConfig(config_json);
+        });
+        MNN_DEBUG("updateConfigNative: END - update queued");
+    } else {
+        MNN_DEBUG("updateConfigNative: ERROR - LLM session is null");
+    }
+    env->ReleaseStringUTFChars(config_json_j, config_json_cstr);
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_updateEnableAudioOutputNative(JNIEnv *env,jobject thiz, jlong llm_ptr, jboolean enable) {
+    MNN_DEBUG("updateEnableAudioOutputNative: START - llm_ptr=%p, enable=%d", reinterpret_cast<void*>(llm_ptr), enable);
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
+    if (llm) {
+        queueSessionUpdate(llm, [llm, enable]() { llm->enableAudioOutput((bool) enable); });
+        MNN_DEBUG("updateEnableAudioOutputNative: END - update queued");
+    } else {
+        MNN_DEBUG("updateEnableAudioOutputNative: ERROR - LLM session is null");
+    }
+}
+
+JNIEXPORT jstring JNICALL Java_com_mnnrn_MnnRnModule_getSystemPromptNative(JNIEnv *env, jobject thiz, jlong llm_ptr) {
+    MNN_DEBUG("getSystemPromptNative: START - llm_ptr=%p", reinterpret_cast<void*>(llm_ptr));
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
+    if (llm) {
+        std::string system_prompt = llm->getSystemPrompt();
+        MNN_DEBUG("getSystemPromptNative: END - returning prompt (len=%zu)", system_prompt.length());
+        return env->NewStringUTF(system_prompt.c_str());
+    }
+    MNN_DEBUG("getSystemPromptNative: ERROR - LLM session is null");
+    return nullptr;
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_clearHistoryNative(JNIEnv *env, jobject thiz, jlong llm_ptr) {
+    MNN_DEBUG("clearHistoryNative: START - llm_ptr=%p", reinterpret_cast<void*>(llm_ptr));
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
+    if (llm) {
+        queueSessionUpdate(llm, [llm]() { llm->clearHistory(); });
+        MNN_DEBUG("clearHistoryNative: END - clear queued");
+    } else {
+        MNN_DEBUG("clearHistoryNative: ERROR - LLM session is null");
+    }
+}
+
+JNIEXPORT jstring JNICALL Java_com_mnnrn_MnnRnModule_saveStateNative(JNIEnv *env, jobject thiz, jlong llm_ptr,
+                                                                     jstring name_j) {
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
+    if (llm == nullptr) {
+        return env->NewStringUTF("session is not initialized");
+    }
+    const char *name_cstr = env->GetStringUTFChars(name_j, nullptr);
+    std::string name(name_cstr);
+    env->ReleaseStringUTFChars(name_j, name_cstr);
+    return runSessionCall(env, llm, [llm, &name]() {
+        std::string error;
+        llm->SaveState(name, &error);
+        return error;
+    });
+}
+
+JNIEXPORT jstring JNICALL Java_com_mnnrn_MnnRnModule_restoreStateNative(JNIEnv *env, jobject thiz, jlong llm_ptr,
+                                                                        jstring name_j, jboolean prefill) {
+    auto *llm = reinterpret_cast<mls::LlmSession *>(llm_ptr);
+    if (llm == nullptr) {
+        return env->NewStringUTF("session is not initialized");
+    }
+    const char *name_cstr = env->GetStringUTFChars(name_j, nullptr);
+    std::string name(name_cstr);
+    env->ReleaseStringUTFChars(name_j, name_cstr);
+    return runSessionCall(env, llm, [llm, &name, prefill]() {
+        std::string error;
+        llm->RestoreState(name, prefill == JNI_TRUE, &error);
+        return error;
+    });
+}
+
+JNIEXPORT jobject JNICALL Java_com_mnnrn_MnnRnModule_runBenchmarkNative(
+        JNIEnv *env,
+        jobject thiz,
+        jlong llmPtr,
+        jint backend,
+        jint threads,
+        jboolean useMmap,
+        jint power,
+        jint precision,
+        jint memory,
+        jint dynamicOption,
+        jint nPrompt,
+        jint nGenerate,
+        jint nRepeat,
+        jboolean kvCache,
+        jobject benchmarkListener
+) {
+    MNN_DEBUG("runBenchmarkNative: START - llmPtr=%p, backend=%d, threads=%d, nPrompt=%d, nGenerate=%d",
+              reinterpret_cast<void*>(llmPtr), backend, threads, nPrompt, nGenerate);
+    auto *llm_session = reinterpret_cast<mls::LlmSession *>(llmPtr);
+    jobject hashMap = newHashMap(env);
+    if (!llm_session) {
+        MNN_DEBUG("runBenchmarkNative: ERROR - LLM session is null");
+        putBoolean(env, hashMap, "success", false);
+        putString(env, hashMap, "errorMessage", "LLM session is not initialized");
+        return hashMap;
+    }
+
+    jmethodID onProgressMethod = mls::GetJniRegistry().benchmarkListenerOnProgress;
+    jobject listener = benchmarkListener ? env->NewGlobalRef(benchmarkListener) : nullptr;
+    // Set on the worker thread, which owns its own JNIEnv
+    JNIEnv *worker_env = nullptr;
+    bool stop_requested = false;
+
+    mls::LlmSession::BenchmarkCallback callback;
+    callback.onProgress = [&worker_env, &stop_requested, listener, onProgressMethod](
+            const mls::LlmSession::BenchmarkProgressInfo &info) {
+        JNIEnv *env = worker_env;
+        MNN_DEBUG("runBenchmarkNative: progress=%d %s", info.progress, info.statusMessage.c_str());
+        if (!listener || !onProgressMethod) {
+            return;
+        }
+        jobject progressMap = newHashMap(env);
+        putLong(env, progressMap, "progress", info.progress);
+        putString(env, progressMap, "statusMessage", info.statusMessage.c_str());
+        putLong(env, progressMap, "progressType", static_cast<int64_t>(info.progressType));
+        putLong(env, progressMap, "currentIteration", info.currentIteration);
+        putLong(env, progressMap, "totalIterations", info.totalIterations);
+        putLong(env, progressMap, "nPrompt", info.nPrompt);
+        putLong(env, progressMap, "nGenerate", info.nGenerate);
+        putDouble(env, progressMap, "runTimeSeconds", info.runTimeSeconds);
+        putDouble(env, progressMap, "prefillTimeSeconds", info.prefillTimeSeconds);
+        putDouble(env, progressMap, "decodeTimeSeconds", info.decodeTimeSeconds);
+        putDouble(env, progressMap, "prefillSpeed", info.prefillSpeed);
+        putDouble(env, progressMap, "decodeSpeed", info.decodeSpeed);
+        jboolean user_stop_requested = env->CallBooleanMethod(listener, onProgressMethod, progressMap);
+        clearListenerException(env, "runBenchmarkNative");
+        env->DeleteLocalRef(progressMap);
+        stop_requested = stop_requested || user_stop_requested;
+    };
+    callback.onError = [](const std::string &error) {
+        MNN_ERROR("runBenchmarkNative: %s", error.c_str());
+    };
+    callback.onIterationComplete = [](const std::string &detailed_stats) {
+        MNN_DEBUG("runBenchmarkNative: iteration %s", detailed_stats.c_str());
+    };
+    callback.shouldStop = [&stop_requested]() {
+        return stop_requested;
+    };
+
+    // Runs on the session's worker so it cannot interleave with a generation; this thread waits
+    mls::LlmSession::BenchmarkResult result{};
+    result.success = false;
+    result.error_message = "Benchmark cancelled";
+    std::promise<void> done;
+    mls::InferenceWorker::Job job;
+    job.run = [&](const mls::CancellationToken &token) {
+        worker_env = currentEnv();
+        auto should_stop = callback.shouldStop;
+        callback.shouldStop = [should_stop, &token]() { return token.cancelled() || should_stop(); };
+        result = llm_session->runBenchmark(backend, threads, useMmap, power, precision, memory,
+                                           dynamicOption, nPrompt, nGenerate, nRepeat, kvCache, callback);
+        done.set_value();
+    };
+    job.on_cancel = [&done]() { done.set_value(); };
+    if (llm_session->worker().submit(std::move(job)) == 0) {
+        result.error_message = "Inference queue is full";
+    } else {
+        done.get_future().wait();
+    }
+    if (listener) {
+        env->DeleteGlobalRef(listener);
+    }
+
+    putBoolean(env, hashMap, "success", result.success);
+    putString(env, hashMap, "errorMessage", result.error_message.c_str());
+    putLong(env, hashMap, "promptTokens", result.prompt_tokens);
+    putLong(env, hashMap, "generateTokens", result.generate_tokens);
+    putLong(env, hashMap, "repeatCount", result.repeat_count);
+    putBoolean(env, hashMap, "kvCacheEnabled", result.kv_cache_enabled);
+    putLongArray(env, hashMap, "prefillTimesUs", result.prefill_times_us);
+    putLongArray(env, hashMap, "decodeTimesUs", result.decode_times_us);
+    putLongArray(env, hashMap, "sampleTimesUs", result.sample_times_us);
+
+    MNN_DEBUG("runBenchmarkNative: END - success=%d, iterations=%d", result.success, result.repeat_count);
+    return hashMap;
+}
+
+// ===== Embedding / vector index =====
+
+JNIEXPORT jlong JNICALL Java_com_mnnrn_MnnRnModule_initEmbeddingNative(JNIEnv *env, jobject thiz,
+                                                                       jstring configPath,
+                                                                       jstring configJson) {
+    std::string config_path = toStdString(env, configPath);
+    std::string config_str = toStdString(env, configJson);
+    json config = config_str.empty() ? json::object() : json::parse(config_str, nullptr, false);
+    if (config.is_discarded()) {
+        MNN_ERROR("initEmbeddingNative: invalid config json");
+        return 0;
+    }
+    auto *session = new mls::EmbeddingSession(config_path, config);
+    if (!session->Load()) {
+        delete session;
+        return 0;
+    }
+    MNN_DEBUG("LIFECYCLE: EmbeddingSession CREATED at %p", session);
+    return reinterpret_cast<jlong>(session);
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_releaseEmbeddingNative(JNIEnv *env, jobject thiz,
+                                                                         jlong embeddingPtr) {
+    delete reinterpret_cast<mls::EmbeddingSession *>(embeddingPtr);
+    MNN_DEBUG("LIFECYCLE: EmbeddingSession DESTROYED at %p", reinterpret_cast<void*>(embeddingPtr));
+}
+
+JNIEXPORT jobject JNICALL Java_com_mnnrn_MnnRnModule_embedToIndexNative(JNIEnv *env, jobject thiz,
+                                                                        jlong embeddingPtr,
+                                                                        jstring indexPath,
+                                                                        jobjectArray texts,
+                                                                        jlongArray ids) {
+    auto *session = reinterpret_cast<mls::EmbeddingSession *>(embeddingPtr);
+    jobject hashMap = newHashMap(env);
+    jsize count = texts ? env->GetArrayLength(texts) : 0;
+    if (!session || !ids || env->GetArrayLength(ids) != count) {
+        putBoolean(env, hashMap, "success", false);
+        putString(env, hashMap, "errorMessage", session ? "texts and ids differ in length"
+                                                        : "Embedding session is not initialized");
+        return hashMap;
+    }
+    std::vector<std::string> chunks;
+    chunks.reserve(count);
+    for (jsize i = 0; i < count; i++) {
+        auto element = (jstring) env->GetObjectArrayElement(texts, i);
+        chunks.push_back(toStdString(env, element));
+        env->DeleteLocalRef(element);
+    }
+    std::vector<jlong> raw_ids(count);
+    env->GetLongArrayRegion(ids, 0, count, raw_ids.data());
+    std::vector<int64_t> chunk_ids(raw_ids.begin(), raw_ids.end());
+
+    mls::EmbeddingSession::IndexStats stats;
+    bool ok = session->EmbedToIndex(toStdString(env, indexPath), chunks, chunk_ids, &stats);
+    putBoolean(env, hashMap, "success", ok);
+    if (!ok) {
+        putString(env, hashMap, "errorMessage", "Failed to embed or write the index");
+    }
+    putLong(env, hashMap, "count", stats.count);
+    putLong(env, hashMap, "dim", stats.dim);
+    putLong(env, hashMap, "tokens", stats.tokens);
+    putLong(env, hashMap, "embedTimeUs", stats.embed_us);
+    putLong(env, hashMap, "indexTimeUs", stats.index_us);
+    return hashMap;
+}
+
+JNIEXPORT jobject JNICALL Java_com_mnnrn_MnnRnModule_searchIndexNative(JNIEnv *env, jobject thiz,
+                                                                       jlong embeddingPtr,
+                                                                       jstring indexPath,
+                                                                       jstring query,
+                                                                       jint k,
+                                                                       jint nprobe) {
+    auto *session = reinterpret_cast<mls::EmbeddingSession *>(embeddingPtr);
+    jobject hashMap = newHashMap(env);
+    std::vector<int64_t> hit_ids;
+    std::vector<double> scores;
+    if (session) {
+        for (const auto &hit : session->Search(toStdString(env, indexPath), toStdString(env, query), k, nprobe)) {
+            hit_ids.push_back(hit.id);
+            scores.push_back(hit.score);
+        }
+    }
+    putLongArray(env, hashMap, "ids", hit_ids);
+    putDoubleArray(env, hashMap, "scores", scores);
+    return hashMap;
+}
+
+JNIEXPORT void JNICALL Java_com_mnnrn_MnnRnModule_closeIndexNative(JNIEnv *env, jobject thiz,
+                                                                   jlong embeddingPtr,
+                                                                   jstring indexPath) {
+    auto *session = reinterpret_cast<mls::EmbeddingSession *>(embeddingPtr);
+    if (session) {
+        session->CloseIndex(toStdString(env, indexPath));
+    }
+}
+
+} // extern "C"
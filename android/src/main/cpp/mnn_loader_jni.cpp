@@ -0,0 +1,30 @@
+//
+// Created for MNN React Native bindings
+//
+// libmnn-rn-loader: loaded before libMNN and libmnn-rn, so it links neither. It only tells
+// NativeLibraries which libMNN build the CPU can run.
+//
+#include <android/log.h>
+#include <jni.h>
+#include "cpu_features.hpp"
+
+extern "C" {
+
+JNIEXPORT jobjectArray JNICALL Java_com_mnnrn_NativeLibraries_mnnVariantsNative(JNIEnv *env, jobject thiz) {
+    const auto &features = mls::CpuFeatures::Get();
+    __android_log_print(ANDROID_LOG_INFO, "MNN_RN_INFO", "CPU features: fp16=%d dotprod=%d i8mm=%d sve=%d",
+                        features.fp16, features.dotprod, features.i8mm, features.sve);
+    auto names = mls::MnnLibraryVariants(features);
+    jclass string_class = env->FindClass("java/lang/String");
+    auto count = static_cast<jsize>(names.size());
+    jobjectArray result = env->NewObjectArray(count, string_class, nullptr);
+    for (jsize i = 0; i < count; i++) {
+        jstring name = env->NewStringUTF(names[i]);
+        env->SetObjectArrayElement(result, i, name);
+        env->DeleteLocalRef(name);
+    }
+    env->DeleteLocalRef(string_class);
+    return result;
+}
+
+} // extern "C"
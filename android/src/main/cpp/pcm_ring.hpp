@@ -0,0 +1,86 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+
+namespace mls {
+
+/**
+ * Single-producer / single-consumer ring of PCM samples over memory owned by the platform
+ * (a direct ByteBuffer on Android), so audio is written in place and read without a copy
+ * into a fresh array. Positions are running sample counts; a sample lives at
+ * position % capacity. The producer waits for the consumer when the ring is full rather
+ * than dropping audio, since synthesis runs faster than playback.
+ */
+class PcmRing {
+public:
+    PcmRing(float* samples, size_t capacity) : samples_(samples), capacity_(capacity) {}
+
+    size_t capacity() const { return capacity_; }
+
+    /**
+     * Copy count samples in, waiting for free space as needed. Returns the samples written,
+     * fewer than count only if the ring was closed.
+     */
+    size_t write(const float* data, size_t count) {
+        size_t written = 0;
+        while (written < count && !closed_.load(std::memory_order_acquire)) {
+            uint64_t write_pos = write_pos_.load(std::memory_order_relaxed);
+            size_t space = capacity_ - static_cast<size_t>(write_pos - read_pos_.load(std::memory_order_acquire));
+            if (space == 0) {
+                std::unique_lock<std::mutex> lock(wait_mutex_);
+                space_cv_.wait(lock, [this, write_pos]() {
+                    return closed_.load(std::memory_order_acquire) ||
+                           write_pos - read_pos_.load(std::memory_order_acquire) < capacity_;
+                });
+                continue;
+            }
+            size_t chunk = std::min(space, count - written);
+            size_t offset = static_cast<size_t>(write_pos % capacity_);
+            size_t first = std::min(chunk, capacity_ - offset);
+            memcpy(samples_ + offset, data + written, first * sizeof(float));
+            memcpy(samples_, data + written + first, (chunk - first) * sizeof(float));
+            write_pos_.store(write_pos + chunk, std::memory_order_release);
+            written += chunk;
+        }
+        return written;
+    }
+
+    uint64_t writePosition() const { return write_pos_.load(std::memory_order_acquire); }
+
+    // Called by the consumer once it has used every sample before position
+    void setReadPosition(uint64_t position) {
+        {
+            std::lock_guard<std::mutex> lock(wait_mutex_);
+            read_pos_.store(position, std::memory_order_release);
+        }
+        space_cv_.notify_one();
+    }
+
+    // The consumer is gone: wake a waiting producer and drop everything written from now on
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(wait_mutex_);
+            closed_.store(true, std::memory_order_release);
+        }
+        space_cv_.notify_one();
+    }
+
+private:
+    float* samples_;
+    size_t capacity_;
+    std::atomic<uint64_t> write_pos_{0};
+    std::atomic<uint64_t> read_pos_{0};
+    std::atomic<bool> closed_{false};
+    std::mutex wait_mutex_;
+    std::condition_variable space_cv_;
+};
+
+} // namespace mls
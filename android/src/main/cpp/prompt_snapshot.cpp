@@ -0,0 +1,107 @@
+#include "prompt_snapshot.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <sys/stat.h>
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+constexpr uint32_t kSnapshotMagic = 0x504E534D; // "MSNP"
+constexpr uint32_t kSnapshotVersion = 1;
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+};
+
+} // namespace
+
+PromptSnapshotStore::PromptSnapshotStore(std::string root_dir) {
+    if (root_dir.empty()) {
+        return;
+    }
+    dir_ = root_dir + "/prompt_snapshots";
+    if (mkdir(dir_.c_str(), 0700) != 0 && errno != EEXIST) {
+        MNN_ERROR("PromptSnapshotStore: cannot create %s", dir_.c_str());
+        dir_.clear();
+    }
+}
+
+std::string PromptSnapshotStore::MakeKey(const std::string& model_path, const std::string& prompt) {
+    uint64_t hash = 1469598103934665603ULL;
+    auto mix = [&hash](const std::string& str) {
+        for (unsigned char c : str) {
+            hash ^= c;
+            hash *= 1099511628211ULL;
+        }
+    };
+    mix(model_path);
+    mix(std::string(1, '\0'));
+    mix(prompt);
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(hash));
+    return buffer;
+}
+
+std::string PromptSnapshotStore::PathFor(const std::string& key) const {
+    return dir_ + "/" + key + ".snap";
+}
+
+bool PromptSnapshotStore::Load(const std::string& key, std::vector<int>& token_ids) const {
+    if (!enabled()) {
+        return false;
+    }
+    FILE* file = fopen(PathFor(key).c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    SnapshotHeader header{};
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 &&
+              header.magic == kSnapshotMagic && header.version == kSnapshotVersion && header.count > 0;
+    if (ok) {
+        token_ids.resize(header.count);
+        ok = fread(token_ids.data(), sizeof(int), header.count, file) == header.count;
+    }
+    fclose(file);
+    if (!ok) {
+        MNN_WARN("PromptSnapshotStore: discarding invalid snapshot %s", key.c_str());
+        token_ids.clear();
+        Remove(key);
+    }
+    return ok;
+}
+
+bool PromptSnapshotStore::Save(const std::string& key, const std::vector<int>& token_ids) const {
+    if (!enabled() || token_ids.empty()) {
+        return false;
+    }
+    // Write to a temporary file and rename so a concurrent reader never sees a partial snapshot
+    std::string path = PathFor(key);
+    std::string tmp_path = path + ".tmp";
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr) {
+        MNN_ERROR("PromptSnapshotStore: cannot write %s", tmp_path.c_str());
+        return false;
+    }
+    SnapshotHeader header{kSnapshotMagic, kSnapshotVersion, static_cast<uint32_t>(token_ids.size()), 0};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(token_ids.data(), sizeof(int), token_ids.size(), file) == token_ids.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void PromptSnapshotStore::Remove(const std::string& key) const {
+    if (enabled()) {
+        remove(PathFor(key).c_str());
+    }
+}
+
+} // namespace mls
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mls {
+
+/**
+ * On-disk store of prefilled prompt snapshots, keyed by model and prompt hash.
+ * A snapshot currently holds the templated token ids of the prompt, which lets a new
+ * session prefill its system prompt during Load without re-templating and re-tokenizing.
+ */
+class PromptSnapshotStore {
+public:
+    explicit PromptSnapshotStore(std::string root_dir);
+
+    /**
+     * Stable 64-bit FNV-1a hash of model path and prompt, as a hex string
+     */
+    static std::string MakeKey(const std::string& model_path, const std::string& prompt);
+
+    bool Load(const std::string& key, std::vector<int>& token_ids) const;
+    bool Save(const std::string& key, const std::vector<int>& token_ids) const;
+    void Remove(const std::string& key) const;
+
+    bool enabled() const { return !dir_.empty(); }
+
+private:
+    std::string PathFor(const std::string& key) const;
+
+    std::string dir_;
+};
+
+} // namespace mls
@@ -0,0 +1,122 @@
+//
+// Created for MNN React Native bindings
+//
+#include "prompt_token_cache.hpp"
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+// Shorter contents are left inside the next piece: they are cheap to tokenize and could match
+// inside the template text itself
+constexpr size_t kMinSplitContent = 8;
+
+// Multimodal tags are expanded by tokenizer_encode, which also encodes the referenced media
+bool HasMediaTags(const std::string& prompt) {
+    return prompt.find("<img>") != std::string::npos || prompt.find("<audio>") != std::string::npos;
+}
+
+} // namespace
+
+uint64_t PromptTokenCache::Hash(std::string_view text) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash ^ text.size();
+}
+
+bool PromptTokenCache::Split(const std::string& prompt, const std::vector<PromptItem>& history,
+                             std::vector<size_t>* ends) {
+    size_t cursor = 0;
+    for (const auto& item : history) {
+        if (item.second.size() < kMinSplitContent) {
+            continue;
+        }
+        auto pos = prompt.find(item.second, cursor);
+        if (pos == std::string::npos) {
+            // The template rewrote the content
+            return false;
+        }
+        cursor = pos + item.second.size();
+        if (cursor < prompt.size()) {
+            ends->push_back(cursor);
+        }
+    }
+    ends->push_back(prompt.size());
+    return ends->size() > 1;
+}
+
+const std::vector<int>& PromptTokenCache::Tokens(MNN::Transformer::Llm* llm, std::string_view text) {
+    auto key = Hash(text);
+    auto it = segments_.find(key);
+    if (it == segments_.end()) {
+        it = segments_.emplace(key, Segment{llm->tokenizer_encode(std::string(text)), generation_}).first;
+    }
+    it->second.last_used = generation_;
+    return it->second.tokens;
+}
+
+std::vector<int> PromptTokenCache::Encode(MNN::Transformer::Llm* llm, const std::vector<PromptItem>& history,
+                                          const ImageMap& images) {
+    auto prompt = llm->apply_chat_template(history);
+    multimodal_ = HasMediaTags(prompt);
+    if (multimodal_ && !images.empty()) {
+        MNN::Transformer::MultimodalPrompt input;
+        input.prompt_template = prompt;
+        input.images = images;
+        return llm->tokenizer_encode(input);
+    }
+    std::vector<size_t> ends;
+    if (inexact_ || multimodal_ || !Split(prompt, history, &ends)) {
+        return llm->tokenizer_encode(prompt);
+    }
+    generation_++;
+    std::vector<int> ids;
+    size_t begin = 0;
+    for (size_t end : ends) {
+        const auto& tokens = Tokens(llm, std::string_view(prompt).substr(begin, end - begin));
+        ids.insert(ids.end(), tokens.begin(), tokens.end());
+        begin = end;
+    }
+    bool validate = encodes_ < kInitialValidations || encodes_ % kRevalidateInterval == 0;
+    encodes_++;
+    if (validate) {
+        auto whole = llm->tokenizer_encode(prompt);
+        if (whole != ids) {
+            MNN_WARN("PromptTokenCache: tokenizer does not split at message boundaries (%zu vs %zu tokens), "
+                     "tokenizing prompts whole", ids.size(), whole.size());
+            inexact_ = true;
+            segments_.clear();
+            return whole;
+        }
+    }
+    if (segments_.size() > 2 * ends.size() + 64) {
+        Prune();
+    }
+    return ids;
+}
+
+void PromptTokenCache::Prune() {
+    for (auto it = segments_.begin(); it != segments_.end();) {
+        it = it->second.last_used == generation_ ? std::next(it) : segments_.erase(it);
+    }
+}
+
+size_t PromptTokenCache::bytes() const {
+    size_t total = 0;
+    for (const auto& entry : segments_) {
+        total += sizeof(entry) + entry.second.tokens.capacity() * sizeof(int);
+    }
+    return total;
+}
+
+void PromptTokenCache::clear() {
+    segments_.clear();
+    encodes_ = 0;
+    inexact_ = false;
+}
+
+} // namespace mls
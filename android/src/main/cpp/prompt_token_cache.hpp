@@ -0,0 +1,64 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "llm/llm.hpp"
+#include "image_input.hpp"
+
+namespace mls {
+
+using PromptItem = std::pair<std::string, std::string>;
+
+/**
+ * Token ids of templated conversations, tokenized one message at a time. The templated prompt
+ * is cut after each message's content, where templates place an end-of-turn special token, and
+ * each piece is cached by a hash of its text. A new turn then only tokenizes the pieces it added.
+ *
+ * The cut is only exact when the tokenizer splits at those boundaries, so the first prompts and
+ * then every kRevalidateInterval-th are also tokenized whole and compared; on a mismatch the
+ * cache turns itself off and prompts are tokenized whole.
+ */
+class PromptTokenCache {
+public:
+    static constexpr int kInitialValidations = 4;
+    static constexpr int kRevalidateInterval = 64;
+
+    // images are the in-memory images <img> tags in history may name instead of a file
+    std::vector<int> Encode(MNN::Transformer::Llm* llm, const std::vector<PromptItem>& history,
+                            const ImageMap& images = {});
+    void clear();
+
+    bool exact() const { return !inexact_; }
+    // Whether the last prompt referenced images or audio, whose tokens come with media embeddings
+    bool multimodal() const { return multimodal_; }
+    size_t size() const { return segments_.size(); }
+    // Memory held by the cached token ids
+    size_t bytes() const;
+
+private:
+    struct Segment {
+        std::vector<int> tokens;
+        uint64_t last_used;
+    };
+
+    // Ends of the pieces of prompt, the last one at prompt.size(); false if it can't be cut
+    static bool Split(const std::string& prompt, const std::vector<PromptItem>& history, std::vector<size_t>* ends);
+    static uint64_t Hash(std::string_view text);
+    const std::vector<int>& Tokens(MNN::Transformer::Llm* llm, std::string_view text);
+    void Prune();
+
+    std::unordered_map<uint64_t, Segment> segments_;
+    uint64_t generation_ = 0;
+    int encodes_ = 0;
+    bool inexact_ = false;
+    bool multimodal_ = false;
+};
+
+} // namespace mls
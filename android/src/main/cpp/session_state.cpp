@@ -0,0 +1,305 @@
+//
+// Created for MNN React Native bindings
+//
+#include "session_state.hpp"
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+constexpr uint32_t kStateMagic = 0x5453534D; // "MSST"
+constexpr uint32_t kStateVersion = 1;
+
+struct StateHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t model_key;
+    int64_t image_counter;
+    uint32_t token_count;
+    uint32_t message_count;
+    uint32_t image_count;
+    uint32_t reserved;
+    uint64_t strings_offset;
+    uint64_t images_offset;
+    uint64_t file_size;
+};
+static_assert(sizeof(StateHeader) == 64, "token ids start right after the header");
+
+// Reads length-prefixed fields from the mapping, failing instead of reading past its end
+class Cursor {
+public:
+    Cursor(const uint8_t* data, size_t size, size_t offset) : data_(data), size_(size), offset_(offset) {}
+
+    bool read(void* out, size_t bytes) {
+        if (offset_ > size_ || bytes > size_ - offset_) {
+            return false;
+        }
+        memcpy(out, data_ + offset_, bytes);
+        offset_ += bytes;
+        return true;
+    }
+
+    bool readString(std::string* out) {
+        uint32_t length = 0;
+        if (!read(&length, sizeof(length)) || offset_ > size_ || length > size_ - offset_) {
+            return false;
+        }
+        out->assign(reinterpret_cast<const char*>(data_ + offset_), length);
+        offset_ += length;
+        return true;
+    }
+
+    const uint8_t* take(size_t bytes) {
+        if (offset_ > size_ || bytes > size_ - offset_) {
+            return nullptr;
+        }
+        const uint8_t* start = data_ + offset_;
+        offset_ += bytes;
+        return start;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t size_;
+    size_t offset_;
+};
+
+bool WriteString(FILE* file, const std::string& value) {
+    auto length = static_cast<uint32_t>(value.size());
+    return fwrite(&length, sizeof(length), 1, file) == 1 &&
+           (length == 0 || fwrite(value.data(), 1, length, file) == length);
+}
+
+// The pixels of an image as ConvertRgbaImage and MNN::CV::imread produce them, or nullptr
+const uint8_t* ImagePixels(const MNN::Transformer::PromptImagePart& image, int dims[3]) {
+    auto data = image.image_data;
+    if (data.get() == nullptr) {
+        return nullptr;
+    }
+    auto* info = data->getInfo();
+    if (info == nullptr || info->dim.size() != 3 || info->type != halide_type_of<uint8_t>()) {
+        return nullptr;
+    }
+    for (int i = 0; i < 3; i++) {
+        dims[i] = info->dim[i];
+    }
+    return data->readMap<uint8_t>();
+}
+
+} // namespace
+
+MappedSessionState::~MappedSessionState() {
+    if (base_ != nullptr) {
+        munmap(base_, size_);
+    }
+}
+
+SessionStateStore::SessionStateStore(std::string root_dir) {
+    if (root_dir.empty()) {
+        return;
+    }
+    dir_ = root_dir + "/session_states";
+    if (mkdir(dir_.c_str(), 0700) != 0 && errno != EEXIST) {
+        MNN_ERROR("SessionStateStore: cannot create %s", dir_.c_str());
+        dir_.clear();
+    }
+}
+
+uint64_t SessionStateStore::ModelKey(const std::string& model_path) {
+    uint64_t hash = 1469598103934665603ULL;
+    for (unsigned char c : model_path) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool SessionStateStore::ValidName(const std::string& name) {
+    if (name.empty() || name.size() > 128 || name[0] == '.') {
+        return false;
+    }
+    for (unsigned char c : name) {
+        if (!isalnum(c) && c != '-' && c != '_' && c != '.') {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string SessionStateStore::PathFor(const std::string& name) const {
+    return dir_ + "/" + name + ".state";
+}
+
+bool SessionStateStore::Save(const std::string& name, const SessionStateData& data, std::string* error) const {
+    if (!enabled()) {
+        *error = "saving session state needs mmap_dir";
+        return false;
+    }
+    if (!ValidName(name)) {
+        *error = "invalid state name: " + name;
+        return false;
+    }
+    std::vector<std::pair<const std::string*, const MNN::Transformer::PromptImagePart*>> images;
+    for (const auto& [image_name, image] : data.images) {
+        int dims[3];
+        if (ImagePixels(image, dims) == nullptr) {
+            MNN_WARN("SessionStateStore: image %s has no pixels to save, skipping it", image_name.c_str());
+            continue;
+        }
+        images.emplace_back(&image_name, &image);
+    }
+    // Write to a temporary file and rename so a restore never reads a partial state
+    std::string path = PathFor(name);
+    std::string tmp_path = path + ".tmp";
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr) {
+        *error = "cannot write " + tmp_path;
+        return false;
+    }
+    StateHeader header{};
+    header.magic = kStateMagic;
+    header.version = kStateVersion;
+    header.model_key = data.model_key;
+    header.image_counter = data.image_counter;
+    header.token_count = static_cast<uint32_t>(data.tokens.size());
+    header.message_count = static_cast<uint32_t>(data.messages.size());
+    header.image_count = static_cast<uint32_t>(images.size());
+    // Patched with the offsets once the sections are written
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              (data.tokens.empty() ||
+               fwrite(data.tokens.data(), sizeof(int), data.tokens.size(), file) == data.tokens.size());
+    header.strings_offset = sizeof(header) + data.tokens.size() * sizeof(int);
+    ok = ok && WriteString(file, data.system_prompt) && WriteString(file, data.summary);
+    for (const auto& [role, content] : data.messages) {
+        ok = ok && WriteString(file, role) && WriteString(file, content);
+    }
+    long images_offset = ftell(file);
+    ok = ok && images_offset >= 0;
+    header.images_offset = static_cast<uint64_t>(images_offset);
+    for (const auto& [image_name, image] : images) {
+        int dims[3];
+        const uint8_t* pixels = ImagePixels(*image, dims);
+        int32_t fields[5] = {image->width, image->height, dims[0], dims[1], dims[2]};
+        size_t bytes = static_cast<size_t>(dims[0]) * dims[1] * dims[2];
+        ok = ok && WriteString(file, *image_name) && fwrite(fields, sizeof(fields), 1, file) == 1 &&
+             fwrite(pixels, 1, bytes, file) == bytes;
+    }
+    long file_size = ftell(file);
+    ok = ok && file_size >= 0;
+    header.file_size = static_cast<uint64_t>(file_size);
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        *error = "cannot write " + path;
+        return false;
+    }
+    MNN_DEBUG("SessionStateStore: saved %s, %zu messages, %zu tokens, %zu images, %lld bytes", name.c_str(),
+              data.messages.size(), data.tokens.size(), images.size(), static_cast<long long>(file_size));
+    return true;
+}
+
+std::unique_ptr<MappedSessionState> SessionStateStore::Load(const std::string& name, std::string* error) const {
+    if (!enabled()) {
+        *error = "restoring session state needs mmap_dir";
+        return nullptr;
+    }
+    if (!ValidName(name)) {
+        *error = "invalid state name: " + name;
+        return nullptr;
+    }
+    std::string path = PathFor(name);
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        *error = "no saved state " + name;
+        return nullptr;
+    }
+    struct stat st{};
+    void* base = MAP_FAILED;
+    bool too_short = false;
+    if (fstat(fd, &st) == 0) {
+        too_short = static_cast<size_t>(st.st_size) < sizeof(StateHeader);
+        if (!too_short) {
+            base = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+    }
+    // The mapping stays valid without the descriptor
+    close(fd);
+    if (too_short) {
+        MNN_WARN("SessionStateStore: discarding truncated state %s", name.c_str());
+        Remove(name);
+        *error = "saved state " + name + " is invalid";
+        return nullptr;
+    }
+    if (base == MAP_FAILED) {
+        *error = "cannot map " + path;
+        return nullptr;
+    }
+    std::unique_ptr<MappedSessionState> state(new MappedSessionState());
+    state->base_ = base;
+    state->size_ = static_cast<size_t>(st.st_size);
+    const auto* bytes = static_cast<const uint8_t*>(base);
+    StateHeader header{};
+    memcpy(&header, bytes, sizeof(header));
+    auto& data = state->data_;
+    bool ok = header.magic == kStateMagic && header.version == kStateVersion && header.file_size == state->size_ &&
+              header.strings_offset == sizeof(header) + static_cast<uint64_t>(header.token_count) * sizeof(int) &&
+              header.strings_offset <= header.images_offset && header.images_offset <= header.file_size;
+    // An invalid header leaves nothing to read
+    Cursor strings(bytes, static_cast<size_t>(ok ? header.images_offset : 0), static_cast<size_t>(header.strings_offset));
+    ok = ok && strings.readString(&data.system_prompt) && strings.readString(&data.summary);
+    for (uint32_t i = 0; ok && i < header.message_count; i++) {
+        PromptItem message;
+        ok = strings.readString(&message.first) && strings.readString(&message.second);
+        data.messages.push_back(std::move(message));
+    }
+    Cursor images(bytes, state->size_, static_cast<size_t>(header.images_offset));
+    for (uint32_t i = 0; ok && i < header.image_count; i++) {
+        std::string image_name;
+        int32_t fields[5];
+        ok = images.readString(&image_name) && images.read(fields, sizeof(fields)) && fields[2] > 0 &&
+             fields[3] > 0 && fields[4] > 0;
+        const uint8_t* pixels =
+                ok ? images.take(static_cast<size_t>(fields[2]) * fields[3] * fields[4]) : nullptr;
+        ok = pixels != nullptr;
+        if (ok) {
+            MNN::Transformer::PromptImagePart image;
+            image.image_data = MNN::Express::_Input({fields[2], fields[3], fields[4]}, MNN::Express::NHWC,
+                                                    halide_type_of<uint8_t>());
+            memcpy(image.image_data->writeMap<uint8_t>(), pixels, static_cast<size_t>(fields[2]) * fields[3] * fields[4]);
+            image.width = fields[0];
+            image.height = fields[1];
+            data.images[image_name] = std::move(image);
+        }
+    }
+    if (!ok) {
+        MNN_WARN("SessionStateStore: discarding invalid state %s", name.c_str());
+        Remove(name);
+        *error = "saved state " + name + " is invalid";
+        return nullptr;
+    }
+    data.model_key = header.model_key;
+    data.image_counter = header.image_counter;
+    state->tokens_ = reinterpret_cast<const int*>(bytes + sizeof(header));
+    state->token_count_ = header.token_count;
+    MNN_DEBUG("SessionStateStore: mapped %s, %zu messages, %u tokens, %zu images", name.c_str(),
+              data.messages.size(), header.token_count, data.images.size());
+    return state;
+}
+
+void SessionStateStore::Remove(const std::string& name) const {
+    if (enabled() && ValidName(name)) {
+        remove(PathFor(name).c_str());
+    }
+}
+
+} // namespace mls
@@ -0,0 +1,84 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "image_input.hpp"
+
+namespace mls {
+
+using PromptItem = std::pair<std::string, std::string>;
+
+// What a session keeps of a conversation across processes
+struct SessionStateData {
+    // Identifies the model the token ids were produced by
+    uint64_t model_key = 0;
+    std::string system_prompt;
+    std::string summary;
+    // Turns after the system entry
+    std::vector<PromptItem> messages;
+    ImageMap images;
+    int64_t image_counter = 0;
+    // The templated conversation as token ids, empty when it could not be tokenized on its own
+    std::vector<int> tokens;
+};
+
+/**
+ * A state file mapped read-only. The messages and images are copied out when it is opened;
+ * the token ids are read from the mapping, so their pages are faulted in only once they are
+ * prefilled.
+ */
+class MappedSessionState {
+public:
+    ~MappedSessionState();
+    MappedSessionState(const MappedSessionState&) = delete;
+    MappedSessionState& operator=(const MappedSessionState&) = delete;
+
+    SessionStateData& data() { return data_; }
+    const int* tokens() const { return tokens_; }
+    size_t tokenCount() const { return token_count_; }
+
+private:
+    friend class SessionStateStore;
+    MappedSessionState() = default;
+
+    SessionStateData data_;
+    void* base_ = nullptr;
+    size_t size_ = 0;
+    const int* tokens_ = nullptr;
+    size_t token_count_ = 0;
+};
+
+/**
+ * Saved session states under mmap_dir, one file per name in session_states/. A file is a
+ * fixed header, the token ids at a 64-byte offset so they can be used in place, then the
+ * length-prefixed strings and the images as BGR pixels.
+ */
+class SessionStateStore {
+public:
+    explicit SessionStateStore(std::string root_dir);
+
+    // 64-bit FNV-1a hash of the model path
+    static uint64_t ModelKey(const std::string& model_path);
+    // Names are used as file names: letters, digits, '-', '_' and '.', not starting with '.'
+    static bool ValidName(const std::string& name);
+
+    bool Save(const std::string& name, const SessionStateData& data, std::string* error) const;
+    std::unique_ptr<MappedSessionState> Load(const std::string& name, std::string* error) const;
+    void Remove(const std::string& name) const;
+
+    bool enabled() const { return !dir_.empty(); }
+
+private:
+    std::string PathFor(const std::string& name) const;
+
+    std::string dir_;
+};
+
+} // namespace mls
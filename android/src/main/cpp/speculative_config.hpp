@@ -0,0 +1,60 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include "nlohmann/json.hpp"
+#include "mls_log.h"
+
+namespace mls {
+
+/**
+ * Session-level speculative decoding, from extra_config "speculative":
+ *   {"type": "lookahead" | "mtp", "draft_length": n, ...lookahead options}
+ * MNN picks the generation strategy at load, so this is applied to the model config there.
+ * Each decode step then verifies a draft of up to draft_length tokens and may emit several.
+ */
+struct SpeculativeConfig {
+    bool enabled = false;
+    std::string type;
+    int draft_length = 4;
+    nlohmann::json options = nlohmann::json::object();
+
+    static SpeculativeConfig Parse(const nlohmann::json& value) {
+        SpeculativeConfig config;
+        if (!value.is_object()) {
+            return config;
+        }
+        config.type = value.value("type", std::string());
+        if (config.type != "lookahead" && config.type != "mtp") {
+            // A separate draft model is not supported by the bundled MNN generation strategies
+            MNN_WARN("speculative: unsupported type '%s', decoding one token per step", config.type.c_str());
+            return config;
+        }
+        config.enabled = true;
+        config.draft_length = std::max(1, value.value("draft_length", config.draft_length));
+        // Lookahead n-gram tuning, passed through under MNN's own key names
+        for (const char* key : {"ngram_match_maxlen", "draft_match_strictness", "draft_selection_rule",
+                                "ngram_update", "lookup_file"}) {
+            if (value.contains(key)) {
+                config.options[key] = value[key];
+            }
+        }
+        return config;
+    }
+
+    void applyTo(nlohmann::json& model_config) const {
+        if (!enabled) {
+            return;
+        }
+        model_config["speculative_type"] = type;
+        model_config["draft_predict_length"] = draft_length;
+        for (const auto& [key, option] : options.items()) {
+            model_config[key] = option;
+        }
+    }
+};
+
+} // namespace mls
@@ -0,0 +1,151 @@
+//
+// Created for MNN React Native bindings
+//
+#include "stop_matcher.hpp"
+#include <algorithm>
+#include <queue>
+#include "mls_config.h"
+#include "mls_log.h"
+
+namespace mls {
+
+StopConfig StopConfig::Parse(const nlohmann::json& value) {
+    StopConfig config;
+    if (!value.is_object()) {
+        return config;
+    }
+    if (value.contains("sequences") && value["sequences"].is_array()) {
+        for (const auto& sequence : value["sequences"]) {
+            if (!sequence.is_string() || sequence.get<std::string>().empty()) {
+                continue;
+            }
+            if (config.sequences.size() == STOP_MAX_SEQUENCES ||
+                sequence.get<std::string>().size() > STOP_MAX_SEQUENCE_BYTES) {
+                MNN_WARN("stop: ignoring sequence beyond %zu sequences of %zu bytes", STOP_MAX_SEQUENCES,
+                         STOP_MAX_SEQUENCE_BYTES);
+                continue;
+            }
+            config.sequences.push_back(sequence.get<std::string>());
+        }
+    }
+    if (value.contains("token_ids") && value["token_ids"].is_array()) {
+        for (const auto& token : value["token_ids"]) {
+            if (token.is_number_integer()) {
+                config.token_ids.push_back(token.get<int>());
+            }
+        }
+    }
+    return config;
+}
+
+StopMatcher::StopMatcher() {
+    Build({});
+}
+
+void StopMatcher::setConfig(const StopConfig& config) {
+    Build(config.sequences);
+    stop_tokens_ = config.token_ids;
+    std::sort(stop_tokens_.begin(), stop_tokens_.end());
+    stop_tokens_.erase(std::unique(stop_tokens_.begin(), stop_tokens_.end()), stop_tokens_.end());
+    MNN_DEBUG("StopMatcher: %zu sequences in %zu states, %zu stop tokens", config.sequences.size(), depth_.size(),
+              stop_tokens_.size());
+}
+
+void StopMatcher::Build(const std::vector<std::string>& sequences) {
+    std::vector<std::string> patterns{END_OF_PROMPT};
+    patterns.insert(patterns.end(), sequences.begin(), sequences.end());
+    // Trie first, with -1 for a missing edge
+    std::vector<int> edges(kAlphabet, -1);
+    depth_.assign(1, 0);
+    match_.assign(1, 0);
+    for (const auto& pattern : patterns) {
+        int state = 0;
+        for (unsigned char byte : pattern) {
+            int& edge = edges[static_cast<size_t>(state) * kAlphabet + byte];
+            if (edge < 0) {
+                edge = static_cast<int>(depth_.size());
+                depth_.push_back(static_cast<uint16_t>(depth_[state] + 1));
+                match_.push_back(0);
+                edges.resize(edges.size() + kAlphabet, -1);
+            }
+            state = edge;
+        }
+        match_[state] = static_cast<uint16_t>(pattern.size());
+    }
+    // Breadth first, each missing edge takes the one of the state's failure link
+    size_t states = depth_.size();
+    next_.assign(states * kAlphabet, 0);
+    std::vector<uint16_t> fail(states, 0);
+    std::queue<int> queue;
+    for (int byte = 0; byte < kAlphabet; byte++) {
+        int child = edges[byte];
+        if (child > 0) {
+            next_[byte] = static_cast<uint16_t>(child);
+            queue.push(child);
+        }
+    }
+    while (!queue.empty()) {
+        int state = queue.front();
+        queue.pop();
+        // A sequence that ends inside a longer one, e.g. "<eop>" in "x<eop>", still matches
+        match_[state] = std::max(match_[state], match_[fail[state]]);
+        for (int byte = 0; byte < kAlphabet; byte++) {
+            size_t index = static_cast<size_t>(state) * kAlphabet + byte;
+            uint16_t fallback = next_[static_cast<size_t>(fail[state]) * kAlphabet + byte];
+            int child = edges[index];
+            if (child > 0) {
+                next_[index] = static_cast<uint16_t>(child);
+                fail[child] = fallback;
+                queue.push(child);
+            } else {
+                next_[index] = fallback;
+            }
+        }
+    }
+    Reset();
+}
+
+void StopMatcher::Reset() {
+    state_ = 0;
+    held_.clear();
+}
+
+std::string_view StopMatcher::Feed(std::string_view text, bool* matched) {
+    *matched = false;
+    uint16_t state = state_;
+    const uint16_t* next = next_.data();
+    for (size_t i = 0; i < text.size(); i++) {
+        state = next[static_cast<size_t>(state) * kAlphabet + static_cast<unsigned char>(text[i])];
+        if (match_[state] != 0) {
+            // The sequence started in the held bytes or in text; everything before it goes out
+            out_.assign(held_);
+            out_.append(text.data(), i + 1);
+            out_.resize(out_.size() - match_[state]);
+            Reset();
+            *matched = true;
+            return out_;
+        }
+    }
+    size_t keep = depth_[state];
+    state_ = state;
+    if (held_.empty() && keep == 0) {
+        return text;
+    }
+    out_.assign(held_);
+    out_.append(text.data(), text.size());
+    held_.assign(out_, out_.size() - keep, keep);
+    out_.resize(out_.size() - keep);
+    return out_;
+}
+
+std::string_view StopMatcher::Drain() {
+    out_.swap(held_);
+    Reset();
+    return out_;
+}
+
+bool StopMatcher::isStopToken(int token) const {
+    return std::binary_search(stop_tokens_.begin(), stop_tokens_.end(), token);
+}
+
+} // namespace mls
@@ -0,0 +1,71 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "nlohmann/json.hpp"
+
+namespace mls {
+
+/**
+ * Where a reply ends besides the model's own stop tokens, from extra_config "stop" or
+ * updateConfig {"stop": ...}: {"sequences": ["\nUser:", ...], "token_ids": [n, ...]}.
+ */
+struct StopConfig {
+    std::vector<std::string> sequences;
+    std::vector<int> token_ids;
+
+    static StopConfig Parse(const nlohmann::json& value);
+};
+
+/**
+ * Finds stop sequences in the reply as it streams. The sequences, END_OF_PROMPT among them, are
+ * compiled into an Aho-Corasick automaton with its failure links folded into a byte transition
+ * table, so each output byte costs one lookup however many sequences there are. Bytes that
+ * could be the start of a sequence are held back until the next piece rules it in or out, which
+ * lets a matched sequence be cut from the stream even when it spans tokens.
+ */
+class StopMatcher {
+public:
+    StopMatcher();
+
+    void setConfig(const StopConfig& config);
+
+    // Start of a reply
+    void Reset();
+
+    /**
+     * Feed the next piece of output.
+     * @param matched set when a stop sequence completed; it and anything after it are dropped
+     * @return the output that can be released, valid until the next call
+     */
+    std::string_view Feed(std::string_view text, bool* matched);
+    // Release the bytes held back at the end of a reply that ended without a match
+    std::string_view Drain();
+
+    // Stop token ids besides the ones Llm::is_stop already ends generation on
+    bool isStopToken(int token) const;
+    bool hasStopTokens() const { return !stop_tokens_.empty(); }
+
+private:
+    static constexpr int kAlphabet = 256;
+
+    void Build(const std::vector<std::string>& sequences);
+
+    // next_[state * kAlphabet + byte]
+    std::vector<uint16_t> next_;
+    // Bytes consumed to reach a state, all of which may still turn out to be a sequence
+    std::vector<uint16_t> depth_;
+    // Length of the longest sequence ending in a state, 0 if none does
+    std::vector<uint16_t> match_;
+    std::vector<int> stop_tokens_;
+    uint16_t state_ = 0;
+    std::string held_;
+    std::string out_;
+};
+
+} // namespace mls
@@ -0,0 +1,105 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace mls {
+
+/**
+ * When to hand coalesced output up to the platform layer.
+ * A threshold of 0 disables it; output is flushed as soon as any enabled threshold is reached.
+ */
+struct StreamFlushPolicy {
+    size_t max_bytes = 0;
+    int max_tokens = 1;
+    int max_ms = 0;
+};
+
+/**
+ * Coalesces decoded text between token boundaries so that one callback
+ * (and one JNI / bridge crossing) carries several characters or tokens.
+ */
+class StreamChunkBatcher {
+public:
+    using OnFlush = std::function<bool(const std::string& chunk, bool is_eop)>;
+
+    StreamChunkBatcher(const StreamFlushPolicy& policy, const OnFlush& on_flush)
+        : policy_(policy), on_flush_(on_flush), last_flush_(std::chrono::steady_clock::now()) {}
+
+    void append(std::string_view text) {
+        if (text.empty()) {
+            return;
+        }
+        pending_.append(text.data(), text.size());
+        if (policy_.max_bytes > 0 && pending_.size() >= policy_.max_bytes) {
+            flush();
+        }
+    }
+
+    /**
+     * Mark the end of count generated tokens and flush if the policy says so.
+     * @return true if the callback asked to stop
+     */
+    bool onToken(int count = 1) {
+        pending_tokens_ += count;
+        if (shouldFlush()) {
+            flush();
+        }
+        return stop_requested_;
+    }
+
+    /**
+     * Emit any pending text.
+     * @return true if the callback asked to stop
+     */
+    bool flush() {
+        if (!pending_.empty() && on_flush_) {
+            stop_requested_ = on_flush_(pending_, false) || stop_requested_;
+        }
+        pending_.clear();
+        pending_tokens_ = 0;
+        last_flush_ = std::chrono::steady_clock::now();
+        return stop_requested_;
+    }
+
+    /**
+     * Emit pending text followed by the end-of-prompt marker.
+     * @return true if the callback asked to stop
+     */
+    bool finish(std::string_view eop_marker) {
+        flush();
+        if (on_flush_) {
+            stop_requested_ = on_flush_(std::string(eop_marker), true) || stop_requested_;
+        }
+        return stop_requested_;
+    }
+
+private:
+    bool shouldFlush() const {
+        if (pending_.empty()) {
+            return false;
+        }
+        if (policy_.max_tokens > 0 && pending_tokens_ >= policy_.max_tokens) {
+            return true;
+        }
+        if (policy_.max_ms > 0) {
+            auto elapsed = std::chrono::steady_clock::now() - last_flush_;
+            return std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() >= policy_.max_ms;
+        }
+        return false;
+    }
+
+    StreamFlushPolicy policy_;
+    const OnFlush& on_flush_;
+    std::string pending_;
+    int pending_tokens_ = 0;
+    bool stop_requested_ = false;
+    std::chrono::steady_clock::time_point last_flush_;
+};
+
+} // namespace mls
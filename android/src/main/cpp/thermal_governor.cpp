@@ -0,0 +1,205 @@
+//
+// Created for MNN React Native bindings
+//
+#include "thermal_governor.hpp"
+#include <algorithm>
+#include <atomic>
+#if defined(__ANDROID__)
+#include <dlfcn.h>
+#endif
+#include "mls_config.h"
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+std::atomic<int> g_platform_status{static_cast<int>(ThermalStatus::NONE)};
+std::atomic<bool> g_power_save{false};
+
+// Weight of the newest step in the smoothed rates
+constexpr double kMeasuredSmoothing = 0.2;
+constexpr double kReferenceSmoothing = 0.05;
+// Readings below the current level needed before pacing is relaxed
+constexpr int kCoolerSamplesToRelax = 2;
+// A paced decode this far behind its schedule starts a new one instead of catching up in a burst
+constexpr auto kMaxPaceDebt = std::chrono::seconds(1);
+
+#if defined(__ANDROID__)
+// AThermal_* arrived in API 30; the manager is kept for the life of the process
+class AndroidThermal {
+public:
+    static AndroidThermal& Get() {
+        static AndroidThermal thermal;
+        return thermal;
+    }
+
+    bool available() const { return manager_ != nullptr; }
+    ThermalStatus status() const {
+        int status = get_current_status_(manager_);
+        return status < 0 ? ThermalStatus::NONE : static_cast<ThermalStatus>(std::min(status, 6));
+    }
+
+private:
+    using AcquireManager = void* (*)();
+    using GetCurrentStatus = int (*)(void*);
+
+    AndroidThermal() {
+        void* library = dlopen("libandroid.so", RTLD_NOW);
+        if (library == nullptr) {
+            return;
+        }
+        auto acquire = reinterpret_cast<AcquireManager>(dlsym(library, "AThermal_acquireManager"));
+        get_current_status_ = reinterpret_cast<GetCurrentStatus>(dlsym(library, "AThermal_getCurrentStatus"));
+        if (acquire != nullptr && get_current_status_ != nullptr) {
+            manager_ = acquire();
+        }
+        MNN_DEBUG("ThermalGovernor: AThermal %s", manager_ ? "available" : "unavailable, using platform reports");
+    }
+
+    void* manager_ = nullptr;
+    GetCurrentStatus get_current_status_ = nullptr;
+};
+#endif
+
+} // namespace
+
+ThermalStatus ReadThermalStatus() {
+#if defined(__ANDROID__)
+    auto& thermal = AndroidThermal::Get();
+    if (thermal.available()) {
+        return thermal.status();
+    }
+#endif
+    return static_cast<ThermalStatus>(g_platform_status.load(std::memory_order_relaxed));
+}
+
+void SetThermalStatus(ThermalStatus status) {
+    g_platform_status.store(static_cast<int>(status), std::memory_order_relaxed);
+}
+
+const char* ThermalStatusName(ThermalStatus status) {
+    switch (status) {
+        case ThermalStatus::LIGHT:
+            return "light";
+        case ThermalStatus::MODERATE:
+            return "moderate";
+        case ThermalStatus::SEVERE:
+            return "severe";
+        case ThermalStatus::CRITICAL:
+            return "critical";
+        case ThermalStatus::EMERGENCY:
+            return "emergency";
+        case ThermalStatus::SHUTDOWN:
+            return "shutdown";
+        default:
+            return "none";
+    }
+}
+
+void SetPowerSaveMode(bool enabled) {
+    g_power_save.store(enabled, std::memory_order_relaxed);
+}
+
+bool PowerSaveMode() {
+    return g_power_save.load(std::memory_order_relaxed);
+}
+
+const char* ThrottleLevelName(ThrottleLevel level) {
+    switch (level) {
+        case ThrottleLevel::SUSTAIN:
+            return "sustain";
+        case ThrottleLevel::COOL:
+            return "cool";
+        default:
+            return "none";
+    }
+}
+
+ThermalGovernorConfig ThermalGovernorConfig::Parse(const nlohmann::json& value) {
+    ThermalGovernorConfig config;
+    if (!value.is_object()) {
+        return config;
+    }
+    config.enabled = true;
+    config.sustained_tokens_per_s = std::max(0.0, value.value("sustained_tokens_per_s", 0.0));
+    return config;
+}
+
+void ThermalGovernor::Begin(Clock::time_point now) {
+    pace_origin_ = now;
+    paced_tokens_ = 0;
+    // Read on the first step: the device may have warmed up or cooled down between requests
+    last_sample_ = Clock::time_point{};
+}
+
+double ThermalGovernor::TargetFor(ThrottleLevel level) const {
+    if (level == ThrottleLevel::NONE) {
+        return 0;
+    }
+    double sustained = config_.sustained_tokens_per_s;
+    if (sustained <= 0) {
+        // Throttled from the start there is no cool reference yet; hold back from the current rate
+        double reference = reference_tokens_per_s_ > 0 ? reference_tokens_per_s_ : state_.measured_tokens_per_s;
+        sustained = reference * THERMAL_SUSTAIN_FRACTION;
+    }
+    return level == ThrottleLevel::COOL ? sustained * THERMAL_COOL_FRACTION : sustained;
+}
+
+void ThermalGovernor::Sample(Clock::time_point now, bool* changed) {
+    last_sample_ = now;
+    state_.status = ReadThermalStatus();
+    state_.power_save = PowerSaveMode();
+    ThrottleLevel level = state_.status >= ThermalStatus::SEVERE ? ThrottleLevel::COOL
+                          : state_.status >= ThermalStatus::LIGHT || state_.power_save ? ThrottleLevel::SUSTAIN
+                                                                                       : ThrottleLevel::NONE;
+    if (level >= state_.level) {
+        cooler_samples_ = 0;
+    } else if (++cooler_samples_ < kCoolerSamplesToRelax) {
+        level = state_.level;
+    }
+    if (level == state_.level) {
+        return;
+    }
+    cooler_samples_ = 0;
+    state_.level = level;
+    state_.target_tokens_per_s = TargetFor(level);
+    pace_origin_ = now;
+    paced_tokens_ = 0;
+    *changed = true;
+    MNN_INFO("ThermalGovernor: status %s%s, %s at %.1f tok/s (measured %.1f)", ThermalStatusName(state_.status),
+             state_.power_save ? " in battery saver" : "", ThrottleLevelName(level), state_.target_tokens_per_s,
+             state_.measured_tokens_per_s);
+}
+
+std::chrono::microseconds ThermalGovernor::OnStep(int tokens, int64_t step_us, Clock::time_point now, bool* changed) {
+    using std::chrono::microseconds;
+    if (step_us > 0) {
+        double rate = tokens * 1e6 / static_cast<double>(step_us);
+        state_.measured_tokens_per_s = state_.measured_tokens_per_s > 0
+                ? state_.measured_tokens_per_s + kMeasuredSmoothing * (rate - state_.measured_tokens_per_s)
+                : rate;
+        if (state_.level == ThrottleLevel::NONE) {
+            reference_tokens_per_s_ = reference_tokens_per_s_ > 0
+                    ? reference_tokens_per_s_ + kReferenceSmoothing * (rate - reference_tokens_per_s_)
+                    : rate;
+        }
+    }
+    if (now - last_sample_ >= std::chrono::milliseconds(THERMAL_SAMPLE_INTERVAL_MS)) {
+        Sample(now, changed);
+    }
+    double target = state_.target_tokens_per_s;
+    if (state_.level == ThrottleLevel::NONE || target <= 0) {
+        return microseconds(0);
+    }
+    paced_tokens_ += tokens;
+    auto due = pace_origin_ + microseconds(static_cast<int64_t>(paced_tokens_ * 1e6 / target));
+    if (due + kMaxPaceDebt < now) {
+        pace_origin_ = now;
+        paced_tokens_ = 0;
+        return microseconds(0);
+    }
+    return due > now ? std::chrono::duration_cast<microseconds>(due - now) : microseconds(0);
+}
+
+} // namespace mls
@@ -0,0 +1,112 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include "nlohmann/json.hpp"
+
+namespace mls {
+
+// AThermalStatus values; iOS thermal states are mapped onto them
+enum class ThermalStatus {
+    NONE = 0,
+    LIGHT = 1,
+    MODERATE = 2,
+    SEVERE = 3,
+    CRITICAL = 4,
+    EMERGENCY = 5,
+    SHUTDOWN = 6,
+};
+
+/**
+ * Device thermal status. On Android 11+ it is read from AThermal_getCurrentStatus, resolved at
+ * runtime since the library supports older releases; elsewhere it is what the platform layer
+ * last reported through SetThermalStatus, NONE until then.
+ */
+ThermalStatus ReadThermalStatus();
+void SetThermalStatus(ThermalStatus status);
+const char* ThermalStatusName(ThermalStatus status);
+
+// Battery saver / Low Power Mode, reported by the platform layer
+void SetPowerSaveMode(bool enabled);
+bool PowerSaveMode();
+
+/**
+ * How hard decode is being held back. SUSTAIN paces decode to a rate the device can hold
+ * (from LIGHT, or in battery saver), COOL to half of it (from SEVERE).
+ */
+enum class ThrottleLevel {
+    NONE = 0,
+    SUSTAIN = 1,
+    COOL = 2,
+};
+
+const char* ThrottleLevelName(ThrottleLevel level);
+
+/**
+ * From extra_config "thermal_governor": {"sustained_tokens_per_s": n}. Its presence turns the
+ * governor on; n = 0 (the default) derives the rate from the decode speed measured while cool.
+ */
+struct ThermalGovernorConfig {
+    bool enabled = false;
+    double sustained_tokens_per_s = 0;
+
+    static ThermalGovernorConfig Parse(const nlohmann::json& value);
+};
+
+// What the governor reports when its level changes
+struct ThermalState {
+    ThermalStatus status = ThermalStatus::NONE;
+    bool power_save = false;
+    ThrottleLevel level = ThrottleLevel::NONE;
+    // Decode rate being held, 0 when not throttling
+    double target_tokens_per_s = 0;
+    // Recent decode rate, excluding time spent paced
+    double measured_tokens_per_s = 0;
+};
+
+/**
+ * Paces decode so a long generation settles at a rate the device can sustain instead of running
+ * flat out into thermal throttling, where speed collapses. The thermal status is sampled at most
+ * every THERMAL_SAMPLE_INTERVAL_MS; each decode step then gets a wait that holds the level's
+ * target rate. The reference rate is learned while the device is cool, so it carries over
+ * between requests. MNN fixes its thread pool, precision and backend at load, so mid-generation
+ * pacing is the lever that does not cost a reload.
+ */
+class ThermalGovernor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void setConfig(const ThermalGovernorConfig& config) { config_ = config; }
+    bool enabled() const { return config_.enabled; }
+
+    // Start of a request's decode
+    void Begin(Clock::time_point now);
+    /**
+     * After a decode step that produced tokens in step_us of generate time.
+     * @param changed set when the throttle level changed with this step
+     * @return how long to wait before the next step
+     */
+    std::chrono::microseconds OnStep(int tokens, int64_t step_us, Clock::time_point now, bool* changed);
+
+    const ThermalState& state() const { return state_; }
+
+private:
+    void Sample(Clock::time_point now, bool* changed);
+    double TargetFor(ThrottleLevel level) const;
+
+    ThermalGovernorConfig config_;
+    ThermalState state_;
+    Clock::time_point last_sample_{};
+    // Samples in a row below the current level, so one reading does not lift pacing
+    int cooler_samples_ = 0;
+    // Decode rate while NONE, smoothed over steps and requests
+    double reference_tokens_per_s_ = 0;
+    // Pacing: tokens produced since origin, which is moved on level changes and when far behind
+    Clock::time_point pace_origin_{};
+    double paced_tokens_ = 0;
+};
+
+} // namespace mls
@@ -1,98 +1,130 @@
-#include "utf8_stream_processor.hpp"
-
-namespace mls {
-
-Utf8StreamProcessor::Utf8StreamProcessor(OnUtf8CharCallback callback)
-    : callback_(std::move(callback)) {
-}
-
-void Utf8StreamProcessor::processStream(const char* data, size_t len) {
-    if (!data || len == 0) {
-        return;
-    }
-    
-    // Append new data to buffer
-    buffer_.append(data, len);
-    
-    // Process complete UTF-8 characters
-    processCompleteCharacters();
-}
-
-bool Utf8StreamProcessor::isValidUtf8Start(unsigned char byte) {
-    // ASCII (0xxxxxxx) or UTF-8 start bytes
-    return (byte & 0x80) == 0x00 ||  // ASCII
-           (byte & 0xE0) == 0xC0 ||  // 110xxxxx (2-byte)
-           (byte & 0xF0) == 0xE0 ||  // 1110xxxx (3-byte)
-           (byte & 0xF8) == 0xF0;    // 11110xxx (4-byte)
-}
-
-int Utf8StreamProcessor::getUtf8CharLength(unsigned char byte) {
-    if ((byte & 0x80) == 0x00) return 1;  // ASCII
-    if ((byte & 0xE0) == 0xC0) return 2;  // 2-byte
-    if ((byte & 0xF0) == 0xE0) return 3;  // 3-byte
-    if ((byte & 0xF8) == 0xF0) return 4;  // 4-byte
-    return -1; // Invalid
-}
-
-bool Utf8StreamProcessor::isUtf8Continuation(unsigned char byte) {
-    return (byte & 0xC0) == 0x80; // 10xxxxxx
-}
-
-void Utf8StreamProcessor::processCompleteCharacters() {
-    size_t pos = 0;
-    
-    while (pos < buffer_.size()) {
-        unsigned char firstByte = static_cast<unsigned char>(buffer_[pos]);
-        
-        if (!isValidUtf8Start(firstByte)) {
-            // Skip invalid byte
-            pos++;
-            continue;
-        }
-        
-        int charLen = getUtf8CharLength(firstByte);
-        if (charLen == -1) {
-            // Invalid UTF-8 start byte
-            pos++;
-            continue;
-        }
-        
-        // Check if we have enough bytes for complete character
-        if (pos + charLen > buffer_.size()) {
-            // Incomplete character, wait for more data
-            break;
-        }
-        
-        // Validate continuation bytes
-        bool validChar = true;
-        for (int i = 1; i < charLen; i++) {
-            if (pos + i >= buffer_.size() || 
-                !isUtf8Continuation(static_cast<unsigned char>(buffer_[pos + i]))) {
-                validChar = false;
-                break;
-            }
-        }
-        
-        if (validChar) {
-            // Extract complete UTF-8 character
-            std::string utf8Char = buffer_.substr(pos, charLen);
-            
-            // Call callback with the character
-            if (callback_) {
-                callback_(utf8Char);
-            }
-            
-            pos += charLen;
-        } else {
-            // Skip invalid sequence
-            pos++;
-        }
-    }
-    
-    // Remove processed characters from buffer
-    if (pos > 0) {
-        buffer_.erase(0, pos);
-    }
-}
-
-} // namespace mls
\ No newline at end of file
+#include "utf8_stream_processor.hpp"
+#include <cstdint>
+#include <cstring>
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace mls {
+
+Utf8StreamProcessor::Utf8StreamProcessor(OnUtf8CharCallback callback)
+    : callback_(std::move(callback)) {
+}
+
+int Utf8StreamProcessor::getUtf8CharLength(unsigned char byte) {
+    if ((byte & 0x80) == 0x00) return 1;  // ASCII
+    if ((byte & 0xE0) == 0xC0) return 2;  // 2-byte
+    if ((byte & 0xF0) == 0xE0) return 3;  // 3-byte
+    if ((byte & 0xF8) == 0xF0) return 4;  // 4-byte
+    return -1; // Invalid
+}
+
+bool Utf8StreamProcessor::isUtf8Continuation(unsigned char byte) {
+    return (byte & 0xC0) == 0x80; // 10xxxxxx
+}
+
+size_t Utf8StreamProcessor::skipAscii(const char* data, size_t len) {
+    size_t pos = 0;
+#if defined(__ARM_NEON)
+    for (; pos + 16 <= len; pos += 16) {
+        uint8x16_t bytes = vld1q_u8(reinterpret_cast<const uint8_t*>(data + pos));
+        if (vmaxvq_u8(bytes) >= 0x80) {
+            break;
+        }
+    }
+#endif
+    for (; pos + 8 <= len; pos += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + pos, sizeof(word));
+        if (word & 0x8080808080808080ULL) {
+            break;
+        }
+    }
+    while (pos < len && (static_cast<unsigned char>(data[pos]) & 0x80) == 0) {
+        pos++;
+    }
+    return pos;
+}
+
+void Utf8StreamProcessor::emit(const char* data, size_t len) {
+    if (len > 0 && callback_) {
+        callback_(std::string_view(data, len));
+    }
+}
+
+size_t Utf8StreamProcessor::completePending(const char* data, size_t len) {
+    int charLen = getUtf8CharLength(static_cast<unsigned char>(pending_[0]));
+    size_t consumed = 0;
+    while (pending_len_ < static_cast<size_t>(charLen) && consumed < len) {
+        unsigned char byte = static_cast<unsigned char>(data[consumed]);
+        if (!isUtf8Continuation(byte)) {
+            // Truncated sequence: drop it and resume at this byte
+            pending_len_ = 0;
+            return consumed;
+        }
+        pending_[pending_len_++] = static_cast<char>(byte);
+        consumed++;
+    }
+    if (pending_len_ == static_cast<size_t>(charLen)) {
+        emit(pending_, pending_len_);
+        pending_len_ = 0;
+    }
+    return consumed;
+}
+
+void Utf8StreamProcessor::processStream(const char* data, size_t len) {
+    if (!data || len == 0) {
+        return;
+    }
+
+    size_t pos = 0;
+    if (pending_len_ > 0) {
+        pos = completePending(data, len);
+        if (pending_len_ > 0) {
+            // Still waiting for more continuation bytes
+            return;
+        }
+    }
+
+    // Emit maximal runs of complete characters straight from the caller's buffer
+    size_t run_start = pos;
+    while (pos < len) {
+        pos += skipAscii(data + pos, len - pos);
+        if (pos >= len) {
+            break;
+        }
+        int charLen = getUtf8CharLength(static_cast<unsigned char>(data[pos]));
+        if (charLen == -1) {
+            // Skip invalid byte
+            emit(data + run_start, pos - run_start);
+            run_start = ++pos;
+            continue;
+        }
+        size_t available = len - pos;
+        size_t check = available < static_cast<size_t>(charLen) ? available : static_cast<size_t>(charLen);
+        bool validChar = true;
+        for (size_t i = 1; i < check; i++) {
+            if (!isUtf8Continuation(static_cast<unsigned char>(data[pos + i]))) {
+                validChar = false;
+                break;
+            }
+        }
+        if (!validChar) {
+            // Skip invalid sequence
+            emit(data + run_start, pos - run_start);
+            run_start = ++pos;
+            continue;
+        }
+        if (available < static_cast<size_t>(charLen)) {
+            // Incomplete character, wait for more data
+            emit(data + run_start, pos - run_start);
+            std::memcpy(pending_, data + pos, available);
+            pending_len_ = available;
+            return;
+        }
+        pos += charLen;
+    }
+    emit(data + run_start, pos - run_start);
+}
+
+} // namespace mls
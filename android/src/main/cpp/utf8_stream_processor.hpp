@@ -1,34 +1,43 @@
-#pragma once
-
-#include <string>
-#include <functional>
-
-namespace mls {
-
-/**
- * UTF8 stream processor for handling streaming text generation
- */
-class Utf8StreamProcessor {
-public:
-    using OnUtf8CharCallback = std::function<void(const std::string& utf8Char)>;
-    
-    explicit Utf8StreamProcessor(OnUtf8CharCallback callback);
-    
-    /**
-     * Process a stream of bytes and extract UTF-8 characters
-     * @param data Raw byte data
-     * @param len Length of data
-     */
-    void processStream(const char* data, size_t len);
-    
-private:
-    OnUtf8CharCallback callback_;
-    std::string buffer_;
-    
-    bool isValidUtf8Start(unsigned char byte);
-    int getUtf8CharLength(unsigned char byte);
-    bool isUtf8Continuation(unsigned char byte);
-    void processCompleteCharacters();
-};
-
-} // namespace mls
\ No newline at end of file
+#pragma once
+
+#include <string_view>
+#include <functional>
+
+namespace mls {
+
+/**
+ * UTF8 stream processor for handling streaming text generation
+ */
+class Utf8StreamProcessor {
+public:
+    /**
+     * Receives the longest run of complete UTF-8 characters available.
+     * The view is only valid for the duration of the call.
+     */
+    using OnUtf8CharCallback = std::function<void(std::string_view utf8Chars)>;
+    
+    explicit Utf8StreamProcessor(OnUtf8CharCallback callback);
+    
+    /**
+     * Process a stream of bytes and extract UTF-8 characters
+     * @param data Raw byte data
+     * @param len Length of data
+     */
+    void processStream(const char* data, size_t len);
+    
+private:
+    static constexpr size_t kMaxCharLength = 4;
+
+    OnUtf8CharCallback callback_;
+    // Leading bytes of a character split across processStream calls
+    char pending_[kMaxCharLength]{};
+    size_t pending_len_ = 0;
+    
+    static int getUtf8CharLength(unsigned char byte);
+    static bool isUtf8Continuation(unsigned char byte);
+    static size_t skipAscii(const char* data, size_t len);
+    size_t completePending(const char* data, size_t len);
+    void emit(const char* data, size_t len);
+};
+
+} // namespace mls
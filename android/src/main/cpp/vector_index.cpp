@@ -0,0 +1,305 @@
+#include "vector_index.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fcntl.h>
+#include <queue>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+constexpr uint32_t kIndexMagic = 0x5849564D; // "MVIX"
+constexpr uint32_t kIndexVersion = 1;
+constexpr int kKmeansIterations = 8;
+// k-means trains on a strided sample so rebuilding a large index stays bounded
+constexpr size_t kMaxTrainingPoints = 16384;
+constexpr int kMaxLists = 1024;
+
+// Layout: header, list offsets (nlist + 1), ids, centroids, vectors; ids and vectors in list order
+struct IndexHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dim;
+    uint32_t nlist;
+    uint64_t count;
+    uint64_t reserved;
+};
+
+float Dot(const float* a, const float* b, int dim) {
+    float sum = 0.0f;
+    for (int i = 0; i < dim; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+void Normalize(float* v, int dim) {
+    float norm = std::sqrt(Dot(v, v, dim));
+    if (norm > 0.0f) {
+        for (int i = 0; i < dim; i++) {
+            v[i] /= norm;
+        }
+    }
+}
+
+int Nearest(const float* v, const std::vector<float>& centroids, int nlist, int dim) {
+    int best = 0;
+    float best_score = -2.0f;
+    for (int c = 0; c < nlist; c++) {
+        float score = Dot(v, centroids.data() + static_cast<size_t>(c) * dim, dim);
+        if (score > best_score) {
+            best_score = score;
+            best = c;
+        }
+    }
+    return best;
+}
+
+// Spherical k-means seeded from evenly spaced points, so a rebuild of the same data is deterministic
+std::vector<float> TrainCentroids(const std::vector<float>& vectors, size_t count, int nlist, int dim) {
+    std::vector<float> centroids(static_cast<size_t>(nlist) * dim);
+    for (int c = 0; c < nlist; c++) {
+        size_t row = count * c / nlist;
+        std::copy_n(vectors.data() + row * dim, dim, centroids.data() + static_cast<size_t>(c) * dim);
+    }
+    if (nlist == 1) {
+        return centroids;
+    }
+    size_t stride = std::max<size_t>(1, count / kMaxTrainingPoints);
+    std::vector<float> sums(centroids.size());
+    std::vector<int> members(nlist);
+    for (int iter = 0; iter < kKmeansIterations; iter++) {
+        std::fill(sums.begin(), sums.end(), 0.0f);
+        std::fill(members.begin(), members.end(), 0);
+        for (size_t row = 0; row < count; row += stride) {
+            const float* v = vectors.data() + row * dim;
+            int c = Nearest(v, centroids, nlist, dim);
+            float* sum = sums.data() + static_cast<size_t>(c) * dim;
+            for (int i = 0; i < dim; i++) {
+                sum[i] += v[i];
+            }
+            members[c]++;
+        }
+        for (int c = 0; c < nlist; c++) {
+            // An empty list keeps its previous centroid
+            if (members[c] == 0) {
+                continue;
+            }
+            float* centroid = centroids.data() + static_cast<size_t>(c) * dim;
+            std::copy_n(sums.data() + static_cast<size_t>(c) * dim, dim, centroid);
+            Normalize(centroid, dim);
+        }
+    }
+    return centroids;
+}
+
+} // namespace
+
+VectorIndex::~VectorIndex() {
+    Close();
+}
+
+bool VectorIndex::Build(const std::string& path, int dim, const std::vector<int64_t>& ids,
+                        std::vector<float> vectors, int nlist) {
+    size_t count = ids.size();
+    if (dim <= 0 || count == 0 || vectors.size() != count * dim) {
+        MNN_ERROR("VectorIndex: invalid build input (dim=%d, count=%zu, values=%zu)", dim, count, vectors.size());
+        return false;
+    }
+    for (size_t row = 0; row < count; row++) {
+        Normalize(vectors.data() + row * dim, dim);
+    }
+    if (nlist <= 0) {
+        nlist = static_cast<int>(std::sqrt(static_cast<double>(count)));
+    }
+    nlist = std::max(1, std::min({nlist, kMaxLists, static_cast<int>(count)}));
+
+    std::vector<float> centroids = TrainCentroids(vectors, count, nlist, dim);
+    std::vector<int> assignment(count);
+    std::vector<uint64_t> offsets(nlist + 1, 0);
+    for (size_t row = 0; row < count; row++) {
+        assignment[row] = Nearest(vectors.data() + row * dim, centroids, nlist, dim);
+        offsets[assignment[row] + 1]++;
+    }
+    for (int c = 0; c < nlist; c++) {
+        offsets[c + 1] += offsets[c];
+    }
+    std::vector<uint64_t> cursor(offsets.begin(), offsets.end() - 1);
+    std::vector<int64_t> sorted_ids(count);
+    std::vector<float> sorted_vectors(vectors.size());
+    for (size_t row = 0; row < count; row++) {
+        uint64_t slot = cursor[assignment[row]]++;
+        sorted_ids[slot] = ids[row];
+        std::copy_n(vectors.data() + row * dim, dim, sorted_vectors.data() + slot * dim);
+    }
+
+    // Write to a temporary file and rename so an open mapping never sees a partial index
+    std::string tmp_path = path + ".tmp";
+    FILE* file = fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr) {
+        MNN_ERROR("VectorIndex: cannot write %s", tmp_path.c_str());
+        return false;
+    }
+    IndexHeader header{kIndexMagic, kIndexVersion, static_cast<uint32_t>(dim), static_cast<uint32_t>(nlist),
+                       static_cast<uint64_t>(count), 0};
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(offsets.data(), sizeof(uint64_t), offsets.size(), file) == offsets.size() &&
+              fwrite(sorted_ids.data(), sizeof(int64_t), count, file) == count &&
+              fwrite(centroids.data(), sizeof(float), centroids.size(), file) == centroids.size() &&
+              fwrite(sorted_vectors.data(), sizeof(float), sorted_vectors.size(), file) == sorted_vectors.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        MNN_ERROR("VectorIndex: failed to write %s", path.c_str());
+        remove(tmp_path.c_str());
+        return false;
+    }
+    MNN_DEBUG("VectorIndex: wrote %zu vectors in %d lists to %s", count, nlist, path.c_str());
+    return true;
+}
+
+bool VectorIndex::Append(const std::string& path, int dim, const std::vector<int64_t>& ids,
+                         std::vector<float> vectors) {
+    VectorIndex existing;
+    struct stat st{};
+    if (stat(path.c_str(), &st) == 0 && existing.Open(path)) {
+        if (existing.dim() != dim) {
+            MNN_ERROR("VectorIndex: %s has dim %d, cannot add vectors of dim %d", path.c_str(), existing.dim(), dim);
+            return false;
+        }
+        std::vector<int64_t> old_ids;
+        std::vector<float> old_vectors;
+        existing.Export(old_ids, old_vectors);
+        existing.Close();
+        std::unordered_set<int64_t> replaced(ids.begin(), ids.end());
+        std::vector<int64_t> merged_ids;
+        std::vector<float> merged;
+        merged_ids.reserve(old_ids.size() + ids.size());
+        merged.reserve(old_vectors.size() + vectors.size());
+        for (size_t row = 0; row < old_ids.size(); row++) {
+            if (replaced.count(old_ids[row]) == 0) {
+                merged_ids.push_back(old_ids[row]);
+                merged.insert(merged.end(), old_vectors.begin() + row * dim, old_vectors.begin() + (row + 1) * dim);
+            }
+        }
+        merged_ids.insert(merged_ids.end(), ids.begin(), ids.end());
+        merged.insert(merged.end(), vectors.begin(), vectors.end());
+        return Build(path, dim, merged_ids, std::move(merged));
+    }
+    return Build(path, dim, ids, std::move(vectors));
+}
+
+bool VectorIndex::Open(const std::string& path) {
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(IndexHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if (base == MAP_FAILED) {
+        MNN_ERROR("VectorIndex: mmap failed for %s", path.c_str());
+        return false;
+    }
+    const auto* header = static_cast<const IndexHeader*>(base);
+    size_t expected = 0;
+    if (header->magic == kIndexMagic && header->version == kIndexVersion && header->dim > 0 && header->nlist > 0) {
+        expected = sizeof(IndexHeader) + sizeof(uint64_t) * (header->nlist + 1) + sizeof(int64_t) * header->count +
+                   sizeof(float) * static_cast<size_t>(header->dim) * (header->nlist + header->count);
+    }
+    if (expected == 0 || expected != size) {
+        MNN_WARN("VectorIndex: %s is not a valid index", path.c_str());
+        munmap(base, size);
+        return false;
+    }
+    base_ = base;
+    mapped_size_ = size;
+    dim_ = static_cast<int>(header->dim);
+    nlist_ = static_cast<int>(header->nlist);
+    count_ = static_cast<size_t>(header->count);
+    const char* cursor = static_cast<const char*>(base) + sizeof(IndexHeader);
+    offsets_ = reinterpret_cast<const uint64_t*>(cursor);
+    cursor += sizeof(uint64_t) * (nlist_ + 1);
+    ids_ = reinterpret_cast<const int64_t*>(cursor);
+    cursor += sizeof(int64_t) * count_;
+    centroids_ = reinterpret_cast<const float*>(cursor);
+    cursor += sizeof(float) * static_cast<size_t>(dim_) * nlist_;
+    vectors_ = reinterpret_cast<const float*>(cursor);
+    return true;
+}
+
+void VectorIndex::Close() {
+    if (base_ != nullptr) {
+        munmap(base_, mapped_size_);
+    }
+    base_ = nullptr;
+    mapped_size_ = 0;
+    dim_ = 0;
+    nlist_ = 0;
+    count_ = 0;
+    offsets_ = nullptr;
+    ids_ = nullptr;
+    centroids_ = nullptr;
+    vectors_ = nullptr;
+}
+
+std::vector<VectorHit> VectorIndex::Search(const float* query, int k, int nprobe) const {
+    std::vector<VectorHit> hits;
+    if (!isOpen() || k <= 0 || count_ == 0) {
+        return hits;
+    }
+    std::vector<float> q(query, query + dim_);
+    Normalize(q.data(), dim_);
+    if (nprobe <= 0) {
+        nprobe = std::max(1, nlist_ / 4);
+    }
+    nprobe = std::min(nprobe, nlist_);
+
+    std::vector<std::pair<float, int>> lists(nlist_);
+    for (int c = 0; c < nlist_; c++) {
+        lists[c] = {Dot(q.data(), centroids_ + static_cast<size_t>(c) * dim_, dim_), c};
+    }
+    std::partial_sort(lists.begin(), lists.begin() + nprobe, lists.end(),
+                      [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    // Min-heap of the best k so far
+    auto worse = [](const VectorHit& a, const VectorHit& b) { return a.score > b.score; };
+    std::priority_queue<VectorHit, std::vector<VectorHit>, decltype(worse)> best(worse);
+    for (int p = 0; p < nprobe; p++) {
+        int c = lists[p].second;
+        for (uint64_t row = offsets_[c]; row < offsets_[c + 1]; row++) {
+            float score = Dot(q.data(), vectors_ + row * dim_, dim_);
+            if (static_cast<int>(best.size()) < k) {
+                best.push({ids_[row], score});
+            } else if (score > best.top().score) {
+                best.pop();
+                best.push({ids_[row], score});
+            }
+        }
+    }
+    hits.resize(best.size());
+    for (size_t i = hits.size(); i-- > 0;) {
+        hits[i] = best.top();
+        best.pop();
+    }
+    return hits;
+}
+
+void VectorIndex::Export(std::vector<int64_t>& ids, std::vector<float>& vectors) const {
+    ids.assign(ids_, ids_ + count_);
+    vectors.assign(vectors_, vectors_ + count_ * dim_);
+}
+
+} // namespace mls
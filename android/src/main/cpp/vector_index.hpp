@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace mls {
+
+struct VectorHit {
+    int64_t id;
+    float score; // cosine similarity
+};
+
+/**
+ * IVF-flat index of L2-normalized vectors kept in a single file and searched through mmap,
+ * so the vectors never have to be resident on the Java or JS heap.
+ * Vectors are clustered into inverted lists around k-means centroids; a search scans only
+ * the nprobe lists whose centroids are closest to the query.
+ */
+class VectorIndex {
+public:
+    VectorIndex() = default;
+    ~VectorIndex();
+    VectorIndex(const VectorIndex&) = delete;
+    VectorIndex& operator=(const VectorIndex&) = delete;
+
+    /**
+     * Cluster the row-major vectors (ids.size() x dim) and write the index to path atomically.
+     * nlist 0 picks about sqrt(count) lists.
+     */
+    static bool Build(const std::string& path, int dim, const std::vector<int64_t>& ids,
+                      std::vector<float> vectors, int nlist = 0);
+
+    /**
+     * Add vectors to the index at path, creating it when missing. Entries whose id is added
+     * again are replaced. The lists are re-clustered over the combined set.
+     */
+    static bool Append(const std::string& path, int dim, const std::vector<int64_t>& ids,
+                       std::vector<float> vectors);
+
+    bool Open(const std::string& path);
+    void Close();
+    bool isOpen() const { return base_ != nullptr; }
+
+    // Top k entries by cosine similarity; nprobe 0 scans about a quarter of the lists
+    std::vector<VectorHit> Search(const float* query, int k, int nprobe = 0) const;
+
+    // Copy every entry out of the mapped file, in list order
+    void Export(std::vector<int64_t>& ids, std::vector<float>& vectors) const;
+
+    int dim() const { return dim_; }
+    size_t size() const { return count_; }
+    int nlist() const { return nlist_; }
+
+private:
+    void* base_ = nullptr;
+    size_t mapped_size_ = 0;
+    int dim_ = 0;
+    int nlist_ = 0;
+    size_t count_ = 0;
+    const uint64_t* offsets_ = nullptr;
+    const int64_t* ids_ = nullptr;
+    const float* centroids_ = nullptr;
+    const float* vectors_ = nullptr;
+};
+
+} // namespace mls
@@ -0,0 +1,117 @@
+//
+// Created for MNN React Native bindings
+//
+#include "weight_prefetcher.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "nlohmann/json.hpp"
+#include "mls_log.h"
+
+namespace mls {
+
+namespace {
+
+size_t FileSize(const std::string& path) {
+    struct stat st{};
+    return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) ? static_cast<size_t>(st.st_size) : 0;
+}
+
+} // namespace
+
+nlohmann::json WeightPrefetcher::ReadConfig(const std::string& config_path, std::string* dir) {
+    // Same layout rules as MNN's LlmConfig: names from config.json, relative to its directory
+    *dir = config_path;
+    std::string config_file = config_path + "/config.json";
+    struct stat st{};
+    if (stat(config_path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        auto slash = config_path.find_last_of('/');
+        *dir = slash == std::string::npos ? "." : config_path.substr(0, slash);
+        config_file = config_path;
+    }
+    nlohmann::json config = nlohmann::json::object();
+    std::ifstream in(config_file);
+    if (in) {
+        config = nlohmann::json::parse(in, nullptr, false);
+        if (!config.is_object()) {
+            config = nlohmann::json::object();
+        }
+    }
+    return config;
+}
+
+std::vector<std::string> WeightPrefetcher::ModelFiles(const std::string& config_path) {
+    std::string dir;
+    auto config = ReadConfig(config_path, &dir);
+    std::vector<std::string> files;
+    for (const auto& name : {config.value("llm_model", std::string("llm.mnn")),
+                             config.value("embedding_file", std::string("embeddings_bf16.bin")),
+                             config.value("llm_weight", std::string("llm.mnn.weight"))}) {
+        auto path = dir + "/" + name;
+        if (FileSize(path) > 0) {
+            files.push_back(path);
+        }
+    }
+    return files;
+}
+
+size_t WeightPrefetcher::TotalBytes(const std::vector<std::string>& files) {
+    size_t total = 0;
+    for (const auto& path : files) {
+        total += FileSize(path);
+    }
+    return total;
+}
+
+void WeightPrefetcher::Start(std::vector<std::string> files) {
+    Stop();
+    stop_ = false;
+    prefetched_bytes_ = 0;
+    if (files.empty()) {
+        return;
+    }
+    thread_ = std::thread([this, files = std::move(files)]() { Run(files); });
+}
+
+void WeightPrefetcher::Stop() {
+    stop_ = true;
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void WeightPrefetcher::Run(const std::vector<std::string>& files) {
+    for (const auto& path : files) {
+        if (stop_) {
+            break;
+        }
+        size_t size = FileSize(path);
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0 || size == 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            continue;
+        }
+        void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            MNN_WARN("WeightPrefetcher: cannot map %s", path.c_str());
+            continue;
+        }
+        auto* base = static_cast<char*>(map);
+        for (size_t offset = 0; offset < size && !stop_; offset += kWindowBytes) {
+            size_t length = std::min(kWindowBytes, size - offset);
+            madvise(base + offset, length, MADV_WILLNEED);
+            prefetched_bytes_ += length;
+        }
+        // The page cache keeps what was read ahead after the mapping is gone
+        munmap(map, size);
+        MNN_DEBUG("WeightPrefetcher: advised %s (%zu bytes)", path.c_str(), size);
+    }
+}
+
+} // namespace mls
@@ -0,0 +1,54 @@
+//
+// Created for MNN React Native bindings
+//
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <vector>
+#include "nlohmann/json.hpp"
+
+namespace mls {
+
+/**
+ * Warms the page cache with a model's weight files on a background thread while the model
+ * loads. Each file is mapped and advised MADV_WILLNEED window by window, so the kernel reads
+ * it ahead of MNN instead of MNN faulting it in page by page.
+ */
+class WeightPrefetcher {
+public:
+    // Advised per madvise call; also how often Stop() is noticed
+    static constexpr size_t kWindowBytes = 16u << 20;
+
+    WeightPrefetcher() = default;
+    ~WeightPrefetcher() { Stop(); }
+    WeightPrefetcher(const WeightPrefetcher&) = delete;
+    WeightPrefetcher& operator=(const WeightPrefetcher&) = delete;
+
+    // The model's config.json as MNN reads it, and the directory its file names are relative to
+    static nlohmann::json ReadConfig(const std::string& config_path, std::string* dir);
+
+    /**
+     * Files of the model at config_path (its config.json or directory), in the order MNN reads
+     * them: graph, embeddings, then weights. Missing files are left out.
+     */
+    static std::vector<std::string> ModelFiles(const std::string& config_path);
+    static size_t TotalBytes(const std::vector<std::string>& files);
+
+    void Start(std::vector<std::string> files);
+    // Stop after the current window and wait for the thread
+    void Stop();
+
+    size_t prefetchedBytes() const { return prefetched_bytes_; }
+
+private:
+    void Run(const std::vector<std::string>& files);
+
+    std::thread thread_;
+    std::atomic<bool> stop_{false};
+    std::atomic<size_t> prefetched_bytes_{0};
+};
+
+} // namespace mls
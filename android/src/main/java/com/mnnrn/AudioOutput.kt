@@ -0,0 +1,93 @@
+package com.mnnrn
+
+import android.media.AudioAttributes
+import android.media.AudioFormat
+import android.media.AudioTrack
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.util.concurrent.locks.LockSupport
+
+/**
+ * Plays a session's synthesized speech straight out of the native PCM ring. Native code writes
+ * float samples into [buffer] in place and reports the new write position; the playback thread
+ * hands slices of the same buffer to AudioTrack and reports back how far it has read, which
+ * frees the space for the producer. Nothing is allocated per chunk.
+ */
+internal class AudioOutput(
+  capacitySamples: Int,
+  sampleRate: Int,
+  private val onConsumed: (readPosition: Long) -> Unit
+) : MnnRnModule.AudioBufferListener {
+
+  val buffer: ByteBuffer =
+    ByteBuffer.allocateDirect(capacitySamples * BYTES_PER_SAMPLE).order(ByteOrder.nativeOrder())
+
+  private val capacity = capacitySamples.toLong()
+  @Volatile private var writePosition = 0L
+  @Volatile private var running = true
+
+  private val track: AudioTrack = run {
+    val format = AudioFormat.Builder()
+      .setEncoding(AudioFormat.ENCODING_PCM_FLOAT)
+      .setChannelMask(AudioFormat.CHANNEL_OUT_MONO)
+      .setSampleRate(sampleRate)
+      .build()
+    AudioTrack.Builder()
+      .setAudioAttributes(
+        AudioAttributes.Builder()
+          .setUsage(AudioAttributes.USAGE_ASSISTANT)
+          .setContentType(AudioAttributes.CONTENT_TYPE_SPEECH)
+          .build()
+      )
+      .setAudioFormat(format)
+      .setBufferSizeInBytes(
+        AudioTrack.getMinBufferSize(sampleRate, AudioFormat.CHANNEL_OUT_MONO, AudioFormat.ENCODING_PCM_FLOAT)
+      )
+      .setTransferMode(AudioTrack.MODE_STREAM)
+      .build()
+  }
+
+  private val thread = Thread(::playLoop, "mnn-rn-audio").apply { start() }
+
+  // Called on the synthesizing thread after each chunk lands in the buffer
+  override fun onAudioWritten(writePosition: Long, isEnd: Boolean): Boolean {
+    this.writePosition = writePosition
+    LockSupport.unpark(thread)
+    return !running // Stop synthesis once playback is closed
+  }
+
+  private fun playLoop() {
+    val view = buffer.duplicate().order(ByteOrder.nativeOrder())
+    var readPosition = 0L
+    track.play()
+    while (running) {
+      val available = writePosition - readPosition
+      if (available == 0L) {
+        LockSupport.park(this)
+        continue
+      }
+      val offset = (readPosition % capacity).toInt()
+      val count = minOf(available, capacity - offset).toInt()
+      view.limit((offset + count) * BYTES_PER_SAMPLE)
+      view.position(offset * BYTES_PER_SAMPLE)
+      val written = track.write(view, count * BYTES_PER_SAMPLE, AudioTrack.WRITE_BLOCKING)
+      if (written < 0) {
+        break
+      }
+      readPosition += written / BYTES_PER_SAMPLE
+      onConsumed(readPosition)
+    }
+  }
+
+  fun close() {
+    running = false
+    LockSupport.unpark(thread)
+    thread.join()
+    track.stop()
+    track.release()
+  }
+
+  companion object {
+    private const val BYTES_PER_SAMPLE = 4
+  }
+}
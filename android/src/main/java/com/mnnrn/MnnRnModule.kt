@@ -1,9 +1,22 @@
 package com.mnnrn
 
+import android.content.BroadcastReceiver
+import android.content.ComponentCallbacks2
+import android.content.Context
+import android.content.Intent
+import android.content.IntentFilter
+import android.content.res.Configuration
+import android.graphics.Bitmap
+import android.graphics.BitmapFactory
+import android.net.Uri
+import android.os.PowerManager
 import android.util.Pair
 import com.facebook.react.bridge.*
 import com.facebook.react.module.annotations.ReactModule
 import com.facebook.react.modules.core.DeviceEventManagerModule
+import com.facebook.react.turbomodule.core.interfaces.CallInvokerHolder
+import java.io.File
+import java.nio.ByteBuffer
 import java.util.concurrent.ConcurrentHashMap
 import java.util.concurrent.atomic.AtomicLong
 import java.util.concurrent.atomic.AtomicBoolean
@@ -15,9 +28,37 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
   private val sessionMap = ConcurrentHashMap<Long, Long>()
   private val sessionIdCounter = AtomicLong(1)
   private val stopFlags = ConcurrentHashMap<Long, AtomicBoolean>()
+  private val audioOutputs = ConcurrentHashMap<Long, AudioSink>()
+  private val embeddingMap = ConcurrentHashMap<Long, Long>()
+
+  // Sessions shed caches, KV state or their model as the system asks; see TrimActionForLevel
+  private val memoryCallbacks = object : ComponentCallbacks2 {
+    override fun onTrimMemory(level: Int) = trimSessions(level)
+    override fun onLowMemory() = trimSessions(ComponentCallbacks2.TRIM_MEMORY_COMPLETE)
+    override fun onConfigurationChanged(newConfig: Configuration) {}
+  }
+
+  // Battery saver makes the thermal governor pace decode; the thermal status itself is read natively
+  private val powerSaveReceiver = object : BroadcastReceiver() {
+    override fun onReceive(context: Context, intent: Intent) = updatePowerSaveMode(context)
+  }
+
+  init {
+    val context = reactContext.applicationContext
+    context.registerComponentCallbacks(memoryCallbacks)
+    context.registerReceiver(powerSaveReceiver, IntentFilter(PowerManager.ACTION_POWER_SAVE_MODE_CHANGED))
+    updatePowerSaveMode(context)
+  }
 
   override fun getName(): String = NAME
 
+  override fun invalidate() {
+    val context = reactApplicationContext.applicationContext
+    context.unregisterComponentCallbacks(memoryCallbacks)
+    context.unregisterReceiver(powerSaveReceiver)
+    super.invalidate()
+  }
+
   // ===== Session Lifecycle =====
 
   @ReactMethod
@@ -26,12 +67,22 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
     chatHistory: ReadableArray?,
     mergedConfig: String,
     extraConfig: String,
+    loadId: Double,
     promise: Promise
   ) {
     Thread {
       try {
         val historyList = chatHistory?.toArrayList() as? ArrayList<String>
-        val nativePtr = initNative(modelDir, historyList, mergedConfig, extraConfig)
+        val loadListener = LoadListener { stage, progress, elapsedMs, prefetchedBytes ->
+          sendEvent("onLlmLoadProgress", Arguments.createMap().apply {
+            putDouble("loadId", loadId)
+            putString("stage", stage)
+            putInt("progress", progress)
+            putDouble("elapsedMs", elapsedMs.toDouble())
+            putDouble("prefetchedBytes", prefetchedBytes.toDouble())
+          })
+        }
+        val nativePtr = initNative(modelDir, historyList, mergedConfig, extraConfig, loadListener)
         
         if (nativePtr == 0L) {
           promise.reject("INIT_ERROR", "Failed to initialize session")
@@ -40,6 +91,24 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
         
         val sessionId = sessionIdCounter.getAndIncrement()
         sessionMap[sessionId] = nativePtr
+        registerStreamingSessionNative(sessionId, nativePtr)
+        setPrefillListenerNative(nativePtr, PrefillListener { done, total ->
+          sendEvent("onLlmPrefillProgress", Arguments.createMap().apply {
+            putDouble("sessionId", sessionId.toDouble())
+            putInt("done", done)
+            putInt("total", total)
+          })
+        })
+        setThermalListenerNative(nativePtr, ThermalListener { status, level, powerSave, target, measured ->
+          sendEvent("onLlmThermalState", Arguments.createMap().apply {
+            putDouble("sessionId", sessionId.toDouble())
+            putString("status", status)
+            putString("level", level)
+            putBoolean("powerSave", powerSave)
+            putDouble("targetTokensPerSecond", target)
+            putDouble("measuredTokensPerSecond", measured)
+          })
+        })
         promise.resolve(sessionId.toDouble())
       } catch (e: Exception) {
         promise.reject("INIT_ERROR", e.message, e)
@@ -53,6 +122,8 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
     val nativePtr = sessionMap.remove(sid)
     stopFlags.remove(sid)
     if (nativePtr != null) {
+      closeAudioOutput(sid)
+      unregisterStreamingSessionNative(sid)
       releaseNative(nativePtr)
       promise.resolve(null)
     } else {
@@ -78,6 +149,8 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
     sessionId: Double,
     prompt: String,
     keepHistory: Boolean,
+    priority: Double,
+    adapter: String,
     promise: Promise
   ) {
     val nativePtr = sessionMap[sessionId.toLong()]
@@ -86,42 +159,114 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
       return
     }
 
-    Thread {
-      try {
-        val sid = sessionId.toLong()
-        val stopFlag = stopFlags.getOrPut(sid, { AtomicBoolean(false) })
-        stopFlag.set(false) // Reset stop flag at start
-        
-        // Create progress listener that emits events
-        val progressListener = ProgressListener { text ->
-          if (stopFlag.get()) {
-            true // Stop generation
-          } else {
-            sendEvent("onLlmChunk", Arguments.createMap().apply {
-              putDouble("sessionId", sessionId)
-              putString("chunk", text)
-            })
-            false // Continue generation
-          }
-        }
+    // Runs on the session's native inference thread; stop is handled natively
+    val jobId = submitAsyncNative(
+      nativePtr,
+      prompt,
+      keepHistory,
+      priority.toInt(),
+      adapter,
+      streamingProgressListener(sessionId),
+      streamingCompletionListener(sessionId, promise)
+    )
+    if (jobId == 0L) {
+      rejectQueueFull(sessionId, promise)
+    }
+  }
 
-        val metricsMap = submitNative(nativePtr, prompt, keepHistory, progressListener)
-        
-        // Emit completion event
-        sendEvent("onLlmComplete", Arguments.createMap().apply {
-          putDouble("sessionId", sessionId)
-          putMap("metrics", convertHashMapToWritableMap(metricsMap))
-        })
-        
-        promise.resolve(convertHashMapToWritableMap(metricsMap))
-      } catch (e: Exception) {
-        sendEvent("onLlmError", Arguments.createMap().apply {
-          putDouble("sessionId", sessionId)
-          putString("error", e.message ?: "Unknown error")
-        })
-        promise.reject("GENERATION_ERROR", e.message, e)
+  // ===== Image Prompts =====
+
+  @ReactMethod
+  override fun submitImagePromptStreaming(
+    sessionId: Double,
+    prompt: String,
+    imageUri: String,
+    priority: Double,
+    adapter: String,
+    promise: Promise
+  ) {
+    val nativePtr = sessionMap[sessionId.toLong()]
+    if (nativePtr == null) {
+      promise.reject("INVALID_SESSION", "Invalid session ID")
+      return
+    }
+    val bitmap = try {
+      decodeBitmap(imageUri, imageMaxSideNative(nativePtr))
+    } catch (e: Exception) {
+      null
+    }
+    if (bitmap == null) {
+      promise.reject("INVALID_IMAGE", "Could not decode $imageUri")
+      return
+    }
+    val jobId = submitImageAsyncNative(
+      nativePtr,
+      prompt,
+      bitmap,
+      priority.toInt(),
+      adapter,
+      streamingProgressListener(sessionId),
+      streamingCompletionListener(sessionId, promise)
+    )
+    // The pixels were converted before the call returned
+    bitmap.recycle()
+    when (jobId) {
+      -1L -> promise.reject("INVALID_IMAGE", "Could not read the pixels of $imageUri")
+      0L -> rejectQueueFull(sessionId, promise)
+    }
+  }
+
+  /**
+   * Ask about a Bitmap from native code, such as a camera frame, without writing it to a file.
+   * The reply goes into the session's history like submitPrompt. The pixels are converted before
+   * this returns, so the caller keeps ownership of the Bitmap and may recycle it right away.
+   * @return the job id, 0 when the session's queue is full, or -1 if the Bitmap could not be read
+   */
+  fun submitBitmap(
+    sessionId: Long,
+    prompt: String,
+    bitmap: Bitmap,
+    progressListener: ProgressListener?,
+    completionListener: CompletionListener?,
+    priority: Int = 0,
+    adapter: String = ""
+  ): Long {
+    val nativePtr = sessionMap[sessionId] ?: return -1L
+    // Hardware and 565 bitmaps can't be locked as RGBA
+    val pixels = if (bitmap.config == Bitmap.Config.ARGB_8888) {
+      bitmap
+    } else {
+      bitmap.copy(Bitmap.Config.ARGB_8888, false) ?: return -1L
+    }
+    try {
+      return submitImageAsyncNative(nativePtr, prompt, pixels, priority, adapter, progressListener, completionListener)
+    } finally {
+      if (pixels !== bitmap) {
+        pixels.recycle()
       }
-    }.start()
+    }
+  }
+
+  // Subsampled by powers of two while it stays at least maxSide; native code scales the rest
+  private fun decodeBitmap(imageUri: String, maxSide: Int): Bitmap? {
+    val uri = if (imageUri.startsWith("/")) Uri.fromFile(File(imageUri)) else Uri.parse(imageUri)
+    val resolver = reactApplicationContext.contentResolver
+    val bounds = BitmapFactory.Options().apply { inJustDecodeBounds = true }
+    resolver.openInputStream(uri)?.use { BitmapFactory.decodeStream(it, null, bounds) }
+    if (bounds.outWidth <= 0 || bounds.outHeight <= 0) {
+      return null
+    }
+    var sampleSize = 1
+    if (maxSide > 0) {
+      while (maxOf(bounds.outWidth, bounds.outHeight) / (sampleSize * 2) >= maxSide) {
+        sampleSize *= 2
+      }
+    }
+    val options = BitmapFactory.Options().apply {
+      inSampleSize = sampleSize
+      inPreferredConfig = Bitmap.Config.ARGB_8888
+    }
+    return resolver.openInputStream(uri)?.use { BitmapFactory.decodeStream(it, null, options) }
   }
 
   // ===== Submit with History (Event-based streaming) =====
@@ -130,6 +275,8 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
   override fun submitWithHistoryStreaming(
     sessionId: Double,
     messages: ReadableArray,
+    priority: Double,
+    adapter: String,
     promise: Promise
   ) {
     val nativePtr = sessionMap[sessionId.toLong()]
@@ -138,33 +285,49 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
       return
     }
 
-    Thread {
-      try {
-        val sid = sessionId.toLong()
-        val stopFlag = stopFlags.getOrPut(sid, { AtomicBoolean(false) })
-        stopFlag.set(false) // Reset stop flag at start
-        
-        val historyList = convertMessagesToPairs(messages)
-        val progressListener = ProgressListener { text ->
-          if (stopFlag.get()) {
-            true // Stop generation
-          } else {
-            sendEvent("onLlmChunk", Arguments.createMap().apply {
-              putDouble("sessionId", sessionId)
-              putString("chunk", text)
-            })
-            false
-          }
-        }
+    val jobId = submitFullHistoryAsyncNative(
+      nativePtr,
+      convertMessagesToPairs(messages),
+      priority.toInt(),
+      adapter,
+      streamingProgressListener(sessionId),
+      streamingCompletionListener(sessionId, promise)
+    )
+    if (jobId == 0L) {
+      rejectQueueFull(sessionId, promise)
+    }
+  }
 
-        val metricsMap = submitFullHistoryNative(nativePtr, historyList, progressListener)
-        
+  // ===== Direct JSI streaming =====
+
+  // Installs global.__mnnRnStreaming; chunks then go from the inference thread to JS callbacks
+  // without the event emitter. Returns false when the runtime is not reachable from here.
+  @ReactMethod(isBlockingSynchronousMethod = true)
+  override fun installStreaming(): Boolean {
+    val jsContext = reactApplicationContext.javaScriptContextHolder?.get() ?: 0L
+    val callInvokerHolder = reactApplicationContext.jsCallInvokerHolder
+    if (jsContext == 0L || callInvokerHolder == null) {
+      return false
+    }
+    return installStreamingNative(jsContext, callInvokerHolder)
+  }
+
+  private fun streamingProgressListener(sessionId: Double) = ProgressListener { text ->
+    sendEvent("onLlmChunk", Arguments.createMap().apply {
+      putDouble("sessionId", sessionId)
+      putString("chunk", text)
+    })
+    false // Continue generation
+  }
+
+  private fun streamingCompletionListener(sessionId: Double, promise: Promise) =
+    CompletionListener { metricsMap ->
+      try {
         // Emit completion event
         sendEvent("onLlmComplete", Arguments.createMap().apply {
           putDouble("sessionId", sessionId)
           putMap("metrics", convertHashMapToWritableMap(metricsMap))
         })
-        
         promise.resolve(convertHashMapToWritableMap(metricsMap))
       } catch (e: Exception) {
         sendEvent("onLlmError", Arguments.createMap().apply {
@@ -173,7 +336,15 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
         })
         promise.reject("GENERATION_ERROR", e.message, e)
       }
-    }.start()
+    }
+
+  private fun rejectQueueFull(sessionId: Double, promise: Promise) {
+    val message = "Too many requests are waiting for this session"
+    sendEvent("onLlmError", Arguments.createMap().apply {
+      putDouble("sessionId", sessionId)
+      putString("error", message)
+    })
+    promise.reject("QUEUE_FULL", message)
   }
 
   // ===== Configuration Methods =====
@@ -235,6 +406,33 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
     }
   }
 
+  @ReactMethod
+  override fun saveState(sessionId: Double, name: String, promise: Promise) {
+    val nativePtr = sessionMap[sessionId.toLong()]
+    if (nativePtr == null) {
+      promise.reject("INVALID_SESSION", "Invalid session ID")
+      return
+    }
+    // Waits for a running generation, so the JS thread is not held
+    Thread {
+      val error = saveStateNative(nativePtr, name)
+      if (error == null) promise.resolve(null) else promise.reject("STATE_ERROR", error)
+    }.start()
+  }
+
+  @ReactMethod
+  override fun restoreState(sessionId: Double, name: String, prefill: Boolean, promise: Promise) {
+    val nativePtr = sessionMap[sessionId.toLong()]
+    if (nativePtr == null) {
+      promise.reject("INVALID_SESSION", "Invalid session ID")
+      return
+    }
+    Thread {
+      val error = restoreStateNative(nativePtr, name, prefill)
+      if (error == null) promise.resolve(null) else promise.reject("STATE_ERROR", error)
+    }.start()
+  }
+
   // ===== Information Methods =====
 
   @ReactMethod
@@ -262,17 +460,253 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
   @ReactMethod
   override fun stopGeneration(sessionId: Double, promise: Promise) {
     val sid = sessionId.toLong()
-    val stopFlag = stopFlags[sid]
-    if (stopFlag != null) {
-      stopFlag.set(true)
+    val nativePtr = sessionMap[sid]
+    if (nativePtr != null) {
+      stopFlags[sid]?.set(true)
+      // Cancels the running request and any still queued, checked at every token
+      stopNative(nativePtr)
       promise.resolve(null)
     } else {
       promise.reject("INVALID_SESSION", "Invalid session ID")
     }
   }
 
+  // ===== Memory =====
+
+  @ReactMethod
+  override fun getMemoryReport(sessionId: Double, promise: Promise) {
+    val nativePtr = sessionMap[sessionId.toLong()]
+    if (nativePtr != null) {
+      promise.resolve(convertHashMapToWritableMap(getMemoryReportNative(nativePtr)))
+    } else {
+      promise.reject("INVALID_SESSION", "Invalid session ID")
+    }
+  }
+
+  @ReactMethod
+  override fun trimMemory(level: Double, promise: Promise) {
+    trimSessions(level.toInt())
+    promise.resolve(null)
+  }
+
+  // ===== Response Format =====
+
+  @ReactMethod
+  override fun setResponseFormat(sessionId: Double, kind: String, spec: String, promise: Promise) {
+    val nativePtr = sessionMap[sessionId.toLong()]
+    if (nativePtr == null) {
+      promise.reject("INVALID_SESSION", "Invalid session ID")
+      return
+    }
+    // The grammar is compiled on this thread; requests already queued keep the previous format
+    val error = setResponseFormatNative(nativePtr, kind, spec)
+    if (error != null) {
+      promise.reject("INVALID_RESPONSE_FORMAT", error)
+    } else {
+      promise.resolve(null)
+    }
+  }
+
+  // ===== Audio Output =====
+
+  @ReactMethod
+  override fun setAudioOutput(sessionId: Double, enabled: Boolean, promise: Promise) {
+    val sid = sessionId.toLong()
+    val nativePtr = sessionMap[sid]
+    if (nativePtr == null) {
+      promise.reject("INVALID_SESSION", "Invalid session ID")
+      return
+    }
+    closeAudioOutput(sid)
+    if (enabled) {
+      var sinkPtr = 0L
+      val output = AudioOutput(AUDIO_BUFFER_SAMPLES, AUDIO_SAMPLE_RATE) { readPosition ->
+        audioConsumedNative(sinkPtr, readPosition)
+      }
+      sinkPtr = setAudioBufferNative(nativePtr, output.buffer, output)
+      if (sinkPtr == 0L) {
+        output.close()
+        promise.reject("AUDIO_ERROR", "Failed to set up audio output")
+        return
+      }
+      audioOutputs[sid] = AudioSink(sinkPtr, output)
+    }
+    updateEnableAudioOutputNative(nativePtr, enabled)
+    promise.resolve(null)
+  }
+
+  private fun closeAudioOutput(sessionId: Long) {
+    val sink = audioOutputs.remove(sessionId) ?: return
+    audioClosedNative(sink.sinkPtr) // Wakes a producer waiting for space before playback stops
+    sink.output.close()
+  }
+
+  // Native PCM ring handle and the playback reading from it
+  private class AudioSink(val sinkPtr: Long, val output: AudioOutput)
+
+  // ===== Diagnostics =====
+
+  @ReactMethod
+  override fun setTracingEnabled(enabled: Boolean, promise: Promise) {
+    setTracingEnabledNative(enabled)
+    promise.resolve(null)
+  }
+
+  @ReactMethod
+  override fun setAsyncLogging(enabled: Boolean, promise: Promise) {
+    setAsyncLoggingNative(enabled)
+    promise.resolve(null)
+  }
+
+  // ===== Benchmark =====
+
+  @ReactMethod
+  override fun runBenchmark(sessionId: Double, options: ReadableMap, promise: Promise) {
+    val nativePtr = sessionMap[sessionId.toLong()]
+    if (nativePtr == null) {
+      promise.reject("INVALID_SESSION", "Invalid session ID")
+      return
+    }
+
+    Thread {
+      try {
+        val sid = sessionId.toLong()
+        val stopFlag = stopFlags.getOrPut(sid, { AtomicBoolean(false) })
+        stopFlag.set(false) // Reset stop flag at start
+
+        val benchmarkListener = BenchmarkListener { progress ->
+          sendEvent("onBenchmarkProgress", convertHashMapToWritableMap(progress).apply {
+            putDouble("sessionId", sessionId)
+          })
+          stopFlag.get()
+        }
+
+        val resultMap = runBenchmarkNative(
+          nativePtr,
+          options.getIntOrDefault("backend", 0),
+          options.getIntOrDefault("threads", 4),
+          if (options.hasKey("useMmap")) options.getBoolean("useMmap") else false,
+          options.getIntOrDefault("power", 0),
+          options.getIntOrDefault("precision", 2),
+          options.getIntOrDefault("memory", 0),
+          options.getIntOrDefault("dynamicOption", 0),
+          options.getIntOrDefault("nPrompt", 512),
+          options.getIntOrDefault("nGenerate", 128),
+          options.getIntOrDefault("nRepeat", 5),
+          if (options.hasKey("kvCache")) options.getBoolean("kvCache") else false,
+          benchmarkListener
+        )
+
+        promise.resolve(convertHashMapToWritableMap(resultMap).apply {
+          putString("mnnVariant", NativeLibraries.mnnVariant)
+        })
+      } catch (e: Exception) {
+        promise.reject("BENCHMARK_ERROR", e.message, e)
+      }
+    }.start()
+  }
+
+  // ===== Embedding / Vector Index =====
+
+  @ReactMethod
+  override fun initEmbedding(configPath: String, config: String, promise: Promise) {
+    Thread {
+      try {
+        val nativePtr = initEmbeddingNative(configPath, config)
+        if (nativePtr == 0L) {
+          promise.reject("INIT_ERROR", "Failed to load embedding model")
+          return@Thread
+        }
+        val embeddingId = sessionIdCounter.getAndIncrement()
+        embeddingMap[embeddingId] = nativePtr
+        promise.resolve(embeddingId.toDouble())
+      } catch (e: Exception) {
+        promise.reject("INIT_ERROR", e.message, e)
+      }
+    }.start()
+  }
+
+  @ReactMethod
+  override fun releaseEmbedding(embeddingId: Double, promise: Promise) {
+    val nativePtr = embeddingMap.remove(embeddingId.toLong())
+    if (nativePtr != null) {
+      releaseEmbeddingNative(nativePtr)
+      promise.resolve(null)
+    } else {
+      promise.reject("INVALID_SESSION", "Invalid embedding session ID")
+    }
+  }
+
+  @ReactMethod
+  override fun embedToIndex(
+    embeddingId: Double,
+    indexPath: String,
+    texts: ReadableArray,
+    ids: ReadableArray,
+    promise: Promise
+  ) {
+    val nativePtr = embeddingMap[embeddingId.toLong()]
+    if (nativePtr == null) {
+      promise.reject("INVALID_SESSION", "Invalid embedding session ID")
+      return
+    }
+    val chunks = Array(texts.size()) { texts.getString(it) ?: "" }
+    val chunkIds = LongArray(ids.size()) { ids.getDouble(it).toLong() }
+    Thread {
+      try {
+        val result = embedToIndexNative(nativePtr, indexPath, chunks, chunkIds)
+        promise.resolve(convertHashMapToWritableMap(result))
+      } catch (e: Exception) {
+        promise.reject("EMBEDDING_ERROR", e.message, e)
+      }
+    }.start()
+  }
+
+  @ReactMethod
+  override fun searchIndex(
+    embeddingId: Double,
+    indexPath: String,
+    query: String,
+    k: Double,
+    nprobe: Double,
+    promise: Promise
+  ) {
+    val nativePtr = embeddingMap[embeddingId.toLong()]
+    if (nativePtr == null) {
+      promise.reject("INVALID_SESSION", "Invalid embedding session ID")
+      return
+    }
+    Thread {
+      try {
+        val result = searchIndexNative(nativePtr, indexPath, query, k.toInt(), nprobe.toInt())
+        promise.resolve(convertHashMapToWritableMap(result))
+      } catch (e: Exception) {
+        promise.reject("EMBEDDING_ERROR", e.message, e)
+      }
+    }.start()
+  }
+
+  @ReactMethod
+  override fun closeIndex(embeddingId: Double, indexPath: String, promise: Promise) {
+    embeddingMap[embeddingId.toLong()]?.let { closeIndexNative(it, indexPath) }
+    promise.resolve(null)
+  }
+
   // ===== Helper Methods =====
 
+  private fun updatePowerSaveMode(context: Context) {
+    val power = context.getSystemService(Context.POWER_SERVICE) as? PowerManager ?: return
+    setPowerSaveModeNative(power.isPowerSaveMode)
+  }
+
+  // Queued behind each session's running request, so a trim never races generation
+  private fun trimSessions(level: Int) {
+    sessionMap.values.forEach { trimMemoryNative(it, level) }
+  }
+
+  private fun ReadableMap.getIntOrDefault(key: String, default: Int): Int =
+    if (hasKey(key)) getDouble(key).toInt() else default
+
   private fun sendEvent(eventName: String, params: WritableMap) {
     reactApplicationContext
       .getJSModule(DeviceEventManagerModule.RCTDeviceEventEmitter::class.java)
@@ -300,6 +734,14 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
         is Int -> map.putInt(key.toString(), value)
         is String -> map.putString(key.toString(), value)
         is Boolean -> map.putBoolean(key.toString(), value)
+        is Double -> map.putDouble(key.toString(), value)
+        is Float -> map.putDouble(key.toString(), value.toDouble())
+        is LongArray -> map.putArray(key.toString(), Arguments.createArray().apply {
+          value.forEach { pushDouble(it.toDouble()) }
+        })
+        is DoubleArray -> map.putArray(key.toString(), Arguments.createArray().apply {
+          value.forEach { pushDouble(it) }
+        })
       }
     }
     return map
@@ -311,31 +753,104 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
     modelDir: String,
     chatHistory: ArrayList<String>?,
     mergedConfig: String,
-    extraConfig: String
+    extraConfig: String,
+    loadListener: LoadListener?
   ): Long
 
-  private external fun submitNative(
+  // Both return the queued job id, or 0 when the session's queue is full.
+  // adapter is a LoRA adapter path for this request, or empty for the base model
+  private external fun submitAsyncNative(
     llmPtr: Long,
     prompt: String,
     keepHistory: Boolean,
-    progressListener: ProgressListener?
-  ): HashMap<*, *>
+    priority: Int,
+    adapter: String,
+    progressListener: ProgressListener?,
+    completionListener: CompletionListener?
+  ): Long
+
+  // Also -1 when the bitmap is not ARGB_8888 or could not be locked
+  private external fun submitImageAsyncNative(
+    llmPtr: Long,
+    prompt: String,
+    bitmap: Bitmap,
+    priority: Int,
+    adapter: String,
+    progressListener: ProgressListener?,
+    completionListener: CompletionListener?
+  ): Long
+
+  private external fun imageMaxSideNative(llmPtr: Long): Int
 
-  private external fun submitFullHistoryNative(
+  private external fun submitFullHistoryAsyncNative(
     llmPtr: Long,
     historyList: ArrayList<Pair<String, String>>,
-    progressListener: ProgressListener?
-  ): HashMap<*, *>
+    priority: Int,
+    adapter: String,
+    progressListener: ProgressListener?,
+    completionListener: CompletionListener?
+  ): Long
 
+  private external fun installStreamingNative(jsContext: Long, callInvokerHolder: CallInvokerHolder): Boolean
+  private external fun registerStreamingSessionNative(sessionId: Long, llmPtr: Long)
+  private external fun unregisterStreamingSessionNative(sessionId: Long)
   private external fun resetNative(llmPtr: Long)
+  private external fun stopNative(llmPtr: Long)
+  private external fun setTracingEnabledNative(enabled: Boolean)
+  private external fun setAsyncLoggingNative(enabled: Boolean)
   private external fun releaseNative(llmPtr: Long)
   private external fun updateMaxNewTokensNative(llmPtr: Long, maxTokens: Int)
   private external fun updateSystemPromptNative(llmPtr: Long, systemPrompt: String)
   private external fun updateAssistantPromptNative(llmPtr: Long, assistantPrompt: String)
   private external fun updateConfigNative(llmPtr: Long, configJson: String)
   private external fun clearHistoryNative(llmPtr: Long)
+  private external fun saveStateNative(llmPtr: Long, name: String): String?
+  private external fun restoreStateNative(llmPtr: Long, name: String, prefill: Boolean): String?
   private external fun getSystemPromptNative(llmPtr: Long): String
   private external fun getDebugInfoNative(llmPtr: Long): String
+  private external fun trimMemoryNative(llmPtr: Long, level: Int)
+  private external fun getMemoryReportNative(llmPtr: Long): HashMap<*, *>
+  private external fun setResponseFormatNative(llmPtr: Long, kind: String, spec: String): String?
+  private external fun updateEnableAudioOutputNative(llmPtr: Long, enable: Boolean)
+  private external fun setAudioBufferNative(llmPtr: Long, buffer: ByteBuffer, listener: AudioBufferListener): Long
+  private external fun setPrefillListenerNative(llmPtr: Long, listener: PrefillListener)
+  private external fun setThermalListenerNative(llmPtr: Long, listener: ThermalListener)
+  private external fun setPowerSaveModeNative(enabled: Boolean)
+  private external fun audioConsumedNative(sinkPtr: Long, readPosition: Long)
+  private external fun audioClosedNative(sinkPtr: Long)
+
+  private external fun initEmbeddingNative(configPath: String, config: String): Long
+  private external fun releaseEmbeddingNative(embeddingPtr: Long)
+  private external fun embedToIndexNative(
+    embeddingPtr: Long,
+    indexPath: String,
+    texts: Array<String>,
+    ids: LongArray
+  ): HashMap<*, *>
+  private external fun searchIndexNative(
+    embeddingPtr: Long,
+    indexPath: String,
+    query: String,
+    k: Int,
+    nprobe: Int
+  ): HashMap<*, *>
+  private external fun closeIndexNative(embeddingPtr: Long, indexPath: String)
+
+  private external fun runBenchmarkNative(
+    llmPtr: Long,
+    backend: Int,
+    threads: Int,
+    useMmap: Boolean,
+    power: Int,
+    precision: Int,
+    memory: Int,
+    dynamicOption: Int,
+    nPrompt: Int,
+    nGenerate: Int,
+    nRepeat: Int,
+    kvCache: Boolean,
+    benchmarkListener: BenchmarkListener?
+  ): HashMap<*, *>
 
   // ===== Progress Listener Interface =====
 
@@ -343,11 +858,41 @@ class MnnRnModule(reactContext: ReactApplicationContext) :
     fun onProgress(text: String): Boolean
   }
 
+  fun interface CompletionListener {
+    fun onComplete(metrics: HashMap<*, *>)
+  }
+
+  fun interface BenchmarkListener {
+    fun onProgress(progress: HashMap<*, *>): Boolean
+  }
+
+  fun interface LoadListener {
+    // A load stage finished: config, weights, warm, then ready or failed
+    fun onLoadProgress(stage: String, progress: Int, elapsedMs: Long, prefetchedBytes: Long)
+  }
+
+  fun interface PrefillListener {
+    // Prompt tokens prefilled so far out of total, after each prefill chunk
+    fun onPrefill(done: Int, total: Int)
+  }
+
+  fun interface ThermalListener {
+    // The thermal governor's throttle level changed; target is 0 when decode is not paced
+    fun onThermalState(status: String, level: String, powerSave: Boolean, target: Double, measured: Double)
+  }
+
+  fun interface AudioBufferListener {
+    // New samples are in the shared buffer up to writePosition; return true to stop synthesis
+    fun onAudioWritten(writePosition: Long, isEnd: Boolean): Boolean
+  }
+
   companion object {
     const val NAME = "MnnRn"
+    private const val AUDIO_SAMPLE_RATE = 24000
+    private const val AUDIO_BUFFER_SAMPLES = AUDIO_SAMPLE_RATE * 10
 
     init {
-      System.loadLibrary("mnn-rn")
+      NativeLibraries.load()
     }
   }
 }
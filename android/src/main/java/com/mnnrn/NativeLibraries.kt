@@ -0,0 +1,40 @@
+package com.mnnrn
+
+import android.util.Log
+
+/**
+ * Loads libMNN, then the bindings linked against it. The APK may carry builds of libMNN for newer
+ * cores next to the baseline one, as libMNN_dotprod.so (armv8.2-a+dotprod+fp16) and libMNN_i8mm.so
+ * (armv8.6-a+i8mm). All keep the soname libMNN.so, so whichever is loaded first satisfies
+ * libmnn-rn's dependency. libmnn-rn-loader reads the CPU's hwcaps and names, best first, the
+ * builds it can run; the first one packaged is used.
+ */
+internal object NativeLibraries {
+  private const val TAG = "MnnRn"
+
+  // The libMNN build in use, e.g. "MNN_dotprod"; "MNN" for the baseline
+  @Volatile
+  var mnnVariant: String = ""
+    private set
+
+  @Synchronized
+  fun load() {
+    if (mnnVariant.isNotEmpty()) {
+      return
+    }
+    System.loadLibrary("mnn-rn-loader")
+    for (name in mnnVariantsNative()) {
+      try {
+        System.loadLibrary(name)
+        mnnVariant = name
+        break
+      } catch (e: UnsatisfiedLinkError) {
+        // Not packaged in this APK, try the next one
+      }
+    }
+    Log.i(TAG, "Using lib$mnnVariant.so")
+    System.loadLibrary("mnn-rn")
+  }
+
+  private external fun mnnVariantsNative(): Array<String>
+}
@@ -2,4 +2,13 @@
 
 @interface MnnRn : NSObject <NativeMnnRnSpec>
 
+// The spec method is named init; keep it out of ObjC's init family so it may return void
+- (void)init:(NSString *)modelDir
+    chatHistory:(NSArray *)chatHistory
+    mergedConfig:(NSString *)mergedConfig
+    extraConfig:(NSString *)extraConfig
+         loadId:(double)loadId
+        resolve:(RCTPromiseResolveBlock)resolve
+         reject:(RCTPromiseRejectBlock)reject __attribute__((objc_method_family(none)));
+
 @end
@@ -1,12 +1,780 @@
 #import "MnnRn.h"
+#import <UIKit/UIKit.h>
+#import <ReactCommon/RCTTurboModuleWithJSIBindings.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "nlohmann/json.hpp"
+#include "llm_session.h"
+#include "constrained_decoder.hpp"
+#include "embedding_session.h"
+#include "image_input.hpp"
+#include "generation_metrics.hpp"
+#include "inference_worker.hpp"
+#include "jsi_streaming.h"
+#include "memory_governor.hpp"
+#include "mls_log.h"
+#include "mls_trace.h"
+#include "thermal_governor.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+std::mutex g_sessions_mutex;
+std::unordered_map<int64_t, std::unique_ptr<mls::LlmSession>> g_sessions;
+std::atomic<int64_t> g_next_session_id{1};
+
+mls::LlmSession *findSession(double session_id) {
+  std::lock_guard<std::mutex> lock(g_sessions_mutex);
+  auto it = g_sessions.find(static_cast<int64_t>(session_id));
+  return it == g_sessions.end() ? nullptr : it->second.get();
+}
+
+// Shared so a release while an embedding call is running frees the model when the call returns
+std::unordered_map<int64_t, std::shared_ptr<mls::EmbeddingSession>> g_embeddings;
+
+std::shared_ptr<mls::EmbeddingSession> findEmbedding(double embedding_id) {
+  std::lock_guard<std::mutex> lock(g_sessions_mutex);
+  auto it = g_embeddings.find(static_cast<int64_t>(embedding_id));
+  return it == g_embeddings.end() ? nullptr : it->second;
+}
+
+NSString *toNSString(const std::string &value) {
+  return [NSString stringWithUTF8String:value.c_str()] ?: @"";
+}
+
+NSArray<NSNumber *> *toNSArray(const std::vector<int64_t> &values) {
+  NSMutableArray<NSNumber *> *array = [NSMutableArray arrayWithCapacity:values.size()];
+  for (auto value : values) {
+    [array addObject:@(value)];
+  }
+  return array;
+}
+
+NSDictionary *toMetricsDictionary(const mls::LlmSession *llm, const MNN::Transformer::LlmContext *context,
+                                  bool cancelled) {
+  NSMutableDictionary *metrics = [NSMutableDictionary dictionary];
+  if (llm) {
+    for (const auto &metric : mls::CollectGenerationMetrics(*llm, context)) {
+      metrics[@(metric.key)] = @(metric.value);
+    }
+  }
+  metrics[@"cancelled"] = @(cancelled);
+  return metrics;
+}
+
+/**
+ * Models live in the app container; mmap the weights from there and keep MNN's caches
+ * (kernel tuning, prompt snapshots) under Library/Caches unless the caller chose a directory.
+ * iOS sessions default to Metal, which falls back to CPU if it cannot load.
+ */
+void applyPlatformDefaults(json &merged_config, json &extra_config) {
+  if (extra_config.value("mmap_dir", "").empty()) {
+    NSString *caches = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES).firstObject;
+    NSString *mmap_dir = [caches stringByAppendingPathComponent:@"mnn_rn"];
+    [[NSFileManager defaultManager] createDirectoryAtPath:mmap_dir
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:nil];
+    extra_config["mmap_dir"] = std::string(mmap_dir.UTF8String);
+  }
+  if (!extra_config.contains("backend") && !merged_config.contains("backend_type")) {
+    extra_config["backend"] = "metal";
+  }
+}
+
+// Apply a session update in order with generation instead of racing a running one
+void queueSessionUpdate(mls::LlmSession *llm, std::function<void()> update) {
+  mls::InferenceWorker::Job job;
+  job.priority = mls::InferenceWorker::kUpdatePriority;
+  job.bounded = false;
+  job.run = [update = std::move(update)](const mls::CancellationToken &) { update(); };
+  llm->worker().submit(std::move(job));
+}
+
+void trimSessions(int level) {
+  std::lock_guard<std::mutex> lock(g_sessions_mutex);
+  for (auto &entry : g_sessions) {
+    auto *llm = entry.second.get();
+    queueSessionUpdate(llm, [llm, level]() { llm->TrimMemory(level); });
+  }
+}
+
+// iOS has one warning, sent when the app is close to its jetsam limit
+void observeMemoryWarnings() {
+  static dispatch_once_t once;
+  dispatch_once(&once, ^{
+    [[NSNotificationCenter defaultCenter] addObserverForName:UIApplicationDidReceiveMemoryWarningNotification
+                                                      object:nil
+                                                       queue:nil
+                                                  usingBlock:^(NSNotification *) {
+                                                    trimSessions(mls::TRIM_MEMORY_RUNNING_CRITICAL);
+                                                  }];
+  });
+}
+
+mls::ThermalStatus thermalStatusFor(NSProcessInfoThermalState state) {
+  switch (state) {
+    case NSProcessInfoThermalStateFair:
+      return mls::ThermalStatus::LIGHT;
+    case NSProcessInfoThermalStateSerious:
+      return mls::ThermalStatus::SEVERE;
+    case NSProcessInfoThermalStateCritical:
+      return mls::ThermalStatus::CRITICAL;
+    default:
+      return mls::ThermalStatus::NONE;
+  }
+}
+
+// The thermal governor reads what is pushed here; Android reads AThermal instead
+void observeThermalState() {
+  static dispatch_once_t once;
+  dispatch_once(&once, ^{
+    auto update = ^(NSNotification *) {
+      NSProcessInfo *info = [NSProcessInfo processInfo];
+      mls::SetThermalStatus(thermalStatusFor(info.thermalState));
+      mls::SetPowerSaveMode(info.lowPowerModeEnabled);
+    };
+    update(nil);
+    NSNotificationCenter *center = [NSNotificationCenter defaultCenter];
+    [center addObserverForName:NSProcessInfoThermalStateDidChangeNotification object:nil queue:nil usingBlock:update];
+    [center addObserverForName:NSProcessInfoPowerStateDidChangeNotification object:nil queue:nil usingBlock:update];
+  });
+}
+
+/**
+ * The image at a file path or file URL as a prompt image. CoreGraphics decodes it and scales it
+ * to fit max_side while drawing into the RGBA buffer, which then converts without a second resize.
+ */
+bool readPromptImage(NSString *imageUri, int max_side, MNN::Transformer::PromptImagePart *image) {
+  NSURL *url = [imageUri hasPrefix:@"/"] ? [NSURL fileURLWithPath:imageUri] : [NSURL URLWithString:imageUri];
+  UIImage *source = url.isFileURL ? [UIImage imageWithContentsOfFile:url.path] : nil;
+  CGImageRef cg_image = source.CGImage;
+  if (!cg_image) {
+    return false;
+  }
+  size_t width = CGImageGetWidth(cg_image);
+  size_t height = CGImageGetHeight(cg_image);
+  size_t longest = std::max(width, height);
+  double scale = max_side > 0 && longest > static_cast<size_t>(max_side) ? static_cast<double>(max_side) / longest : 1.0;
+  size_t out_width = std::max<size_t>(1, static_cast<size_t>(std::lround(width * scale)));
+  size_t out_height = std::max<size_t>(1, static_cast<size_t>(std::lround(height * scale)));
+  std::vector<uint8_t> pixels(out_width * out_height * 4);
+  CGColorSpaceRef color_space = CGColorSpaceCreateDeviceRGB();
+  CGContextRef context = CGBitmapContextCreate(pixels.data(), out_width, out_height, 8, out_width * 4, color_space,
+                                               kCGImageAlphaNoneSkipLast | kCGBitmapByteOrder32Big);
+  CGColorSpaceRelease(color_space);
+  if (!context) {
+    return false;
+  }
+  CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
+  CGContextDrawImage(context, CGRectMake(0, 0, out_width, out_height), cg_image);
+  CGContextRelease(context);
+  return mls::ConvertRgbaImage(pixels.data(), static_cast<int>(out_width), static_cast<int>(out_height),
+                               static_cast<int>(out_width * 4), 0, image);
+}
+
+NSDictionary *toMemoryDictionary(const mls::MemoryReport &report) {
+  return @{
+    @"residentBytes" : @(report.process.resident_bytes),
+    @"nativeHeapBytes" : @(report.process.native_heap_bytes),
+    @"weightBytes" : @(report.weight_bytes),
+    @"kvCacheBytes" : @(report.kv_cache_bytes),
+    @"kvTokens" : @(report.kv_tokens),
+    @"adapterBytes" : @(report.adapter_bytes),
+    @"tokenCacheBytes" : @(report.token_cache_bytes),
+    @"budgetBytes" : @(report.budget_bytes),
+    @"loaded" : @(report.loaded),
+    @"shared" : @(report.shared),
+    @"lastTrim" : @(mls::TrimActionName(report.last_trim)),
+  };
+}
+
+using Generate = std::function<const MNN::Transformer::LlmContext *(
+    const std::function<bool(const std::string &, bool)> &, const mls::CancellationToken &)>;
+
+// Chunks reach JS through the JSI streaming bindings; this path only resolves the metrics
+void submitGeneration(mls::LlmSession *llm, int priority, Generate generate, RCTPromiseResolveBlock resolve,
+                      RCTPromiseRejectBlock reject) {
+  mls::InferenceWorker::Job job;
+  job.priority = priority;
+  job.run = [llm, resolve, generate = std::move(generate)](const mls::CancellationToken &token) {
+    auto *context = generate([](const std::string &, bool) { return false; }, token);
+    resolve(toMetricsDictionary(llm, context, token.cancelled()));
+  };
+  job.on_cancel = [resolve]() { resolve(toMetricsDictionary(nullptr, nullptr, true)); };
+  if (llm->worker().submit(std::move(job)) == 0) {
+    reject(@"QUEUE_FULL", @"Too many requests are waiting for this session", nil);
+  }
+}
+
+} // namespace
+
+@interface MnnRn () <RCTTurboModuleWithJSIBindings>
+@end
+
+@implementation MnnRn {
+  std::atomic<bool> _streamingInstalled;
+}
 
-@implementation MnnRn
 RCT_EXPORT_MODULE()
 
-- (NSNumber *)multiply:(double)a b:(double)b {
-    NSNumber *result = @(a * b);
++ (BOOL)requiresMainQueueSetup {
+  return NO;
+}
+
+- (void)installJSIBindingsWithRuntime:(facebook::jsi::Runtime &)runtime
+                          callInvoker:(const std::shared_ptr<facebook::react::CallInvoker> &)callInvoker {
+  mls::InstallJsiStreaming(runtime, callInvoker);
+  _streamingInstalled = true;
+}
+
+// ===== Session Lifecycle =====
+
+- (void)init:(NSString *)modelDir
+    chatHistory:(NSArray *)chatHistory
+    mergedConfig:(NSString *)mergedConfig
+    extraConfig:(NSString *)extraConfig
+         loadId:(double)loadId
+        resolve:(RCTPromiseResolveBlock)resolve
+         reject:(RCTPromiseRejectBlock)reject {
+  // There is no event emitter on iOS, so load stages are only logged natively
+  observeMemoryWarnings();
+  observeThermalState();
+  std::string model_dir = modelDir.UTF8String;
+  std::string merged_config_str = mergedConfig.UTF8String;
+  std::string extra_config_str = extraConfig.UTF8String;
+  std::vector<std::string> history;
+  for (id item in chatHistory ?: @[]) {
+    if ([item isKindOfClass:[NSString class]]) {
+      history.emplace_back([item UTF8String]);
+    }
+  }
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+    json merged_config = json::parse(merged_config_str, nullptr, false);
+    json extra_config = json::parse(extra_config_str, nullptr, false);
+    if (merged_config.is_discarded() || extra_config.is_discarded()) {
+      reject(@"INIT_ERROR", @"Invalid config JSON", nil);
+      return;
+    }
+    applyPlatformDefaults(merged_config, extra_config);
+    auto session = std::make_unique<mls::LlmSession>(model_dir, merged_config, extra_config, history);
+    session->Load();
+    int64_t session_id = g_next_session_id.fetch_add(1);
+    mls::RegisterStreamingSession(session_id, session.get());
+    {
+      std::lock_guard<std::mutex> lock(g_sessions_mutex);
+      g_sessions[session_id] = std::move(session);
+    }
+    resolve(@(session_id));
+  });
+}
+
+- (void)release:(double)sessionId resolve:(RCTPromiseResolveBlock)resolve reject:(RCTPromiseRejectBlock)reject {
+  // Stop JSI submissions first so nothing new reaches the session being destroyed
+  mls::UnregisterStreamingSession(static_cast<int64_t>(sessionId));
+  std::unique_ptr<mls::LlmSession> session;
+  {
+    std::lock_guard<std::mutex> lock(g_sessions_mutex);
+    auto it = g_sessions.find(static_cast<int64_t>(sessionId));
+    if (it != g_sessions.end()) {
+      session = std::move(it->second);
+      g_sessions.erase(it);
+    }
+  }
+  if (!session) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  session.reset();
+  resolve(nil);
+}
+
+- (void)reset:(double)sessionId resolve:(RCTPromiseResolveBlock)resolve reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  queueSessionUpdate(llm, [llm]() { llm->Reset(); });
+  resolve(nil);
+}
+
+// ===== Text Generation =====
+
+- (void)submitPromptStreaming:(double)sessionId
+                       prompt:(NSString *)prompt
+                  keepHistory:(BOOL)keepHistory
+                     priority:(double)priority
+                      adapter:(NSString *)adapter
+                      resolve:(RCTPromiseResolveBlock)resolve
+                       reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  std::string input = prompt.UTF8String;
+  std::string adapter_path = adapter.UTF8String ?: "";
+  submitGeneration(llm, static_cast<int>(priority),
+                   [llm, input, adapter_path](const auto &on_progress, const mls::CancellationToken &token) {
+                     llm->SelectAdapter(adapter_path);
+                     return llm->Response(input, on_progress, &token);
+                   },
+                   resolve, reject);
+}
+
+- (void)submitImagePromptStreaming:(double)sessionId
+                            prompt:(NSString *)prompt
+                          imageUri:(NSString *)imageUri
+                          priority:(double)priority
+                           adapter:(NSString *)adapter
+                           resolve:(RCTPromiseResolveBlock)resolve
+                            reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  MNN::Transformer::PromptImagePart image;
+  if (!readPromptImage(imageUri, llm->getImageMaxSide(), &image)) {
+    reject(@"INVALID_IMAGE", [NSString stringWithFormat:@"Could not decode %@", imageUri], nil);
+    return;
+  }
+  std::string input = prompt.UTF8String;
+  std::string adapter_path = adapter.UTF8String ?: "";
+  submitGeneration(llm, static_cast<int>(priority),
+                   [llm, input, image, adapter_path](const auto &on_progress, const mls::CancellationToken &token) {
+                     llm->SelectAdapter(adapter_path);
+                     return llm->Response(llm->AttachImage(image) + input, on_progress, &token);
+                   },
+                   resolve, reject);
+}
+
+- (void)submitWithHistoryStreaming:(double)sessionId
+                          messages:(NSArray *)messages
+                          priority:(double)priority
+                           adapter:(NSString *)adapter
+                           resolve:(RCTPromiseResolveBlock)resolve
+                            reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  std::vector<mls::PromptItem> history;
+  for (NSDictionary *message in messages) {
+    NSString *role = message[@"role"];
+    NSString *content = message[@"content"];
+    if ([role isKindOfClass:[NSString class]] && [content isKindOfClass:[NSString class]]) {
+      history.emplace_back(role.UTF8String, content.UTF8String);
+    }
+  }
+  std::string adapter_path = adapter.UTF8String ?: "";
+  submitGeneration(llm, static_cast<int>(priority),
+                   [llm, history = std::move(history), adapter_path](const auto &on_progress,
+                                                                     const mls::CancellationToken &token) {
+                     llm->SelectAdapter(adapter_path);
+                     return llm->ResponseWithHistory(history, on_progress, &token);
+                   },
+                   resolve, reject);
+}
+
+- (NSNumber *)installStreaming {
+  // Installed by the runtime through RCTTurboModuleWithJSIBindings before JS can call this
+  return @(_streamingInstalled.load());
+}
+
+// ===== Configuration Methods =====
+
+- (void)updateMaxNewTokens:(double)sessionId
+                 maxTokens:(double)maxTokens
+                   resolve:(RCTPromiseResolveBlock)resolve
+                    reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  int max_new_tokens = static_cast<int>(maxTokens);
+  queueSessionUpdate(llm, [llm, max_new_tokens]() { llm->SetMaxNewTokens(max_new_tokens); });
+  resolve(nil);
+}
+
+- (void)updateSystemPrompt:(double)sessionId
+              systemPrompt:(NSString *)systemPrompt
+                   resolve:(RCTPromiseResolveBlock)resolve
+                    reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  std::string system_prompt = systemPrompt.UTF8String;
+  queueSessionUpdate(llm, [llm, system_prompt]() { llm->setSystemPrompt(system_prompt); });
+  resolve(nil);
+}
+
+- (void)updateAssistantPrompt:(double)sessionId
+              assistantPrompt:(NSString *)assistantPrompt
+                      resolve:(RCTPromiseResolveBlock)resolve
+                       reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  std::string assistant_prompt = assistantPrompt.UTF8String;
+  queueSessionUpdate(llm, [llm, assistant_prompt]() { llm->SetAssistantPrompt(assistant_prompt); });
+  resolve(nil);
+}
+
+- (void)updateConfig:(double)sessionId
+          configJson:(NSString *)configJson
+             resolve:(RCTPromiseResolveBlock)resolve
+              reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  std::string config_json = configJson.UTF8String;
+  queueSessionUpdate(llm, [llm, config_json]() { llm->updateConfig(config_json); });
+  resolve(nil);
+}
+
+// ===== History =====
+
+- (void)clearHistory:(double)sessionId resolve:(RCTPromiseResolveBlock)resolve reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  queueSessionUpdate(llm, [llm]() { llm->clearHistory(); });
+  resolve(nil);
+}
+
+- (void)saveState:(double)sessionId
+             name:(NSString *)name
+          resolve:(RCTPromiseResolveBlock)resolve
+           reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  // Settled on the worker, after any running generation
+  queueSessionUpdate(llm, [llm, state_name = std::string(name.UTF8String), resolve, reject]() {
+    std::string error;
+    if (llm->SaveState(state_name, &error)) {
+      resolve(nil);
+    } else {
+      reject(@"STATE_ERROR", toNSString(error), nil);
+    }
+  });
+}
+
+- (void)restoreState:(double)sessionId
+                name:(NSString *)name
+             prefill:(BOOL)prefill
+             resolve:(RCTPromiseResolveBlock)resolve
+              reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  queueSessionUpdate(llm, [llm, state_name = std::string(name.UTF8String), prefill, resolve, reject]() {
+    std::string error;
+    if (llm->RestoreState(state_name, prefill, &error)) {
+      resolve(nil);
+    } else {
+      reject(@"STATE_ERROR", toNSString(error), nil);
+    }
+  });
+}
+
+// ===== Information =====
+
+- (void)getSystemPrompt:(double)sessionId resolve:(RCTPromiseResolveBlock)resolve reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  resolve(toNSString(llm->getSystemPrompt()));
+}
+
+- (void)getDebugInfo:(double)sessionId resolve:(RCTPromiseResolveBlock)resolve reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  resolve(toNSString(llm->getDebugInfo()));
+}
+
+// ===== Memory =====
+
+- (void)getMemoryReport:(double)sessionId resolve:(RCTPromiseResolveBlock)resolve reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  resolve(toMemoryDictionary(llm->getMemoryReport()));
+}
+
+- (void)trimMemory:(double)level resolve:(RCTPromiseResolveBlock)resolve reject:(RCTPromiseRejectBlock)reject {
+  trimSessions(static_cast<int>(level));
+  resolve(nil);
+}
+
+// ===== Response Format =====
+
+- (void)setResponseFormat:(double)sessionId
+                     kind:(NSString *)kind
+                     spec:(NSString *)spec
+                  resolve:(RCTPromiseResolveBlock)resolve
+                   reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  // Compiled here so a bad schema is reported to the caller instead of the worker's log
+  std::string error;
+  std::shared_ptr<const mls::Grammar> grammar = mls::CompileResponseFormat(kind.UTF8String, spec.UTF8String, &error);
+  if (!grammar && !error.empty()) {
+    reject(@"INVALID_RESPONSE_FORMAT", toNSString(error), nil);
+    return;
+  }
+  if (grammar && llm->getSpeculativeConfig().enabled) {
+    reject(@"INVALID_RESPONSE_FORMAT", @"constrained output is not available with speculative decoding", nil);
+    return;
+  }
+  queueSessionUpdate(llm, [llm, grammar]() { llm->setGrammar(grammar); });
+  resolve(nil);
+}
+
+// ===== Generation Control =====
+
+- (void)stopGeneration:(double)sessionId resolve:(RCTPromiseResolveBlock)resolve reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  // Cancels the running request and any still queued, checked at every token
+  llm->worker().cancelAll();
+  llm->RequestStop();
+  resolve(nil);
+}
+
+// ===== Audio Output =====
+
+- (void)setAudioOutput:(double)sessionId
+               enabled:(BOOL)enabled
+               resolve:(RCTPromiseResolveBlock)resolve
+                reject:(RCTPromiseRejectBlock)reject {
+  reject(@"UNSUPPORTED", @"Audio output is only available on Android", nil);
+}
+
+// ===== Embedding / Vector Index =====
+
+- (void)initEmbedding:(NSString *)configPath
+               config:(NSString *)config
+              resolve:(RCTPromiseResolveBlock)resolve
+               reject:(RCTPromiseRejectBlock)reject {
+  std::string config_path = configPath.UTF8String;
+  std::string config_str = config.UTF8String;
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+    json embedding_config = config_str.empty() ? json::object() : json::parse(config_str, nullptr, false);
+    if (embedding_config.is_discarded()) {
+      reject(@"INIT_ERROR", @"Invalid config JSON", nil);
+      return;
+    }
+    auto session = std::make_shared<mls::EmbeddingSession>(config_path, embedding_config);
+    if (!session->Load()) {
+      reject(@"INIT_ERROR", @"Failed to load embedding model", nil);
+      return;
+    }
+    int64_t embedding_id = g_next_session_id.fetch_add(1);
+    {
+      std::lock_guard<std::mutex> lock(g_sessions_mutex);
+      g_embeddings[embedding_id] = std::move(session);
+    }
+    resolve(@(embedding_id));
+  });
+}
+
+- (void)releaseEmbedding:(double)embeddingId
+                 resolve:(RCTPromiseResolveBlock)resolve
+                  reject:(RCTPromiseRejectBlock)reject {
+  std::shared_ptr<mls::EmbeddingSession> session;
+  {
+    std::lock_guard<std::mutex> lock(g_sessions_mutex);
+    auto it = g_embeddings.find(static_cast<int64_t>(embeddingId));
+    if (it != g_embeddings.end()) {
+      session = std::move(it->second);
+      g_embeddings.erase(it);
+    }
+  }
+  if (!session) {
+    reject(@"INVALID_SESSION", @"Invalid embedding session ID", nil);
+    return;
+  }
+  resolve(nil);
+}
+
+- (void)embedToIndex:(double)embeddingId
+           indexPath:(NSString *)indexPath
+               texts:(NSArray *)texts
+                 ids:(NSArray *)ids
+             resolve:(RCTPromiseResolveBlock)resolve
+              reject:(RCTPromiseRejectBlock)reject {
+  auto session = findEmbedding(embeddingId);
+  if (!session) {
+    reject(@"INVALID_SESSION", @"Invalid embedding session ID", nil);
+    return;
+  }
+  std::string index_path = indexPath.UTF8String;
+  std::vector<std::string> chunks;
+  std::vector<int64_t> chunk_ids;
+  chunks.reserve(texts.count);
+  chunk_ids.reserve(ids.count);
+  for (id item in texts) {
+    chunks.emplace_back([item isKindOfClass:[NSString class]] ? [item UTF8String] : "");
+  }
+  for (id item in ids) {
+    chunk_ids.push_back([item isKindOfClass:[NSNumber class]] ? [item longLongValue] : 0);
+  }
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+    mls::EmbeddingSession::IndexStats stats;
+    bool ok = session->EmbedToIndex(index_path, chunks, chunk_ids, &stats);
+    NSMutableDictionary *result = [@{
+      @"success" : @(ok),
+      @"count" : @(stats.count),
+      @"dim" : @(stats.dim),
+      @"tokens" : @(stats.tokens),
+      @"embedTimeUs" : @(stats.embed_us),
+      @"indexTimeUs" : @(stats.index_us),
+    } mutableCopy];
+    if (!ok) {
+      result[@"errorMessage"] = @"Failed to embed or write the index";
+    }
+    resolve(result);
+  });
+}
+
+- (void)searchIndex:(double)embeddingId
+          indexPath:(NSString *)indexPath
+              query:(NSString *)query
+                  k:(double)k
+             nprobe:(double)nprobe
+            resolve:(RCTPromiseResolveBlock)resolve
+             reject:(RCTPromiseRejectBlock)reject {
+  auto session = findEmbedding(embeddingId);
+  if (!session) {
+    reject(@"INVALID_SESSION", @"Invalid embedding session ID", nil);
+    return;
+  }
+  std::string index_path = indexPath.UTF8String;
+  std::string query_str = query.UTF8String;
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+    auto hits = session->Search(index_path, query_str, static_cast<int>(k), static_cast<int>(nprobe));
+    NSMutableArray<NSNumber *> *hit_ids = [NSMutableArray arrayWithCapacity:hits.size()];
+    NSMutableArray<NSNumber *> *scores = [NSMutableArray arrayWithCapacity:hits.size()];
+    for (const auto &hit : hits) {
+      [hit_ids addObject:@(hit.id)];
+      [scores addObject:@(hit.score)];
+    }
+    resolve(@{@"ids" : hit_ids, @"scores" : scores});
+  });
+}
+
+- (void)closeIndex:(double)embeddingId
+         indexPath:(NSString *)indexPath
+           resolve:(RCTPromiseResolveBlock)resolve
+            reject:(RCTPromiseRejectBlock)reject {
+  if (auto session = findEmbedding(embeddingId)) {
+    session->CloseIndex(indexPath.UTF8String);
+  }
+  resolve(nil);
+}
+
+// ===== Diagnostics =====
+
+- (void)setTracingEnabled:(BOOL)enabled resolve:(RCTPromiseResolveBlock)resolve reject:(RCTPromiseRejectBlock)reject {
+  mls_trace_set_enabled(enabled);
+  resolve(nil);
+}
+
+- (void)setAsyncLogging:(BOOL)enabled resolve:(RCTPromiseResolveBlock)resolve reject:(RCTPromiseRejectBlock)reject {
+  mls_log_set_async(enabled);
+  resolve(nil);
+}
+
+// ===== Benchmark =====
+
+- (void)runBenchmark:(double)sessionId
+             options:(JS::NativeMnnRn::SpecRunBenchmarkOptions &)options
+             resolve:(RCTPromiseResolveBlock)resolve
+              reject:(RCTPromiseRejectBlock)reject {
+  auto *llm = findSession(sessionId);
+  if (!llm) {
+    reject(@"INVALID_SESSION", @"Invalid session ID", nil);
+    return;
+  }
+  int backend = static_cast<int>(options.backend().value_or(0));
+  int threads = static_cast<int>(options.threads().value_or(4));
+  bool use_mmap = options.useMmap().value_or(false);
+  int power = static_cast<int>(options.power().value_or(0));
+  int precision = static_cast<int>(options.precision().value_or(2));
+  int memory = static_cast<int>(options.memory().value_or(0));
+  int dynamic_option = static_cast<int>(options.dynamicOption().value_or(0));
+  int n_prompt = static_cast<int>(options.nPrompt().value_or(512));
+  int n_generate = static_cast<int>(options.nGenerate().value_or(128));
+  int n_repeat = static_cast<int>(options.nRepeat().value_or(5));
+  bool kv_cache = options.kvCache().value_or(false);
 
-    return result;
+  mls::InferenceWorker::Job job;
+  job.run = [=](const mls::CancellationToken &token) {
+    mls::LlmSession::BenchmarkCallback callback;
+    callback.onProgress = [](const mls::LlmSession::BenchmarkProgressInfo &info) {
+      MNN_DEBUG("runBenchmark: progress=%d %s", info.progress, info.statusMessage.c_str());
+    };
+    callback.onError = [](const std::string &error) { MNN_ERROR("runBenchmark: %s", error.c_str()); };
+    callback.onIterationComplete = [](const std::string &detailed_stats) {
+      MNN_DEBUG("runBenchmark: iteration %s", detailed_stats.c_str());
+    };
+    callback.shouldStop = [&token]() { return token.cancelled(); };
+    auto result = llm->runBenchmark(backend, threads, use_mmap, power, precision, memory, dynamic_option, n_prompt,
+                                    n_generate, n_repeat, kv_cache, callback);
+    resolve(@{
+      @"success" : @(result.success),
+      @"errorMessage" : toNSString(result.error_message),
+      @"promptTokens" : @(result.prompt_tokens),
+      @"generateTokens" : @(result.generate_tokens),
+      @"repeatCount" : @(result.repeat_count),
+      @"kvCacheEnabled" : @(result.kv_cache_enabled),
+      @"prefillTimesUs" : toNSArray(result.prefill_times_us),
+      @"decodeTimesUs" : toNSArray(result.decode_times_us),
+      @"sampleTimesUs" : toNSArray(result.sample_times_us),
+    });
+  };
+  job.on_cancel = [resolve]() { resolve(@{@"success" : @NO, @"errorMessage" : @"Benchmark cancelled"}); };
+  if (llm->worker().submit(std::move(job)) == 0) {
+    reject(@"BENCHMARK_ERROR", @"Inference queue is full", nil);
+  }
 }
 
 - (std::shared_ptr<facebook::react::TurboModule>)getTurboModule:
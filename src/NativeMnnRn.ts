@@ -7,7 +7,9 @@ export interface Spec extends TurboModule {
     modelDir: string,
     chatHistory: string[] | null,
     mergedConfig: string,
-    extraConfig: string
+    extraConfig: string,
+    // Tags the onLlmLoadProgress events of this load
+    loadId: number
   ): Promise<number>;
 
   release(sessionId: number): Promise<void>;
@@ -17,14 +19,29 @@ export interface Spec extends TurboModule {
   submitPromptStreaming(
     sessionId: number,
     prompt: string,
-    keepHistory: boolean
+    keepHistory: boolean,
+    priority: number,
+    adapter: string
+  ): Promise<Object>;
+
+  submitImagePromptStreaming(
+    sessionId: number,
+    prompt: string,
+    imageUri: string,
+    priority: number,
+    adapter: string
   ): Promise<Object>;
 
   submitWithHistoryStreaming(
     sessionId: number,
-    messages: Array<{ role: string; content: string }>
+    messages: Array<{ role: string; content: string }>,
+    priority: number,
+    adapter: string
   ): Promise<Object>;
 
+  // Installs the direct JSI streaming bindings (global.__mnnRnStreaming)
+  installStreaming(): boolean;
+
   // Configuration
   updateMaxNewTokens(sessionId: number, maxTokens: number): Promise<void>;
   updateSystemPrompt(sessionId: number, systemPrompt: string): Promise<void>;
@@ -36,13 +53,69 @@ export interface Spec extends TurboModule {
 
   // History
   clearHistory(sessionId: number): Promise<void>;
+  saveState(sessionId: number, name: string): Promise<void>;
+  restoreState(
+    sessionId: number,
+    name: string,
+    prefill: boolean
+  ): Promise<void>;
 
   // Information
   getSystemPrompt(sessionId: number): Promise<string>;
   getDebugInfo(sessionId: number): Promise<string>;
 
+  // Memory: native usage by category, and a trim at an onTrimMemory level for every session
+  getMemoryReport(sessionId: number): Promise<Object>;
+  trimMemory(level: number): Promise<void>;
+
+  // Constrained output for later requests: kind 'json_schema' | 'grammar' | 'json' | 'text'
+  setResponseFormat(sessionId: number, kind: string, spec: string): Promise<void>;
+
   // Generation control
   stopGeneration(sessionId: number): Promise<void>;
+
+  // Audio output (TTS playback from the native PCM ring)
+  setAudioOutput(sessionId: number, enabled: boolean): Promise<void>;
+
+  // Diagnostics
+  setTracingEnabled(enabled: boolean): Promise<void>;
+  setAsyncLogging(enabled: boolean): Promise<void>;
+
+  // Embedding / vector index (vectors stay native)
+  initEmbedding(configPath: string, config: string): Promise<number>;
+  releaseEmbedding(embeddingId: number): Promise<void>;
+  embedToIndex(
+    embeddingId: number,
+    indexPath: string,
+    texts: string[],
+    ids: number[]
+  ): Promise<Object>;
+  searchIndex(
+    embeddingId: number,
+    indexPath: string,
+    query: string,
+    k: number,
+    nprobe: number
+  ): Promise<Object>;
+  closeIndex(embeddingId: number, indexPath: string): Promise<void>;
+
+  // Benchmark
+  runBenchmark(
+    sessionId: number,
+    options: {
+      backend?: number;
+      threads?: number;
+      useMmap?: boolean;
+      power?: number;
+      precision?: number;
+      memory?: number;
+      dynamicOption?: number;
+      nPrompt?: number;
+      nGenerate?: number;
+      nRepeat?: number;
+      kvCache?: boolean;
+    }
+  ): Promise<Object>;
 }
 
 export default TurboModuleRegistry.getEnforcing<Spec>('MnnRn');
@@ -1,4 +1,4 @@
-import { DeviceEventEmitter } from 'react-native';
+import { DeviceEventEmitter, Platform } from 'react-native';
 import type { EmitterSubscription } from 'react-native';
 import MnnRnNative from './NativeMnnRn';
 
@@ -13,6 +13,112 @@ export interface LlmSessionConfig {
   mergedConfig?: string;
   extraConfig?: string;
   chatHistory?: string[];
+  streamFlush?: StreamFlushPolicy;
+  kvPrefixReuse?: boolean;
+  promptSnapshot?: boolean;
+  shareModel?: boolean;
+  requestQueueSize?: number;
+  backend?: LlmBackend;
+  threadPolicy?: boolean;
+  debugCapture?: number;
+  speculative?: SpeculativeDecoding;
+  loraCacheBytes?: number;
+  contextWindow?: ContextWindow;
+  prefillChunkTokens?: number;
+  prefetchWeights?: boolean;
+  warmup?: boolean;
+  memoryBudgetBytes?: number;
+  kvCache?: KvCacheOptions;
+  imageMaxSide?: number;
+  thermalGovernor?: ThermalGovernorOptions;
+  stop?: StopOptions;
+}
+
+/**
+ * Token budget for the conversation. Before each prompt the oldest turns after
+ * the system prompt are evicted until the templated prompt fits in
+ * `maxTokens - reserveTokens`. 'summarize' folds the evicted turns into a short
+ * summary appended to the system prompt (session history only; histories passed
+ * to submitWithHistory are always windowed).
+ */
+export interface ContextWindow {
+  maxTokens: number;
+  /** Kept free for the reply (default: maxTokens / 4) */
+  reserveTokens?: number;
+  policy?: 'sliding_window' | 'summarize';
+  /** Longest summary generated when policy is 'summarize' (default: 128) */
+  summaryTokens?: number;
+}
+
+/**
+ * KV cache layout. 'int8' stores keys as int8 and values as fp8, about half of
+ * fp16; 'fp16' runs the model at low precision, which the cache follows.
+ * 'reserve' grows the cache to `reserveTokens` once at load so later turns do
+ * not reallocate it; 'grow' (default) extends it as the conversation grows.
+ * `spill` keeps the cache in a file under mmap_dir once it passes
+ * `spillLimitMb` per layer.
+ */
+export interface KvCacheOptions {
+  precision?: 'auto' | 'fp16' | 'int8';
+  allocation?: 'grow' | 'reserve';
+  /** Default: contextWindow.maxTokens, else 4096 */
+  reserveTokens?: number;
+  spill?: boolean;
+  spillLimitMb?: number;
+}
+
+/**
+ * Paces decode while the device is warm or in battery saver, so long replies
+ * settle at a rate the device can hold instead of running into thermal
+ * throttling. From 'light' (or battery saver) decode is held at
+ * `sustainedTokensPerSecond`, from 'severe' at half of it. Left unset, the rate
+ * is 75% of the decode speed measured while the device was cool.
+ */
+export interface ThermalGovernorOptions {
+  sustainedTokensPerSecond?: number;
+}
+
+/**
+ * Where a reply ends besides the model's own stop tokens. A reply ends as soon
+ * as one of `sequences` appears in its text, even across tokens, and the
+ * sequence is left out of it. A token in `tokenIds` ends the reply without
+ * being emitted.
+ */
+export interface StopOptions {
+  sequences?: string[];
+  tokenIds?: number[];
+}
+
+/**
+ * Speculative decoding: each decode step drafts up to `draftLength` tokens and
+ * verifies them in one forward pass. 'lookahead' drafts from n-grams of the
+ * prompt and output so far (any model); 'mtp' uses the model's multi-token
+ * prediction heads (models exported with them).
+ */
+export interface SpeculativeDecoding {
+  type: 'lookahead' | 'mtp';
+  draftLength?: number;
+  /** Lookahead only: longest n-gram matched against the context */
+  ngramMatchMaxLen?: number;
+  /** Lookahead only: how strictly a draft must match ('low' | 'medium' | 'high') */
+  matchStrictness?: 'low' | 'medium' | 'high';
+}
+
+/**
+ * Compute backend. 'auto' picks the first GPU backend available on the device
+ * (Metal, OpenCL, then Vulkan); any GPU choice falls back to CPU if it cannot load.
+ */
+export type LlmBackend = 'auto' | 'cpu' | 'opencl' | 'vulkan' | 'metal';
+
+/**
+ * Controls how generated text is coalesced natively before it crosses the
+ * bridge. A chunk is emitted as soon as any enabled threshold is reached;
+ * 0 disables a threshold. Defaults to one chunk per token.
+ */
+export interface StreamFlushPolicy {
+  maxBytes?: number;
+  maxTokens?: number;
+  maxMs?: number;
 }
 
 export interface LlmMessage {
@@ -25,11 +131,177 @@ export interface LlmMetrics {
   decodeLen: number;
   prefillTime: number;
   decodeTime: number;
+  reusedTokens?: number;
+  prefixCacheHits?: number;
+  prefixCacheMisses?: number;
+  /** True when stopGeneration() ended or dropped this request */
+  cancelled?: boolean;
+  /** Request start to first generated token, in microseconds */
+  ttftUs?: number;
+  /** Inter-token latency percentiles in microseconds (~20% bucket resolution) */
+  interTokenP50Us?: number;
+  interTokenP90Us?: number;
+  interTokenP99Us?: number;
+  /** Time spent delivering chunks across the bridge, in microseconds */
+  callbackTimeUs?: number;
+  /** Time inside the decode step excluding chunk delivery, in microseconds */
+  generateTimeUs?: number;
+  sampleTimeUs?: number;
+  /** Prompt tokens actually prefilled (not reused from the KV cache) */
+  prefilledTokens?: number;
+  /** Forward passes the prefill was split into (prefillChunkTokens) */
+  prefillChunks?: number;
+  /** Decode forward passes after the first token */
+  decodeSteps?: number;
+  /** Tokens emitted per decode forward pass; above 1 with speculative decoding */
+  tokensPerStep?: number;
+  /** Accepted share of the drafted tokens (0 without speculative decoding) */
+  draftAcceptanceRate?: number;
+  /** Switching to the request's LoRA adapter, including loading it on first use, in microseconds */
+  adapterSwitchUs?: number;
+  /** Messages evicted by the context window before this request */
+  evictedMessages?: number;
+  /** Estimated prompt tokens left after applying the context window (0 when it is off) */
+  contextTokens?: number;
+  /** Templating and tokenizing the prompt, in microseconds */
+  tokenizeUs?: number;
+  /** Tokens held in the KV cache after this request */
+  kvCacheTokens?: number;
+  /** Estimated bytes of those tokens at the cache's precision */
+  kvCacheBytes?: number;
+  /** Tokens the response format made the model redraw */
+  grammarResampledTokens?: number;
+  /** Building and applying the response format's token masks, in microseconds */
+  grammarMaskUs?: number;
+  /** Decode time the thermal governor spent pacing, in microseconds */
+  thermalWaitUs?: number;
+}
+
+/**
+ * Constrains replies to a JSON schema, a GBNF grammar (llama.cpp syntax, with
+ * a `root` rule) or any JSON object. Schemas support type, properties and
+ * required, items, enum, const, anyOf / oneOf and local $ref; length, range,
+ * pattern and format keywords are not enforced.
+ */
+export type ResponseFormat =
+  | { type: 'json_schema'; schema: object | string }
+  | { type: 'grammar'; grammar: string }
+  | { type: 'json' }
+  | { type: 'text' };
+
+export interface BenchmarkOptions {
+  /** MNN forward type: 0 = CPU, 1 = Metal, 3 = OpenCL, 7 = Vulkan */
+  backend?: number;
+  /** 0 = size and pin prefill/decode threads from the CPU topology for `power` */
+  threads?: number;
+  useMmap?: boolean;
+  /** 0 = normal, 1 = high, 2 = low */
+  power?: number;
+  /** 0 = normal, 1 = high, 2 = low */
+  precision?: number;
+  /** 0 = normal, 1 = high, 2 = low */
+  memory?: number;
+  dynamicOption?: number;
+  nPrompt?: number;
+  nGenerate?: number;
+  nRepeat?: number;
+  kvCache?: boolean;
+}
+
+export interface BenchmarkProgress {
+  progress: number;
+  statusMessage: string;
+  progressType: number;
+  currentIteration: number;
+  totalIterations: number;
+  nPrompt: number;
+  nGenerate: number;
+  runTimeSeconds: number;
+  prefillTimeSeconds: number;
+  decodeTimeSeconds: number;
+  prefillSpeed: number;
+  decodeSpeed: number;
+}
+
+export interface BenchmarkResult {
+  success: boolean;
+  errorMessage: string;
+  promptTokens: number;
+  generateTokens: number;
+  repeatCount: number;
+  kvCacheEnabled: boolean;
+  prefillTimesUs: number[];
+  decodeTimesUs: number[];
+  sampleTimesUs: number[];
+  /** Android: the libMNN build in use, e.g. 'MNN_dotprod' ('MNN' for the baseline) */
+  mnnVariant?: string;
+}
+
+/**
+ * Native memory of a session. Session figures are a snapshot taken after the
+ * last request, load or trim; the process figures are read on each call.
+ */
+export interface MemoryReport {
+  /** Resident memory of the whole app (physical footprint on iOS) */
+  residentBytes: number;
+  /** Native heap in use; 0 where the platform does not report it */
+  nativeHeapBytes: number;
+  /** Model files in use; a shared model is counted by each session */
+  weightBytes: number;
+  /** Estimated from kvTokens and the model's layer and head sizes */
+  kvCacheBytes: number;
+  kvTokens: number;
+  adapterBytes: number;
+  tokenCacheBytes: number;
+  /** memoryBudgetBytes, 0 when unset */
+  budgetBytes: number;
+  /** False after a trim released the model; the next prompt loads it again */
+  loaded: boolean;
+  shared: boolean;
+  lastTrim: 'none' | 'caches' | 'adapters' | 'kv_cache' | 'unload';
+}
+
+export interface EmbeddingIndexResult {
+  success: boolean;
+  errorMessage?: string;
+  /** Chunks embedded and written; chunks that failed to embed are skipped */
+  count: number;
+  dim: number;
+  tokens: number;
+  embedTimeUs: number;
+  indexTimeUs: number;
+}
+
+export interface VectorSearchResult {
+  /** Chunk ids, best match first */
+  ids: number[];
+  /** Cosine similarity of each id to the query */
+  scores: number[];
 }
 
 export type ChunkCallback = (chunk: string) => void;
 export type MetricsCallback = (metrics: LlmMetrics) => void;
 export type ErrorCallback = (error: string) => void;
+export type BenchmarkProgressCallback = (progress: BenchmarkProgress) => void;
+/** Prompt tokens prefilled so far out of `total` */
+export type PrefillProgressCallback = (done: number, total: number) => void;
+export type ThermalStateCallback = (state: ThermalState) => void;
+
+/**
+ * A finished step of model loading. 'weights' covers the tokenizer and the
+ * weights, which MNN loads in one call; 'warm' covers backend tuning and the
+ * warmup or system prompt prefill, and is only sent when one of those ran.
+ */
+export interface LoadProgress {
+  stage: 'config' | 'weights' | 'warm' | 'ready' | 'failed';
+  /** Rough completion percentage */
+  progress: number;
+  /** Since the load started */
+  elapsedMs: number;
+  /** Weight bytes advised for read-ahead so far (prefetchWeights) */
+  prefetchedBytes: number;
+}
+export type LoadProgressCallback = (progress: LoadProgress) => void;
 
 // ===== Event Types =====
 export interface LlmChunkEvent {
@@ -47,6 +319,86 @@ export interface LlmErrorEvent {
   error: string;
 }
 
+export interface LlmLoadProgressEvent extends LoadProgress {
+  loadId: number;
+}
+
+export interface LlmPrefillProgressEvent {
+  sessionId: number;
+  done: number;
+  total: number;
+}
+
+export type ThermalStatus =
+  | 'none'
+  | 'light'
+  | 'moderate'
+  | 'severe'
+  | 'critical'
+  | 'emergency'
+  | 'shutdown';
+
+export interface ThermalState {
+  status: ThermalStatus;
+  powerSave: boolean;
+  /** 'none' runs flat out, 'sustain' holds the sustained rate, 'cool' half of it */
+  level: 'none' | 'sustain' | 'cool';
+  /** Decode rate being held, 0 at level 'none' */
+  targetTokensPerSecond: number;
+  measuredTokensPerSecond: number;
+}
+
+export interface LlmThermalStateEvent extends ThermalState {
+  sessionId: number;
+}
+
+export interface BenchmarkProgressEvent extends BenchmarkProgress {
+  sessionId: number;
+}
+
+// ===== Direct Streaming =====
+
+/**
+ * Bindings installed natively on the JS runtime. Chunks and metrics are passed
+ * straight to the callbacks instead of going through the event emitter.
+ * A returned job id of 0 means the session's request queue is full.
+ */
+interface StreamingBindings {
+  submitPrompt(
+    sessionId: number,
+    prompt: string,
+    keepHistory: boolean,
+    priority: number,
+    onChunk: ChunkCallback,
+    onComplete: MetricsCallback,
+    adapter: string
+  ): number;
+  submitWithHistory(
+    sessionId: number,
+    messages: LlmMessage[],
+    priority: number,
+    onChunk: ChunkCallback,
+    onComplete: MetricsCallback,
+    adapter: string
+  ): number;
+}
+
+let streamingBindings: StreamingBindings | null | undefined;
+let nextLoadId = 1;
+
+function getStreamingBindings(): StreamingBindings | null {
+  if (streamingBindings === undefined) {
+    try {
+      streamingBindings = MnnRnNative.installStreaming()
+        ? ((globalThis as any).__mnnRnStreaming ?? null)
+        : null;
+    } catch {
+      streamingBindings = null;
+    }
+  }
+  return streamingBindings ?? null;
+}
+
 // ===== MnnLlmSession Class =====
 
 export class MnnLlmSession {
@@ -68,6 +420,26 @@ export class MnnLlmSession {
    * @param config.mergedConfig - JSON config for MNN (optional)
    * @param config.extraConfig - Additional JSON config (optional)
    * @param config.chatHistory - Initial chat history (optional)
+   * @param config.streamFlush - Native chunk coalescing policy (optional)
+   * @param config.kvPrefixReuse - Only prefill the part of the conversation not already in the KV cache (default: false)
+   * @param config.promptSnapshot - Prefill the system prompt during init, cached under mmap_dir (default: false)
+   * @param config.shareModel - Share loaded weights with other sessions of the same model (default: false)
+   * @param config.backend - Compute backend policy (optional; default: backend_type from mergedConfig, else CPU)
+   * @param config.threadPolicy - Pick thread count and core affinity per phase from the CPU topology (default: false)
+   * @param config.requestQueueSize - Prompts that may wait for this session before new ones are rejected (default: 8)
+   * @param config.debugCapture - Keep the last N prompts and replies for getDebugInfo (default: 0, off)
+   * @param config.speculative - Speculative decoding mode and draft length (optional; default: off)
+   * @param config.loraCacheBytes - Budget for LoRA adapters kept loaded, least recently used evicted first (default: 256 MB)
+   * @param config.contextWindow - Token budget and eviction policy for the conversation (optional; default: unbounded)
+   * @param config.prefillChunkTokens - Prefill long prompts in chunks of this many tokens, so stop works mid-prefill and progress is reported (default: 0, one pass)
+   * @param config.prefetchWeights - Read the weight files ahead on a background thread while the model loads (default: true)
+   * @param config.warmup - Run one token through the model before init resolves, so the first prompt starts warm (default: false)
+   * @param config.kvCache - KV cache precision, allocation and spilling (optional; default: the model config)
+   * @param config.imageMaxSide - Longest side image prompts are scaled down to before the vision encoder (default: 1024)
+   * @param config.thermalGovernor - Pace decode while the device is warm or in battery saver (optional; default: off)
+   * @param config.stop - Stop sequences and token ids that end a reply (optional; default: the model's stop tokens)
+   * @param config.memoryBudgetBytes - Drop idle adapters, then the KV cache, before a prompt when they hold more than this (default: 0, no budget)
+   * @param onLoadProgress - Called as each load stage finishes (Android)
    *
    * @throws Error if initialization fails or session is already initialized
    *
@@ -81,7 +453,7 @@ export class MnnLlmSession {
    * });
    * ```
    */
-  async init(config: LlmSessionConfig): Promise<void> {
+  async init(config: LlmSessionConfig, onLoadProgress?: LoadProgressCallback): Promise<void> {
     if (this.isInitialized) {
       throw new Error('Session is already initialized');
     }
@@ -94,6 +466,25 @@ export class MnnLlmSession {
       mergedConfig,
       extraConfig,
       chatHistory = [],
+      streamFlush,
+      kvPrefixReuse = false,
+      promptSnapshot = false,
+      shareModel = false,
+      requestQueueSize = 8,
+      backend,
+      threadPolicy = false,
+      debugCapture = 0,
+      speculative,
+      loraCacheBytes,
+      contextWindow,
+      prefillChunkTokens = 0,
+      prefetchWeights = true,
+      warmup = false,
+      memoryBudgetBytes,
+      kvCache,
+      imageMaxSide,
+      thermalGovernor,
+      stop,
     } = config;
 
     // Build merged config
@@ -108,19 +499,109 @@ export class MnnLlmSession {
     const defaultExtraConfig = {
       keep_history: keepHistory,
       mmap_dir: '',
+      kv_prefix_reuse: kvPrefixReuse,
+      prompt_snapshot: promptSnapshot,
+      share_model: shareModel,
+      request_queue_size: requestQueueSize,
+      thread_policy: threadPolicy,
+      debug_capture: debugCapture,
+      prefill_chunk_tokens: prefillChunkTokens,
+      prefetch_weights: prefetchWeights,
+      warmup,
+      ...(loraCacheBytes !== undefined && { lora_cache_bytes: loraCacheBytes }),
+      ...(kvCache && {
+        kv_cache: {
+          precision: kvCache.precision ?? 'auto',
+          allocation: kvCache.allocation ?? 'grow',
+          ...(kvCache.reserveTokens !== undefined && {
+            reserve_tokens: kvCache.reserveTokens,
+          }),
+          spill: kvCache.spill ?? false,
+          ...(kvCache.spillLimitMb !== undefined && {
+            spill_limit_mb: kvCache.spillLimitMb,
+          }),
+        },
+      }),
+      ...(imageMaxSide !== undefined && { image_max_side: imageMaxSide }),
+      ...(thermalGovernor && {
+        thermal_governor: {
+          sustained_tokens_per_s: thermalGovernor.sustainedTokensPerSecond ?? 0,
+        },
+      }),
+      ...(stop && {
+        stop: {
+          sequences: stop.sequences ?? [],
+          token_ids: stop.tokenIds ?? [],
+        },
+      }),
+      ...(memoryBudgetBytes !== undefined && {
+        memory_budget_bytes: memoryBudgetBytes,
+      }),
+      ...(contextWindow && {
+        context: {
+          max_tokens: contextWindow.maxTokens,
+          policy: contextWindow.policy ?? 'sliding_window',
+          ...(contextWindow.reserveTokens !== undefined && {
+            reserve_tokens: contextWindow.reserveTokens,
+          }),
+          ...(contextWindow.summaryTokens !== undefined && {
+            summary_tokens: contextWindow.summaryTokens,
+          }),
+        },
+      }),
+      ...(speculative && {
+        speculative: {
+          type: speculative.type,
+          draft_length: speculative.draftLength ?? 4,
+          ...(speculative.ngramMatchMaxLen !== undefined && {
+            ngram_match_maxlen: speculative.ngramMatchMaxLen,
+          }),
+          ...(speculative.matchStrictness && {
+            draft_match_strictness: speculative.matchStrictness,
+          }),
+        },
+      }),
+      ...(backend && { backend }),
+      ...(streamFlush && {
+        stream_flush: {
+          max_bytes: streamFlush.maxBytes ?? 0,
+          max_tokens: streamFlush.maxTokens ?? 1,
+          max_ms: streamFlush.maxMs ?? 0,
+        },
+      }),
     };
 
     const extraConfigStr = extraConfig || JSON.stringify(defaultExtraConfig);
 
+    // Stage events can arrive after init resolves, so the listener goes with the last stage
+    const loadId = nextLoadId++;
+    const loadListener: EmitterSubscription | null =
+      onLoadProgress && Platform.OS === 'android'
+        ? DeviceEventEmitter.addListener(
+            'onLlmLoadProgress',
+            ({ loadId: id, ...progress }: LlmLoadProgressEvent) => {
+              if (id !== loadId) {
+                return;
+              }
+              onLoadProgress(progress);
+              if (progress.stage === 'ready' || progress.stage === 'failed') {
+                loadListener?.remove();
+              }
+            }
+          )
+        : null;
+
     try {
       this.sessionId = await MnnRnNative.init(
         modelDir,
         chatHistory.length > 0 ? chatHistory : null,
         mergedConfigStr,
-        extraConfigStr
+        extraConfigStr,
+        loadId
       );
       this.isInitialized = true;
     } catch (error) {
+      loadListener?.remove();
       throw new Error(`Failed to initialize session: ${error}`);
     }
   }
@@ -197,6 +678,48 @@ export class MnnLlmSession {
     }
   }
 
+  /**
+   * Run a request through the direct streaming bindings, or return null when
+   * they are not installed so the caller falls back to events.
+   */
+  private streamDirect(
+    submit: (
+      bindings: StreamingBindings,
+      onChunk: ChunkCallback,
+      onDone: MetricsCallback
+    ) => number,
+    onChunk?: ChunkCallback,
+    onComplete?: MetricsCallback,
+    onError?: ErrorCallback
+  ): Promise<LlmMetrics> | null {
+    const bindings = getStreamingBindings();
+    if (!bindings) {
+      return null;
+    }
+    this.removeAllListeners();
+    return new Promise<LlmMetrics>((resolve, reject) => {
+      const jobId = submit(
+        bindings,
+        (chunk) => {
+          if (onChunk && !this.stopRequested) {
+            onChunk(chunk);
+          }
+        },
+        (metrics) => {
+          if (onComplete && !this.stopRequested) {
+            onComplete(metrics);
+          }
+          resolve(metrics);
+        }
+      );
+      if (jobId === 0) {
+        const message = 'Too many requests are waiting for this session';
+        onError?.(message);
+        reject(Object.assign(new Error(message), { code: 'QUEUE_FULL' }));
+      }
+    });
+  }
+
   /**
    * Remove all event listeners
    */
@@ -234,6 +757,8 @@ export class MnnLlmSession {
    * @param onChunk - Optional callback for each generated text chunk (streaming)
    * @param onComplete - Optional callback when generation completes with metrics
    * @param onError - Optional callback for error handling
+   * @param priority - Queue priority; higher runs first when prompts wait on the session (default: 0)
+   * @param adapter - LoRA adapter file to answer with, loaded onto the base model on first use (default: base model)
    * @returns Promise<LlmMetrics> - Resolves with final generation metrics
    *
    * @example
@@ -256,13 +781,34 @@ export class MnnLlmSession {
     keepHistory: boolean,
     onChunk?: ChunkCallback,
     onComplete?: MetricsCallback,
-    onError?: ErrorCallback
+    onError?: ErrorCallback,
+    priority: number = 0,
+    adapter: string = ''
   ): Promise<LlmMetrics> {
     this.ensureInitialized();
 
     // Reset stop flag when starting new generation
     this.stopRequested = false;
 
+    const direct = this.streamDirect(
+      (bindings, chunk, done) =>
+        bindings.submitPrompt(
+          this.sessionId!,
+          prompt,
+          keepHistory,
+          priority,
+          chunk,
+          done,
+          adapter
+        ),
+      onChunk,
+      onComplete,
+      onError
+    );
+    if (direct) {
+      return direct;
+    }
+
     // Set up event listeners
     this.setupListeners(onChunk, onComplete, onError);
 
@@ -270,7 +816,37 @@ export class MnnLlmSession {
     return (await MnnRnNative.submitPromptStreaming(
       this.sessionId!,
       prompt,
-      keepHistory
+      keepHistory,
+      priority,
+      adapter
+    )) as LlmMetrics;
+  }
+
+  /**
+   * Submit a prompt about an image, for multimodal models. The image is
+   * decoded natively from a file path, file:// or (Android) content:// URI and
+   * scaled to fit imageMaxSide; the prompt follows it in the user turn.
+   */
+  async submitImagePrompt(
+    prompt: string,
+    imageUri: string,
+    onChunk?: ChunkCallback,
+    onComplete?: MetricsCallback,
+    onError?: ErrorCallback,
+    priority: number = 0,
+    adapter: string = ''
+  ): Promise<LlmMetrics> {
+    this.ensureInitialized();
+    this.stopRequested = false;
+
+    this.setupListeners(onChunk, onComplete, onError);
+
+    return (await MnnRnNative.submitImagePromptStreaming(
+      this.sessionId!,
+      prompt,
+      imageUri,
+      priority,
+      adapter
     )) as LlmMetrics;
   }
 
@@ -281,16 +857,38 @@ export class MnnLlmSession {
     messages: LlmMessage[],
     onChunk?: ChunkCallback,
     onComplete?: MetricsCallback,
-    onError?: ErrorCallback
+    onError?: ErrorCallback,
+    priority: number = 0,
+    adapter: string = ''
   ): Promise<LlmMetrics> {
     this.ensureInitialized();
 
+    const direct = this.streamDirect(
+      (bindings, chunk, done) =>
+        bindings.submitWithHistory(
+          this.sessionId!,
+          messages,
+          priority,
+          chunk,
+          done,
+          adapter
+        ),
+      onChunk,
+      onComplete,
+      onError
+    );
+    if (direct) {
+      return direct;
+    }
+
     // Set up event listeners
     this.setupListeners(onChunk, onComplete, onError);
 
     return (await MnnRnNative.submitWithHistoryStreaming(
       this.sessionId!,
-      messages
+      messages,
+      priority,
+      adapter
     )) as LlmMetrics;
   }
 
@@ -326,6 +924,16 @@ export class MnnLlmSession {
     await MnnRnNative.updateConfig(this.sessionId!, configJson);
   }
 
+  /**
+   * Play speech synthesized by audio-capable (omni) models as it is generated.
+   * Samples go from the model into a native ring buffer that the player reads
+   * in place. Android only.
+   */
+  async setAudioOutput(enabled: boolean): Promise<void> {
+    this.ensureInitialized();
+    await MnnRnNative.setAudioOutput(this.sessionId!, enabled);
+  }
+
   /**
    * Clear the conversation history.
    *
@@ -343,6 +951,38 @@ export class MnnLlmSession {
     await MnnRnNative.clearHistory(this.sessionId!);
   }
 
+  /**
+   * Save the conversation as `name` under mmap_dir: system prompt, turns,
+   * summary, attached images and the conversation's token ids. Waits for a
+   * running generation to finish.
+   *
+   * @param name - File name of the state: letters, digits, '-', '_' and '.'
+   */
+  async saveState(name: string): Promise<void> {
+    this.ensureInitialized();
+    await MnnRnNative.saveState(this.sessionId!, name);
+  }
+
+  /**
+   * Replace the conversation with the one saved as `name`. With
+   * `kvPrefixReuse`, `prefill` rebuilds the KV cache from the saved token ids
+   * once the session is idle, so the next prompt only prefills its own turn.
+   *
+   * @param name - Name the state was saved under
+   * @param options.prefill - Prefill the restored conversation in the background (default: true)
+   */
+  async restoreState(
+    name: string,
+    options: { prefill?: boolean } = {}
+  ): Promise<void> {
+    this.ensureInitialized();
+    await MnnRnNative.restoreState(
+      this.sessionId!,
+      name,
+      options.prefill ?? true
+    );
+  }
+
   /**
    * Get current system prompt
    */
@@ -359,6 +999,53 @@ export class MnnLlmSession {
     return await MnnRnNative.getDebugInfo(this.sessionId!);
   }
 
+  /**
+   * Constrain the replies of the requests that follow to a format, until it is
+   * set again; `null` or `{ type: 'text' }` lets the model generate freely.
+   * Generation stops as soon as the reply is complete. Rejects if the schema or
+   * grammar does not compile, or with speculative decoding enabled.
+   *
+   * @example
+   * ```typescript
+   * await session.setResponseFormat({
+   *   type: 'json_schema',
+   *   schema: {
+   *     type: 'object',
+   *     properties: { tool: { enum: ['search', 'weather'] }, query: { type: 'string' } },
+   *     required: ['tool', 'query'],
+   *   },
+   * });
+   * let reply = '';
+   * await session.submitPrompt('Weather in Paris?', true, (chunk) => (reply += chunk));
+   * const call = JSON.parse(reply);
+   * ```
+   */
+  async setResponseFormat(format: ResponseFormat | null): Promise<void> {
+    this.ensureInitialized();
+    let spec = '';
+    if (format?.type === 'json_schema') {
+      spec =
+        typeof format.schema === 'string'
+          ? format.schema
+          : JSON.stringify(format.schema);
+    } else if (format?.type === 'grammar') {
+      spec = format.grammar;
+    }
+    await MnnRnNative.setResponseFormat(
+      this.sessionId!,
+      format?.type ?? 'text',
+      spec
+    );
+  }
+
+  /**
+   * Native memory held by this session and the app, by category
+   */
+  async getMemoryReport(): Promise<MemoryReport> {
+    this.ensureInitialized();
+    return (await MnnRnNative.getMemoryReport(this.sessionId!)) as MemoryReport;
+  }
+
   /**
    * Stop the current text generation immediately.
    *
@@ -386,6 +1073,90 @@ export class MnnLlmSession {
     }
   }
 
+  /**
+   * Subscribe to prefill progress of this session's requests. Reported after
+   * each chunk when `prefillChunkTokens` splits a prompt (Android).
+   *
+   * @param callback - Receives prompt tokens prefilled so far and the total
+   * @returns Subscription; call `remove()` to unsubscribe
+   */
+  onPrefillProgress(callback: PrefillProgressCallback): EmitterSubscription {
+    return DeviceEventEmitter.addListener(
+      'onLlmPrefillProgress',
+      (event: LlmPrefillProgressEvent) => {
+        if (event.sessionId === this.sessionId) {
+          callback(event.done, event.total);
+        }
+      }
+    );
+  }
+
+  /**
+   * Subscribe to the thermal governor of this session (`thermalGovernor`).
+   * Called when it starts, changes or stops pacing decode (Android).
+   *
+   * @param callback - Receives the thermal status and the rate being held
+   * @returns Subscription; call `remove()` to unsubscribe
+   */
+  onThermalState(callback: ThermalStateCallback): EmitterSubscription {
+    return DeviceEventEmitter.addListener(
+      'onLlmThermalState',
+      ({ sessionId, ...state }: LlmThermalStateEvent) => {
+        if (sessionId === this.sessionId) {
+          callback(state);
+        }
+      }
+    );
+  }
+
+  /**
+   * Run a llama-bench style benchmark on the loaded model.
+   *
+   * Runs one warmup round followed by `nRepeat` rounds of a synthetic
+   * `nPrompt`-token prefill and `nGenerate`-token decode. The model is
+   * reloaded with the requested runtime options when they differ from the
+   * current ones, and restored afterwards. Can be interrupted with `stop()`.
+   *
+   * @param options - Benchmark options
+   * @param onProgress - Optional callback for per-iteration progress
+   * @returns Promise<BenchmarkResult> - Per-iteration timings in microseconds
+   *
+   * @example
+   * ```typescript
+   * const result = await session.runBenchmark(
+   *   { nPrompt: 512, nGenerate: 128, nRepeat: 5, threads: 4 },
+   *   (p) => console.log(p.statusMessage, p.decodeSpeed.toFixed(1), 'tok/s')
+   * );
+   * ```
+   */
+  async runBenchmark(
+    options: BenchmarkOptions = {},
+    onProgress?: BenchmarkProgressCallback
+  ): Promise<BenchmarkResult> {
+    this.ensureInitialized();
+    this.stopRequested = false;
+
+    const progressListener = onProgress
+      ? DeviceEventEmitter.addListener(
+          'onBenchmarkProgress',
+          (event: BenchmarkProgressEvent) => {
+            if (event.sessionId === this.sessionId) {
+              onProgress(event);
+            }
+          }
+        )
+      : null;
+
+    try {
+      return (await MnnRnNative.runBenchmark(
+        this.sessionId!,
+        options
+      )) as BenchmarkResult;
+    } finally {
+      progressListener?.remove();
+    }
+  }
+
   /**
    * Ensure session is initialized
    * @private
@@ -432,8 +1203,152 @@ export function createMnnLlmSession(): MnnLlmSession {
   return new MnnLlmSession();
 }
 
+// ===== MnnEmbeddingSession Class =====
+
+/**
+ * Sentence-embedding model with on-disk vector indexes for retrieval.
+ *
+ * Chunks are embedded and indexed natively in a single call, and searches
+ * return only ids and scores, so vectors never cross the bridge. An index is
+ * a single IVF file (clustered inverted lists) that is memory-mapped for
+ * search; adding chunks re-clusters it. Keep your own id → chunk mapping.
+ *
+ * @example
+ * ```typescript
+ * const embedder = createMnnEmbeddingSession();
+ * await embedder.init('/sdcard/models/bge-small/config.json');
+ * await embedder.embedToIndex(indexPath, chunks, chunks.map((_, i) => i));
+ * const { ids } = await embedder.search(indexPath, 'What is MNN?', 5);
+ * ```
+ */
+export class MnnEmbeddingSession {
+  private embeddingId: number | null = null;
+
+  /**
+   * Load an embedding model.
+   *
+   * @param configPath - Path to the model's config.json
+   * @param config - MNN config overrides such as backend_type or thread_num (optional)
+   */
+  async init(configPath: string, config?: object): Promise<void> {
+    if (this.embeddingId !== null) {
+      throw new Error('Embedding session is already initialized');
+    }
+    try {
+      this.embeddingId = await MnnRnNative.initEmbedding(
+        configPath,
+        config ? JSON.stringify(config) : ''
+      );
+    } catch (error) {
+      throw new Error(`Failed to initialize embedding session: ${error}`);
+    }
+  }
+
+  async release(): Promise<void> {
+    const id = this.ensureInitialized();
+    this.embeddingId = null;
+    await MnnRnNative.releaseEmbedding(id);
+  }
+
+  /**
+   * Embed `texts[i]` under `ids[i]` and add them to the index at
+   * `indexPath`, creating it when missing. Ids already in the index are
+   * replaced. Pass whole documents' worth of chunks per call.
+   */
+  async embedToIndex(
+    indexPath: string,
+    texts: string[],
+    ids: number[]
+  ): Promise<EmbeddingIndexResult> {
+    const id = this.ensureInitialized();
+    if (texts.length !== ids.length) {
+      throw new Error('texts and ids must have the same length');
+    }
+    return (await MnnRnNative.embedToIndex(
+      id,
+      indexPath,
+      texts,
+      ids
+    )) as EmbeddingIndexResult;
+  }
+
+  /**
+   * Return the `k` chunks most similar to `query`.
+   *
+   * @param nprobe - Inverted lists to scan; higher is more exact and slower
+   *   (default: 0, about a quarter of the lists)
+   */
+  async search(
+    indexPath: string,
+    query: string,
+    k: number,
+    nprobe: number = 0
+  ): Promise<VectorSearchResult> {
+    const id = this.ensureInitialized();
+    return (await MnnRnNative.searchIndex(
+      id,
+      indexPath,
+      query,
+      k,
+      nprobe
+    )) as VectorSearchResult;
+  }
+
+  /**
+   * Unmap an index before deleting or replacing its file.
+   */
+  async closeIndex(indexPath: string): Promise<void> {
+    const id = this.ensureInitialized();
+    await MnnRnNative.closeIndex(id, indexPath);
+  }
+
+  private ensureInitialized(): number {
+    if (this.embeddingId === null) {
+      throw new Error('Embedding session is not initialized. Call init() first.');
+    }
+    return this.embeddingId;
+  }
+}
+
+export function createMnnEmbeddingSession(): MnnEmbeddingSession {
+  return new MnnEmbeddingSession();
+}
+
+/**
+ * Emit ATrace sections (load, prefill, each decode step, stream and bridge
+ * callbacks) so model work shows up in Perfetto / systrace captures.
+ * Process-wide; off by default and free when off.
+ */
+export async function setTracingEnabled(enabled: boolean): Promise<void> {
+  await MnnRnNative.setTracingEnabled(enabled);
+}
+
+/**
+ * Queue native log lines in a ring buffer written to logcat by a background
+ * thread, so logging never blocks generation. Lines are dropped when the
+ * buffer is full. Process-wide; off by default.
+ */
+export async function setAsyncLogging(enabled: boolean): Promise<void> {
+  await MnnRnNative.setAsyncLogging(enabled);
+}
+
+/**
+ * Shed memory in every session as onTrimMemory would at `level`
+ * (ComponentCallbacks2.TRIM_MEMORY_*). Sessions already respond to the system's
+ * own callbacks on Android and memory warnings on iOS; this is for app-level
+ * pressure such as before loading a large asset.
+ */
+export async function trimMemory(level: number): Promise<void> {
+  await MnnRnNative.trimMemory(level);
+}
+
 // Export everything
 export default {
   MnnLlmSession,
   createMnnLlmSession,
+  MnnEmbeddingSession,
+  createMnnEmbeddingSession,
+  setTracingEnabled,
+  setAsyncLogging,
+  trimMemory,
 };